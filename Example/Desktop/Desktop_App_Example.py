@@ -3,6 +3,7 @@
 import SerialSession
 import platform
 import os
+import sys
 import re
 import time
 import random
@@ -48,8 +49,9 @@ if __name__ == '__main__':
     # ---------- Application Setup ----------
     # ---------------------------------------
 
-    # get a list of the ports available on the machine
-    testPorts = getPorts()
+    # get a list of the ports available on the machine, or use the ports
+    # given on the command line (such as the pty of the host build)
+    testPorts = sys.argv[1:] if len(sys.argv) > 1 else getPorts()
 
     # test if there are no ports
     if len(testPorts) == 0:
@@ -113,6 +115,6 @@ if __name__ == '__main__':
     
     # disconnect
     if Stm32Session is not None:
-        del Stm32Session
+        Stm32Session.close()
         # and report disconnection
         print('Disconnected from port {}'.format(availablePort))
@@ -1,11 +1,20 @@
 # Author: Kevin Imlay
 
+import select
 import serial
 
+# termios is only on POSIX systems, where the character size a port took can be
+# read back.
+try:
+    import termios
+except ImportError:
+    termios = None
+
 
 # Defines communication parameters.  Same as what has been programmed to MCU.
 DEFAULT_BAUD = 9600
 DEFAULT_BYTESIZE = serial.SEVENBITS
+DEFAULT_BINARY_BYTESIZE = serial.EIGHTBITS
 DEFAULT_PARITY = serial.PARITY_NONE
 DEFAULT_STOPBITS = serial.STOPBITS_TWO
 DEFAULT_READ_TIMEOUT = 0.7
@@ -16,6 +25,11 @@ DEFAULT_DSRDTR_FLOW_CONTRL = False
 DEFAULT_INTER_BYTE_TIMEOUT = None
 DEFAULT_EXCLUSIVE = False
 
+# Encodings of characters on the wire, for text and for binary payloads.  Latin-1
+# maps each of the 256 byte values to the character of the same code.
+TEXT_ENCODING = 'ascii'
+BINARY_ENCODING = 'latin-1'
+
 
 class SerialConnection:
     # Serial Connection encapsulates the most basic functions for sending and
@@ -24,29 +38,41 @@ class SerialConnection:
 
     # serial connection parameters
     _connection = None
+    # encoding of characters on the wire
+    _encoding = TEXT_ENCODING
 
 
-    def __init__(self):
+    def __init__(self, rtscts=DEFAULT_RTSCTS_FLOW_CONTRL, binary=False):
         # Initialize new connection object with defualt serial parameters.
-        # These parameters are what are also programmed into the MCU.
+        # These parameters are what are also programmed into the MCU.  If
+        # rtscts is True, hardware RTS/CTS flow control is used, which the MCU
+        # must be built for (UART_HW_FLOW_CONTROL).  If binary is True,
+        # characters are 8-bit and may take any byte value, for binary
+        # payloads (UART_PAYLOAD_BINARY).
         #
         # Raises a ValueError if a value is out of range
 
+        # Test for valid rtscts and binary parameters.
+        if not isinstance(rtscts, bool): raise TypeError
+        if not isinstance(binary, bool): raise TypeError
+
         # Create new serial object
         self._connection = serial.Serial()
 
         # Set parameters for serial communication.
         self._connection.baudrate = DEFAULT_BAUD
-        self._connection.bytesize = DEFAULT_BYTESIZE
+        self._connection.bytesize = DEFAULT_BINARY_BYTESIZE if binary \
+            else DEFAULT_BYTESIZE
         self._connection.parity = DEFAULT_PARITY
         self._connection.stopbits = DEFAULT_STOPBITS
         self._connection.timeout = DEFAULT_READ_TIMEOUT
         self._connection.write_timeout = DEFAULT_WRITE_TIMEOUT
         self._connection.xonxoff = DEFAULT_SOFT_FLOW_CONTRL
-        self._connection.rtscts = DEFAULT_RTSCTS_FLOW_CONTRL
+        self._connection.rtscts = rtscts
         self._connection.dsrdtr = DEFAULT_DSRDTR_FLOW_CONTRL
         self._connection.inter_byte_timeout = DEFAULT_INTER_BYTE_TIMEOUT
         self._connection.exclusive = DEFAULT_EXCLUSIVE
+        self._encoding = BINARY_ENCODING if binary else TEXT_ENCODING
 
 
     def openPort(self, port):
@@ -64,6 +90,33 @@ class SerialConnection:
         # Try to open connection.
         self._connection.open()
 
+        # Go on with the character size the port took.
+        self._matchCharacterSize()
+
+
+    def _matchCharacterSize(self):
+        # Sets the connection's character size to the one the open port has.
+        # A port with only 8-bit characters, such as the pseudo-terminal of
+        # the MCU's host build, keeps them when opened for 7-bit ones, and
+        # then refuses (EINVAL) every later reconfiguration asking for 7-bit
+        # ones again, so changing the baud rate or the read timeout fails.
+        # Text is 7-bit, so it is sent and received the same either way.
+        # Nothing changes on a port that took the size asked for, or where
+        # the size cannot be read back.
+        if termios is None:
+            return
+        sizes = {termios.CS5: serial.FIVEBITS, termios.CS6: serial.SIXBITS,
+            termios.CS7: serial.SEVENBITS, termios.CS8: serial.EIGHTBITS}
+        cflag = termios.tcgetattr(self._connection.fileno())[2]
+        taken = sizes[cflag & termios.CSIZE]
+        if taken != self._connection.bytesize:
+            self._connection.bytesize = taken
+
+
+    def hardwareFlowControl(self):
+        # Returns if hardware RTS/CTS flow control is used.
+        return self._connection.rtscts
+
 
     def closePort(self):
         # Alias to close serial connection.
@@ -72,9 +125,24 @@ class SerialConnection:
         self._connection.close()
 
 
+    def setBaudRate(self, baudRate, readTimeout):
+        # Changes the baud rate of the serial connection, and the read timeout
+        # to go with it.  Takes effect immediately if the port is open.
+        #
+        # Raises a ValueError if a value is out of range.
+
+        # Test for valid parameters.
+        if not isinstance(baudRate, int): raise TypeError
+
+        # Set parameters for serial communication.
+        self._connection.baudrate = baudRate
+        self._connection.timeout = readTimeout
+
+
     def send(self, message):
         # Alias to send a message over the serial connection.  The message
-        # must be a string that can be encoded to ASCII.
+        # must be a string that can be encoded to ASCII, or to single bytes
+        # for a binary connection.
         #
         # Raises a serial.SerialException if the connection is not open.
 
@@ -84,10 +152,46 @@ class SerialConnection:
         # Encode message and send message.  Ensure message is sent before 
         # continuing.
         # print('  ::SENDING::  ' + message)
-        self._connection.write(message.encode('ascii'))
+        self._connection.write(message.encode(self._encoding))
         self._connection.flush()
 
 
+    def waitReceive(self, timeout):
+        # Waits up to timeout seconds for a character to be received, without
+        # reading it.  Returns if one has been.  Only for POSIX systems, as the
+        # serial port is waited on with select().
+        #
+        # Raises a serial.SerialException if the connection is not open.
+
+        # Test for valid timeout parameter.
+        if not isinstance(timeout, (int, float)): raise TypeError
+
+        # Wait on the port unless a character is already waiting.
+        if self._connection.in_waiting > 0:
+            return True
+        ready, _, _ = select.select([self._connection.fileno()], [], [],
+            max(timeout, 0))
+        return len(ready) > 0
+
+
+    def receiveUntil(self, terminator, maxLength):
+        # Alias to receive a message from the serial connection up to and
+        # including a terminator character, or until maxLength characters or
+        # the read timeout.  The terminator must be a single character string.
+        #
+        # Raises a serial.SerialException if the connection is not open.
+
+        # Test for valid parameters.
+        if not isinstance(terminator, str): raise TypeError
+        if not isinstance(maxLength, int): raise TypeError
+        if maxLength < 1: raise ValueError
+
+        # Read from the serial connection, decode, and return string.
+        received = self._connection.read_until(
+            terminator.encode(self._encoding), maxLength).decode(self._encoding)
+        return received
+
+
     def receive(self, length):
         # Alias to receive a message from the serial connection.  The length
         # must be an integer greater than 0.
@@ -99,6 +203,6 @@ class SerialConnection:
         if length < 1: raise ValueError
 
         # Read from the serial connection, decode, and return string.
-        received = self._connection.read(length).decode('ascii')
+        received = self._connection.read(length).decode(self._encoding)
         # print('  ::RECEIVING::  ' + received)
         return received
@@ -3,6 +3,10 @@
 # Defines the character to postfix a packet's body segment with.
 EMPTY_CHAR = '\0'
 
+# Defines the character that ends a COBS frame.  A COBS frame contains no
+# other occurence of it.
+FRAME_DELIMITER = '\0'
+
 
 # Messages for exceptions.
 MISCOUTED_PARAMETERS_MSG = '''An invalid number of parameters 
@@ -31,6 +35,19 @@ class SerialPacket:
     # achieve this, the body must not exceed O-N characters, and the body
     # is postfixed with null characters if it does not consume the full
     # O-N length.
+    #
+    # A packet can also be formatted as a variable-length COBS frame, which
+    # the MCU expects when built with UART_FRAMING_COBS.  The frame is the
+    # header, one character holding the body length, and the body, encoded
+    # with Consistent Overhead Byte Stuffing so that it holds no null
+    # characters, followed by a null character delimiting the frame.  No
+    # padding is sent.
+    #
+    # For binary payloads, the body may hold null characters, so it is not
+    # ended at the first one.  A fixed-length packet is formatted as the
+    # header, one character holding the body length and the body, padded to
+    # the packet length.  The MCU expects this when built with
+    # UART_PAYLOAD_BINARY.
 
     # Packet parameters.
     # Expected length of the packet
@@ -139,6 +156,30 @@ class SerialPacket:
         return formatStr
 
 
+    def formatFrame(self):
+        # Formats the packet into a COBS frame string from the header and body
+        # texts.  The body is not padded.
+
+        # add header, body length and body, then encode and delimit
+        return cobsEncode(self._headerText + chr(len(self._bodyText))
+            + self._bodyText) + FRAME_DELIMITER
+
+
+    def formatBinary(self):
+        # Formats the packet into one string from the header text, the body
+        # length and the body text, padded until the packet length is reached.
+        #
+        # Raises a ValueError if the body does not fit with its length.
+
+        # add header, body length and body
+        formatStr = self._headerText + chr(len(self._bodyText)) \
+            + self._bodyText
+        if len(formatStr) > self._packetLength: raise ValueError
+
+        # postfix null characters and return formatted string
+        return formatStr + EMPTY_CHAR * (self._packetLength - len(formatStr))
+
+
     def __str__(self):
         # Helpful definition of how to print this object.
 
@@ -171,3 +212,111 @@ class SerialPacket:
         return self._packetLength == other._packetLength \
         and self._headerText == other._headerText \
             and self._bodyText == other._bodyText
+
+
+def parseFrame(packetLength, headerLength, frameString, binary=False):
+    # Parses a COBS frame string, with or without its delimiter, into a
+    # SerialPacket object.  A binary body is kept whole.
+    #
+    # Raises a ValueError if the frame is malformed.
+
+    # Check parameters.
+    if not isinstance(frameString, str): raise TypeError
+
+    # Remove delimiter and decode.
+    decoded = cobsDecode(frameString.rstrip(FRAME_DELIMITER))
+
+    # Split into header, body length and body, checking the body length.
+    if len(decoded) < headerLength + 1: raise ValueError
+    headerText = decoded[:headerLength]
+    bodyText = decoded[headerLength + 1:]
+    if ord(decoded[headerLength]) != len(bodyText): raise ValueError
+
+    # Create packet.  A text body may be padded with null characters by the
+    # sender; only the padding is removed, as with a fixed-length packet the
+    # body is passed on whole (a packed body may hold null characters).
+    if not binary:
+        bodyText = bodyText.rstrip(EMPTY_CHAR)
+    return SerialPacket(packetLength, headerLength, headerText, bodyText)
+
+
+def parseBinary(packetLength, headerLength, packetString):
+    # Parses a fixed-length packet string formatted by formatBinary() into a
+    # SerialPacket object.
+    #
+    # Raises a ValueError if the packet is malformed.
+
+    # Check parameters.
+    if not isinstance(packetString, str): raise TypeError
+    if len(packetString) != packetLength: raise ValueError
+
+    # Split into header, body length and body, checking the body length.
+    bodyLength = ord(packetString[headerLength])
+    if headerLength + 1 + bodyLength > packetLength: raise ValueError
+
+    # Create packet.
+    return SerialPacket(packetLength, headerLength, packetString[:headerLength],
+        packetString[headerLength + 1:headerLength + 1 + bodyLength])
+
+
+def cobsEncode(data):
+    # Encodes a string with Consistent Overhead Byte Stuffing.  Each null
+    # character is replaced with the distance to the next one (or to the
+    # end), and a first character gives the distance to the first one.
+    # Strings longer than 253 characters are not supported, as packets
+    # are far shorter.
+
+    # Split on null characters and prefix each block with its distance.
+    encoded = ''
+    for block in data.split(FRAME_DELIMITER):
+        encoded += chr(len(block) + 1) + block
+
+    # return encoded string
+    return encoded
+
+
+def cobsDecode(encoded):
+    # Decodes a string encoded by cobsEncode(), without its delimiter.
+    #
+    # Raises a ValueError if the string is not validly encoded.
+
+    # Follow the chain of distances, putting back null characters.
+    blocks = []
+    index = 0
+    while index < len(encoded):
+        distance = ord(encoded[index])
+        if distance == 0 or index + distance > len(encoded): raise ValueError
+        blocks.append(encoded[index + 1:index + distance])
+        index += distance
+
+    # An empty string has no blocks to decode.
+    if not blocks: raise ValueError
+
+    # return decoded string
+    return FRAME_DELIMITER.join(blocks)
+
+
+def unpackSevenBit(chars, count):
+    # Unpacks count bytes from a string of 7-bit characters, as packed by the
+    # MCU's packSevenBit():  the bytes' bits in order, least significant bit
+    # first, 7 to a character.  Missing characters (stripped padding) are
+    # taken as null characters.
+    #
+    # Raises a ValueError if a character is not 7-bit.
+
+    # Gather the characters' bits, emitting a byte for every 8.
+    data = bytearray()
+    accumulator = 0
+    bits = 0
+    chars = chars.ljust((count * 8 + 6) // 7, EMPTY_CHAR)
+    for char in chars:
+        if ord(char) > 0x7F: raise ValueError
+        accumulator |= ord(char) << bits
+        bits += 7
+        if bits >= 8 and len(data) < count:
+            data.append(accumulator & 0xFF)
+            accumulator >>= 8
+            bits -= 8
+
+    # return unpacked bytes
+    return bytes(data)
@@ -45,16 +45,23 @@
 
 /* Private variables ---------------------------------------------------------*/
 UART_HandleTypeDef huart2;
+DMA_HandleTypeDef hdma_usart2_rx;
+DMA_HandleTypeDef hdma_usart2_tx;
 
 /* USER CODE BEGIN PV */
 
+static int blueLedOn = false;
+
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
 static void MX_GPIO_Init(void);
+static void MX_DMA_Init(void);
 static void MX_USART2_UART_Init(void);
 /* USER CODE BEGIN PFP */
 
+DesktopComSessionStatus toggleBlueLed(const PacketView* message, void* context);
+
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
@@ -70,9 +77,7 @@ int main(void)
 {
   /* USER CODE BEGIN 1 */
 
-  char message_command_buffer[UART_PACKET_HEADER_SIZE];
-  char message_payload_buffer[UART_PACKET_PAYLOAD_SIZE];
-  int blueLedOn = false;
+  PacketView received;
 
   /* USER CODE END 1 */
 
@@ -91,12 +96,16 @@ int main(void)
 
   /* Initialize all configured peripherals */
   MX_GPIO_Init();
+  MX_DMA_Init();
   MX_USART2_UART_Init();
   /* USER CODE BEGIN 2 */
 
   // initialize the Desktop App Communication
   desktopAppSession_init(&huart2);
 
+  // "LED/0" commands are dispatched to their handler by the session updates
+  desktopAppSession_registerHandler("LED\0", toggleBlueLed, NULL);
+
   /* USER CODE END 2 */
 
   /* Infinite loop */
@@ -119,40 +128,10 @@ int main(void)
 	// update the session manager
 	desktopAppSession_update();
 
-	// get message from desktop if there is one
-	if (desktopAppSession_dequeueMessage(message_command_buffer, message_payload_buffer) == SESSION_OKAY)
+	// messages with no handler are not used, free their slots for the next one
+	if (desktopAppSession_peekMessage(&received) == SESSION_OKAY)
 	{
-		// if the command is "LED/0" and payload is "toggle blue LED\0", toggle the blue LED
-		if (!strncmp(message_command_buffer, "LED\0", UART_PACKET_HEADER_SIZE)
-				&& !strncmp(message_payload_buffer, "toggle blue LED\0", UART_PACKET_PAYLOAD_SIZE))
-		{
-			if (!blueLedOn)
-			{
-				// turn led on
-				activate_led(BLUE_LED);
-				blueLedOn = 1;
-
-				// report it to desktop
-				memset(message_payload_buffer, 0, sizeof(char) * UART_PACKET_PAYLOAD_SIZE);
-				strncpy(message_payload_buffer, "blue LED is now on\0", sizeof(char) * UART_PACKET_PAYLOAD_SIZE);
-				desktopAppSession_enqueueMessage("LED/0", message_payload_buffer);
-				// Note that this only enqueues the message to be sent the next time
-				// desktopAppSession_update() is called.
-			}
-			else
-			{
-				// turn led off
-				deactivate_led(BLUE_LED);
-				blueLedOn = 0;
-
-				// report it to desktop
-				memset(message_payload_buffer, 0, sizeof(char) * UART_PACKET_PAYLOAD_SIZE);
-				strncpy(message_payload_buffer, "blue LED is now off\0", sizeof(char) * UART_PACKET_PAYLOAD_SIZE);
-				desktopAppSession_enqueueMessage("LED/0", message_payload_buffer);
-				// Note that this only enqueues the message to be sent the next time
-				// desktopAppSession_update() is called.
-			}
-		}
+		desktopAppSession_releaseMessage();
 	}
 
   }
@@ -184,8 +163,7 @@ static void MX_USART2_UART_Init(void)
   huart2.Init.OverSampling = UART_OVERSAMPLING_16;
   huart2.Init.OneBitSampling = UART_ONE_BIT_SAMPLE_DISABLE;
   huart2.Init.ClockPrescaler = UART_PRESCALER_DIV1;
-  huart2.AdvancedInit.AdvFeatureInit = UART_ADVFEATURE_RXOVERRUNDISABLE_INIT;
-  huart2.AdvancedInit.OverrunDisable = UART_ADVFEATURE_OVERRUN_DISABLE;
+  huart2.AdvancedInit.AdvFeatureInit = UART_ADVFEATURE_NO_INIT;
   if (HAL_UART_Init(&huart2) != HAL_OK)
   {
     Error_Handler();
@@ -208,6 +186,23 @@ static void MX_USART2_UART_Init(void)
 
 }
 
+/**
+  * Enable DMA controller clock
+  */
+static void MX_DMA_Init(void)
+{
+
+  /* DMA controller clock enable */
+  __HAL_RCC_DMAMUX1_CLK_ENABLE();
+  __HAL_RCC_DMA1_CLK_ENABLE();
+
+  /* DMA interrupt init */
+  /* DMA1_Channel1_2_3_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Channel1_2_3_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel1_2_3_IRQn);
+
+}
+
 /**
   * @brief GPIO Initialization Function
   * @param None
@@ -227,6 +222,50 @@ static void MX_GPIO_Init(void)
 
 /* USER CODE BEGIN 4 */
 
+/* toggleBlueLed
+ *
+ * Handler for "LED/0" commands.  If the payload is "toggle blue LED" and nothing
+ * more, toggles the blue LED and reports it to the desktop, building the message in
+ * place in the tx queue.  The LED is left as it is until a tx slot is free for the
+ * report.
+ *
+ * Note that the report is only enqueued, to be sent as the session is updated.
+ */
+DesktopComSessionStatus toggleBlueLed(const PacketView* message, void* context)
+{
+  PacketView reply;
+
+  // the whole command, and no more (the payload is zeroed past the length received)
+  if (message->length < strlen("toggle blue LED")
+    || memcmp(message->payload, "toggle blue LED", sizeof("toggle blue LED")) != 0)
+  {
+    return SESSION_OKAY;
+  }
+
+  if (desktopAppSession_acquireMessage(&reply, SESSION_PRIORITY_URGENT) != SESSION_OKAY)
+  {
+    return SESSION_BUFFER_FULL;
+  }
+
+  if (!blueLedOn)
+  {
+    // turn led on
+    activate_led(BLUE_LED);
+    blueLedOn = 1;
+  }
+  else
+  {
+    // turn led off
+    deactivate_led(BLUE_LED);
+    blueLedOn = 0;
+  }
+
+  memcpy(reply.header, "LED/0", UART_PACKET_HEADER_SIZE);
+  strncpy((char*)reply.payload, blueLedOn ? "blue LED is now on\0" : "blue LED is now off\0", reply.length);
+  desktopAppSession_commitMessage();
+  return SESSION_OKAY;
+}
+
 /* USER CODE END 4 */
 
 /**
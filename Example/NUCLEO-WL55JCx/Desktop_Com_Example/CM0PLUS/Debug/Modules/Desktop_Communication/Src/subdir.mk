@@ -5,17 +5,26 @@
 
 # Add inputs and outputs from these tool invocations to the build variables 
 C_SRCS += \
+../Modules/Desktop_Communication/Src/command_table.c \
 ../Modules/Desktop_Communication/Src/desktop_app_session.c \
+../Modules/Desktop_Communication/Src/packet_queue.c \
+../Modules/Desktop_Communication/Src/rtt_estimator.c \
 ../Modules/Desktop_Communication/Src/uart_packet_helpers.c \
 ../Modules/Desktop_Communication/Src/uart_transport_layer.c 
 
 OBJS += \
+./Modules/Desktop_Communication/Src/command_table.o \
 ./Modules/Desktop_Communication/Src/desktop_app_session.o \
+./Modules/Desktop_Communication/Src/packet_queue.o \
+./Modules/Desktop_Communication/Src/rtt_estimator.o \
 ./Modules/Desktop_Communication/Src/uart_packet_helpers.o \
 ./Modules/Desktop_Communication/Src/uart_transport_layer.o 
 
 C_DEPS += \
+./Modules/Desktop_Communication/Src/command_table.d \
 ./Modules/Desktop_Communication/Src/desktop_app_session.d \
+./Modules/Desktop_Communication/Src/packet_queue.d \
+./Modules/Desktop_Communication/Src/rtt_estimator.d \
 ./Modules/Desktop_Communication/Src/uart_packet_helpers.d \
 ./Modules/Desktop_Communication/Src/uart_transport_layer.d 
 
@@ -27,7 +36,7 @@ Modules/Desktop_Communication/Src/%.o Modules/Desktop_Communication/Src/%.su Mod
 clean: clean-Modules-2f-Desktop_Communication-2f-Src
 
 clean-Modules-2f-Desktop_Communication-2f-Src:
-	-$(RM) ./Modules/Desktop_Communication/Src/desktop_app_session.cyclo ./Modules/Desktop_Communication/Src/desktop_app_session.d ./Modules/Desktop_Communication/Src/desktop_app_session.o ./Modules/Desktop_Communication/Src/desktop_app_session.su ./Modules/Desktop_Communication/Src/uart_packet_helpers.cyclo ./Modules/Desktop_Communication/Src/uart_packet_helpers.d ./Modules/Desktop_Communication/Src/uart_packet_helpers.o ./Modules/Desktop_Communication/Src/uart_packet_helpers.su ./Modules/Desktop_Communication/Src/uart_transport_layer.cyclo ./Modules/Desktop_Communication/Src/uart_transport_layer.d ./Modules/Desktop_Communication/Src/uart_transport_layer.o ./Modules/Desktop_Communication/Src/uart_transport_layer.su
+	-$(RM) ./Modules/Desktop_Communication/Src/command_table.cyclo ./Modules/Desktop_Communication/Src/command_table.d ./Modules/Desktop_Communication/Src/command_table.o ./Modules/Desktop_Communication/Src/command_table.su ./Modules/Desktop_Communication/Src/desktop_app_session.cyclo ./Modules/Desktop_Communication/Src/desktop_app_session.d ./Modules/Desktop_Communication/Src/desktop_app_session.o ./Modules/Desktop_Communication/Src/desktop_app_session.su ./Modules/Desktop_Communication/Src/packet_queue.cyclo ./Modules/Desktop_Communication/Src/packet_queue.d ./Modules/Desktop_Communication/Src/packet_queue.o ./Modules/Desktop_Communication/Src/packet_queue.su ./Modules/Desktop_Communication/Src/rtt_estimator.cyclo ./Modules/Desktop_Communication/Src/rtt_estimator.d ./Modules/Desktop_Communication/Src/rtt_estimator.o ./Modules/Desktop_Communication/Src/rtt_estimator.su ./Modules/Desktop_Communication/Src/uart_packet_helpers.cyclo ./Modules/Desktop_Communication/Src/uart_packet_helpers.d ./Modules/Desktop_Communication/Src/uart_packet_helpers.o ./Modules/Desktop_Communication/Src/uart_packet_helpers.su ./Modules/Desktop_Communication/Src/uart_transport_layer.cyclo ./Modules/Desktop_Communication/Src/uart_transport_layer.d ./Modules/Desktop_Communication/Src/uart_transport_layer.o ./Modules/Desktop_Communication/Src/uart_transport_layer.su
 
 .PHONY: clean-Modules-2f-Desktop_Communication-2f-Src
 
@@ -0,0 +1,137 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ *
+ * Purpose:
+ *		A fixed-size hash table of packet header codes, for dispatching received
+ *	packets by their header in constant time rather than comparing the header
+ *	against every known code in turn.
+ *		A header code's UART_PACKET_HEADER_SIZE bytes are packed into a uint32_t
+ *	ID, with COMMAND_ID() for codes known at compile time (an integer constant,
+ *	usable in case labels and initializers) or commandId() for a received header.
+ *	IDs are placed by open addressing with linear probing:  a lookup hashes the
+ *	ID to a slot and compares IDs from there, which is one compare unless IDs
+ *	collide.  The table only maps IDs to slot indexes; the user keeps what each
+ *	slot dispatches to (handlers, contexts) in arrays of the table's size.
+ *		The size is set at compile time and must be a power of two (up to 65536)
+ *	so that slots wrap with a mask.  Keeping the table no more than half full
+ *	keeps probes short.
+ *
+ *	Note:  IDs are never removed.  The all-zero header code is not a valid ID.
+ */
+
+#ifndef INC_COMMAND_TABLE_H_
+#define INC_COMMAND_TABLE_H_
+
+
+#include <stdint.h>
+#include <uart_packet_helpers.h>
+
+
+_Static_assert(UART_PACKET_HEADER_SIZE == 4, "header codes must pack into a uint32_t");
+
+/*
+ * Packs the four characters of a header code into its ID, first character in the
+ * least significant byte (the order the bytes sit in memory on a little-endian MCU).
+ */
+#define COMMAND_ID(a, b, c, d) ((uint32_t)(uint8_t)(a) | ((uint32_t)(uint8_t)(b) << 8) \
+		| ((uint32_t)(uint8_t)(c) << 16) | ((uint32_t)(uint8_t)(d) << 24))
+
+/*
+ * ID of a free slot (the all-zero header code), and the slot index returned when
+ * an ID is not found or cannot be inserted.
+ */
+#define COMMAND_ID_FREE 0
+#define COMMAND_SLOT_NONE UINT32_MAX
+
+/*
+ * State of a command table.  Declare tables with COMMAND_TABLE_DEFINE() rather than
+ * directly.
+ */
+typedef struct {
+	uint32_t* ids;		// ID held by each slot, COMMAND_ID_FREE if free
+	uint32_t mask;		// size - 1, for wrapping slot indexes
+	uint32_t count;		// number of slots in use
+} CommandTable;
+
+/*
+ * Defines a file-scope static command table and its storage.
+ *
+ * Parameters:
+ * 	name - identifier of the CommandTable variable.
+ * 	size - number of slots, must be a power of two.
+ */
+#define COMMAND_TABLE_DEFINE(name, size) \
+	_Static_assert((size) > 0 && ((size) & ((size) - 1)) == 0 && (size) <= 65536, \
+			"command table size must be a power of two, at most 65536"); \
+	static uint32_t name##_ids[(size)]; \
+	static CommandTable name = { name##_ids, (size) - 1, 0 }
+
+
+/* commandId
+ *
+ * Function:
+ * 	Packs a header code into its ID, as COMMAND_ID() does.
+ *
+ * Parameters:
+ * 	header - byte buffer pointer to the header code.
+ *
+ * Return:
+ * 	uint32_t - ID of the header code.
+ */
+uint32_t commandId(const uint8_t header[UART_PACKET_HEADER_SIZE]);
+
+/* commandTable_reset
+ *
+ * Function:
+ * 	Frees every slot of the table.
+ *
+ * Parameters:
+ * 	table - pointer to the table.
+ */
+void commandTable_reset(CommandTable* table);
+
+/* commandTable_count
+ *
+ * Function:
+ * 	Returns the number of IDs held in the table.
+ *
+ * Parameters:
+ * 	table - pointer to the table.
+ *
+ * Return:
+ * 	uint32_t - number of IDs held.
+ */
+uint32_t commandTable_count(const CommandTable* table);
+
+/* commandTable_insert
+ *
+ * Function:
+ * 	Finds the slot of an ID, placing the ID in a free slot if it is not held yet.
+ *
+ * Parameters:
+ * 	table - pointer to the table.
+ * 	id - ID to insert.
+ *
+ * Return:
+ * 	uint32_t - slot index of the ID, or COMMAND_SLOT_NONE if the ID is
+ * 			COMMAND_ID_FREE or the table is full.
+ */
+uint32_t commandTable_insert(CommandTable* table, uint32_t id);
+
+/* commandTable_find
+ *
+ * Function:
+ * 	Finds the slot of an ID.
+ *
+ * Parameters:
+ * 	table - pointer to the table.
+ * 	id - ID to find.
+ *
+ * Return:
+ * 	uint32_t - slot index of the ID, or COMMAND_SLOT_NONE if it is not held.
+ */
+uint32_t commandTable_find(const CommandTable* table, uint32_t id);
+
+
+#endif /* INC_COMMAND_TABLE_H_ */
@@ -0,0 +1,204 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ *
+ * Purpose:
+ *		Records when each packet is queued, transmitted, received, dispatched
+ *	and delivered, and other events of the transport and session layers, into
+ *	a ring of SESSION_TRACE_DEPTH entries, so a latency spike can be followed
+ *	through both layers after the fact.  An entry is 8 bytes:  the time, read
+ *	from the profile's time source (see stage_profile.h), the event, and two
+ *	small arguments.  The oldest entries are overwritten.  The desktop
+ *	application reads the ring with the session's TRAC command (see
+ *	desktop_app_session.h).
+ *		Events are recorded with TRACE_EVENT(), TRACE_HEADER() and
+ *	TRACE_FRAME(), from the main context or interrupts.  Recording masks
+ *	interrupts for the few stores of an entry.
+ *
+ *		Only built if SESSION_TRACE is defined at build time.  Otherwise the
+ *	macros are empty, so the events cost nothing.
+ *
+ *	Note:  Times are 32-bit and wrap (every 4.3 s on a host, in nanoseconds, and
+ *	every 89 s at 48 MHz on the cores), so the time between two entries is only
+ *	known if it is shorter.
+ */
+
+#ifndef INC_EVENT_TRACE_H_
+#define INC_EVENT_TRACE_H_
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/*
+ * Number of entries the ring holds.  Must be a power of two.
+ */
+#ifndef SESSION_TRACE_DEPTH
+#define SESSION_TRACE_DEPTH 128
+#endif
+
+/*
+ * Events.  The arguments of each are given as (arg, value).
+ */
+typedef enum {
+	TRACE_TX_QUEUE = 1,		// Packet queued (lane, first two header characters)
+	TRACE_TX_START,			// Frame transmission started (lane, frame length)
+	TRACE_TX_DONE,			// Frame transmitted (lane, 0)
+	TRACE_TX_REWIND,		// Window rewound to resend (0, packets resent)
+	TRACE_RX_FRAME,			// Frame received and queued (payload length, first two header characters)
+	TRACE_RX_DISCARD,		// Bytes discarded (TraceDiscard, number of bytes)
+	TRACE_UART_ERROR,		// UART error (0, HAL error code)
+	TRACE_DISPATCH,			// Message taken from the rx queue (handled, first two header characters)
+	TRACE_DELIVER,			// Message taken by the application (0, first two header characters)
+	TRACE_SESSION,			// Session state entered (state, 0)
+	TRACE_TIMEOUT,			// CTS window timed out (0, 0)
+	TRACE_EVENTS			// Number of events, plus one
+} TraceEvent;
+
+/*
+ * Lanes, the arg of the tx events.
+ */
+typedef enum {
+	TRACE_LANE_BULK,
+	TRACE_LANE_URGENT,
+	TRACE_LANE_CONTROL
+} TraceLane;
+
+/*
+ * Why bytes were discarded, the arg of TRACE_RX_DISCARD.
+ */
+typedef enum {
+	TRACE_DISCARD_MALFORMED,	// frame did not decode
+	TRACE_DISCARD_LONG,			// frame too long for a slot
+	TRACE_DISCARD_NOISE			// bytes outside a frame
+} TraceDiscard;
+
+/*
+ * An entry of the ring.
+ */
+typedef struct {
+	uint32_t time;			// time recorded, in the units of stageProfile_unit()
+	uint8_t event;			// TraceEvent
+	uint8_t arg;			// first argument
+	uint16_t value;			// second argument
+} TraceEntry;
+
+/*
+ * Bytes an entry takes in the TRAC reply:  the time, event, arg and value,
+ * little-endian.
+ */
+#define TRACE_ENTRY_SIZE 8
+
+
+#ifdef SESSION_TRACE
+
+/*
+ * Records an event with its arguments.
+ */
+#define TRACE_EVENT(event, arg, value) eventTrace_record((event), (uint8_t)(arg), (uint16_t)(value))
+
+/*
+ * Records an event of a message, given its header, with the first two characters
+ * of the header as the value.
+ */
+#define TRACE_HEADER(event, arg, header) eventTrace_record((event), (uint8_t)(arg), \
+		(uint16_t)((header)[0] | ((header)[1] << 8)))
+
+/*
+ * Records an event of a packet, given its frame buffer (not yet encoded, or
+ * decoded), with the first two characters of the header as the value.
+ */
+#define TRACE_FRAME(event, arg, frame) eventTrace_recordFrame((event), (uint8_t)(arg), (frame))
+
+
+/* eventTrace_init
+ *
+ * Function:
+ * 	Starts the time source (see stageProfile_init()) and empties the ring.
+ */
+void eventTrace_init(void);
+
+/* eventTrace_record
+ *
+ * Function:
+ * 	Adds an entry to the ring, overwriting the oldest if it is full, unless
+ * 	the ring is frozen.  May be called from interrupts.
+ *
+ * Parameters:
+ * 	event - the event.
+ * 	arg - first argument.
+ * 	value - second argument.
+ */
+void eventTrace_record(TraceEvent event, uint8_t arg, uint16_t value);
+
+/* eventTrace_recordFrame
+ *
+ * Function:
+ * 	Adds an entry for a packet, with the first two characters of its header
+ * 	as the value, as eventTrace_record().
+ *
+ * Parameters:
+ * 	event - the event.
+ * 	arg - first argument.
+ * 	frame - the packet's frame buffer, not encoded.
+ */
+void eventTrace_recordFrame(TraceEvent event, uint8_t arg, uint8_t* frame);
+
+/* eventTrace_freeze
+ *
+ * Function:
+ * 	Stops entries from being added, so the ring can be read while the reading
+ * 	itself causes events.  Events meanwhile are not recorded.
+ *
+ * Return:
+ * 	uint32_t - number of entries recorded since the ring was emptied, the
+ * 			index after the newest.
+ */
+uint32_t eventTrace_freeze(void);
+
+/* eventTrace_thaw
+ *
+ * Function:
+ * 	Lets entries be added again, after emptying the ring if asked to.
+ *
+ * Parameters:
+ * 	clear - true to empty the ring.
+ */
+void eventTrace_thaw(bool clear);
+
+/* eventTrace_read
+ *
+ * Function:
+ * 	Returns an entry of the ring by its index, counted from when the ring was
+ * 	emptied.  Only entries from SESSION_TRACE_DEPTH before the index returned
+ * 	by eventTrace_freeze() are still held.
+ *
+ * Parameters:
+ * 	index - index of the entry.
+ *
+ * Return:
+ * 	const TraceEntry* - pointer to the entry.
+ */
+const TraceEntry* eventTrace_read(uint32_t index);
+
+/* eventTrace_encode
+ *
+ * Function:
+ * 	Lays an entry out as it is sent in the TRAC reply.
+ *
+ * Parameters:
+ * 	entry - pointer to the entry.
+ * 	bytes - byte buffer of TRACE_ENTRY_SIZE bytes to store it in.
+ */
+void eventTrace_encode(const TraceEntry* entry, uint8_t bytes[TRACE_ENTRY_SIZE]);
+
+#else
+
+#define TRACE_EVENT(event, arg, value)
+#define TRACE_HEADER(event, arg, header)
+#define TRACE_FRAME(event, arg, frame)
+
+#endif /* SESSION_TRACE */
+
+#endif /* INC_EVENT_TRACE_H_ */
@@ -0,0 +1,123 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ *
+ * Purpose:
+ *		Estimates how long the desktop application takes to answer, from
+ *	measured round trips, the way TCP does (RFC 6298):  a smoothed round-trip
+ *	time (SRTT) and its variation (RTTVAR), from which a timeout (RTO) is taken
+ *	as SRTT plus four times RTTVAR.  The session feeds it the time an exchange
+ *	took less the time its frames spent on the wire, so the estimate holds
+ *	across a baud rate change, and adds the wire time at the current baud rate
+ *	back to each timeout it derives (see desktop_app_session.h).
+ *		Times are in milliseconds, the HAL tick.  SRTT and RTTVAR are kept
+ *	scaled by 8 and 4, so the gains of 1/8 and 1/4 are shifts.  A timeout that
+ *	expires doubles the RTO (backoff) until the next sample.
+ *
+ *	Note:  Samples must not be taken from exchanges whose message was resent
+ *	(Karn's algorithm), as which of the sends was answered is not known.
+ */
+
+#ifndef INC_RTT_ESTIMATOR_H_
+#define INC_RTT_ESTIMATOR_H_
+
+
+#include <stdint.h>
+
+
+/*
+ * Bounds of the RTO, in milliseconds.  The lower bound keeps a run of quick
+ * answers from leaving no room for the desktop's scheduling jitter.
+ */
+#ifndef SESSION_RTO_MIN_MS
+#define SESSION_RTO_MIN_MS 20
+#endif
+#ifndef SESSION_RTO_MAX_MS
+#define SESSION_RTO_MAX_MS 2000
+#endif
+
+/*
+ * Round-trip time estimate.
+ */
+typedef struct {
+	uint32_t srtt;			// smoothed round-trip time, in 1/8 ms
+	uint32_t rttvar;		// round-trip time variation, in 1/4 ms
+	uint32_t rto_ms;		// timeout, backoff included
+	uint32_t samples;		// samples taken since initialized
+} RttEstimator;
+
+
+/* rttEstimator_init
+ *
+ * Function:
+ * 	Starts an estimate with no samples, and the timeout to use until the first.
+ *
+ * Parameters:
+ * 	rtt - pointer to the estimate.
+ * 	initial_ms - timeout until the first sample.
+ */
+void rttEstimator_init(RttEstimator* rtt, uint32_t initial_ms);
+
+/* rttEstimator_sample
+ *
+ * Function:
+ * 	Adds a measured round trip to the estimate and takes the timeout from it,
+ * 	ending any backoff.
+ *
+ * Parameters:
+ * 	rtt - pointer to the estimate.
+ * 	sample_ms - round-trip time.
+ */
+void rttEstimator_sample(RttEstimator* rtt, uint32_t sample_ms);
+
+/* rttEstimator_backoff
+ *
+ * Function:
+ * 	Doubles the timeout, up to SESSION_RTO_MAX_MS, after it expired.
+ *
+ * Parameters:
+ * 	rtt - pointer to the estimate.
+ */
+void rttEstimator_backoff(RttEstimator* rtt);
+
+/* rttEstimator_timeout
+ *
+ * Function:
+ * 	Returns the timeout (RTO).
+ *
+ * Parameters:
+ * 	rtt - pointer to the estimate.
+ *
+ * Return:
+ * 	uint32_t - timeout in milliseconds.
+ */
+uint32_t rttEstimator_timeout(const RttEstimator* rtt);
+
+/* rttEstimator_smoothed
+ *
+ * Function:
+ * 	Returns the smoothed round-trip time (SRTT).
+ *
+ * Parameters:
+ * 	rtt - pointer to the estimate.
+ *
+ * Return:
+ * 	uint32_t - time in milliseconds, 0 before the first sample.
+ */
+uint32_t rttEstimator_smoothed(const RttEstimator* rtt);
+
+/* rttEstimator_variation
+ *
+ * Function:
+ * 	Returns the round-trip time variation (RTTVAR).
+ *
+ * Parameters:
+ * 	rtt - pointer to the estimate.
+ *
+ * Return:
+ * 	uint32_t - time in milliseconds, 0 before the first sample.
+ */
+uint32_t rttEstimator_variation(const RttEstimator* rtt);
+
+
+#endif /* INC_RTT_ESTIMATOR_H_ */
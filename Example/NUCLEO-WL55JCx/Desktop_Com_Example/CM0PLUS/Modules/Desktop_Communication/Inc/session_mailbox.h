@@ -0,0 +1,323 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ *
+ * Purpose:
+ *		Splits the desktop application session across the two cores of the
+ *	STM32WL5x.  The link core (CM0+) owns the UART and runs the session as
+ *	usual; an application on the other core (CM4) exchanges messages with it
+ *	through a mailbox in shared SRAM, with the same enqueue and dequeue calls
+ *	as the session's (sessionMailbox_enqueueMessage() and so on).
+ *		The mailbox holds two lock-free single producer, single consumer rings
+ *	of SESSION_MAILBOX_DEPTH messages, one each way, indexed as the packet
+ *	queues are (see packet_queue.h).  A message is copied in with its length,
+ *	priority and whether it is binary, so nothing about it is lost between the
+ *	cores.  After changing a ring, a core rings the other's doorbell:  it sets
+ *	its IPCC channel (SESSION_MAILBOX_CHANNEL_TO_LINK from the application,
+ *	SESSION_MAILBOX_CHANNEL_FROM_LINK from the link), unless it is still set.
+ *	The other core's IPCC interrupt clears the channel and calls the hook given
+ *	at initialization, where it can notify a sequencer task or RTOS task (see
+ *	session_sequencer.h and session_rtos.h).  A core can also poll.
+ *		On the link core, sessionMailbox_updateLink() (called after each
+ *	session update) moves the application's messages into the transport
+ *	layer's tx lanes while a session is open and they have room, and moves
+ *	received messages that no handler on the link core took into the ring to
+ *	the application while it has room.  It also publishes whether a session is
+ *	open.
+ *
+ *		Only built if SESSION_MAILBOX is defined at build time.  The link
+ *	core's functions (session_mailbox_link.c) use the session, so the
+ *	application core's project builds only session_mailbox.c.  Both cores must
+ *	place the mailbox at the same address in SRAM that neither linker script
+ *	hands out (see README.md).
+ *
+ *	Note:  One context on each core may use the mailbox.  The IPCC interrupts
+ *	must be enabled on both cores.
+ */
+
+#ifndef INC_SESSION_MAILBOX_H_
+#define INC_SESSION_MAILBOX_H_
+
+
+#ifdef SESSION_MAILBOX
+
+#include <desktop_app_session.h>
+#include <stdatomic.h>
+
+
+/*
+ * Number of messages each ring holds.  Must be a power of two.
+ */
+#ifndef SESSION_MAILBOX_DEPTH
+#define SESSION_MAILBOX_DEPTH 8
+#endif
+
+/*
+ * IPCC channels of the doorbells, application to link core and back.
+ */
+#ifndef SESSION_MAILBOX_CHANNEL_TO_LINK
+#define SESSION_MAILBOX_CHANNEL_TO_LINK IPCC_CHANNEL_5
+#endif
+#ifndef SESSION_MAILBOX_CHANNEL_FROM_LINK
+#define SESSION_MAILBOX_CHANNEL_FROM_LINK IPCC_CHANNEL_6
+#endif
+
+/*
+ * Value of a mailbox's ready field once the link core has initialized it.
+ */
+#define SESSION_MAILBOX_READY 0x4D424F58U
+
+/*
+ * A message in a ring.
+ */
+typedef struct {
+	uint8_t header[UART_PACKET_HEADER_SIZE];	// header code
+	uint8_t payload[UART_PACKET_PAYLOAD_SIZE];	// payload, zero padded
+	uint16_t length;							// number of payload bytes
+	uint8_t priority;							// SessionPriority it is sent with
+	uint8_t binary;								// sent with its length, rather than as text
+} MailboxMessage;
+
+/*
+ * A ring of messages from one core to the other.  The indexes are free-running
+ * counts of the messages written and read.
+ */
+typedef struct {
+	atomic_uint_fast32_t head;					// messages written, by the sending core only
+	atomic_uint_fast32_t tail;					// messages read, by the receiving core only
+	MailboxMessage slots[SESSION_MAILBOX_DEPTH];
+} MailboxRing;
+
+/*
+ * The mailbox, in memory both cores see.
+ */
+typedef struct {
+	atomic_uint_fast32_t ready;					// SESSION_MAILBOX_READY once initialized
+	atomic_uint_fast32_t open;					// session open at the link core's last update
+	MailboxRing toLink;							// application core to link core
+	MailboxRing fromLink;						// link core to application core
+} SessionMailbox;
+
+
+/* sessionMailbox_initLink
+ *
+ * Function:
+ * 	(Link core) Empties the mailbox, marks it ready and activates the IPCC
+ * 	interrupt of the application's doorbell.
+ *
+ * Parameters:
+ * 	mailbox - pointer to the mailbox in shared memory.
+ * 	hipcc - HAL IPCC handle pointer, initialized.
+ * 	notify - function called from the IPCC interrupt when the application
+ * 			rings, or NULL.
+ *
+ * Return:
+ * 	bool - true if initialized, false if a pointer is NULL.
+ *
+ * Note:
+ * 	desktopAppSession_init() must have been performed prior.  The mailbox must
+ * 	be initialized before the application core initializes its side.
+ */
+bool sessionMailbox_initLink(SessionMailbox* mailbox, IPCC_HandleTypeDef* hipcc, void (*notify)(void));
+
+/* sessionMailbox_updateLink
+ *
+ * Function:
+ * 	(Link core) Moves messages between the mailbox and the session, and
+ * 	publishes whether a session is open.  Rings the application's doorbell if
+ * 	either ring changed.  Called after each desktopAppSession_update().
+ *
+ * Return:
+ * 	bool - true if any message was moved, false if not.
+ */
+bool sessionMailbox_updateLink(void);
+
+/* sessionMailbox_initApp
+ *
+ * Function:
+ * 	(Application core) Takes the mailbox once the link core has initialized
+ * 	it and activates the IPCC interrupt of the link's doorbell.
+ *
+ * Parameters:
+ * 	mailbox - pointer to the mailbox in shared memory.
+ * 	hipcc - HAL IPCC handle pointer, initialized.
+ * 	notify - function called from the IPCC interrupt when the link core rings,
+ * 			or NULL.
+ *
+ * Return:
+ * 	bool - true if initialized, false if a pointer is NULL or the link core
+ * 			has not initialized the mailbox yet (call again).
+ */
+bool sessionMailbox_initApp(SessionMailbox* mailbox, IPCC_HandleTypeDef* hipcc, void (*notify)(void));
+
+/* sessionMailbox_isOpen
+ *
+ * Function:
+ * 	(Application core) Returns whether a session was open at the link core's
+ * 	last update.
+ *
+ * Return:
+ * 	bool - true if open, false if not (or not initialized)
+ */
+bool sessionMailbox_isOpen(void);
+
+/* sessionMailbox_enqueueMessage
+ *
+ * Function:
+ * 	(Application core) Copies a text message into the mailbox for the link core
+ * 	to send, as desktopAppSession_enqueueMessage().
+ *
+ * Parameters:
+ * 	header - char array message header code
+ * 	body - char array message body (or payload)
+ * 	priority - SESSION_PRIORITY_URGENT or SESSION_PRIORITY_BULK
+ *
+ * Return:
+ * 	DesktopComSessionStatus
+ * 		SESSION_NOT_INIT - if sessionMailbox_initApp() has not been performed
+ * 				prior
+ * 		SESSION_BUFFER_FULL - if the ring to the link core is full
+ * 		SESSION_OKAY - if enqueuing successful
+ */
+DesktopComSessionStatus sessionMailbox_enqueueMessage(const char header[UART_PACKET_HEADER_SIZE],
+		const char body[UART_PACKET_PAYLOAD_SIZE], SessionPriority priority);
+
+/* sessionMailbox_enqueueBinary
+ *
+ * Function:
+ * 	(Application core) Copies a message with a binary payload into the mailbox,
+ * 	as desktopAppSession_enqueueBinary().
+ *
+ * Parameters:
+ * 	header - char array message header code
+ * 	payload - byte array message payload
+ * 	length - number of payload bytes, at most UART_PACKET_PAYLOAD_SIZE
+ * 	priority - SESSION_PRIORITY_URGENT or SESSION_PRIORITY_BULK
+ *
+ * Return:
+ * 	DesktopComSessionStatus
+ * 		SESSION_NOT_INIT - if sessionMailbox_initApp() has not been performed
+ * 				prior
+ * 		SESSION_ERROR - if the payload is too long
+ * 		SESSION_BUFFER_FULL - if the ring to the link core is full
+ * 		SESSION_OKAY - if enqueuing successful
+ */
+DesktopComSessionStatus sessionMailbox_enqueueBinary(const char header[UART_PACKET_HEADER_SIZE],
+		const uint8_t* payload, uint16_t length, SessionPriority priority);
+
+/* sessionMailbox_dequeueMessage
+ *
+ * Function:
+ * 	(Application core) Copies out the oldest message the link core forwarded,
+ * 	as desktopAppSession_dequeueMessage().
+ *
+ * Parameters:
+ * 	header - char array pointer where the message header code is to be stored
+ * 	body - char array pointer where the message body (or payload) is to be stored
+ *
+ * Return:
+ * 	DesktopComSessionStatus
+ * 		SESSION_NOT_INIT - if sessionMailbox_initApp() has not been performed
+ * 				prior
+ * 		SESSION_BUFFER_EMPTY - if no message is ready
+ * 		SESSION_OKAY - if dequeuing successful
+ */
+DesktopComSessionStatus sessionMailbox_dequeueMessage(char header[UART_PACKET_HEADER_SIZE],
+		char body[UART_PACKET_PAYLOAD_SIZE]);
+
+/* sessionMailbox_dequeueBinary
+ *
+ * Function:
+ * 	(Application core) Copies out the oldest message the link core forwarded
+ * 	with the length of its payload, as desktopAppSession_dequeueBinary().
+ *
+ * Parameters:
+ * 	header - char array pointer where the message header code is to be stored
+ * 	payload - byte array pointer where the message payload is to be stored
+ * 	length - pointer to where the number of payload bytes is to be stored
+ *
+ * Return:
+ * 	DesktopComSessionStatus
+ * 		SESSION_NOT_INIT - if sessionMailbox_initApp() has not been performed
+ * 				prior
+ * 		SESSION_BUFFER_EMPTY - if no message is ready
+ * 		SESSION_OKAY - if dequeuing successful
+ */
+DesktopComSessionStatus sessionMailbox_dequeueBinary(char header[UART_PACKET_HEADER_SIZE],
+		uint8_t payload[UART_PACKET_PAYLOAD_SIZE], uint16_t* length);
+
+/* mailboxRing_reset
+ *
+ * Function:
+ * 	Empties a ring.  Neither core may be using it.
+ *
+ * Parameters:
+ * 	ring - pointer to the ring.
+ */
+void mailboxRing_reset(MailboxRing* ring);
+
+/* mailboxRing_back
+ *
+ * Function:
+ * 	(Sending core) Returns the free slot at the back of a ring to write a
+ * 	message into in place.  It is not part of the ring until committed.
+ *
+ * Parameters:
+ * 	ring - pointer to the ring.
+ *
+ * Return:
+ * 	MailboxMessage* - pointer to the slot, or NULL if the ring is full.
+ */
+MailboxMessage* mailboxRing_back(MailboxRing* ring);
+
+/* mailboxRing_commit
+ *
+ * Function:
+ * 	(Sending core) Adds the message written into the slot from
+ * 	mailboxRing_back() to the ring.
+ *
+ * Parameters:
+ * 	ring - pointer to the ring.
+ */
+void mailboxRing_commit(MailboxRing* ring);
+
+/* mailboxRing_front
+ *
+ * Function:
+ * 	(Receiving core) Returns the message at the front of a ring to be read in
+ * 	place.  It stays in the ring until released.
+ *
+ * Parameters:
+ * 	ring - pointer to the ring.
+ *
+ * Return:
+ * 	MailboxMessage* - pointer to the message, or NULL if the ring is empty.
+ */
+MailboxMessage* mailboxRing_front(MailboxRing* ring);
+
+/* mailboxRing_release
+ *
+ * Function:
+ * 	(Receiving core) Removes the message at the front of a ring.
+ *
+ * Parameters:
+ * 	ring - pointer to the ring.
+ */
+void mailboxRing_release(MailboxRing* ring);
+
+/* mailboxDoorbell_ring
+ *
+ * Function:
+ * 	Sets an IPCC channel towards the other core, unless it is still set (the
+ * 	other core has not yet taken the last ring, and will see the change).
+ *
+ * Parameters:
+ * 	hipcc - HAL IPCC handle pointer.
+ * 	channel - IPCC channel index.
+ */
+void mailboxDoorbell_ring(IPCC_HandleTypeDef* hipcc, uint32_t channel);
+
+
+#endif /* SESSION_MAILBOX */
+
+#endif /* INC_SESSION_MAILBOX_H_ */
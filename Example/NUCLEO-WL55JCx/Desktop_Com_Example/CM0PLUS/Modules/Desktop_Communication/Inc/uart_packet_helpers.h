@@ -9,12 +9,34 @@
  * 		Variable-length strings for the are not supported.  Character arrays passed into the
  * 	packet composition function need to be the same length as the header and payload segments,
  * 	as this function does not null-terminate.
+ * 		A packet view gives access to the header and payload segments of a packet in place,
+ * 	without copying them out of the packet.
+ * 		Packets are held in frame buffers, which also hold what is needed to put the packet
+ * 	on the wire.  By default a frame is the fixed-length packet itself.  If UART_FRAMING_COBS
+ * 	is defined at build time, a frame is variable length instead:  the header, a one byte
+ * 	payload length and only the used part of the payload, encoded with Consistent Overhead
+ * 	Byte Stuffing (COBS) so that it contains no zero bytes, followed by a zero byte that
+ * 	delimits the frame.  Short messages then cost only their real size on the wire, and a
+ * 	receiver resynchronizes at the next delimiter.  The desktop application must be set to
+ * 	the same framing.
+ * 		If SESSION_WINDOWED is defined at build time, a link segment follows the header,
+ * 	holding the packet's sequence number and the cumulative acknowledgement of the packets
+ * 	received from the other side (see desktop_app_session.h).  The payload is shortened to
+ * 	make room for it.  If SESSION_CREDIT is defined instead, the link segment holds the
+ * 	packet's sequence number and the credit granted to the other side.
+ * 		If UART_PAYLOAD_BINARY is defined at build time, payloads are binary:  every packet
+ * 	carries the length of its payload, so payloads may hold (and end in) zero bytes and are
+ * 	received with exactly the length sent.  A fixed-length packet gains a one byte payload
+ * 	length after the link segment, and the payload is shortened to make room for it.  A COBS
+ * 	frame already carries the payload length, so it is unchanged.  The desktop application
+ * 	must be set to binary payloads (and 8-bit characters) too.
  */
 
 #ifndef INC_UART_PACKET_HELPERS_H_
 #define INC_UART_PACKET_HELPERS_H_
 
 
+#include <stdbool.h>
 #include <stdint.h>
 
 
@@ -23,7 +45,54 @@
  */
 #define UART_PACKET_SIZE 64
 #define UART_PACKET_HEADER_SIZE 4
-#define UART_PACKET_PAYLOAD_SIZE (UART_PACKET_SIZE - UART_PACKET_HEADER_SIZE)
+#if defined(SESSION_WINDOWED) && defined(SESSION_CREDIT)
+#error "SESSION_WINDOWED and SESSION_CREDIT are alternative flow controls"
+#endif
+#if defined(SESSION_WINDOWED) || defined(SESSION_CREDIT)
+#define UART_PACKET_LINK_SIZE 2
+#else
+#define UART_PACKET_LINK_SIZE 0
+#endif
+#if defined(UART_PAYLOAD_BINARY) && !defined(UART_FRAMING_COBS)
+#define UART_PACKET_LENGTH_SIZE 1
+#else
+#define UART_PACKET_LENGTH_SIZE 0
+#endif
+#define UART_PACKET_PAYLOAD_SIZE (UART_PACKET_SIZE - UART_PACKET_HEADER_SIZE - UART_PACKET_LINK_SIZE \
+		- UART_PACKET_LENGTH_SIZE)
+
+/*
+ * Link segment parameters.  The first byte is the sequence number, counting
+ * modulo UART_LINK_SEQ_MODULUS, UART_LINK_ACK_ONLY for a packet that only
+ * carries the second byte, or UART_LINK_UNSEQUENCED for a packet outside the
+ * sequence that carries neither (a handshake message from a desktop starting
+ * over).  The second byte is the sequence number of the next packet expected
+ * from the other side (SESSION_WINDOWED), or the sequence number the other side
+ * may send up to, but not including (SESSION_CREDIT).  Both stay within 7 bits.
+ */
+#define UART_LINK_SEQ 0
+#define UART_LINK_ACK 1
+#define UART_LINK_CREDIT 1
+#define UART_LINK_SEQ_MODULUS 64
+#define UART_LINK_ACK_ONLY 0x40
+#define UART_LINK_UNSEQUENCED 0x41
+
+/*
+ * Size parameters for frames.  A COBS frame adds the payload length byte, the
+ * COBS code byte and the delimiter to the packet.
+ */
+#ifdef UART_FRAMING_COBS
+#define UART_FRAME_LENGTH_SIZE 1
+#define UART_FRAME_DELIMITER 0x00
+#define UART_FRAME_SIZE (1 + UART_PACKET_SIZE + UART_FRAME_LENGTH_SIZE + 1)
+#else
+#define UART_FRAME_SIZE UART_PACKET_SIZE
+#endif
+
+/*
+ * Number of 7-bit characters packSevenBit() packs a number of bytes into.
+ */
+#define SEVEN_BIT_LENGTH(count) (((count) * 8 + 6) / 7)
 
 /*
  * A SerialMessage is made up of a header and a body. The header represents
@@ -35,6 +104,17 @@ typedef struct {
 	uint8_t body[UART_PACKET_PAYLOAD_SIZE];
 } SerialMessage;
 
+/*
+ * A PacketView points into a packet held elsewhere (such as in a queue slot),
+ * giving access to its header and payload segments in place.
+ */
+typedef struct {
+	uint8_t* header;	// header segment, UART_PACKET_HEADER_SIZE bytes
+	uint8_t* link;		// link segment, UART_PACKET_LINK_SIZE bytes
+	uint8_t* payload;	// payload segment
+	uint16_t length;	// number of bytes in the payload segment
+} PacketView;
+
 /* composePacket
  *
  * Function:
@@ -74,5 +154,123 @@ void composePacket(uint8_t packet_buffer[UART_PACKET_SIZE], const uint8_t header
 void decomposePacket(uint8_t header_buffer[UART_PACKET_HEADER_SIZE], uint8_t payload_buffer[UART_PACKET_PAYLOAD_SIZE],
 		const uint8_t packet_buffer[UART_PACKET_SIZE]);
 
+/* packetView_init
+ *
+ * Function:
+ * 	points a view at the header and payload segments of a packet.
+ *
+ * Parameters:
+ * 	view - pointer to the view to set.
+ * 	packet_buffer - byte buffer pointer to the packet.
+ *
+ * Return:  (by parameter)
+ * 	view - view of the packet's segments.
+ */
+void packetView_init(PacketView* view, uint8_t packet_buffer[UART_FRAME_SIZE]);
+
+/* packetView_frame
+ *
+ * Function:
+ * 	Returns the frame buffer a view was initialized on, for copying the whole
+ * 	frame (such as into another queue's slot).
+ *
+ * Parameters:
+ * 	view - pointer to the view.
+ *
+ * Return:
+ * 	uint8_t* - byte buffer pointer to the frame, UART_FRAME_SIZE bytes.
+ */
+uint8_t* packetView_frame(const PacketView* view);
+
+/* receivedPayloadLength
+ *
+ * Function:
+ * 	returns the length of the payload of a packet decoded by decodeFrame().
+ *
+ * Parameters:
+ * 	frame_buffer - byte buffer pointer to the decoded frame.
+ *
+ * Return:
+ * 	uint16_t - payload length, UART_PACKET_PAYLOAD_SIZE for fixed-length frames
+ * 			without UART_PAYLOAD_BINARY.
+ */
+uint16_t receivedPayloadLength(const uint8_t frame_buffer[UART_FRAME_SIZE]);
+
+/* textPayloadLength
+ *
+ * Function:
+ * 	returns the length of a text payload built in a frame buffer (through a packet
+ * 	view):  the payload up to its trailing zero bytes, which are padding.
+ *
+ * Parameters:
+ * 	frame_buffer - byte buffer pointer to the frame.
+ *
+ * Return:
+ * 	uint16_t - payload length.
+ */
+uint16_t textPayloadLength(const uint8_t frame_buffer[UART_FRAME_SIZE]);
+
+/* encodeFrame
+ *
+ * Function:
+ * 	encodes the packet built in a frame buffer (through a packet view) into the frame
+ * 	to put on the wire, in place.  For COBS frames only the payload's length bytes are
+ * 	sent.  For fixed-length frames with UART_PAYLOAD_BINARY the length is recorded in
+ * 	the packet, otherwise it is not sent and the full payload is.
+ *
+ * Parameters:
+ * 	frame_buffer - byte buffer pointer to the frame.
+ * 	payloadLength - number of payload bytes, at most UART_PACKET_PAYLOAD_SIZE.
+ *
+ * Return:
+ * 	uint16_t - number of bytes in the frame.
+ */
+uint16_t encodeFrame(uint8_t frame_buffer[UART_FRAME_SIZE], uint16_t payloadLength);
+
+/* frameLength
+ *
+ * Function:
+ * 	returns the number of bytes of a frame encoded by encodeFrame().
+ *
+ * Parameters:
+ * 	frame_buffer - byte buffer pointer to the frame.
+ *
+ * Return:
+ * 	uint16_t - number of bytes in the frame.
+ */
+uint16_t frameLength(const uint8_t frame_buffer[UART_FRAME_SIZE]);
+
+/* decodeFrame
+ *
+ * Function:
+ * 	decodes a frame received from the wire into a packet, in place, for reading
+ * 	through a packet view.  Payload bytes past the received length are zeroed.
+ *
+ * Parameters:
+ * 	frame_buffer - byte buffer pointer to the frame.
+ * 	length - number of bytes received into the frame, not including the delimiter.
+ *
+ * Return:
+ * 	bool - true if the frame is well formed, false if it should be discarded.
+ */
+bool decodeFrame(uint8_t frame_buffer[UART_FRAME_SIZE], uint16_t length);
+
+/* packSevenBit
+ *
+ * Function:
+ * 	packs bytes into 7-bit characters, least significant bits first, so that binary
+ * 	data can be sent in a text payload over a 7-bit UART.  Every 7 bytes take 8
+ * 	characters.
+ *
+ * Parameters:
+ * 	bytes - byte array to pack.
+ * 	count - number of bytes.
+ * 	chars - byte array where the SEVEN_BIT_LENGTH(count) characters are to be stored.
+ *
+ * Return:
+ * 	uint16_t - number of characters stored.
+ */
+uint16_t packSevenBit(const uint8_t* bytes, uint16_t count, uint8_t* chars);
+
 
 #endif /* INC_UART_PACKET_HELPERS_H_ */
@@ -8,6 +8,52 @@
  *	communication.  Structured to allow for future implementation of queuing
  *	multiple packets for transmission and multiple packets in reception (variable
  *	length messages broken into packets).
+ *		Reception is performed in the background by a circular DMA transfer into
+ *	a byte ring, with the UART's idle-line detection used to signal the end of a
+ *	burst of bytes.  Complete frames are moved from the ring into a queue of
+ *	received packets by the reception interrupt, so packets arriving while the
+ *	application is busy are not lost.  Frames are fixed-length packets, or COBS
+ *	frames if UART_FRAMING_COBS is defined (see uart_packet_helpers.h).
+ *		Transmission is performed from a queue of packets, drained by DMA (or by
+ *	TXE interrupts if no DMA channel is linked for transmission) with each
+ *	transmit complete interrupt starting the next queued packet.  Queuing a
+ *	packet does not wait for it to be transmitted.
+ *		Packets are queued in one of two lanes, each a queue of its own:  urgent
+ *	(commands, replies and flow control) and bulk (data).  The transmit
+ *	complete interrupt picks the lane the next packet comes from, by strict
+ *	priority (urgent packets always go first) or weighted round-robin (a bulk
+ *	packet goes after every so many urgent ones), so an urgent packet waits for
+ *	at most the packet in flight rather than the whole bulk queue.
+ *		For sliding-window sessions, transmitted packets can be retained in the
+ *	queue until acknowledged, and resent from the oldest on demand
+ *	(uartTransport_setTxWindow()).  A separate control frame can be sent ahead of
+ *	the queue for acknowledgement or credit only packets.  The window is kept in
+ *	the bulk lane, and while it is set every packet is queued there, so packets
+ *	are sent in the order they were numbered.
+ *		If UART_HW_FLOW_CONTROL is defined at build time, the UART must be
+ *	configured for hardware RTS/CTS flow control.  The UART holds transmission
+ *	while CTS is deasserted, and reception stops taking bytes (deasserting RTS)
+ *	while the rx queue is full and the ring is filling, so the desktop streams
+ *	packets without the session's software flow control.
+ *		The layer counts what it sends and receives, what it discards and the
+ *	UART's errors by type, and the most packets each queue has held
+ *	(uartTransport_stats()).  The counts are kept across resets and baud rate
+ *	changes, until uartTransport_resetStats().
+ *
+ *		No function masks interrupts.  The queues are each filled by one side
+ *	and drained by the other, and the state the interrupts work from (the ring,
+ *	the packet in flight, the window of retained packets, the counts) is only
+ *	changed by them.  Calls from the main context that need that state changed
+ *	record the request and pend the UART interrupt, whose handler ends with
+ *	uartTransport_IRQHandler() to take it.
+ *
+ *	Note:  The layer implements the HAL_UARTEx_RxEventCallback(),
+ *	HAL_UART_TxCpltCallback() and HAL_UART_ErrorCallback() HAL callbacks.  The
+ *	UART handle passed in must have a DMA channel linked for reception (hdmarx)
+ *	configured in circular mode, and the UART global interrupt must be enabled
+ *	and call uartTransport_IRQHandler() after HAL_UART_IRQHandler().  The UART
+ *	and DMA interrupts must have the same priority, so neither preempts the
+ *	other.
  */
 
 #ifndef INC_UART_TRANSPORT_LAYER_H_
@@ -20,6 +66,55 @@
 #include "stm32wlxx_hal.h"
 
 
+/*
+ * Size, in bytes, of the circular DMA reception ring.  Must be able to hold
+ * at least two frames so that one can be taken from the ring while the next
+ * is being received.
+ */
+#ifndef UART_RX_RING_SIZE
+#define UART_RX_RING_SIZE (4 * UART_FRAME_SIZE)
+#endif
+
+/*
+ * Number of packets the transmission and reception queues hold.  Each must be a
+ * power of two.
+ */
+#ifndef UART_TX_QUEUE_LENGTH
+#define UART_TX_QUEUE_LENGTH 4
+#endif
+#ifndef UART_RX_QUEUE_LENGTH
+#define UART_RX_QUEUE_LENGTH 2
+#endif
+
+/*
+ * Number of packets the urgent transmission lane holds (the bulk lane is the tx
+ * queue above).  Must be a power of two.
+ */
+#ifndef UART_TX_URGENT_QUEUE_LENGTH
+#define UART_TX_URGENT_QUEUE_LENGTH 2
+#endif
+
+/*
+ * Default transmission schedule (a TransportTxSchedule) and, for weighted
+ * round-robin, the number of urgent packets sent for each bulk packet while both
+ * lanes have packets waiting.
+ */
+#ifndef UART_TX_SCHEDULE
+#define UART_TX_SCHEDULE TX_SCHEDULE_STRICT
+#endif
+#ifndef UART_TX_URGENT_WEIGHT
+#define UART_TX_URGENT_WEIGHT 4
+#endif
+
+/*
+ * Interrupt of the UART the layer runs on, pended from the main context for
+ * uartTransport_IRQHandler().
+ */
+#ifndef UART_TRANSPORT_IRQn
+#define UART_TRANSPORT_IRQn USART2_IRQn
+#endif
+
+
 /*
  * Status returns for API calls to the UART Transport Layer.
  */
@@ -35,6 +130,47 @@ typedef enum {
 	TRANSPORT_NOT_INIT
 } TransportStatus;
 
+/*
+ * Transmission lanes.
+ */
+typedef enum {
+	TX_LANE_URGENT,
+	TX_LANE_BULK
+} TransportTxLane;
+
+/*
+ * How the lane of the next packet transmitted is picked.
+ * 	TX_SCHEDULE_STRICT - the urgent lane whenever it has a packet waiting.
+ * 	TX_SCHEDULE_WEIGHTED - the urgent lane, except that a waiting bulk packet is
+ * 		sent after every urgentWeight urgent packets, so a busy urgent lane
+ * 		cannot hold bulk data back indefinitely.
+ */
+typedef enum {
+	TX_SCHEDULE_STRICT,
+	TX_SCHEDULE_WEIGHTED
+} TransportTxSchedule;
+
+/*
+ * Counts kept by the transport layer.
+ */
+typedef struct {
+	uint32_t txPackets;			// frames started on the UART, resent ones included
+	uint32_t txBytes;			// bytes of those frames
+	uint32_t rxPackets;			// well-formed frames received
+	uint32_t rxBytes;			// bytes of the frames received, malformed ones included
+	uint32_t rxMalformed;		// frames discarded as malformed or too long
+	uint32_t rxNoise;			// bytes discarded outside a frame (noise, partial frames)
+	uint32_t rxRestarts;		// times reception was restarted after a UART error stopped it
+	uint32_t errOverrun;		// UART overrun errors
+	uint32_t errFraming;		// UART framing errors
+	uint32_t errNoise;			// UART noise errors
+	uint32_t errParity;			// UART parity errors
+	uint32_t errDma;			// DMA transfer errors
+	uint32_t txHighWater;		// most packets held by the bulk lane
+	uint32_t txUrgentHighWater;	// most packets held by the urgent lane
+	uint32_t rxHighWater;		// most packets held by the rx queue
+} TransportStats;
+
 /* uartTransport_init
  *
  * Function:
@@ -45,8 +181,11 @@ typedef enum {
  *			peripheral to be used.
  *
  * Return:
- * 	bool - returns false if the huart paramter is NULL or the UART
- * 	handle has not been initialized by HAL_UART_init.
+ * 	bool - returns false if the huart paramter is NULL, the UART
+ * 	handle has not been initialized by HAL_UART_init, the UART handle has
+ * 	no circular DMA channel linked for reception, the UART is not configured
+ * 	for RTS/CTS flow control when built with UART_HW_FLOW_CONTROL, or
+ * 	background reception could not be started.
  *
  * Note:
  * 	Will not re-inialize the layer if the layer has already been initialized.
@@ -57,6 +196,7 @@ bool uartTransport_init(UART_HandleTypeDef* huart);
  *
  * Function:
  * 	Resets the transport layer's state to that immediately after being initialized.
+ * 	Any bytes received but not yet taken from the reception ring are discarded.
  *
  * Return:
  * 	bool - true if the layer has been initialized, false otherwise.
@@ -64,6 +204,9 @@ bool uartTransport_init(UART_HandleTypeDef* huart);
 bool uartTransport_reset(void);
 
 /* uartTransport_deinit
+ *
+ * Function:
+ * 	Stops background reception and releases the UART handle.
  *
  * Return:
  * 	bool - true if the layer had been initialized (and is now deinitialized), false
@@ -71,10 +214,55 @@ bool uartTransport_reset(void);
  */
 bool uartTransport_deinit(void);
 
+/* uartTransport_setBaudRate
+ *
+ * Function:
+ * 	Changes the UART's baud rate.  Transmission and reception are stopped,
+ * 	the UART is reconfigured, and the layer is reset (as by
+ * 	uartTransport_reset()) with reception restarted at the new rate.
+ *
+ * Parameters:
+ * 	baudRate - new baud rate, in bits per second.
+ *
+ * Return:
+ * 	bool - true if the rate was changed, false if the layer has not been
+ * 			initialized or the UART could not be reconfigured (the UART is
+ * 			then left at the previous rate).
+ *
+ * Note:
+ * 	Packets queued for transmission and not yet sent are discarded, so the
+ * 	tx queue should be drained with uartTransport_tx_polled() first.
+ */
+bool uartTransport_setBaudRate(uint32_t baudRate);
+
+/* uartTransport_getBaudRate
+ *
+ * Function:
+ * 	Returns the UART's baud rate.
+ *
+ * Return:
+ * 	uint32_t - baud rate, in bits per second, or 0 if the layer has not been
+ * 			initialized.
+ */
+uint32_t uartTransport_getBaudRate(void);
+
+/* uartTransport_frameTime_ms
+ *
+ * Function:
+ * 	Returns the time the longest frame takes on the wire at the UART's baud
+ * 	rate, rounded up, for sizing timeouts.
+ *
+ * Return:
+ * 	uint32_t - frame time in milliseconds, or 0 if the layer has not been
+ * 			initialized.
+ */
+uint32_t uartTransport_frameTime_ms(void);
+
 /* uartTransport_enqueueTx
  *
  * Function:
- *	Buffers a packet for transmission.
+ *	Queues a packet for transmission and starts transmitting if the UART is
+ *	idle.  Returns without waiting for the packet to be transmitted.
  *
  * Parameters:
  *	header - byte array pointer to header for packet.
@@ -106,53 +294,367 @@ TransportStatus uartTransport_bufferTx(uint8_t header[UART_PACKET_HEADER_SIZE],
  */
 TransportStatus uartTransport_debufferRx(uint8_t header[UART_PACKET_HEADER_SIZE], uint8_t payload[UART_PACKET_PAYLOAD_SIZE]);
 
+/* uartTransport_acquireTx
+ *
+ * Function:
+ *	Gets a view of a free packet slot in the tx queue (the bulk lane) for a
+ *	packet to be built in place, without copying.  The slot is zeroed.  The
+ *	packet is not queued until uartTransport_commitTx() is called.
+ *
+ * Parameters:
+ *	view - pointer to the view to point at the slot's header and payload.
+ *
+ * Return:
+ *	TransportStatus
+ *		TRANSPORT_OKAY - slot acquired
+ *		TRANSPORT_TX_FULL - tx queue full
+ *		TRANSPORT_NOT_INIT - transport layer not initialized
+ *
+ * Note:
+ *	Only one slot may be acquired at a time, and it must be committed before
+ *	uartTransport_bufferTx() is called.
+ */
+TransportStatus uartTransport_acquireTx(PacketView* view);
+
+/* uartTransport_acquireTxLane
+ *
+ * Function:
+ *	Gets a view of a free packet slot in a transmission lane, as
+ *	uartTransport_acquireTx() does for the bulk lane.
+ *
+ * Parameters:
+ *	view - pointer to the view to point at the slot's header and payload.
+ *	lane - lane to queue the packet in.
+ *
+ * Return:
+ *	TransportStatus
+ *		TRANSPORT_OKAY - slot acquired
+ *		TRANSPORT_TX_FULL - the lane is full
+ *		TRANSPORT_NOT_INIT - transport layer not initialized
+ *
+ * Note:
+ *	While a window is set (see uartTransport_setTxWindow()), the slot is in
+ *	the bulk lane whatever the lane asked for.
+ */
+TransportStatus uartTransport_acquireTxLane(PacketView* view, TransportTxLane lane);
+
+/* uartTransport_commitTx
+ *
+ * Function:
+ *	Queues the packet built in the slot from uartTransport_acquireTx() (or
+ *	uartTransport_acquireTxLane()) for transmission and starts transmitting if
+ *	the UART is idle.  The payload is text:  its length is up to its trailing
+ *	zero bytes.
+ *
+ * Return:
+ *	TransportStatus
+ *		TRANSPORT_OKAY - packet queued
+ *		TRANSPORT_NOT_INIT - transport layer not initialized
+ */
+TransportStatus uartTransport_commitTx(void);
+
+/* uartTransport_commitTxLength
+ *
+ * Function:
+ *	Queues the packet built in the slot from uartTransport_acquireTx() for
+ *	transmission with a payload of a given length, which may hold zero bytes,
+ *	and starts transmitting if the UART is idle.
+ *
+ * Parameters:
+ *	length - number of payload bytes, at most UART_PACKET_PAYLOAD_SIZE.
+ *
+ * Return:
+ *	TransportStatus
+ *		TRANSPORT_OKAY - packet queued
+ *		TRANSPORT_NOT_INIT - transport layer not initialized
+ *
+ * Note:
+ *	The length is only carried to the desktop application by COBS frames or
+ *	with UART_PAYLOAD_BINARY (see uart_packet_helpers.h).  Otherwise the full
+ *	payload is sent.
+ */
+TransportStatus uartTransport_commitTxLength(uint16_t length);
+
+/* uartTransport_peekRx
+ *
+ * Function:
+ *	Gets a view of the oldest received packet, in place in the rx queue,
+ *	without copying or removing it.
+ *
+ * Parameters:
+ *	view - pointer to the view to point at the packet's header and payload.
+ *
+ * Return:
+ *	TransportStatus
+ *		TRANSPORT_OKAY - packet available
+ *		TRANSPORT_RX_EMPTY - rx queue empty
+ *		TRANSPORT_NOT_INIT - transport layer not initialized
+ *
+ * Note:
+ *	The view is valid until uartTransport_releaseRx() is called.
+ */
+TransportStatus uartTransport_peekRx(PacketView* view);
+
+/* uartTransport_releaseRx
+ *
+ * Function:
+ *	Removes the oldest received packet from the rx queue, freeing its slot
+ *	for reception.
+ *
+ * Return:
+ *	TransportStatus
+ *		TRANSPORT_OKAY - packet released (or rx queue was empty)
+ *		TRANSPORT_NOT_INIT - transport layer not initialized
+ */
+TransportStatus uartTransport_releaseRx(void);
+
 /* uartTransport_tx_polled
  *
  * Function:
- *	Perform transmission of buffered packet over UART.
+ *	Starts transmission of queued packets over UART if it is not under way, and
+ *	waits for the queue to be transmitted.
  *
  * Parameters:
- *	timeout_ms - timeout for transmission, in milliseconds.
+ *	timeout_ms - timeout for transmission, in milliseconds.  A timeout of 0
+ *			starts transmission and returns without waiting.
  *
  * Return:
  *	TransportStatus
  *		TRANSPORT_NOT_INIT - transport layer not initialized
- *		TRANSPORT_TX_EMPTY - tx buffer is empty
+ *		TRANSPORT_TX_EMPTY - tx queue is empty
  *		TRANSPORT_BUSY - UART peripheral is busy and tx could
  *			not begin
- *		TRANSPORT_TIMEOUT - timeout on tx
- *		TRANSPORT_ERROR - error with message transmission,
- *			see note † in uart_transport_layer.c.
- *		TRANSPORT_OKAY - transmission successful.
+ *		TRANSPORT_TIMEOUT - the queue was not transmitted within
+ *			the (non-zero) timeout.
+ *		TRANSPORT_OKAY - transmission successful, or under way
+ *			for a timeout of 0.
  *
  * Note:
- *	If transmission is delayed or takes longer than the timeout, the timeout
- *	will stop transmission before transmission is complete.
+ *	If transmission takes longer than the timeout, transmission continues in
+ *	the background after the function returns.  Packets retained for a window
+ *	(see uartTransport_setTxWindow()) count as transmitted.
  */
 TransportStatus uartTransport_tx_polled(uint32_t timeout_ms);
 
+/* uartTransport_setTxSchedule
+ *
+ * Function:
+ *	Sets how the lane of the next packet transmitted is picked.  The schedule
+ *	is UART_TX_SCHEDULE, with UART_TX_URGENT_WEIGHT, until set.
+ *
+ * Parameters:
+ *	schedule - TransportTxSchedule.
+ *	urgentWeight - urgent packets sent for each bulk packet, for
+ *			TX_SCHEDULE_WEIGHTED.  Must not be 0.
+ *
+ * Return:
+ *	bool - false if the schedule or weight is not valid, true otherwise.
+ */
+bool uartTransport_setTxSchedule(TransportTxSchedule schedule, uint32_t urgentWeight);
+
+/* uartTransport_setTxWindow
+ *
+ * Function:
+ *	Sets how many transmitted packets are retained in the tx queue until
+ *	acknowledged with uartTransport_ackTx().  Transmission pauses while the
+ *	window is full.
+ *
+ * Parameters:
+ *	window - most packets retained, or 0 to release packets once transmitted
+ *			(the default).
+ *
+ * Note:
+ *	Setting a window of 0 releases any retained packets.  An acknowledgement
+ *	waiting in uartTransport_peerAck() is dropped, as are acknowledgements
+ *	from uartTransport_ackTx() not yet applied if retention is turned on or
+ *	off.
+ */
+void uartTransport_setTxWindow(uint32_t window);
+
+/* uartTransport_ackTx
+ *
+ * Function:
+ *	Acknowledges retained packets, which are released from the front of the
+ *	tx queue.  A packet being resent (see uartTransport_rewindTx()) is
+ *	released once it has been sent again, so the caller can count
+ *	acknowledged packets as done straight away.
+ *
+ * Parameters:
+ *	count - number of packets acknowledged.
+ */
+void uartTransport_ackTx(uint32_t count);
+
+/* uartTransport_rewindTx
+ *
+ * Function:
+ *	Resends the retained packets, from the oldest, followed by the packets
+ *	not yet sent.
+ *
+ * Note:
+ *	A packet in flight completes first.
+ */
+void uartTransport_rewindTx(void);
+
+/* uartTransport_acquireControlTx
+ *
+ * Function:
+ *	Gets the control frame buffer, cleared, to compose a packet into in
+ *	place.  The control frame is sent ahead of the tx queue and is never
+ *	retained.
+ *
+ * Parameters:
+ *	view - pointer to a PacketView to set up on the control frame.
+ *
+ * Return:
+ *	TransportStatus
+ *		TRANSPORT_NOT_INIT - transport layer not initialized
+ *		TRANSPORT_TX_FULL - the last control frame has not been sent
+ *		TRANSPORT_OKAY - the view is ready to be written
+ */
+TransportStatus uartTransport_acquireControlTx(PacketView* view);
+
+/* uartTransport_commitControlTx
+ *
+ * Function:
+ *	Sends the control frame from uartTransport_acquireControlTx() once the
+ *	packet in flight, if any, completes.
+ *
+ * Return:
+ *	TransportStatus
+ *		TRANSPORT_NOT_INIT - transport layer not initialized
+ *		TRANSPORT_OKAY - control frame waiting to be sent
+ */
+TransportStatus uartTransport_commitControlTx(void);
+
+#if UART_PACKET_LINK_SIZE > 0
+/* uartTransport_peerAck
+ *
+ * Function:
+ *	Gets the acknowledgement (or credit) carried by the latest packet
+ *	received, if one has arrived since the last call.  Packets carrying only
+ *	the link segment are taken by reception and never reach the rx queue, and
+ *	unsequenced packets carry none (see UART_LINK_UNSEQUENCED).
+ *
+ * Parameters:
+ *	ack - pointer to store the link segment's second byte.
+ *
+ * Return:
+ *	bool - true if a new acknowledgement was stored, false otherwise.
+ */
+bool uartTransport_peerAck(uint8_t* ack);
+#endif
+
+/* uartTransport_setTxCompleteCallback
+ *
+ * Function:
+ *	Sets a function to be called each time a queued packet has been
+ *	transmitted.
+ *
+ * Parameters:
+ *	callback - function pointer, or NULL for no callback.
+ *
+ * Note:
+ *	The callback is called from interrupt context and must be short.
+ */
+void uartTransport_setTxCompleteCallback(void (*callback)(void));
+
+/* uartTransport_setRxEventCallback
+ *
+ * Function:
+ *	Sets a function to be called each time bytes are received (after any
+ *	complete packets have been moved into the rx queue), and when an error
+ *	stops reception (it is restarted by uartTransport_IRQHandler(), pended
+ *	by uartTransport_rx_polled() at the latest).
+ *
+ * Parameters:
+ *	callback - function pointer, or NULL for no callback.
+ *
+ * Note:
+ *	The callback is called from interrupt context and must be short.
+ */
+void uartTransport_setRxEventCallback(void (*callback)(void));
+
+/* uartTransport_txPending
+ *
+ * Function:
+ *	Returns the number of packets queued for transmission in either lane and
+ *	not yet sent (including one being sent).  Packets sent and retained for a
+ *	window are not counted.
+ *
+ * Return:
+ *	uint32_t - number of packets, 0 if not initialized.
+ */
+uint32_t uartTransport_txPending(void);
+
+/* uartTransport_rxPending
+ *
+ * Function:
+ *	Returns the number of packets in the rx queue, received and not yet
+ *	released.
+ *
+ * Return:
+ *	uint32_t - number of packets, 0 if not initialized.
+ */
+uint32_t uartTransport_rxPending(void);
+
+/* uartTransport_stats
+ *
+ * Function:
+ *	Copies out the layer's counts.
+ *
+ * Parameters:
+ *	stats - pointer to where the counts are to be stored.
+ *
+ * Note:
+ *	Interrupts are not masked for the copy, so an interrupt taken during it
+ *	can leave one count an event ahead of another.
+ */
+void uartTransport_stats(TransportStats* stats);
+
+/* uartTransport_resetStats
+ *
+ * Function:
+ *	Zeroes the layer's counts.
+ */
+void uartTransport_resetStats(void);
+
+/* uartTransport_IRQHandler
+ *
+ * Function:
+ *	Takes what the main context has left to the interrupts:  restarts
+ *	reception stopped by a UART error, moves frames left in the reception ring
+ *	into the freed rx queue, applies window, acknowledgement, rewind and count
+ *	reset requests, and starts transmission if the UART is idle.
+ *
+ * Note:
+ *	To be called from the UART's global interrupt handler (UART_TRANSPORT_IRQn),
+ *	after HAL_UART_IRQHandler().  The layer pends the interrupt itself when
+ *	there is something to take.
+ */
+void uartTransport_IRQHandler(void);
+
 /* uartTransport_rx_polled
  *
  * Function:
- *	Perform reception of packet(s) over UART and buffers them.
+ *	Waits for a packet received in the background to be ready in the rx queue.
  *
  * Parameters:
- *	timeout_ms - timeout for transmission, in milliseconds.
+ *	timeout_ms - timeout for reception, in milliseconds.  A timeout of 0 checks
+ *			the rx queue once and returns without waiting.
  *
  * Return:
  *	TransportStatus
  *		TRANSPORT_NOT_INIT - transport layer not initialized
- *		TRANSPORT_RX_FULL - rx buffer is full
- *		TRANSPORT_BUSY - UART peripheral is busy and rx could
- *			not begin
- *		TRANSPORT_TIMEOUT - timeout on rx
- *		TRANSPORT_ERROR - error with message transmission,
- *			see note † in uart_transport_layer.c.
- *		TRANSPORT_OKAY - reception successful.
+ *		TRANSPORT_TIMEOUT - no packet was received within the timeout
+ *		TRANSPORT_ERROR - background reception stopped on a UART
+ *			error and could not be restarted.
+ *		TRANSPORT_OKAY - a packet is ready to be debuffered.
  *
  * Note:
- *	If reception is delayed or takes longer than the timeout, the timeout will
- *	stop reception before reception is complete.
+ *	Bytes of an incomplete packet are kept in the reception ring across calls.
+ *	If no further bytes arrive for longer than twice the time a packet takes to
+ *	be received, the incomplete packet is discarded so that reception
+ *	resynchronizes on the next packet.
  */
 TransportStatus uartTransport_rx_polled(uint32_t timeout_ms);
 
@@ -0,0 +1,129 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ */
+
+
+#include <command_table.h>
+#include "string.h"
+
+
+/*
+ * Multiplier of the hash (Fibonacci hashing:  2^32 divided by the golden ratio).
+ * Header codes differ mostly in their low bits' patterns, and the upper half of the
+ * product mixes in every byte of the ID.
+ */
+#define COMMAND_HASH_MULTIPLIER 0x9E3779B1U
+#define COMMAND_HASH_SHIFT 16
+
+
+// Private Function Prototypes
+uint32_t _commandTable_home(const CommandTable* table, uint32_t id);
+
+
+/* commandId
+ *
+ * Shifts rather than copying the bytes into a uint32_t, so the ID does not depend
+ * on the byte order of the MCU.  The compiler reduces this to one load where it can.
+ */
+uint32_t commandId(const uint8_t header[UART_PACKET_HEADER_SIZE])
+{
+	return COMMAND_ID(header[0], header[1], header[2], header[3]);
+}
+
+
+/* commandTable_reset
+ *
+ * Sets every slot to COMMAND_ID_FREE.
+ */
+void commandTable_reset(CommandTable* table)
+{
+	memset(table->ids, 0, (table->mask + 1) * sizeof(uint32_t));
+	table->count = 0;
+}
+
+
+/* commandTable_count
+ *
+ * Returns the count maintained by commandTable_insert().
+ */
+uint32_t commandTable_count(const CommandTable* table)
+{
+	return table->count;
+}
+
+
+/* commandTable_insert
+ *
+ * Probes from the ID's home slot until the ID or a free slot is found.  As IDs are
+ * never removed, an ID is always before the first free slot on its probe sequence.
+ */
+uint32_t commandTable_insert(CommandTable* table, uint32_t id)
+{
+	uint32_t slot = _commandTable_home(table, id);
+	uint32_t probes;
+
+	if (id == COMMAND_ID_FREE)
+	{
+		return COMMAND_SLOT_NONE;
+	}
+
+	for (probes = 0; probes <= table->mask; probes++)
+	{
+		if (table->ids[slot] == id)
+		{
+			return slot;
+		}
+		if (table->ids[slot] == COMMAND_ID_FREE)
+		{
+			table->ids[slot] = id;
+			table->count++;
+			return slot;
+		}
+		slot = (slot + 1) & table->mask;
+	}
+
+	// every slot holds another ID
+	return COMMAND_SLOT_NONE;
+}
+
+
+/* commandTable_find
+ *
+ * Probes from the ID's home slot until the ID or a free slot is found.
+ */
+uint32_t commandTable_find(const CommandTable* table, uint32_t id)
+{
+	uint32_t slot = _commandTable_home(table, id);
+	uint32_t probes;
+
+	if (id == COMMAND_ID_FREE)
+	{
+		return COMMAND_SLOT_NONE;
+	}
+
+	for (probes = 0; probes <= table->mask; probes++)
+	{
+		if (table->ids[slot] == id)
+		{
+			return slot;
+		}
+		if (table->ids[slot] == COMMAND_ID_FREE)
+		{
+			break;
+		}
+		slot = (slot + 1) & table->mask;
+	}
+
+	return COMMAND_SLOT_NONE;
+}
+
+
+/* _commandTable_home
+ *
+ * Returns the slot an ID is placed in when it does not collide.
+ */
+uint32_t _commandTable_home(const CommandTable* table, uint32_t id)
+{
+	return ((id * COMMAND_HASH_MULTIPLIER) >> COMMAND_HASH_SHIFT) & table->mask;
+}
@@ -5,29 +5,216 @@
 
 
 #include <desktop_app_session.h>
+#include <packet_queue.h>
+#include <stage_profile.h>
+#include <event_trace.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdint.h>
 
 
+/*
+ * CTS messages are the software flow control, unless a link segment mode or
+ * hardware flow control takes their place.
+ */
+#if UART_PACKET_LINK_SIZE == 0 && !defined(UART_HW_FLOW_CONTROL)
+#define SESSION_CTS
+#endif
+
+/*
+ * A high-water mark as it is laid out in the STAT reply, a nibble saturating at 15.
+ */
+#define STAT_NIBBLE(value) ((uint8_t)((value) > 15 ? 15 : (value)))
+
+
+/*
+ * Session states.  A session is moved from one state to the next by calls to
+ * desktopAppSession_start() and desktopAppSession_update(), which check what the
+ * transport layer has received or sent and return without waiting on it.
+ */
+typedef enum {
+	STATE_CLOSED,			// No session, a SYNC is listened for
+	STATE_ACKNOWLEDGED,		// ACKN queued, the SYNA is waited for
+	STATE_SWITCHING,		// SYNA received, the ACKN is left to be sent before switching baud rate
+	STATE_CONFIRMING,		// Baud rate switched, the BAUD confirmation is waited for
+	STATE_OPEN,				// Session open
+	STATE_CLOSING,			// DISC answered, the answer is left to be sent before closing
+	STATE_DRAINING,			// Stopping, the messages queued are left to be sent before the DISC
+	STATE_STOPPING			// DISC sent, the desktop's DACK is waited for
+} SessionState;
+
+/*
+ * Stages of a session update, in the order they run.  An update that spends its time
+ * budget leaves the stages after it for the next update, which starts from the stage
+ * it stopped at, so that every stage runs however small the budget.
+ */
+typedef enum {
+	UPDATE_WINDOW,			// Acknowledgements taken and resends (windowed mode)
+	UPDATE_TRACE,			// Packets of a trace dump queued (SESSION_TRACE)
+	UPDATE_TELL,			// Transmission of queued packets started
+	UPDATE_DISPATCH,		// Received messages dispatched or moved into the receive queue
+	UPDATE_RECEIVE,			// Acknowledgement or credit sent, and reception (the CTS window in CTS mode)
+	UPDATE_STAGES			// Number of stages
+} UpdateStage;
+
+/*
+ * What a slot of the handler table dispatches to.
+ */
+typedef struct {
+	SessionHandler handler;		// function called with the message, NULL if none
+	void* context;				// pointer passed to the handler
+} SessionHandlerEntry;
+
+
 /*
  * Private helper function prototypes for session manager.
  */
-DesktopComSessionStatus _handshake(unsigned int timeout_ms);
+DesktopComSessionStatus _handshake(void);
+DesktopComSessionStatus _closingHandshake(void);
+bool _session_stopping(void);
+void _session_enter(SessionState state);
+bool _session_elapsed(uint32_t timeout_ms);
+void _session_open(void);
+void _session_closing(void);
+uint32_t _session_newToken(void);
+void _session_budgetStart(uint32_t budget_us);
+bool _session_budgetLeft(void);
+bool _session_stageDue(UpdateStage stage);
 DesktopComSessionStatus _session_update(void);
 DesktopComSessionStatus _listen(void);
 DesktopComSessionStatus _tell(void);
+const SessionHandlerEntry* _handlerFor(const uint8_t header[UART_PACKET_HEADER_SIZE]);
+bool _isSessionHeader(uint32_t id);
+DesktopComSessionStatus _serviceSessionCommands(void);
+bool _admitMessage(const PacketView* message);
+void _receiveQueue_reset(void);
+DesktopComSessionStatus _handleDisconnect(const PacketView* command, void* context);
+DesktopComSessionStatus _handleResume(const PacketView* command, void* context);
+DesktopComSessionStatus _handleEcho(const PacketView* command, void* context);
+DesktopComSessionStatus _handleStat(const PacketView* command, void* context);
+uint16_t _stat_encode(uint8_t* chars);
+#ifdef SESSION_PROFILE
+DesktopComSessionStatus _handleProfile(const PacketView* command, void* context);
+#endif
+#ifdef SESSION_TRACE
+DesktopComSessionStatus _handleTrace(const PacketView* command, void* context);
+void _traceDump_continue(void);
+void _traceDump_stop(bool clear);
+#endif
+void _session_setTimeouts(void);
+void _rtt_sample(uint32_t elapsed_ms, uint32_t frames);
+void _rtt_backoff(void);
+uint32_t _chooseBaudRate(const PacketView* sync);
+void _restoreBaudRate(void);
+TransportStatus _txAcquire(PacketView* view, TransportTxLane lane);
+TransportTxLane _laneFor(SessionPriority priority);
+void _txStamp(void);
+void _txCommit(void);
+void _txCommitLength(uint16_t length);
+TransportStatus _rxFront(PacketView* view);
+void _rxRelease(void);
+#if UART_PACKET_LINK_SIZE > 0
+void _link_reset(void);
+uint8_t _link_advertised(void);
+void _link_advertise(void);
+#endif
+#ifdef SESSION_WINDOWED
+void _window_update(void);
+#endif
+
+
+#ifdef SESSION_WINDOWED
+/*
+ * Window limits.  Sequence numbers must tell a full window apart from an empty one,
+ * the tx queue holds the window, and a full window from the desktop must fit in the
+ * rx queue and the ring (less a frame for the one being received).
+ */
+_Static_assert(SESSION_WINDOW_SIZE > 0 && SESSION_WINDOW_SIZE < UART_LINK_SEQ_MODULUS,
+		"session window must be smaller than the sequence modulus");
+_Static_assert(SESSION_WINDOW_SIZE <= UART_TX_QUEUE_LENGTH,
+		"session window must fit in the tx queue");
+_Static_assert(SESSION_WINDOW_SIZE + 1 <= UART_RX_QUEUE_LENGTH + UART_RX_RING_SIZE / UART_FRAME_SIZE - 1,
+		"session window must fit in the rx queue and ring");
+#endif
+
+#ifdef SESSION_CREDIT
+/*
+ * Credit limits.  Credits must tell no credit apart from a full grant, and packets
+ * sent on credit must fit in the rx queue and the ring (less a frame for the one
+ * being received).
+ */
+_Static_assert(SESSION_CREDITS > 0 && SESSION_CREDITS < UART_LINK_SEQ_MODULUS,
+		"session credits must be fewer than the sequence modulus");
+_Static_assert(SESSION_CREDITS <= UART_RX_QUEUE_LENGTH + UART_RX_RING_SIZE / UART_FRAME_SIZE - 1,
+		"session credits must fit in the rx queue and ring");
+#endif
+
+
+/*
+ * Handler table.  The header codes are kept by the command table and the handlers
+ * in the slot of the same index.
+ */
+COMMAND_TABLE_DEFINE(_handlerTable, SESSION_HANDLERS);
+static SessionHandlerEntry _handlers[SESSION_HANDLERS];
+
+/*
+ * Receive queue, holding the messages for the application.  Only the main context
+ * uses it.
+ */
+PACKET_QUEUE_DEFINE(_receiveQueue, SESSION_RX_QUEUE_LENGTH);
 
 
 /*
  * File-scope static variables for session manager functionality across
  * function calls.  (Manager Operational Variables)
  */
-static bool _sessionOpen = false;						// Flag to signal if a session is open
+static SessionState _sessionState = STATE_CLOSED;		// State of the session
+static uint32_t _stateTick = 0;							// Tick the session entered its state
 static bool _sessionInit = false;						// Flag to signal if the manager is initialized
-static char _messageCommand[UART_PACKET_HEADER_SIZE];	// Rx buffer for header (used for processing in manager)
-static char _messageData[UART_PACKET_PAYLOAD_SIZE];		// Rx buffer for body (used for processing in manager)
-static bool _messageReady = false;						// Flag to signal if a message is in the Rx buffer
+static uint32_t _defaultBaudRate = 0;					// UART baud rate before negotiation
+static uint32_t _negotiatedBaudRate = 0;				// UART baud rate chosen in the handshake
+static uint32_t _sessionToken = 0;						// Token the desktop resumes the session with
+static RttEstimator _rtt;								// Estimate of the desktop's response time
+static uint32_t _receiveTimeout_ms = RECEIVE_TIMEOUT_MS;	// Desktop's response and a frame, at the current baud rate
+static uint32_t _replyTimeout_ms = RECEIVE_TIMEOUT_MS;	// Urgent message sent and answered, at the current baud rate
+static uint32_t _sendTimeout_ms = SEND_TIMEOUT_MS;		// Tx queue drain timeout at the current baud rate
+static const uint32_t _baudRates[] = SESSION_BAUD_RATES;	// Baud rates offered in the handshake
+static uint8_t* _txLink = NULL;							// Link segment of the message being built
+static uint32_t _budgetStart = 0;						// Time source reading when the budgeted update started
+static uint32_t _budget = UINT32_MAX;					// Time budget of the update, in the time source's units (UINT32_MAX for none)
+static uint32_t _budgetSteps = 0;						// Steps taken in the update
+static UpdateStage _updateResume = UPDATE_WINDOW;		// Stage the next update starts from
+static UpdateStage _updateStopped = UPDATE_STAGES;		// Stage the update spent its budget at (UPDATE_STAGES for none)
+static SessionRxOverflow _rxOverflow = SESSION_RX_OVERFLOW;	// Policy for messages received with the receive queue full
+static uint32_t _rxRejected = 0;						// Messages rejected with the receive queue full
+static uint32_t _rxDroppedOldest = 0;					// Messages discarded to make room in the receive queue
+static uint32_t _rxDroppedNewest = 0;					// Messages discarded with the receive queue full
+static SessionLinkStats _linkStats = {0};				// Counts kept across sessions (not the transport's)
+#ifdef SESSION_CTS
+static bool _ctsOpen = false;							// Flag for a CTS sent and its Message window open
+static uint32_t _ctsTick = 0;							// Tick the CTS was queued
+#endif
+#if UART_PACKET_LINK_SIZE > 0
+static uint8_t _txSeq = 0;								// Sequence number of the next message sent
+static uint8_t _rxExpected = 0;							// Sequence number of the next message to receive
+static uint8_t _rxAckSent = 0;							// Acknowledgement (or credit) last sent to the desktop
+static uint32_t _rxAckTick = 0;							// Tick the acknowledgement (or credit) was last sent
+#endif
+#ifdef SESSION_TRACE
+static bool _traceDumping = false;						// Flag for a trace dump being streamed
+static bool _traceClear = false;						// Flag for emptying the trace once dumped
+static uint32_t _traceNext = 0;							// Index of the next trace entry to send
+static uint32_t _traceEnd = 0;							// Index after the last trace entry to send
+#endif
+#ifdef SESSION_WINDOWED
+static uint8_t _txBase = 0;								// Sequence number of the oldest unacknowledged message
+static uint8_t _txPeerAck = 0;							// Latest acknowledgement from the desktop
+static uint32_t _txProgressTick = 0;					// Tick of the last acknowledgement (or idle window)
+static uint32_t _retransmitTimeout_ms = RECEIVE_TIMEOUT_MS;	// Time without acknowledgement before resending
+static bool _rttTiming = false;							// Flag for a message being timed to its acknowledgement
+static uint8_t _rttSeq = 0;								// Sequence number of the message timed
+static uint32_t _rttTick = 0;							// Tick the message timed was queued
+#endif
 
 
 /* desktopAppSession_init
@@ -41,11 +228,31 @@ bool desktopAppSession_init(UART_HandleTypeDef* huart)
 	if (!_sessionInit && uartTransport_init(huart))
 	{
 		// reset operational variables
-		_sessionOpen = false;
+		_session_enter(STATE_CLOSED);
 		_sessionInit = true;
-		_messageReady = false;
-		memset(_messageCommand, 0, UART_PACKET_HEADER_SIZE * sizeof(char));
-		memset(_messageData, 0, UART_PACKET_PAYLOAD_SIZE * sizeof(char));
+		_defaultBaudRate = uartTransport_getBaudRate();
+		stageProfile_init();
+		rttEstimator_init(&_rtt, RECEIVE_TIMEOUT_MS);
+		_session_setTimeouts();
+		_rxOverflow = SESSION_RX_OVERFLOW;
+		_receiveQueue_reset();
+		memset(&_linkStats, 0, sizeof(_linkStats));
+
+		// the session's own commands dispatch through the handler table too
+		commandTable_reset(&_handlerTable);
+		memset(_handlers, 0, sizeof(_handlers));
+		_handlers[commandTable_insert(&_handlerTable, HANDSHAKE_ID_DISC)].handler = _handleDisconnect;
+		_handlers[commandTable_insert(&_handlerTable, HANDSHAKE_ID_SYNC)].handler = _handleDisconnect;
+		_handlers[commandTable_insert(&_handlerTable, RESUME_ID)].handler = _handleResume;
+		_handlers[commandTable_insert(&_handlerTable, ECHO_ID)].handler = _handleEcho;
+		_handlers[commandTable_insert(&_handlerTable, STAT_ID)].handler = _handleStat;
+#ifdef SESSION_PROFILE
+		_handlers[commandTable_insert(&_handlerTable, PROF_ID)].handler = _handleProfile;
+#endif
+#ifdef SESSION_TRACE
+		_handlers[commandTable_insert(&_handlerTable, TRAC_ID)].handler = _handleTrace;
+		eventTrace_init();
+#endif
 
 		return true;
 	}
@@ -64,38 +271,45 @@ bool desktopAppSession_init(UART_HandleTypeDef* huart)
  */
 bool sessionOpen(void)
 {
-	return _sessionInit && _sessionOpen;
+	return _sessionInit && _sessionState == STATE_OPEN;
+}
+
+
+/* desktopAppSession_deinit
+ *
+ * Deinitializes the UART transport layer, abandoning any session without a closing
+ * handshake.  Only will deinitialize if the manager has been initialized.
+ */
+bool desktopAppSession_deinit(void)
+{
+	// if the module has been initialized
+	if (_sessionInit && uartTransport_deinit())
+	{
+		_session_enter(STATE_CLOSED);
+		_sessionInit = false;
+		return true;
+	}
+
+	// module not initialized
+	else
+	{
+		return false;
+	}
 }
 
 
 /* desktopAppSession_start
  *
- * Attempts to handshake with the desktop application.  Wrapper for the handshake function.
- * Will not attempt if the manager has not been initialized and will not attempt if a
- * session is already open.
+ * Advances the handshake with the desktop application by a step.  Wrapper for the
+ * handshake function.  Will not attempt if the manager has not been initialized.
  */
 DesktopComSessionStatus desktopAppSession_start(void)
 {
-	DesktopComSessionStatus handshakeStatus;
-
 	// if the module has been initialized
 	if (_sessionInit)
 	{
-		// only attempt to handshake if a session is not already open
-		if (!_sessionOpen)
-		{
-			// perform handshake and return result
-			handshakeStatus = _handshake(SESSION_START_TIMEOUT_MS);
-			if (handshakeStatus == SESSION_OKAY)
-				_sessionOpen = true;
-			return handshakeStatus;
-		}
-
-		// if session is open
-		else
-		{
-			return SESSION_OKAY;
-		}
+		// a session that is open stays open, otherwise the handshake is advanced
+		return _handshake();
 	}
 
 	// module not initialized
@@ -108,15 +322,23 @@ DesktopComSessionStatus desktopAppSession_start(void)
 
 /* desktopAppSession_stop
  *
- * Force the end of a session by sending the end session confirmation code
- * to the desktop application.  Only ends a session if the session manager
- * has been initialized and a session is open.
- *
- * Note:  needs to be implemented.
+ * Close the session with the desktop application.  Wraps the _closingHandshake()
+ * function, which advances the closing by a step, with a check for the module to
+ * be initialized.
  */
 DesktopComSessionStatus desktopAppSession_stop(void)
 {
-	return SESSION_OKAY;
+	// if the module has been initialized
+	if (_sessionInit)
+	{
+		return _closingHandshake();
+	}
+
+	// module not initialized
+	else
+	{
+		return SESSION_NOT_INIT;
+	}
 }
 
 
@@ -127,18 +349,50 @@ DesktopComSessionStatus desktopAppSession_stop(void)
  */
 DesktopComSessionStatus desktopAppSession_update(void)
 {
+	return desktopAppSession_updateWithin(SESSION_BUDGET_NONE, NULL);
+}
+
+
+/* desktopAppSession_updateWithin
+ *
+ * Updates the session manager, running its stages, and servicing session commands
+ * within the dispatch stage, only while the time budget lasts.  The next update
+ * starts from the stage the budget ran out at.  Reports what is left to do.
+ */
+DesktopComSessionStatus desktopAppSession_updateWithin(uint32_t budget_us, uint32_t* backlog)
+{
+	DesktopComSessionStatus status;
+
 	// if the module has been initialized
 	if (_sessionInit)
 	{
 		// only run _update() if a session is opened
-		if (_sessionOpen)
+		if (_sessionState == STATE_OPEN)
 		{
-			return _session_update();
+			_session_budgetStart(budget_us);
+			PROFILE_CALL(PROFILE_UPDATE, status = _session_update());
+			_updateResume = (_updateStopped == UPDATE_STAGES) ? UPDATE_WINDOW : _updateStopped;
+
+			if (backlog != NULL)
+			{
+				*backlog = uartTransport_txPending() + uartTransport_rxPending();
+			}
+			return status;
 		}
 
-		// a session has not been opened
+		// a session has not been opened (one that is closing is advanced, one being
+		// stopped is advanced by desktopAppSession_stop())
 		else
 		{
+			if (_sessionState == STATE_CLOSING)
+			{
+				_session_closing();
+			}
+
+			if (backlog != NULL)
+			{
+				*backlog = uartTransport_txPending() + uartTransport_rxPending();
+			}
 			return SESSION_NOT_OPEN;
 		}
 	}
@@ -151,27 +405,36 @@ DesktopComSessionStatus desktopAppSession_update(void)
 }
 
 
-/* desktopAppSession_enqueueMessage
- *
- * Buffers a single message into the transport layer tx buffer.
+/* desktopAppSession_registerHandler
  *
- * todo: Need to add a queue in the session manager for this.
+ * Places the header in the handler table and sets its slot's handler.  The session's
+ * own headers cannot be taken over.
  */
-DesktopComSessionStatus desktopAppSession_enqueueMessage(char header[UART_PACKET_HEADER_SIZE],
-		char body[UART_PACKET_PAYLOAD_SIZE])
+DesktopComSessionStatus desktopAppSession_registerHandler(const char header[UART_PACKET_HEADER_SIZE],
+		SessionHandler handler, void* context)
 {
+	uint32_t id;
+	uint32_t slot;
+
 	// if the module has been initialized
 	if (_sessionInit)
 	{
-		// try to enqueue message and return if successful
-		if (uartTransport_bufferTx((uint8_t*)header, (uint8_t*)body) != TRANSPORT_OKAY)
+		id = commandId((const uint8_t*)header);
+		if (_isSessionHeader(id))
 		{
-			return SESSION_BUFFER_FULL;
+			return SESSION_ERROR;
 		}
-		else
+
+		// find or take a slot for the header
+		slot = commandTable_insert(&_handlerTable, id);
+		if (slot == COMMAND_SLOT_NONE)
 		{
-			return SESSION_OKAY;
+			return SESSION_BUFFER_FULL;
 		}
+
+		_handlers[slot].handler = handler;
+		_handlers[slot].context = context;
+		return SESSION_OKAY;
 	}
 
 	// module has not been initialized
@@ -182,36 +445,30 @@ DesktopComSessionStatus desktopAppSession_enqueueMessage(char header[UART_PACKET
 }
 
 
-/* desktopAppSession_dequeueMessage
+/* desktopAppSession_setRxOverflow
  *
- * Debuffers from the session manager's header and body buffer.  See note of this buffer
- * above.
- *
- * todo: Need to add a queue in the session manager for this.
+ * Sets the policy _admitMessage() applies with the receive queue full.
  */
-DesktopComSessionStatus desktopAppSession_dequeueMessage(char header[UART_PACKET_HEADER_SIZE], char body[UART_PACKET_PAYLOAD_SIZE])
+DesktopComSessionStatus desktopAppSession_setRxOverflow(SessionRxOverflow policy)
 {
 	// if the module has been initialized
 	if (_sessionInit)
 	{
-		// if a message is present in the received queue, copy to output
-		if (_messageReady)
+		switch (policy)
 		{
-			memcpy(header, _messageCommand, UART_PACKET_HEADER_SIZE*sizeof(char));
-			memcpy(body, _messageData, UART_PACKET_PAYLOAD_SIZE*sizeof(char));
-			_messageReady = false;
+			case SESSION_RX_HOLD:
+			case SESSION_RX_REJECT:
+			case SESSION_RX_DROP_OLDEST:
+			case SESSION_RX_DROP_NEWEST:
+				_rxOverflow = policy;
+				return SESSION_OKAY;
 
-			return SESSION_OKAY;
-		}
-
-		// no message is ready
-		else
-		{
-			return SESSION_BUFFER_EMPTY;
+			default:
+				return SESSION_ERROR;
 		}
 	}
 
-	// the module has not been initialized
+	// module has not been initialized
 	else
 	{
 		return SESSION_NOT_INIT;
@@ -219,258 +476,1561 @@ DesktopComSessionStatus desktopAppSession_dequeueMessage(char header[UART_PACKET
 }
 
 
-/* _handshake
+/* desktopAppSession_rxStats
  *
- * Performs handshake with desktop application.  Listens for incomming request to
- * open a session with the SESSION_START_TIMEOUT_MS value.  If a message is received
- * with the HANDSHAKE_HEADER_SYNC header command, then handshaking begins.  A message
- * is sent with the HANDSHAKE_HEADER_ACKN header command is sent and listening begins
- * again with the RECEIVE_TIMEOUT_MS timeout value.  If the HANDSHAKE_HEADER_SYNACK
- * header command is received, then a session is opened.
- *
- * This series of steps for the handshake confirms that timeout values on the MCU are
- * not too short (as long as the Desktop is sufficiently fast enough at responding
- * messages from the MCU).  Timeout values may need to be tweaked if handshaking
- * consistently fails.
+ * Reads the receive queue's counts and the counters kept by _admitMessage().
+ */
+DesktopComSessionStatus desktopAppSession_rxStats(SessionRxStats* stats)
+{
+	// if the module has been initialized
+	if (_sessionInit)
+	{
+		stats->depth = packetQueue_count(&_receiveQueue);
+		stats->capacity = SESSION_RX_QUEUE_LENGTH;
+		stats->highWater = packetQueue_highWater(&_receiveQueue);
+		stats->pending = uartTransport_rxPending();
+		stats->rejected = _rxRejected;
+		stats->droppedOldest = _rxDroppedOldest;
+		stats->droppedNewest = _rxDroppedNewest;
+		return SESSION_OKAY;
+	}
+
+	// module has not been initialized
+	else
+	{
+		return SESSION_NOT_INIT;
+	}
+}
+
+
+/* desktopAppSession_linkStats
  *
- * A state machine approach is used for confirming each step in the handshaking process.
- * These states are as follows:
- * 	0)	Initial state/reset state.  Waiting for a message from the desktop application.
- * 	1)	Dequeue the message received.
- * 	2)	Check if the message is synchronization message.
- * 	3)	Queue acknowledge message.
- * 	4)	Transmit message to desktop application.
- * 	5)	Wait for incoming message from the desktop application.
- * 	6)	Dequeue the message received.
- * 	7)	Check if the message is a synchronization acknowledge message.
- * 	8)	Implicit.  Handshaking successful.
- *
- * 	The state machine is used simply as a list of steps that must be checked off in order.
- * 	If any one step fails, handshaking fails.
- *
- * Note:  no software flow control is used for the first message.  Listening for the
- * first message from the desktop may timeout and cause synchronization issues while
- * attempting to handshake.
- */
-DesktopComSessionStatus _handshake(unsigned int timeout_ms)
-{
-	unsigned int state = 0;
-	bool error = false;
-	bool success = false;
-	TransportStatus transportStatus;
-	char messageHeader[UART_PACKET_HEADER_SIZE] = {0};
-	char messageBody[UART_PACKET_PAYLOAD_SIZE] = {0};
+ * Reads the transport layer's counts and the session's, taking the receive queue's
+ * high-water mark since the session was opened into account.
+ */
+DesktopComSessionStatus desktopAppSession_linkStats(SessionLinkStats* stats)
+{
+	uint32_t highWater;
 
-	// while the handshake follows proper steps and UART communication does not error
-	while (!success && !error)
+	// if the module has been initialized
+	if (_sessionInit)
 	{
-		// state 0:  receive message
-		if (state == 0)
-		{
-			transportStatus = uartTransport_rx_polled(timeout_ms); // handshake timeout until start of handshake
-		}
-		// state 1: message received, dequeue
-		else if (state == 1)
-		{
-			transportStatus = uartTransport_debufferRx((uint8_t*)messageHeader, (uint8_t*)messageBody);
-		}
-		// state 2: check if sync
-		else if (state == 2)
-		{
-			if (strncmp(messageHeader, HANDSHAKE_HEADER_SYNC, UART_PACKET_HEADER_SIZE))
-			{
-				error = true;
-			}
-		}
-		// state 3: sync received, queue ack
-		else if (state == 3)
+		*stats = _linkStats;
+		uartTransport_stats(&stats->transport);
+		highWater = packetQueue_highWater(&_receiveQueue);
+		if (highWater > stats->receiveHighWater)
 		{
-			memset(messageBody,0,UART_PACKET_PAYLOAD_SIZE);
-			transportStatus = uartTransport_bufferTx((uint8_t*)HANDSHAKE_HEADER_ACKN, (uint8_t*)messageBody);
-		}
-		// state 4: send ack
-		else if (state == 4)
-		{
-			transportStatus = uartTransport_tx_polled(SEND_TIMEOUT_MS);
-		}
-		// state 5: ack sent, receive message
-		else if (state == 5)
-		{
-			transportStatus = uartTransport_rx_polled(RECEIVE_TIMEOUT_MS);
-		}
-		// state 6: dequeue message
-		else if (state == 6)
-		{
-			transportStatus = uartTransport_debufferRx((uint8_t*)messageHeader, (uint8_t*)messageBody);
-		}
-		// state 7: message received, check if syn ack
-		else // if (state == 7)
-		{
-			if (strncmp(messageHeader, HANDSHAKE_HEADER_SYNACK, UART_PACKET_HEADER_SIZE))
-			{
-				error = true;
-			}
+			stats->receiveHighWater = highWater;
 		}
+		return SESSION_OKAY;
+	}
 
-		// catch status codes and move through state machine
-		if (transportStatus == TRANSPORT_OKAY)
-		{
-			if (state == 0)
-				state = 1;
-			else if (state == 1)
-				state = 2;
-			else if (state == 2)
-				state = 3;
-			else if (state == 3)
-				state = 4;
-			else if (state == 4)
-				state = 5;
-			else if (state == 5)
-				state = 6;
-			else if (state == 6)
-				state = 7;
-			else // if (state == 7)
-				success = true;
-		}
-		else
-		{
-			error = true;
-		}
+	// module has not been initialized
+	else
+	{
+		return SESSION_NOT_INIT;
 	}
+}
 
 
-	// report status of handshake
-	if (success && !error)
+/* desktopAppSession_resetLinkStats
+ *
+ * Zeroes the session's counts and the transport layer's.
+ */
+DesktopComSessionStatus desktopAppSession_resetLinkStats(void)
+{
+	// if the module has been initialized
+	if (_sessionInit)
 	{
+		memset(&_linkStats, 0, sizeof(_linkStats));
+		packetQueue_resetHighWater(&_receiveQueue);
+		uartTransport_resetStats();
 		return SESSION_OKAY;
 	}
+
+	// module has not been initialized
 	else
 	{
-		if (transportStatus == TRANSPORT_TIMEOUT)
-		{
-			return SESSION_TIMEOUT;
-		}
-		else
-		{
-			return SESSION_ERROR;
-		}
+		return SESSION_NOT_INIT;
 	}
 }
 
 
-/* _session_update
- *
- * Performs update of session manager.  First transmits a queued message, then receives
- * a message.  Checks if the message received is for the session manager (close session,
- * echo).  If it is, then the session handles appropriately.
+/* desktopAppSession_roundTrip
  *
- * Note:  If a response to the desktop is necessary, this response won't be sent until
- * the next time the session is updated.
+ * Copies the estimate.
  */
-DesktopComSessionStatus _session_update(void)
+DesktopComSessionStatus desktopAppSession_roundTrip(RttEstimator* rtt)
 {
-	char messageHeader[UART_PACKET_HEADER_SIZE] = {0};
-	char messageBody[UART_PACKET_PAYLOAD_SIZE] = {0};
-	DesktopComSessionStatus status;
+	// if the module has been initialized
+	if (_sessionInit)
+	{
+		*rtt = _rtt;
+		return SESSION_OKAY;
+	}
 
-	// Perform Tx message phase of session cycle.
-	status = _tell();
+	// module has not been initialized
+	else
+	{
+		return SESSION_NOT_INIT;
+	}
+}
 
-	// Perform Rx message phase of session cycle.
-	status = _listen();
-	if (status == SESSION_ERROR)
+
+/* desktopAppSession_setTxSchedule
+ *
+ * Sets the transport layer's transmission schedule.
+ */
+DesktopComSessionStatus desktopAppSession_setTxSchedule(TransportTxSchedule schedule, uint32_t urgentWeight)
+{
+	// if the module has been initialized
+	if (_sessionInit)
 	{
-		return SESSION_ERROR;
+		return uartTransport_setTxSchedule(schedule, urgentWeight) ? SESSION_OKAY : SESSION_ERROR;
+	}
+
+	// module has not been initialized
+	else
+	{
+		return SESSION_NOT_INIT;
 	}
+}
+
 
-	// If a message was received while listening.
-	else if (status == SESSION_OKAY)
+/* desktopAppSession_enqueueMessage
+ *
+ * Queues a message into the priority's transport layer tx lane, which starts
+ * transmitting it in the background.
+ */
+DesktopComSessionStatus desktopAppSession_enqueueMessage(char header[UART_PACKET_HEADER_SIZE],
+		char body[UART_PACKET_PAYLOAD_SIZE], SessionPriority priority)
+{
+	// if the module has been initialized
+	if (_sessionInit)
 	{
-		// dequeue received message
-		uartTransport_debufferRx((uint8_t*)messageHeader, (uint8_t*)messageBody);
+		PacketView message;
 
-		// Check if disconnection handshake message was received.
-		// If so, set session open flag to false.
-		if (!strncmp(messageHeader, HANDSHAKE_HEADER_DISC, UART_PACKET_HEADER_SIZE))
+		// a session being stopped takes no more messages
+		if (_session_stopping())
 		{
-			desktopAppSession_enqueueMessage(HANDSHAKE_HEADER_DISC, "\0");
-			_tell();
-			_sessionOpen = false;
-			status = SESSION_CLOSED;
+			return SESSION_NOT_OPEN;
 		}
 
-		// Check if echo command.
-		else if (!strncmp(messageHeader, ECHO_HEADER, UART_PACKET_HEADER_SIZE))
+		// try to enqueue message and return if successful
+		if (_txAcquire(&message, _laneFor(priority)) != TRANSPORT_OKAY)
 		{
-			desktopAppSession_enqueueMessage(messageHeader, messageBody);
-			status = _tell();
+			return SESSION_BUFFER_FULL;
 		}
-
-		// Else, buffer for processing by the application
 		else
 		{
-			memcpy(_messageCommand, messageHeader, UART_PACKET_HEADER_SIZE*sizeof(char));
-			memcpy(_messageData, messageBody, UART_PACKET_PAYLOAD_SIZE*sizeof(char));
-			_messageReady = true;
+			memcpy(message.header, header, UART_PACKET_HEADER_SIZE * sizeof(uint8_t));
+			memcpy(message.payload, body, message.length * sizeof(uint8_t));
+			_txCommit();
+			return SESSION_OKAY;
 		}
 	}
 
-	return status;
+	// module has not been initialized
+	else
+	{
+		return SESSION_NOT_INIT;
+	}
 }
 
 
-/* _listen
- *
- * Wraps calls to the UART transmission layer.
- * Listens for a message from the desktop application.  Performs software flow control.
+/* desktopAppSession_dequeueMessage
  *
- * Listening is divided into two windows:  CTS and Message.  The CTS window acts as
- * software flow control to let the desktop application that it is ready to receive a
- * message.  A CTS message is transmitted.  The Message window listens for a message
- * from the desktop application with the RECEIVE_TIMEOUT_MS value.  Error codes from
- * the transport layer are aliased to session error codes.
+ * Copies out the oldest received message and releases it.  The whole payload is
+ * copied, not only its length:  a received slot is zeroed past the length (see
+ * decodeFrame()), so a shorter body leaves no bytes of an earlier one behind its
+ * terminator.
  */
-DesktopComSessionStatus _listen(void)
+DesktopComSessionStatus desktopAppSession_dequeueMessage(char header[UART_PACKET_HEADER_SIZE], char body[UART_PACKET_PAYLOAD_SIZE])
 {
-	TransportStatus transportStatus;
-	char messageBody[UART_PACKET_PAYLOAD_SIZE] = {0};
-
-	// CTS Window
-	// Tx the CTS message to signal to desktop that the MCU is about to be ready to
-	// receive a message.
-	memset(messageBody,0,UART_PACKET_PAYLOAD_SIZE);
-	snprintf(messageBody, UART_PACKET_PAYLOAD_SIZE, "Clear to send!\n");
-	transportStatus = uartTransport_bufferTx((uint8_t*)CTS_HEADER,(uint8_t*) messageBody);
+	PacketView message;
+	DesktopComSessionStatus status;
 
-	if (transportStatus != TRANSPORT_OKAY)
+	// if a message is present, copy to output
+	status = desktopAppSession_peekMessage(&message);
+	if (status == SESSION_OKAY)
 	{
-		return SESSION_ERROR;
+		memcpy(header, message.header, UART_PACKET_HEADER_SIZE * sizeof(uint8_t));
+		memcpy(body, message.payload, UART_PACKET_PAYLOAD_SIZE * sizeof(uint8_t));
+		desktopAppSession_releaseMessage();
 	}
 
-	transportStatus = uartTransport_tx_polled(SEND_TIMEOUT_MS);
+	return status;
+}
 
-	if (transportStatus == TRANSPORT_TIMEOUT)
-	{
-		return SESSION_TIMEOUT;
-	}
-	else if (transportStatus != TRANSPORT_OKAY)
-	{
-		return SESSION_ERROR;
-	}
 
-	// Message Window
-	// Rx to receive a packet from the desktop.
-	transportStatus = uartTransport_rx_polled(RECEIVE_TIMEOUT_MS);
+/* desktopAppSession_enqueueBinary
+ *
+ * Queues a message with a binary payload into the priority's transport layer tx lane,
+ * which starts transmitting it in the background.
+ */
+DesktopComSessionStatus desktopAppSession_enqueueBinary(const char header[UART_PACKET_HEADER_SIZE],
+		const uint8_t* payload, uint16_t length, SessionPriority priority)
+{
+	// if the module has been initialized
+	if (_sessionInit)
+	{
+		PacketView message;
+
+		// the payload must fit in one message
+		if (length > UART_PACKET_PAYLOAD_SIZE)
+		{
+			return SESSION_ERROR;
+		}
+
+		// a session being stopped takes no more messages
+		if (_session_stopping())
+		{
+			return SESSION_NOT_OPEN;
+		}
+
+		// try to enqueue message and return if successful
+		if (_txAcquire(&message, _laneFor(priority)) != TRANSPORT_OKAY)
+		{
+			return SESSION_BUFFER_FULL;
+		}
+		else
+		{
+			memcpy(message.header, header, UART_PACKET_HEADER_SIZE * sizeof(uint8_t));
+			memcpy(message.payload, payload, length * sizeof(uint8_t));
+			_txCommitLength(length);
+			return SESSION_OKAY;
+		}
+	}
+
+	// module has not been initialized
+	else
+	{
+		return SESSION_NOT_INIT;
+	}
+}
+
+
+/* desktopAppSession_dequeueBinary
+ *
+ * Copies out the oldest received message, with its payload length, and releases it.
+ * The caller's payload is zeroed past the length, as the text API's body is.
+ */
+DesktopComSessionStatus desktopAppSession_dequeueBinary(char header[UART_PACKET_HEADER_SIZE],
+		uint8_t payload[UART_PACKET_PAYLOAD_SIZE], uint16_t* length)
+{
+	PacketView message;
+	DesktopComSessionStatus status;
+
+	// if a message is present, copy to output
+	status = desktopAppSession_peekMessage(&message);
+	if (status == SESSION_OKAY)
+	{
+		memcpy(header, message.header, UART_PACKET_HEADER_SIZE * sizeof(uint8_t));
+		memcpy(payload, message.payload, message.length * sizeof(uint8_t));
+		memset(payload + message.length, 0, (UART_PACKET_PAYLOAD_SIZE - message.length) * sizeof(uint8_t));
+		*length = message.length;
+		desktopAppSession_releaseMessage();
+	}
+
+	return status;
+}
+
+
+/* desktopAppSession_acquireMessage
+ *
+ * Hands out a free slot of the priority's transport layer tx lane to build a message
+ * in.
+ */
+DesktopComSessionStatus desktopAppSession_acquireMessage(PacketView* message, SessionPriority priority)
+{
+	// if the module has been initialized
+	if (_sessionInit)
+	{
+		// a session being stopped takes no more messages
+		if (_session_stopping())
+		{
+			return SESSION_NOT_OPEN;
+		}
+
+		// try to acquire a slot
+		if (_txAcquire(message, _laneFor(priority)) != TRANSPORT_OKAY)
+		{
+			return SESSION_BUFFER_FULL;
+		}
+		else
+		{
+			return SESSION_OKAY;
+		}
+	}
+
+	// module has not been initialized
+	else
+	{
+		return SESSION_NOT_INIT;
+	}
+}
+
+
+/* desktopAppSession_commitMessage
+ *
+ * Queues the message built in the acquired slot for transmission.
+ */
+DesktopComSessionStatus desktopAppSession_commitMessage(void)
+{
+	// if the module has been initialized
+	if (_sessionInit)
+	{
+		_txCommit();
+		return SESSION_OKAY;
+	}
+
+	// module has not been initialized
+	else
+	{
+		return SESSION_NOT_INIT;
+	}
+}
+
+
+/* desktopAppSession_commitMessageLength
+ *
+ * Queues the message built in the acquired slot for transmission, with a binary
+ * payload.
+ */
+DesktopComSessionStatus desktopAppSession_commitMessageLength(uint16_t length)
+{
+	// if the module has been initialized
+	if (_sessionInit)
+	{
+		// the payload must fit in the slot
+		if (length > UART_PACKET_PAYLOAD_SIZE)
+		{
+			return SESSION_ERROR;
+		}
+
+		_txCommitLength(length);
+		return SESSION_OKAY;
+	}
+
+	// module has not been initialized
+	else
+	{
+		return SESSION_NOT_INIT;
+	}
+}
+
+
+/* desktopAppSession_peekMessage
+ *
+ * Messages for the application are moved into the receive queue by the updates and
+ * held there until the application releases them.  The oldest is handed out.
+ */
+DesktopComSessionStatus desktopAppSession_peekMessage(PacketView* message)
+{
+	// if the module has been initialized
+	if (_sessionInit)
+	{
+		uint8_t* frame = packetQueue_front(&_receiveQueue);
+
+		// if a message for the application is at the front of the receive queue
+		if (_sessionState == STATE_OPEN && frame != NULL)
+		{
+			packetView_init(message, frame);
+			message->length = receivedPayloadLength(frame);
+			return SESSION_OKAY;
+		}
+
+		// no message is ready
+		else
+		{
+			return SESSION_BUFFER_EMPTY;
+		}
+	}
+
+	// the module has not been initialized
+	else
+	{
+		return SESSION_NOT_INIT;
+	}
+}
+
+
+/* desktopAppSession_releaseMessage
+ *
+ * Frees the oldest received message's slot in the receive queue.  A message held in
+ * the transport layer rx queue for want of the slot is moved in by the next update.
+ */
+DesktopComSessionStatus desktopAppSession_releaseMessage(void)
+{
+	PacketView message;
+
+	// if the module has been initialized
+	if (_sessionInit)
+	{
+		// only release a message handed out by desktopAppSession_peekMessage()
+		if (desktopAppSession_peekMessage(&message) == SESSION_OKAY)
+		{
+			TRACE_HEADER(TRACE_DELIVER, 0, message.header);
+			packetQueue_release(&_receiveQueue);
+			return SESSION_OKAY;
+		}
+
+		// no message is ready
+		else
+		{
+			return SESSION_BUFFER_EMPTY;
+		}
+	}
+
+	// the module has not been initialized
+	else
+	{
+		return SESSION_NOT_INIT;
+	}
+}
+
+
+/* _handshake
+ *
+ * Advances the handshake with the desktop application by a step, without waiting.  If a
+ * message with the HANDSHAKE_HEADER_SYNC header command has been received, a message
+ * with the HANDSHAKE_HEADER_ACKN header command is queued and the
+ * HANDSHAKE_HEADER_SYNACK header command is then listened for, within the send and
+ * receive timeouts.  If it is received, a session is opened.
+ *
+ * This series of steps for the handshake confirms that timeout values on the MCU are
+ * not too short (as long as the Desktop is sufficiently fast enough at responding
+ * messages from the MCU).  Timeout values may need to be tweaked if handshaking
+ * consistently fails.
+ *
+ * The steps are the states of the session:
+ * 	CLOSED)			Check for a message, which must be a SYNC.  Queue the ACKN.  A
+ * 					RSUM is answered with a DISC, as there is no session to resume.
+ * 	ACKNOWLEDGED)	Check for a message, which must be a SYNA.  If no baud rate was
+ * 					negotiated, the session is open.
+ * 	SWITCHING)		Once the ACKN has been sent, switch baud rate.
+ * 	CONFIRMING)		Check for a message, which must be a BAUD.  Queue it back.  The
+ * 					session is open.
+ * If any one step fails, handshaking fails and starts over.  SESSION_BUSY is returned
+ * while a step is waited on.  Switching follows the SYNA in the same call, so it does
+ * not wait for the caller's next step (a sequencer task may not run again at once).
+ *
+ * Baud rate negotiation:  the SYNC payload lists the baud rates the desktop supports,
+ * in decimal separated by commas.  The highest rate also in SESSION_BAUD_RATES is sent
+ * back in the ACKN payload, after the session token (nothing follows the token to stay
+ * at the default rate), and both sides switch to it once the SYNA is received.  The
+ * desktop sends a BAUD_HEADER message at the new rate and the MCU sends it back.  If
+ * the switch or the BAUD message fails (within SESSION_START_TIMEOUT_MS), the MCU
+ * falls back to the default rate, as does the desktop when it does not receive the
+ * reply, and the session is opened at the default rate.
+ *
+ * Note:  no software flow control is used for the first message.
+ */
+DesktopComSessionStatus _handshake(void)
+{
+	PacketView message;
+	bool matched;
+	bool resume;
+
+	// a session being stopped (by desktopAppSession_stop()) or closing is finished first
+	if (_session_stopping())
+	{
+		return SESSION_BUSY;
+	}
+	if (_sessionState == STATE_CLOSING)
+	{
+		_session_closing();
+		if (_sessionState == STATE_CLOSING)
+		{
+			return SESSION_BUSY;
+		}
+	}
+
+	// closed:  check for a sync, answer with an ack (with the chosen baud rate)
+	if (_sessionState == STATE_CLOSED)
+	{
+		// the desktop has not attempted to start a session
+		if (uartTransport_rx_polled(0) != TRANSPORT_OKAY || uartTransport_peekRx(&message) != TRANSPORT_OKAY)
+		{
+			return SESSION_TIMEOUT;
+		}
+
+		// check if sync, then release
+		matched = !memcmp(message.header, HANDSHAKE_HEADER_SYNC, UART_PACKET_HEADER_SIZE);
+		if (matched)
+		{
+			_negotiatedBaudRate = _chooseBaudRate(&message);
+			_sessionToken = _session_newToken();
+			_linkStats.handshakes++;
+			rttEstimator_init(&_rtt, RECEIVE_TIMEOUT_MS);
+			_session_setTimeouts();
+		}
+		resume = !matched && !memcmp(message.header, RESUME_HEADER, UART_PACKET_HEADER_SIZE);
+		uartTransport_releaseRx();
+		if (!matched)
+		{
+			// no session to resume:  answer with a disconnect, so the desktop handshakes
+			if (resume && uartTransport_acquireTxLane(&message, TX_LANE_URGENT) == TRANSPORT_OKAY)
+			{
+				memcpy(message.header, HANDSHAKE_HEADER_DISC, UART_PACKET_HEADER_SIZE);
+				uartTransport_commitTx();
+				uartTransport_tx_polled(0);
+			}
+			return SESSION_ERROR;
+		}
+
+		// build ack in place and queue
+		if (uartTransport_acquireTxLane(&message, TX_LANE_URGENT) != TRANSPORT_OKAY)
+		{
+			return SESSION_ERROR;
+		}
+		memcpy(message.header, HANDSHAKE_HEADER_ACKN, UART_PACKET_HEADER_SIZE);
+		if (_negotiatedBaudRate != _defaultBaudRate)
+		{
+			snprintf((char*)message.payload, message.length, "%08lX %lu", (unsigned long)_sessionToken,
+					(unsigned long)_negotiatedBaudRate);
+		}
+		else
+		{
+			snprintf((char*)message.payload, message.length, "%08lX", (unsigned long)_sessionToken);
+		}
+		uartTransport_commitTx();
+		uartTransport_tx_polled(0);
+
+		_session_enter(STATE_ACKNOWLEDGED);
+		return SESSION_BUSY;
+	}
+
+	// ack queued:  check for a syn ack, within the time to send the ack and hear back
+	else if (_sessionState == STATE_ACKNOWLEDGED)
+	{
+		if (uartTransport_rx_polled(0) == TRANSPORT_OKAY && uartTransport_peekRx(&message) == TRANSPORT_OKAY)
+		{
+			matched = !memcmp(message.header, HANDSHAKE_HEADER_SYNACK, UART_PACKET_HEADER_SIZE);
+			uartTransport_releaseRx();
+			if (!matched)
+			{
+				_linkStats.handshakeFailures++;
+				_session_enter(STATE_CLOSED);
+				return SESSION_ERROR;
+			}
+
+			// the ACKN and SYNA were a round trip
+			_rtt_sample(HAL_GetTick() - _stateTick, 2);
+
+			// switch to the negotiated baud rate, if any (without waiting for
+			// another step, as the desktop sends at the new rate once its SYNA
+			// has left)
+			if (_negotiatedBaudRate != _defaultBaudRate)
+			{
+				_session_enter(STATE_SWITCHING);
+				return _handshake();
+			}
+			_session_open();
+			return SESSION_OKAY;
+		}
+		else if (_session_elapsed(_replyTimeout_ms))
+		{
+			_linkStats.handshakeFailures++;
+			_session_enter(STATE_CLOSED);
+			return SESSION_TIMEOUT;
+		}
+		return SESSION_BUSY;
+	}
+
+	// syn ack received:  switch once the ack has been sent (a failed switch falls
+	// back to the default rate and still opens the session)
+	else if (_sessionState == STATE_SWITCHING)
+	{
+		if (uartTransport_tx_polled(0) == TRANSPORT_TX_EMPTY || _session_elapsed(_sendTimeout_ms))
+		{
+			if (uartTransport_setBaudRate(_negotiatedBaudRate))
+			{
+				_session_setTimeouts();
+				_session_enter(STATE_CONFIRMING);
+				return SESSION_BUSY;
+			}
+			_restoreBaudRate();
+			_session_open();
+			return SESSION_OKAY;
+		}
+		return SESSION_BUSY;
+	}
+
+	// switched:  check for the desktop's confirmation at the new rate, which it sends
+	// once the SYNA has left its serial adapter, and send it back
+	else if (_sessionState == STATE_CONFIRMING)
+	{
+		if (uartTransport_rx_polled(0) == TRANSPORT_OKAY && uartTransport_peekRx(&message) == TRANSPORT_OKAY)
+		{
+			matched = !memcmp(message.header, BAUD_HEADER, UART_PACKET_HEADER_SIZE);
+			uartTransport_releaseRx();
+			if (matched && uartTransport_acquireTxLane(&message, TX_LANE_URGENT) == TRANSPORT_OKAY)
+			{
+				memcpy(message.header, BAUD_HEADER, UART_PACKET_HEADER_SIZE);
+				uartTransport_commitTx();
+				uartTransport_tx_polled(0);
+			}
+			else
+			{
+				_restoreBaudRate();
+			}
+			_session_open();
+			return SESSION_OKAY;
+		}
+		else if (_session_elapsed(SESSION_START_TIMEOUT_MS))
+		{
+			_restoreBaudRate();
+			_session_open();
+			return SESSION_OKAY;
+		}
+		return SESSION_BUSY;
+	}
+
+	// open
+	else
+	{
+		return SESSION_OKAY;
+	}
+}
+
+
+/* _closingHandshake
+ *
+ * Advances the closing of a session by the MCU by a step, without waiting.  The steps
+ * are the states of the session:
+ * 	OPEN)			Stop taking messages from the application.
+ * 	DRAINING)		Send the messages queued for the desktop (in windowed mode, until
+ * 					they are acknowledged), within the send timeout (and a
+ * 					retransmit timeout, in windowed mode).  Session commands are
+ * 					still answered.  Queue a DISC.
+ * 	STOPPING)		Check for a message, until a DACK (or a DISC, the desktop
+ * 					closing at the same time) within the reply timeout.  Close,
+ * 					returning to the default baud rate.
+ * A handshake in progress is abandoned, and a session the desktop is closing (a DISC
+ * answered) is finished.  SESSION_BUSY is returned while a step is waited on, and
+ * SESSION_TIMEOUT once closed if the desktop did not confirm.
+ */
+DesktopComSessionStatus _closingHandshake(void)
+{
+	PacketView message;
+	uint32_t drainTimeout_ms = _sendTimeout_ms;
+	bool confirmed = false;
+
+	// closing on the desktop's DISC:  finish sending the answer
+	if (_sessionState == STATE_CLOSING)
+	{
+		_session_closing();
+		return (_sessionState == STATE_CLOSING) ? SESSION_BUSY : SESSION_OKAY;
+	}
+
+	// open:  take no more messages from the application
+	if (_sessionState == STATE_OPEN)
+	{
+		_session_enter(STATE_DRAINING);
+	}
+
+	// draining:  send what is queued, then the disconnection
+	if (_sessionState == STATE_DRAINING)
+	{
+		_session_budgetStart(SESSION_BUDGET_NONE);
+#ifdef SESSION_WINDOWED
+		_window_update();
+		drainTimeout_ms += _retransmitTimeout_ms;
+#endif
+		_tell();
+		if (_serviceSessionCommands() == SESSION_CLOSED)
+		{
+			// the desktop closed first, and its DISC is being answered
+			return SESSION_BUSY;
+		}
+#if UART_PACKET_LINK_SIZE > 0
+		_link_advertise();
+#endif
+		uartTransport_rx_polled(0);
+
+		if (!_session_elapsed(drainTimeout_ms) && (uartTransport_txPending() > 0
+#ifdef SESSION_WINDOWED
+				|| _txSeq != _txBase
+#endif
+				))
+		{
+			return SESSION_BUSY;
+		}
+
+		// messages left unacknowledged by now are dropped, freeing the window's slots,
+		// and the disconnection goes in the urgent lane rather than behind them
+		uartTransport_setTxWindow(0);
+		if (_txAcquire(&message, TX_LANE_URGENT) != TRANSPORT_OKAY)
+		{
+			return SESSION_BUSY;
+		}
+		memcpy(message.header, HANDSHAKE_HEADER_DISC, UART_PACKET_HEADER_SIZE);
+		_txCommit();
+		_tell();
+		_session_enter(STATE_STOPPING);
+		return SESSION_BUSY;
+	}
+
+	// stopping:  check for the desktop's confirmation
+	if (_sessionState == STATE_STOPPING)
+	{
+		_tell();
+		uartTransport_rx_polled(0);
+		while (!confirmed && uartTransport_peekRx(&message) == TRANSPORT_OKAY)
+		{
+			confirmed = !memcmp(message.header, HANDSHAKE_HEADER_DISCACK, UART_PACKET_HEADER_SIZE)
+					|| !memcmp(message.header, HANDSHAKE_HEADER_DISC, UART_PACKET_HEADER_SIZE);
+			uartTransport_releaseRx();
+		}
+		if (!confirmed && !_session_elapsed(_replyTimeout_ms))
+		{
+			return SESSION_BUSY;
+		}
+		_restoreBaudRate();
+		_session_enter(STATE_CLOSED);
+		return confirmed ? SESSION_OKAY : SESSION_TIMEOUT;
+	}
+
+	// closed, or a handshake in progress, which is abandoned
+	if (_sessionState != STATE_CLOSED)
+	{
+		_restoreBaudRate();
+		_session_enter(STATE_CLOSED);
+	}
+	return SESSION_OKAY;
+}
+
+
+/* _session_enter
+ *
+ * Moves the session to a state, noting when for the state's timeout.
+ */
+void _session_enter(SessionState state)
+{
+	_sessionState = state;
+	_stateTick = HAL_GetTick();
+	TRACE_EVENT(TRACE_SESSION, state, 0);
+#ifdef SESSION_TRACE
+	// a trace dump does not outlast its session
+	if (state != STATE_OPEN)
+	{
+		_traceDump_stop(false);
+	}
+#endif
+}
+
+
+/* _session_elapsed
+ *
+ * Returns if the session has been in its state for the timeout.
+ */
+bool _session_elapsed(uint32_t timeout_ms)
+{
+	return (HAL_GetTick() - _stateTick) >= timeout_ms;
+}
+
+
+/* _session_open
+ *
+ * Opens the session once the handshake is done.
+ */
+void _session_open(void)
+{
+#if UART_PACKET_LINK_SIZE > 0
+	_link_reset();
+#endif
+#ifdef SESSION_CTS
+	_ctsOpen = false;
+#endif
+	_receiveQueue_reset();
+	_updateResume = UPDATE_WINDOW;
+	_linkStats.sessions++;
+	_session_enter(STATE_OPEN);
+}
+
+
+/* _session_closing
+ *
+ * Closes the session once the messages queued (such as the disconnection confirmation)
+ * have been sent, or they have had the time to be, returning to the default baud rate.
+ */
+void _session_closing(void)
+{
+	if (uartTransport_tx_polled(0) == TRANSPORT_TX_EMPTY || _session_elapsed(_sendTimeout_ms))
+	{
+		_restoreBaudRate();
+		_session_enter(STATE_CLOSED);
+	}
+}
+
+
+/* _session_stopping
+ *
+ * Returns if the MCU is closing the session (desktopAppSession_stop()).
+ */
+bool _session_stopping(void)
+{
+	return _sessionState == STATE_DRAINING || _sessionState == STATE_STOPPING;
+}
+
+
+/* _session_newToken
+ *
+ * Returns a token for a new session, never 0:  the tick, the number of handshakes and
+ * the last token, mixed (MurmurHash3's finalizer) so that tokens of consecutive
+ * sessions differ in every bit.  The token tells sessions apart; it is not a secret.
+ */
+uint32_t _session_newToken(void)
+{
+	uint32_t token = HAL_GetTick() ^ (_linkStats.handshakes * 0x9E3779B9U) ^ _sessionToken;
+
+	token ^= token >> 16;
+	token *= 0x85EBCA6BU;
+	token ^= token >> 13;
+	token *= 0xC2B2AE35U;
+	token ^= token >> 16;
+
+	return (token != 0) ? token : 1;
+}
+
+
+/* _session_update
+ *
+ * Performs update of session manager.  First transmits queued messages, then services
+ * any session commands (close session, echo) at the front of the rx queue and moves
+ * messages for the application into the receive queue.  If no message is left held in
+ * the rx queue, a message is received and serviced.
+ *
+ * A message held in the transport layer rx queue (the receive queue is full, with the
+ * SESSION_RX_HOLD policy) holds off the CTS window.  This is the flow control that keeps
+ * the desktop from sending more than the MCU can hold.  No step waits:  the
+ * CTS window stays open across updates until a message arrives or it times out.
+ *
+ * In windowed mode, acknowledgements from the desktop are taken first and unacknowledged
+ * messages are resent if the retransmit timeout has passed.  No CTS window is opened;
+ * the released messages are acknowledged instead.  In credit mode, no CTS window is
+ * opened either; released messages are granted back to the desktop as credit.  With
+ * hardware flow control (UART_HW_FLOW_CONTROL), no CTS window is opened and nothing
+ * needs granting.
+ *
+ * Note:  If a response to the desktop is necessary, this response won't be sent until
+ * the next time the session is updated.
+ */
+DesktopComSessionStatus _session_update(void)
+{
+#ifdef SESSION_CTS
+	PacketView message;
+#endif
+	DesktopComSessionStatus status = SESSION_OKAY;
+
+#ifdef SESSION_WINDOWED
+	// Take acknowledgements and resend on timeout.
+	if (_session_stageDue(UPDATE_WINDOW))
+	{
+		_window_update();
+	}
+#endif
+
+#ifdef SESSION_TRACE
+	// Queue the next packets of a trace dump in the bulk lane's free slots.
+	if (_session_stageDue(UPDATE_TRACE))
+	{
+		_traceDump_continue();
+	}
+#endif
+
+	// Perform Tx message phase of session cycle.
+	if (_session_stageDue(UPDATE_TELL))
+	{
+		PROFILE_CALL(PROFILE_TELL, status = _tell());
+	}
+
+	// Service session commands received since the last update.
+	if (_session_stageDue(UPDATE_DISPATCH))
+	{
+		PROFILE_CALL(PROFILE_DISPATCH, status = _serviceSessionCommands());
+		if (status != SESSION_OKAY)
+		{
+			return status;
+		}
+	}
+
+	if (!_session_stageDue(UPDATE_RECEIVE))
+	{
+		return status;
+	}
+
+#if UART_PACKET_LINK_SIZE > 0
+	// Acknowledge (or grant credit for) released messages.  The desktop keeps
+	// sending within its window or credit, so there is no CTS window to listen in.
+	_link_advertise();
+	uartTransport_rx_polled(0);
+#elif defined(UART_HW_FLOW_CONTROL)
+	// The UART's RTS line holds the desktop off while the MCU cannot take more,
+	// so there is no CTS window to listen in.
+	uartTransport_rx_polled(0);
+#else
+	// If a message is still held for room in the receive queue, do not listen for
+	// another.
+	if (_rxFront(&message) == TRANSPORT_OKAY)
+	{
+		return SESSION_OKAY;
+	}
+
+	// Perform Rx message phase of session cycle.
+	PROFILE_CALL(PROFILE_LISTEN, status = _listen());
+	if (status == SESSION_OKAY)
+	{
+		PROFILE_CALL(PROFILE_DISPATCH, status = _serviceSessionCommands());
+	}
+#endif
+
+	return status;
+}
+
+
+/* _session_budgetStart
+ *
+ * Starts an update's time budget, measured with the stage profile's time source
+ * (cycles on the cores, nanoseconds on a host) rather than the 1 ms HAL tick.
+ */
+void _session_budgetStart(uint32_t budget_us)
+{
+	_budgetStart = stageProfile_now();
+	_budget = (budget_us == SESSION_BUDGET_NONE) ? UINT32_MAX : stageProfile_fromMicroseconds(budget_us);
+	_budgetSteps = 0;
+	_updateStopped = UPDATE_STAGES;
+}
+
+
+/* _session_budgetLeft
+ *
+ * Returns if the update may take another step within its time budget.  The first
+ * step is always taken, so an update makes progress with any budget.
+ */
+bool _session_budgetLeft(void)
+{
+	return _budgetSteps == 0 || _budget == UINT32_MAX || (stageProfile_now() - _budgetStart) < _budget;
+}
+
+
+/* _session_stageDue
+ *
+ * Returns if a stage of the update is to run:  it is not before the stage the last
+ * update stopped at (those ran then), and the budget is not spent, the first stage
+ * always running.  The first stage skipped for the budget is where the next update
+ * starts.
+ */
+bool _session_stageDue(UpdateStage stage)
+{
+	if (stage < _updateResume)
+	{
+		return false;
+	}
+	if (!_session_budgetLeft())
+	{
+		if (_updateStopped == UPDATE_STAGES)
+		{
+			_updateStopped = stage;
+		}
+		return false;
+	}
+
+	_budgetSteps++;
+	return true;
+}
+
+
+/* _handlerFor
+ *
+ * Returns the handler table entry for a header, or NULL if no handler is registered
+ * for it (the message is for the application to peek).
+ */
+const SessionHandlerEntry* _handlerFor(const uint8_t header[UART_PACKET_HEADER_SIZE])
+{
+	uint32_t slot = commandTable_find(&_handlerTable, commandId(header));
+
+	if (slot == COMMAND_SLOT_NONE || _handlers[slot].handler == NULL)
+	{
+		return NULL;
+	}
+
+	return &_handlers[slot];
+}
+
+
+/* _isSessionHeader
+ *
+ * Returns if a header ID is one the session sends or handles itself.
+ */
+bool _isSessionHeader(uint32_t id)
+{
+	switch (id)
+	{
+		case HANDSHAKE_ID_SYNC:
+		case HANDSHAKE_ID_ACKN:
+		case HANDSHAKE_ID_SYNACK:
+		case HANDSHAKE_ID_DISC:
+		case HANDSHAKE_ID_DISCACK:
+		case CTS_ID:
+		case ECHO_ID:
+		case BAUD_ID:
+		case ACK_ID:
+		case CREDIT_ID:
+		case NAK_ID:
+		case STAT_ID:
+#ifdef SESSION_PROFILE
+		case PROF_ID:
+#endif
+#ifdef SESSION_TRACE
+		case TRAC_ID:
+#endif
+		case RESUME_ID:
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+
+/* _serviceSessionCommands
+ *
+ * Dispatches the messages at the front of the transport layer rx queue that have a
+ * handler (session commands, and the application's registered headers), in place,
+ * and moves the others into the receive queue for the application to peek, until
+ * the queue is empty, a message is held for want of room in the receive queue, or
+ * the update's time budget is spent (one message is always taken, so the stage makes
+ * progress with any budget).  Each message takes one lookup in the handler table.
+ * Returns SESSION_CLOSED if the desktop closed the session, SESSION_BUFFER_FULL if
+ * a handler could not answer because the tx queue is full (the message is dispatched
+ * again on the next update), or any other status a handler returned.
+ */
+DesktopComSessionStatus _serviceSessionCommands(void)
+{
+	PacketView command;
+	const SessionHandlerEntry* entry;
+	DesktopComSessionStatus status;
+	bool first;
+
+#ifdef SESSION_CTS
+	// A message received since the CTS closes the Message window, whether it is a
+	// message dispatched here or one left for the application.
+	if (_rxFront(&command) == TRANSPORT_OKAY)
+	{
+		_ctsOpen = false;
+	}
+#endif
+
+	for (first = true; (first || _session_budgetLeft()) && _rxFront(&command) == TRANSPORT_OKAY; first = false)
+	{
+		_budgetSteps++;
+
+		// a message for the application, left in place if the receive queue
+		// has no room for it
+		entry = _handlerFor(command.header);
+		if (entry == NULL)
+		{
+			if (!_admitMessage(&command))
+			{
+				return SESSION_OKAY;
+			}
+			TRACE_HEADER(TRACE_DISPATCH, 0, command.header);
+			_rxRelease();
+			continue;
+		}
+
+		// leave the message in place to retry if the handler could not answer
+		status = entry->handler(&command, entry->context);
+		if (status == SESSION_BUFFER_FULL)
+		{
+			return status;
+		}
+		TRACE_HEADER(TRACE_DISPATCH, 1, command.header);
+
+		_rxRelease();
+		if (status != SESSION_OKAY)
+		{
+			return status;
+		}
+	}
+
+	// messages left for want of budget, which the next update starts with
+	if (_rxFront(&command) == TRANSPORT_OKAY && _updateStopped == UPDATE_STAGES)
+	{
+		_updateStopped = UPDATE_DISPATCH;
+	}
+
+	return SESSION_OKAY;
+}
+
+
+/* _admitMessage
+ *
+ * Copies a message for the application into the receive queue.  With the queue full,
+ * applies the overflow policy:  returns false to leave the message in place (hold, or
+ * reject with no tx slot free for the NAK yet), or true once it is disposed of and can
+ * be released.
+ */
+bool _admitMessage(const PacketView* message)
+{
+	uint8_t* slot = packetQueue_back(&_receiveQueue);
+	PacketView nak;
+
+	if (slot == NULL)
+	{
+		switch (_rxOverflow)
+		{
+			case SESSION_RX_REJECT:
+				if (_txAcquire(&nak, TX_LANE_URGENT) != TRANSPORT_OKAY)
+				{
+					return false;
+				}
+				memcpy(nak.header, NAK_HEADER, UART_PACKET_HEADER_SIZE);
+				memcpy(nak.payload, message->header, UART_PACKET_HEADER_SIZE);
+				_txCommitLength(UART_PACKET_HEADER_SIZE);
+				_rxRejected++;
+				_linkStats.dropped++;
+				return true;
+
+			case SESSION_RX_DROP_OLDEST:
+				packetQueue_release(&_receiveQueue);
+				_rxDroppedOldest++;
+				_linkStats.dropped++;
+				slot = packetQueue_back(&_receiveQueue);
+				break;
+
+			case SESSION_RX_DROP_NEWEST:
+				_rxDroppedNewest++;
+				_linkStats.dropped++;
+				return true;
+
+			default:
+				return false;
+		}
+	}
+
+	memcpy(slot, packetView_frame(message), UART_FRAME_SIZE);
+	packetQueue_commit(&_receiveQueue);
+	return true;
+}
+
+
+/* _receiveQueue_reset
+ *
+ * Empties the receive queue and clears its counters.
+ */
+void _receiveQueue_reset(void)
+{
+	uint32_t highWater = packetQueue_highWater(&_receiveQueue);
+
+	// the high-water mark is kept across sessions in the counts
+	if (highWater > _linkStats.receiveHighWater)
+	{
+		_linkStats.receiveHighWater = highWater;
+	}
+	packetQueue_reset(&_receiveQueue);
+	_rxRejected = 0;
+	_rxDroppedOldest = 0;
+	_rxDroppedNewest = 0;
+}
+
+
+/* _handleDisconnect
+ *
+ * Handler for the disconnection handshake message, and for a SYNC or a resumption that
+ * cannot be taken up in an open session (the desktop has started over).  Confirms it
+ * and starts closing the session.  Sent messages are no longer kept for resending, and
+ * the window is dropped before the confirmation is queued, so it takes the urgent lane
+ * even if the window is full.
+ */
+DesktopComSessionStatus _handleDisconnect(const PacketView* command, void* context)
+{
+	PacketView response;
+
+	(void)command;
+	(void)context;
+	uartTransport_setTxWindow(0);
+	if (_txAcquire(&response, TX_LANE_URGENT) != TRANSPORT_OKAY)
+	{
+		return SESSION_BUFFER_FULL;
+	}
+
+	memcpy(response.header, HANDSHAKE_HEADER_DISC, UART_PACKET_HEADER_SIZE);
+	_txCommit();
+	_tell();
+	_session_enter(STATE_CLOSING);
+	return SESSION_CLOSED;
+}
+
+
+/* _handleResume
+ *
+ * Handler for the resumption message.  If its payload is the session's token in hex,
+ * the session goes on:  the reply is sent in the control frame, ahead of queued
+ * messages, with the sequence number of the oldest message not acknowledged (or the
+ * next sent, in credit mode) and of the next message expected, and in windowed mode
+ * the messages not acknowledged are sent again.  In CTS mode, a new CTS window is
+ * opened by the next update.  Otherwise the session is closed as by a disconnection.
+ */
+DesktopComSessionStatus _handleResume(const PacketView* command, void* context)
+{
+	PacketView response;
+	uint32_t token = 0;
+	uint16_t i;
+	uint8_t digit;
+
+	// read the token, which is 0 if malformed
+	for (i = 0; i < command->length && command->payload[i] != '\0'; i++)
+	{
+		digit = command->payload[i];
+		if (digit >= '0' && digit <= '9')
+		{
+			token = (token << 4) | (uint32_t)(digit - '0');
+		}
+		else if (digit >= 'A' && digit <= 'F')
+		{
+			token = (token << 4) | (uint32_t)(digit - 'A' + 10);
+		}
+		else
+		{
+			token = 0;
+			break;
+		}
+	}
+	if (token == 0 || token != _sessionToken)
+	{
+		return _handleDisconnect(command, context);
+	}
+
+	// reply with where each side goes on from
+	if (uartTransport_acquireControlTx(&response) != TRANSPORT_OKAY)
+	{
+		return SESSION_BUFFER_FULL;
+	}
+	memcpy(response.header, RESUME_HEADER, UART_PACKET_HEADER_SIZE);
+#if UART_PACKET_LINK_SIZE > 0
+#ifdef SESSION_WINDOWED
+	snprintf((char*)response.payload, response.length, "%u %u", _txBase, _rxExpected);
+#else
+	snprintf((char*)response.payload, response.length, "%u %u", _txSeq, _rxExpected);
+#endif
+	response.link[UART_LINK_SEQ] = UART_LINK_ACK_ONLY;
+	response.link[UART_LINK_ACK] = _link_advertised();
+	_rxAckSent = _link_advertised();
+	_rxAckTick = HAL_GetTick();
+#endif
+	uartTransport_commitControlTx();
+
+#ifdef SESSION_WINDOWED
+	// the desktop has none of the messages not acknowledged
+	uartTransport_rewindTx();
+	_rttTiming = false;
+	_txProgressTick = HAL_GetTick();
+#endif
+#ifdef SESSION_CTS
+	_ctsOpen = false;
+#endif
+	_tell();
+	return SESSION_OKAY;
+}
+
+
+/* _handleEcho
+ *
+ * Handler for the echo command, sent back as received.
+ */
+DesktopComSessionStatus _handleEcho(const PacketView* command, void* context)
+{
+	PacketView response;
+
+	(void)context;
+	if (_txAcquire(&response, TX_LANE_URGENT) != TRANSPORT_OKAY)
+	{
+		return SESSION_BUFFER_FULL;
+	}
+
+	memcpy(response.header, command->header, UART_PACKET_HEADER_SIZE);
+	memcpy(response.payload, command->payload, command->length);
+	_txCommitLength(command->length);
+	_tell();
+	return SESSION_OKAY;
+}
+
+
+/* _handleStat
+ *
+ * Handler for the statistics command.  Replies with the counts, then zeroes them if
+ * the payload holds "reset".
+ */
+DesktopComSessionStatus _handleStat(const PacketView* command, void* context)
+{
+	PacketView response;
 
-	if (transportStatus == TRANSPORT_TIMEOUT)
+	(void)context;
+	if (_txAcquire(&response, TX_LANE_URGENT) != TRANSPORT_OKAY)
 	{
-		return SESSION_TIMEOUT;
+		return SESSION_BUFFER_FULL;
+	}
+
+	memcpy(response.header, command->header, UART_PACKET_HEADER_SIZE);
+	_txCommitLength(_stat_encode(response.payload));
+	if (command->length >= 5 && memcmp(command->payload, "reset", 5) == 0)
+	{
+		desktopAppSession_resetLinkStats();
+	}
+	_tell();
+	return SESSION_OKAY;
+}
+
+
+/* _stat_encode
+ *
+ * Lays the counts out as the STAT reply (see desktop_app_session.h) and packs them
+ * into 7-bit characters.  Returns the number of characters.
+ */
+uint16_t _stat_encode(uint8_t* chars)
+{
+	SessionLinkStats stats;
+	uint8_t bytes[SESSION_STAT_SIZE];
+	uint32_t wide[4];
+	uint32_t narrow[15];
+	uint32_t i;
+	uint8_t* out = bytes;
+
+	desktopAppSession_linkStats(&stats);
+	wide[0] = stats.transport.txPackets;
+	wide[1] = stats.transport.rxPackets;
+	wide[2] = stats.transport.txBytes;
+	wide[3] = stats.transport.rxBytes;
+	narrow[0] = stats.transport.rxMalformed;
+	narrow[1] = stats.transport.rxNoise;
+	narrow[2] = stats.transport.rxRestarts;
+	narrow[3] = stats.transport.errOverrun;
+	narrow[4] = stats.transport.errFraming;
+	narrow[5] = stats.transport.errNoise;
+	narrow[6] = stats.transport.errParity;
+	narrow[7] = stats.transport.errDma;
+	narrow[8] = stats.handshakes;
+	narrow[9] = stats.handshakeFailures;
+	narrow[10] = stats.sessions;
+	narrow[11] = stats.timeouts;
+	narrow[12] = stats.resends;
+	narrow[13] = stats.outOfSequence;
+	narrow[14] = stats.dropped;
+
+	*out++ = SESSION_STAT_VERSION;
+	for (i = 0; i < 4; i++)
+	{
+		*out++ = (uint8_t)wide[i];
+		*out++ = (uint8_t)(wide[i] >> 8);
+		*out++ = (uint8_t)(wide[i] >> 16);
+		*out++ = (uint8_t)(wide[i] >> 24);
+	}
+	for (i = 0; i < 15; i++)
+	{
+		narrow[i] = (narrow[i] > 0xFFFF) ? 0xFFFF : narrow[i];
+		*out++ = (uint8_t)narrow[i];
+		*out++ = (uint8_t)(narrow[i] >> 8);
+	}
+	*out++ = (uint8_t)(STAT_NIBBLE(stats.transport.txHighWater) | (STAT_NIBBLE(stats.transport.txUrgentHighWater) << 4));
+	*out++ = (uint8_t)(STAT_NIBBLE(stats.transport.rxHighWater) | (STAT_NIBBLE(stats.receiveHighWater) << 4));
+
+	return packSevenBit(bytes, SESSION_STAT_SIZE, chars);
+}
+
+
+#ifdef SESSION_PROFILE
+/* _handleProfile
+ *
+ * Handler for the profile command.  Replies with the times of the stage whose index
+ * the payload holds, or clears the times if it holds "reset".  A stage that does not
+ * exist is reported with no times.
+ */
+DesktopComSessionStatus _handleProfile(const PacketView* command, void* context)
+{
+	PacketView response;
+	StageProfileStats stats;
+	uint32_t stage = 0;
+	uint16_t i;
+
+	(void)context;
+	if (_txAcquire(&response, TX_LANE_URGENT) != TRANSPORT_OKAY)
+	{
+		return SESSION_BUFFER_FULL;
+	}
+
+	memcpy(response.header, command->header, UART_PACKET_HEADER_SIZE);
+	if (command->length >= 5 && memcmp(command->payload, "reset", 5) == 0)
+	{
+		stageProfile_reset();
+		snprintf((char*)response.payload, response.length, "reset");
+	}
+	else
+	{
+		for (i = 0; i < command->length && command->payload[i] >= '0' && command->payload[i] <= '9'; i++)
+		{
+			stage = stage * 10 + (command->payload[i] - '0');
+		}
+		if (!stageProfile_read((ProfileStage)stage, &stats))
+		{
+			memset(&stats, 0, sizeof(stats));
+		}
+		snprintf((char*)response.payload, response.length, "%lu %u %s %s %lu %lu %lu %lu",
+				(unsigned long)stage, (unsigned)PROFILE_STAGES, stageProfile_unit(),
+				stageProfile_name((ProfileStage)stage), (unsigned long)stats.count, (unsigned long)stats.min,
+				(unsigned long)stats.max, (unsigned long)(stats.count > 0 ? stats.total / stats.count : 0));
+	}
+	_txCommit();
+	_tell();
+	return SESSION_OKAY;
+}
+#endif
+
+
+#ifdef SESSION_TRACE
+/* _handleTrace
+ *
+ * Handler for the trace command.  Freezes the trace and answers with the number of
+ * entries held, the number overwritten before them, the units of their times and
+ * how many entries each packet of the dump carries.  The entries follow, in the
+ * bulk lane, from the next updates.  A dump already streaming is started over.  If
+ * the payload holds "reset", the trace is emptied once dumped.
+ */
+DesktopComSessionStatus _handleTrace(const PacketView* command, void* context)
+{
+	PacketView response;
+	uint32_t end;
+
+	(void)context;
+	if (_txAcquire(&response, TX_LANE_BULK) != TRANSPORT_OKAY)
+	{
+		return SESSION_BUFFER_FULL;
+	}
+
+	end = eventTrace_freeze();
+	_traceNext = (end > SESSION_TRACE_DEPTH) ? end - SESSION_TRACE_DEPTH : 0;
+	_traceEnd = end;
+	_traceDumping = true;
+	_traceClear = (command->length >= 5 && memcmp(command->payload, "reset", 5) == 0);
+
+	memcpy(response.header, command->header, UART_PACKET_HEADER_SIZE);
+	snprintf((char*)response.payload, response.length, "%u %lu %lu %s %u", (unsigned)SESSION_TRACE_VERSION,
+			(unsigned long)(_traceEnd - _traceNext), (unsigned long)_traceNext, stageProfile_unit(),
+			(unsigned)SESSION_TRACE_PER_PACKET);
+	_txCommit();
+	_traceDump_continue();
+	_tell();
+	return SESSION_OKAY;
+}
+
+
+/* _traceDump_continue
+ *
+ * Packs the next entries of the dump, SESSION_TRACE_PER_PACKET to a packet, into
+ * the bulk lane's free slots.  Once the last is queued, the trace is thawed.
+ */
+void _traceDump_continue(void)
+{
+	PacketView packet;
+	uint8_t bytes[SESSION_TRACE_PER_PACKET * TRACE_ENTRY_SIZE];
+	uint16_t count;
+
+	while (_traceDumping && _traceNext != _traceEnd && _txAcquire(&packet, TX_LANE_BULK) == TRANSPORT_OKAY)
+	{
+		for (count = 0; count < SESSION_TRACE_PER_PACKET && _traceNext != _traceEnd; count++)
+		{
+			eventTrace_encode(eventTrace_read(_traceNext++), &bytes[count * TRACE_ENTRY_SIZE]);
+		}
+		memcpy(packet.header, TRAC_HEADER, UART_PACKET_HEADER_SIZE);
+		_txCommitLength(packSevenBit(bytes, count * TRACE_ENTRY_SIZE, packet.payload));
+	}
+
+	if (_traceDumping && _traceNext == _traceEnd)
+	{
+		_traceDump_stop(_traceClear);
+	}
+}
+
+
+/* _traceDump_stop
+ *
+ * Ends the dump, if one is streaming, and thaws the trace.
+ */
+void _traceDump_stop(bool clear)
+{
+	if (_traceDumping)
+	{
+		_traceDumping = false;
+		eventTrace_thaw(clear);
+	}
+}
+#endif
+
+
+/* _listen
+ *
+ * Wraps calls to the UART transmission layer.
+ * Listens for a message from the desktop application.  Performs software flow control.
+ *
+ * Listening is divided into two windows:  CTS and Message.  The CTS window acts as
+ * software flow control to let the desktop application that it is ready to receive a
+ * message.  A CTS message is queued.  The Message window then stays open across calls,
+ * for the time to send the CTS and the desktop's response time, until a message from
+ * the desktop application is received.  Nothing is waited on.  SESSION_TIMEOUT is
+ * returned when the Message window closes with nothing received, and the next call
+ * opens a new CTS window.
+ *
+ * Reception continues in the background between calls, so a packet that arrived
+ * after the last Message window closed is taken immediately without a CTS window.
+ */
+DesktopComSessionStatus _listen(void)
+{
+#ifdef SESSION_CTS
+	PacketView cts;
+
+	// A packet may have been received in the background, in the Message window or
+	// sent by the desktop after the previous Message window closed.  If so, take it
+	// and close the Message window.
+	if (uartTransport_rx_polled(0) == TRANSPORT_OKAY)
+	{
+		_ctsOpen = false;
+		return SESSION_OKAY;
+	}
+
+	// Message Window
+	// Wait for a packet from the desktop until the window times out.
+	if (_ctsOpen)
+	{
+		if ((HAL_GetTick() - _ctsTick) >= _replyTimeout_ms)
+		{
+			_ctsOpen = false;
+			_linkStats.timeouts++;
+			TRACE_EVENT(TRACE_TIMEOUT, 0, 0);
+			return SESSION_TIMEOUT;
+		}
+		return SESSION_OKAY;
 	}
-	else if (transportStatus != TRANSPORT_OKAY)
+
+	// CTS Window
+	// Tx the CTS message to signal to desktop that the MCU is about to be ready to
+	// receive a message.  The message is built in place in the urgent lane, so it is
+	// not held up by bulk messages.
+	if (uartTransport_acquireTxLane(&cts, TX_LANE_URGENT) != TRANSPORT_OKAY)
 	{
 		return SESSION_ERROR;
 	}
 
+	memcpy(cts.header, CTS_HEADER, UART_PACKET_HEADER_SIZE);
+	snprintf((char*)cts.payload, cts.length, "Clear to send!\n");
+	uartTransport_commitTx();
+	uartTransport_tx_polled(0);
+
+	_ctsOpen = true;
+	_ctsTick = HAL_GetTick();
+#endif
+
 	return SESSION_OKAY;
 }
 
@@ -478,18 +2038,19 @@ DesktopComSessionStatus _listen(void)
 /* _tell
  *
  * Wraps UART transmission layer calls.
- * Transmits a buffered message to the desktop application.
- * Aliases transport layer error codes to session error codes.
+ * Starts transmission of queued messages to the desktop application without
+ * waiting for them to finish.  Aliases transport layer error codes to session
+ * error codes.
  */
 DesktopComSessionStatus _tell(void)
 {
 	TransportStatus transportStatus;
 
-	// attempt to transmit packet
-	transportStatus = uartTransport_tx_polled(SEND_TIMEOUT_MS);
+	// start transmission of queued packets
+	transportStatus = uartTransport_tx_polled(0);
 
 	// report status of transmission
-	if (transportStatus == TRANSPORT_OKAY)
+	if (transportStatus == TRANSPORT_OKAY || transportStatus == TRANSPORT_TX_EMPTY)
 	{
 		return SESSION_OKAY;
 	}
@@ -502,3 +2063,387 @@ DesktopComSessionStatus _tell(void)
 		return SESSION_ERROR;
 	}
 }
+
+
+/* _session_setTimeouts
+ *
+ * Sets the timeouts for the current baud rate and the desktop's response time (the
+ * estimate's RTO).  Waiting on the desktop allows its response time plus one frame
+ * on the wire, and an urgent message (a CTS or the ACKN) answered allows a full
+ * queue of frames ahead of it besides.  Draining the tx queue allows SEND_TIMEOUT_MS
+ * plus a full queue of frames, as it does not wait on the desktop.  In windowed
+ * mode, resending waits for the desktop's response time plus a window of frames
+ * each way.
+ */
+void _session_setTimeouts(void)
+{
+	uint32_t frameTime_ms = uartTransport_frameTime_ms();
+	uint32_t response_ms = rttEstimator_timeout(&_rtt);
+
+	_receiveTimeout_ms = response_ms + frameTime_ms;
+	_replyTimeout_ms = response_ms + (UART_TX_QUEUE_LENGTH + 1) * frameTime_ms;
+	_sendTimeout_ms = SEND_TIMEOUT_MS + UART_TX_QUEUE_LENGTH * frameTime_ms;
+#ifdef SESSION_WINDOWED
+	_retransmitTimeout_ms = response_ms + 2 * SESSION_WINDOW_SIZE * frameTime_ms;
+#endif
+}
+
+
+/* _rtt_sample
+ *
+ * Takes an exchange with the desktop as a sample of its response time, less the time
+ * its frames took on the wire at the current baud rate, and sets the timeouts from the
+ * new estimate.  Not taken with SESSION_FIXED_TIMEOUTS.
+ */
+void _rtt_sample(uint32_t elapsed_ms, uint32_t frames)
+{
+#ifndef SESSION_FIXED_TIMEOUTS
+	uint32_t wire_ms = frames * uartTransport_frameTime_ms();
+
+	rttEstimator_sample(&_rtt, (elapsed_ms > wire_ms) ? elapsed_ms - wire_ms : 0);
+	_session_setTimeouts();
+#else
+	(void)elapsed_ms;
+	(void)frames;
+#endif
+}
+
+
+/* _rtt_backoff
+ *
+ * Backs the response time off after a timeout that needed a resend, and sets the
+ * timeouts from it.  Not with SESSION_FIXED_TIMEOUTS.
+ */
+void _rtt_backoff(void)
+{
+#ifndef SESSION_FIXED_TIMEOUTS
+	rttEstimator_backoff(&_rtt);
+	_session_setTimeouts();
+#endif
+}
+
+
+/* _chooseBaudRate
+ *
+ * Parses the comma separated decimal baud rates in a SYNC payload and returns the
+ * highest one that is also in SESSION_BAUD_RATES and above the default rate.  Returns
+ * the default rate if there is none (such as for an empty payload).
+ */
+uint32_t _chooseBaudRate(const PacketView* sync)
+{
+	uint32_t chosen = _defaultBaudRate;
+	uint32_t rate = 0;
+	uint16_t i;
+	unsigned int j;
+
+	for (i = 0; i <= sync->length; i++)
+	{
+		// accumulate digits of a rate
+		if (i < sync->length && sync->payload[i] >= '0' && sync->payload[i] <= '9')
+		{
+			rate = rate * 10 + (sync->payload[i] - '0');
+		}
+
+		// at the end of a rate, check it against the rates offered
+		else
+		{
+			for (j = 0; j < sizeof(_baudRates) / sizeof(_baudRates[0]); j++)
+			{
+				if (rate == _baudRates[j] && rate > chosen)
+				{
+					chosen = rate;
+				}
+			}
+			rate = 0;
+
+			// the rest of the payload is padding
+			if (i < sync->length && sync->payload[i] == '\0')
+			{
+				break;
+			}
+		}
+	}
+
+	return chosen;
+}
+
+
+/* _restoreBaudRate
+ *
+ * Returns to the default baud rate if a different rate was negotiated.  Anything left
+ * in the tx queue is dropped, so the session lets it be sent first.
+ */
+void _restoreBaudRate(void)
+{
+	if (uartTransport_getBaudRate() != _defaultBaudRate)
+	{
+		uartTransport_setBaudRate(_defaultBaudRate);
+		_session_setTimeouts();
+	}
+}
+
+
+/* _txAcquire
+ *
+ * Acquires a slot in a transport layer tx lane for a sequenced message, keeping its
+ * link segment to stamp on commit.
+ */
+TransportStatus _txAcquire(PacketView* view, TransportTxLane lane)
+{
+	TransportStatus status = uartTransport_acquireTxLane(view, lane);
+
+	if (status == TRANSPORT_OKAY)
+	{
+		_txLink = view->link;
+	}
+
+	return status;
+}
+
+
+/* _laneFor
+ *
+ * Returns the transport layer tx lane for a message priority.
+ */
+TransportTxLane _laneFor(SessionPriority priority)
+{
+	return (priority == SESSION_PRIORITY_URGENT) ? TX_LANE_URGENT : TX_LANE_BULK;
+}
+
+
+/* _txStamp
+ *
+ * In windowed and credit modes, stamps the message in the acquired slot with the next
+ * sequence number and the current acknowledgement (or credit), which then counts as
+ * sent if the message is sent without waiting:  always in credit mode, and if the
+ * message is within the window in windowed mode.
+ */
+void _txStamp(void)
+{
+#if UART_PACKET_LINK_SIZE > 0
+#ifdef SESSION_WINDOWED
+	if (((uint8_t)(_txSeq - _txBase) % UART_LINK_SEQ_MODULUS) < SESSION_WINDOW_SIZE)
+#endif
+	{
+		_rxAckSent = _link_advertised();
+		_rxAckTick = HAL_GetTick();
+#ifdef SESSION_WINDOWED
+		// time one message at a time to its acknowledgement
+		if (!_rttTiming)
+		{
+			_rttTiming = true;
+			_rttSeq = _txSeq;
+			_rttTick = HAL_GetTick();
+		}
+#endif
+	}
+	_txLink[UART_LINK_SEQ] = _txSeq;
+	_txLink[UART_LINK_ACK] = _link_advertised();
+	_txSeq = (_txSeq + 1) % UART_LINK_SEQ_MODULUS;
+#endif
+}
+
+
+/* _txCommit
+ *
+ * Queues the message in the acquired slot, stamped, with a text payload.
+ */
+void _txCommit(void)
+{
+	_txStamp();
+	uartTransport_commitTx();
+}
+
+
+/* _txCommitLength
+ *
+ * Queues the message in the acquired slot, stamped, with a payload of a given length.
+ */
+void _txCommitLength(uint16_t length)
+{
+	_txStamp();
+	uartTransport_commitTxLength(length);
+}
+
+
+/* _rxFront
+ *
+ * Peeks the message at the front of the transport layer rx queue.  In windowed mode,
+ * messages out of sequence (lost ones' successors, or resent duplicates) are dropped
+ * and the acknowledgement is sent again so the desktop resends from the right place.
+ * Unsequenced messages (a desktop starting over) are taken as they come.
+ */
+TransportStatus _rxFront(PacketView* view)
+{
+	TransportStatus status = uartTransport_peekRx(view);
+
+#ifdef SESSION_WINDOWED
+	while (status == TRANSPORT_OKAY && view->link[UART_LINK_SEQ] != _rxExpected
+			&& view->link[UART_LINK_SEQ] != UART_LINK_UNSEQUENCED)
+	{
+		uartTransport_releaseRx();
+		_linkStats.outOfSequence++;
+		_rxAckSent = UART_LINK_ACK_ONLY;
+		status = uartTransport_peekRx(view);
+	}
+#endif
+
+	return status;
+}
+
+
+/* _rxRelease
+ *
+ * Releases the message at the front of the transport layer rx queue.  In windowed mode,
+ * the message is then acknowledged by the next message or acknowledgement sent.  In
+ * credit mode, its slot is granted back to the desktop the same way.  The next message
+ * expected follows the sequence number of the message released, so in credit mode
+ * credit is not lost with a message lost on the way.  Unsequenced messages are not
+ * counted.
+ */
+void _rxRelease(void)
+{
+#if UART_PACKET_LINK_SIZE > 0
+	PacketView view;
+
+	if (uartTransport_peekRx(&view) == TRANSPORT_OKAY && view.link[UART_LINK_SEQ] != UART_LINK_UNSEQUENCED)
+	{
+		_rxExpected = (view.link[UART_LINK_SEQ] + 1) % UART_LINK_SEQ_MODULUS;
+	}
+#endif
+	uartTransport_releaseRx();
+}
+
+
+#if UART_PACKET_LINK_SIZE > 0
+/* _link_reset
+ *
+ * Starts the link segment for a new session:  sequence numbers from zero in both
+ * directions.  In windowed mode, sent messages are kept in the tx queue until
+ * acknowledged.  In credit mode, the first credit is granted by the next update.
+ */
+void _link_reset(void)
+{
+	uint8_t ack;
+
+	_txSeq = 0;
+	_rxExpected = 0;
+	_rxAckTick = HAL_GetTick();
+	(void)uartTransport_peerAck(&ack);
+#ifdef SESSION_WINDOWED
+	_rxAckSent = 0;
+	_txBase = 0;
+	_txPeerAck = 0;
+	_txProgressTick = HAL_GetTick();
+	_rttTiming = false;
+	uartTransport_setTxWindow(SESSION_WINDOW_SIZE);
+#else
+	_rxAckSent = UART_LINK_ACK_ONLY;
+#endif
+}
+
+
+/* _link_advertised
+ *
+ * The link segment's second byte for the messages released so far:  the acknowledgement
+ * in windowed mode, or the credit limit in credit mode.  The credit limit is
+ * SESSION_CREDITS past the message after the last one released.
+ */
+uint8_t _link_advertised(void)
+{
+#ifdef SESSION_CREDIT
+	return (_rxExpected + SESSION_CREDITS) % UART_LINK_SEQ_MODULUS;
+#else
+	return _rxExpected;
+#endif
+}
+
+
+/* _link_advertise
+ *
+ * Sends the acknowledgement (or credit) in a control frame, ahead of queued messages,
+ * if it has changed since it was last sent.  In credit mode, the credit is also sent
+ * again while nothing is received for a receive timeout, in case a credit frame was
+ * lost and the desktop is waiting on it.
+ */
+void _link_advertise(void)
+{
+	PacketView message;
+	bool resend = false;
+
+#ifdef SESSION_CREDIT
+	resend = (HAL_GetTick() - _rxAckTick) >= _receiveTimeout_ms
+			&& uartTransport_peekRx(&message) != TRANSPORT_OKAY;
+#endif
+
+	if ((_rxAckSent != _link_advertised() || resend)
+			&& uartTransport_acquireControlTx(&message) == TRANSPORT_OKAY)
+	{
+#ifdef SESSION_CREDIT
+		memcpy(message.header, CREDIT_HEADER, UART_PACKET_HEADER_SIZE);
+#else
+		memcpy(message.header, ACK_HEADER, UART_PACKET_HEADER_SIZE);
+#endif
+		message.link[UART_LINK_SEQ] = UART_LINK_ACK_ONLY;
+		message.link[UART_LINK_ACK] = _link_advertised();
+		uartTransport_commitControlTx();
+		_rxAckSent = _link_advertised();
+		_rxAckTick = HAL_GetTick();
+	}
+}
+#endif
+
+
+#ifdef SESSION_WINDOWED
+
+
+/* _window_update
+ *
+ * Releases the messages the desktop has acknowledged and resends the rest from the
+ * oldest if none have been acknowledged within the retransmit timeout.  Messages
+ * being resent are released by the transport layer once they have been sent again,
+ * so the window moves on at once.  The message timed, once acknowledged, is a
+ * round-trip sample:  itself and the acknowledgement on the wire.  Resending drops
+ * the timing, as the acknowledgement could then be for either send, and backs the
+ * timeouts off.
+ */
+void _window_update(void)
+{
+	uint8_t outstanding = (uint8_t)(_txSeq - _txBase) % UART_LINK_SEQ_MODULUS;
+	uint8_t acked;
+
+	// take the latest acknowledgement
+	uartTransport_peerAck(&_txPeerAck);
+
+	// release the acknowledged messages (an acknowledgement outside the window is stale)
+	acked = (uint8_t)(_txPeerAck - _txBase) % UART_LINK_SEQ_MODULUS;
+	if (acked > 0 && acked <= outstanding)
+	{
+		uartTransport_ackTx(acked);
+		if (_rttTiming && ((uint8_t)(_rttSeq - _txBase) % UART_LINK_SEQ_MODULUS) < acked)
+		{
+			_rttTiming = false;
+			_rtt_sample(HAL_GetTick() - _rttTick, 2);
+		}
+		_txBase = (_txBase + acked) % UART_LINK_SEQ_MODULUS;
+		outstanding -= acked;
+		_txProgressTick = HAL_GetTick();
+	}
+
+	// nothing is waiting on an acknowledgement
+	if (outstanding == 0)
+	{
+		_txProgressTick = HAL_GetTick();
+	}
+
+	// go back to the oldest unacknowledged message
+	else if ((HAL_GetTick() - _txProgressTick) >= _retransmitTimeout_ms)
+	{
+		uartTransport_rewindTx();
+		_linkStats.resends++;
+		_rttTiming = false;
+		_rtt_backoff();
+		_txProgressTick = HAL_GetTick();
+	}
+}
+#endif
@@ -0,0 +1,220 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ */
+
+
+#include <packet_queue.h>
+#include "string.h"
+
+
+/*
+ * Memory orders for the index accesses.  Each side reads the index the other
+ * side writes with acquire ordering, so the packet bytes written before the
+ * other side's release store are visible.  A side reading its own index needs
+ * no ordering.
+ */
+#define LOAD_OWN(index) atomic_load_explicit(&(index), memory_order_relaxed)
+#define LOAD_OTHER(index) atomic_load_explicit(&(index), memory_order_acquire)
+#define STORE_OWN(index, value) atomic_store_explicit(&(index), (value), memory_order_release)
+
+
+/* packetQueue_reset
+ *
+ * Sets both indexes to zero and clears the high-water mark.
+ */
+void packetQueue_reset(PacketQueue* queue)
+{
+	atomic_store(&queue->head, 0);
+	atomic_store(&queue->tail, 0);
+	queue->highWater = 0;
+}
+
+
+/* packetQueue_count
+ *
+ * The indexes are free-running counts, so the unsigned difference is the number
+ * of packets in the queue even after the counts wrap.
+ */
+uint32_t packetQueue_count(PacketQueue* queue)
+{
+	return (uint32_t)(atomic_load_explicit(&queue->head, memory_order_acquire)
+			- atomic_load_explicit(&queue->tail, memory_order_acquire));
+}
+
+
+/* packetQueue_isFull
+ *
+ * Full when the count reaches the depth.
+ */
+bool packetQueue_isFull(PacketQueue* queue)
+{
+	return packetQueue_count(queue) > queue->mask;
+}
+
+
+/* packetQueue_highWater
+ *
+ * Returns the high-water mark maintained by packetQueue_commit().
+ */
+uint32_t packetQueue_highWater(PacketQueue* queue)
+{
+	return queue->highWater;
+}
+
+
+/* packetQueue_resetHighWater
+ *
+ * Sets the high-water mark to the current count.
+ */
+void packetQueue_resetHighWater(PacketQueue* queue)
+{
+	queue->highWater = packetQueue_count(queue);
+}
+
+
+/* packetQueue_push
+ *
+ * Copies the packet into the back slot and commits it.
+ */
+bool packetQueue_push(PacketQueue* queue, const uint8_t packet[UART_FRAME_SIZE])
+{
+	uint8_t* slot = packetQueue_back(queue);
+
+	// queue full
+	if (slot == NULL)
+	{
+		return false;
+	}
+
+	// copy in and publish
+	else
+	{
+		memcpy(slot, packet, UART_FRAME_SIZE * sizeof(uint8_t));
+		packetQueue_commit(queue);
+		return true;
+	}
+}
+
+
+/* packetQueue_pop
+ *
+ * Copies the front packet out and releases it.
+ */
+bool packetQueue_pop(PacketQueue* queue, uint8_t packet[UART_FRAME_SIZE])
+{
+	uint8_t* slot = packetQueue_front(queue);
+
+	// queue empty
+	if (slot == NULL)
+	{
+		return false;
+	}
+
+	// copy out and free the slot
+	else
+	{
+		memcpy(packet, slot, UART_FRAME_SIZE * sizeof(uint8_t));
+		packetQueue_release(queue);
+		return true;
+	}
+}
+
+
+/* packetQueue_back
+ *
+ * The slot at the head index is free unless the consumer has not yet released
+ * the packet a full depth behind it.
+ */
+uint8_t* packetQueue_back(PacketQueue* queue)
+{
+	uint32_t head = LOAD_OWN(queue->head);
+	uint32_t tail = LOAD_OTHER(queue->tail);
+
+	if ((uint32_t)(head - tail) > queue->mask)
+	{
+		return NULL;
+	}
+	else
+	{
+		return queue->slots[head & queue->mask];
+	}
+}
+
+
+/* packetQueue_commit
+ *
+ * Publishes the back slot by advancing the head index (after the packet bytes
+ * have been written), then updates the high-water mark.
+ */
+void packetQueue_commit(PacketQueue* queue)
+{
+	uint32_t head = LOAD_OWN(queue->head) + 1;
+	uint32_t count;
+
+	STORE_OWN(queue->head, head);
+
+	count = (uint32_t)(head - LOAD_OTHER(queue->tail));
+	if (count > queue->highWater)
+	{
+		queue->highWater = count;
+	}
+}
+
+
+/* packetQueue_front
+ *
+ * The slot at the tail index holds a packet if the producer has advanced the
+ * head index past it.
+ */
+uint8_t* packetQueue_front(PacketQueue* queue)
+{
+	uint32_t tail = LOAD_OWN(queue->tail);
+	uint32_t head = LOAD_OTHER(queue->head);
+
+	if (head == tail)
+	{
+		return NULL;
+	}
+	else
+	{
+		return queue->slots[tail & queue->mask];
+	}
+}
+
+
+/* packetQueue_at
+ *
+ * The slot index packets past the tail index holds a packet if the producer
+ * has advanced the head index past it.
+ */
+uint8_t* packetQueue_at(PacketQueue* queue, uint32_t index)
+{
+	uint32_t tail = LOAD_OWN(queue->tail);
+	uint32_t head = LOAD_OTHER(queue->head);
+
+	if ((uint32_t)(head - tail) <= index)
+	{
+		return NULL;
+	}
+	else
+	{
+		return queue->slots[(tail + index) & queue->mask];
+	}
+}
+
+
+/* packetQueue_release
+ *
+ * Frees the front slot by advancing the tail index (after the packet bytes have
+ * been read).  Does nothing if the queue is empty.
+ */
+void packetQueue_release(PacketQueue* queue)
+{
+	uint32_t tail = LOAD_OWN(queue->tail);
+
+	if (LOAD_OTHER(queue->head) != tail)
+	{
+		STORE_OWN(queue->tail, tail + 1);
+	}
+}
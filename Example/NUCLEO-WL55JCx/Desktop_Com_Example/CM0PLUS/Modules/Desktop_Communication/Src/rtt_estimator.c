@@ -0,0 +1,117 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ */
+
+
+#include <rtt_estimator.h>
+
+
+// Private Function Prototypes
+uint32_t _rttEstimator_clamp(uint32_t timeout_ms);
+
+
+/* rttEstimator_init
+ *
+ * No SRTT or RTTVAR until the first sample.
+ */
+void rttEstimator_init(RttEstimator* rtt, uint32_t initial_ms)
+{
+	rtt->srtt = 0;
+	rtt->rttvar = 0;
+	rtt->rto_ms = _rttEstimator_clamp(initial_ms);
+	rtt->samples = 0;
+}
+
+
+/* rttEstimator_sample
+ *
+ * The first sample sets SRTT to it and RTTVAR to half of it.  Later ones move
+ * RTTVAR a quarter of the way to the sample's distance from SRTT, then SRTT an
+ * eighth of the way to the sample.  In the scaled values, RTTVAR times four is
+ * already the RTO's variation term, at least a tick.
+ */
+void rttEstimator_sample(RttEstimator* rtt, uint32_t sample_ms)
+{
+	int32_t error;
+
+	if (sample_ms > SESSION_RTO_MAX_MS)
+	{
+		sample_ms = SESSION_RTO_MAX_MS;
+	}
+
+	if (rtt->samples == 0)
+	{
+		rtt->srtt = sample_ms << 3;
+		rtt->rttvar = sample_ms << 1;
+	}
+	else
+	{
+		error = (int32_t)(sample_ms << 3) - (int32_t)rtt->srtt;
+		rtt->rttvar -= rtt->rttvar >> 2;
+		rtt->rttvar += (uint32_t)((error < 0) ? -error : error) >> 3;
+		rtt->srtt -= rtt->srtt >> 3;
+		rtt->srtt += sample_ms;
+	}
+	rtt->samples++;
+
+	rtt->rto_ms = _rttEstimator_clamp((rtt->srtt >> 3) + ((rtt->rttvar > 1) ? rtt->rttvar : 1));
+}
+
+
+/* rttEstimator_backoff
+ *
+ * Doubles the timeout, up to the bound.
+ */
+void rttEstimator_backoff(RttEstimator* rtt)
+{
+	rtt->rto_ms = _rttEstimator_clamp(rtt->rto_ms * 2);
+}
+
+
+/* rttEstimator_timeout
+ *
+ * Returns the RTO.
+ */
+uint32_t rttEstimator_timeout(const RttEstimator* rtt)
+{
+	return rtt->rto_ms;
+}
+
+
+/* rttEstimator_smoothed
+ *
+ * Unscales SRTT.
+ */
+uint32_t rttEstimator_smoothed(const RttEstimator* rtt)
+{
+	return rtt->srtt >> 3;
+}
+
+
+/* rttEstimator_variation
+ *
+ * Unscales RTTVAR.
+ */
+uint32_t rttEstimator_variation(const RttEstimator* rtt)
+{
+	return rtt->rttvar >> 2;
+}
+
+
+/* _rttEstimator_clamp
+ *
+ * Bounds a timeout to SESSION_RTO_MIN_MS and SESSION_RTO_MAX_MS.
+ */
+uint32_t _rttEstimator_clamp(uint32_t timeout_ms)
+{
+	if (timeout_ms < SESSION_RTO_MIN_MS)
+	{
+		return SESSION_RTO_MIN_MS;
+	}
+	if (timeout_ms > SESSION_RTO_MAX_MS)
+	{
+		return SESSION_RTO_MAX_MS;
+	}
+	return timeout_ms;
+}
@@ -0,0 +1,174 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ */
+
+
+#include <stage_profile.h>
+#include <string.h>
+#include "stm32wlxx_hal.h"
+#if !defined(CORE_CM4) && !defined(CORE_CM0PLUS)
+#include <time.h>
+#endif
+
+
+// Private Variables
+#ifdef SESSION_PROFILE
+static StageProfileStats _stats[PROFILE_STAGES];	// times of each stage
+static const char* const _names[PROFILE_STAGES] = {
+	"update", "tell", "dispatch", "listen", "tx_encode", "tx_start", "rx_extract"
+};
+#endif
+
+
+/* stageProfile_init
+ *
+ * On the CM4, enables the trace block and starts the DWT cycle counter.
+ */
+void stageProfile_init(void)
+{
+#ifdef CORE_CM4
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+
+#ifdef SESSION_PROFILE
+	stageProfile_reset();
+#endif
+}
+
+
+/* stageProfile_now
+ *
+ * Reads the DWT cycle counter (CM4), the HAL tick and the SysTick counter (CM0+),
+ * or the monotonic clock (host).  The SysTick counts down from its reload value
+ * once per tick; the tick is read again to catch a reload in between.
+ */
+uint32_t stageProfile_now(void)
+{
+#if defined(CORE_CM4)
+	return DWT->CYCCNT;
+#elif defined(CORE_CM0PLUS)
+	uint32_t tick;
+	uint32_t value;
+
+	do
+	{
+		tick = HAL_GetTick();
+		value = SysTick->VAL;
+	} while (tick != HAL_GetTick());
+
+	return tick * (SysTick->LOAD + 1U) + (SysTick->LOAD - value);
+#else
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint32_t)((uint64_t)now.tv_sec * 1000000000U + (uint64_t)now.tv_nsec);
+#endif
+}
+
+
+#ifdef SESSION_PROFILE
+/* stageProfile_record
+ *
+ * Updates the stage's times with interrupts masked, as a stage run from an
+ * interrupt may be recorded in the middle of one from the main context.
+ */
+void stageProfile_record(ProfileStage stage, uint32_t start)
+{
+	uint32_t elapsed = stageProfile_now() - start;
+	StageProfileStats* stats = &_stats[stage];
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	if (stats->count == 0 || elapsed < stats->min)
+	{
+		stats->min = elapsed;
+	}
+	if (elapsed > stats->max)
+	{
+		stats->max = elapsed;
+	}
+	stats->count++;
+	stats->total += elapsed;
+	__set_PRIMASK(primask);
+}
+
+
+/* stageProfile_reset
+ *
+ * Zeroes every stage's times with interrupts masked.
+ */
+void stageProfile_reset(void)
+{
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	memset(_stats, 0, sizeof(_stats));
+	__set_PRIMASK(primask);
+}
+
+
+/* stageProfile_read
+ *
+ * Copies the stage's times with interrupts masked.
+ */
+bool stageProfile_read(ProfileStage stage, StageProfileStats* stats)
+{
+	uint32_t primask;
+
+	if ((uint32_t)stage >= PROFILE_STAGES)
+	{
+		return false;
+	}
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	*stats = _stats[stage];
+	__set_PRIMASK(primask);
+
+	return true;
+}
+
+
+/* stageProfile_name
+ *
+ * Looks the name up in the table of names.
+ */
+const char* stageProfile_name(ProfileStage stage)
+{
+	return (uint32_t)stage < PROFILE_STAGES ? _names[stage] : "?";
+}
+#endif
+
+
+/* stageProfile_unit
+ *
+ * Cycles on the cores, nanoseconds on a host.
+ */
+const char* stageProfile_unit(void)
+{
+#if defined(CORE_CM4) || defined(CORE_CM0PLUS)
+	return "cyc";
+#else
+	return "ns";
+#endif
+}
+
+
+/* stageProfile_fromMicroseconds
+ *
+ * Cycles of the core clock in the time on the cores, nanoseconds on a host, held to
+ * STAGE_PROFILE_SPAN.
+ */
+uint32_t stageProfile_fromMicroseconds(uint32_t time_us)
+{
+#if defined(CORE_CM4) || defined(CORE_CM0PLUS)
+	uint64_t time = (uint64_t)time_us * (SystemCoreClock / 1000000U);
+#else
+	uint64_t time = (uint64_t)time_us * 1000U;
+#endif
+
+	return (time < STAGE_PROFILE_SPAN) ? (uint32_t)time : STAGE_PROFILE_SPAN;
+}
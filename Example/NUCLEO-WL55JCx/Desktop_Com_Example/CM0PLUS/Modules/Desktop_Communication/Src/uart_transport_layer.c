@@ -5,6 +5,9 @@
 
 
 #include <uart_transport_layer.h>
+#include <packet_queue.h>
+#include <stage_profile.h>
+#include <event_trace.h>
 #include "string.h"
 
 
@@ -19,38 +22,143 @@
  */
 #define IS_UART_HANDLE_INIT(hal_uart_handle) (hal_uart_handle != NULL && hal_uart_handle->Instance != NULL)
 
+/*
+ * Macro to check if a HAL uart handle has a circular DMA channel linked for
+ * reception.
+ *
+ * Paremeters:
+ * 	hal_uart_handle - pointer to an initialized UART_HandleTypeDef.
+ *
+ * Return:
+ * 	bool - true if a circular rx DMA channel is linked, false if not.
+ */
+#define IS_UART_RX_DMA_CIRCULAR(hal_uart_handle) (hal_uart_handle->hdmarx != NULL \
+		&& hal_uart_handle->hdmarx->Init.Mode == DMA_CIRCULAR)
+
+/*
+ * Macro to check if a HAL uart handle is configured for the flow control the
+ * layer was built for:  hardware RTS/CTS if UART_HW_FLOW_CONTROL is defined,
+ * anything otherwise.
+ *
+ * Paremeters:
+ * 	hal_uart_handle - pointer to an initialized UART_HandleTypeDef.
+ *
+ * Return:
+ * 	bool - true if configured as built for, false if not.
+ */
+#ifdef UART_HW_FLOW_CONTROL
+#define IS_UART_FLOW_CONTROL_SET(hal_uart_handle) (hal_uart_handle->Init.HwFlowCtl == UART_HWCONTROL_RTS_CTS)
+#else
+#define IS_UART_FLOW_CONTROL_SET(hal_uart_handle) (true)
+#endif
+
+/*
+ * Bytes a sender may still send after RTS is deasserted (hardware flow control).
+ */
+#define UART_RX_FLOW_SLACK 16
+
+/*
+ * Number of bits on the wire per byte (start bit, 8 data bits and 2 stop bits).
+ */
+#define UART_BITS_PER_BYTE 11
+
 
 /*
  * Private helper function prototypes for transport layer.
  */
 void _transportLayer_reset(void);
+bool _transportLayer_startRx(void);
+void _transportLayer_pend(void);
+void _txQueue_takeRequests(void);
+void _txQueue_startNext(void);
+uint32_t _txQueue_pending(void);
+uint16_t _rxRing_count(void);
+void _rxRing_read(uint8_t* dest, uint16_t count);
+uint16_t _rxRing_frameLength(void);
+void _rxRing_extract(void);
+void _rxRing_service(void);
+void _stats_foldHighWater(TransportStats* stats);
+#ifdef UART_HW_FLOW_CONTROL
+void _rxRing_flowControl(void);
+#endif
 
 
 /*
  * File-scope static variables for transport layer functionality across
- * function calls.  (Layer Operational Variables)
+ * function calls.  (Layer Operational Variables)  Each is written by either the
+ * main context or the UART interrupts, never both, outside of a reset (which
+ * runs with the UART stopped).  The main context asks the interrupts to change
+ * their state through running counts of requests, and pends the UART interrupt
+ * for uartTransport_IRQHandler() to take them.
  */
 static UART_HandleTypeDef* _uartHandle = NULL;		// pointer to HAL uart handle, for HAL calls
-static uint8_t _txBuffer[UART_PACKET_SIZE] = {0};	// transmission buffer (to be replaced by queue)
-static uint8_t _rxBuffer[UART_PACKET_SIZE] = {0};	// reception buffer (to be replaced by queue)
-static bool _txBuffer_full = false;					// transmission buffer full flag
-static bool _rxBuffer_full = false;					// reception buffer full flag
+PACKET_QUEUE_DEFINE(_txQueue, UART_TX_QUEUE_LENGTH);	// transmission queue, bulk lane (main loop -> tx complete ISR)
+PACKET_QUEUE_DEFINE(_txUrgentQueue, UART_TX_URGENT_QUEUE_LENGTH);	// urgent lane (main loop -> tx complete ISR)
+PACKET_QUEUE_DEFINE(_rxQueue, UART_RX_QUEUE_LENGTH);	// reception queue (rx event ISR -> main loop)
+static volatile bool _txInFlight = false;			// flag for a packet being transmitted
+static volatile bool _txUrgentInFlight = false;		// flag for the packet in flight being from the urgent lane
+static PacketQueue* _txBuildQueue = &_txQueue;		// lane of the slot handed out to build a packet in
+static TransportTxSchedule _txSchedule = UART_TX_SCHEDULE;	// how the lane of the next packet is picked
+static uint32_t _txUrgentWeight = UART_TX_URGENT_WEIGHT;	// urgent packets per bulk packet, weighted schedule
+static uint32_t _txUrgentRun = 0;					// urgent packets sent in a row while bulk ones waited
+static volatile uint32_t _txSent = 0;				// packets at the front of the tx queue sent and retained
+static volatile uint32_t _txWindow = 0;				// most packets retained until acknowledged, 0 for none
+static bool _txRewind = false;						// resend retained packets after the one in flight
+static volatile uint32_t _txWindowSetting = 0;		// window last set (main loop)
+static volatile uint32_t _txWindowAckMark = 0;		// _txAckRequested when the window was last set (main loop)
+static volatile uint32_t _txWindowRequested = 0;	// window settings made (main loop)
+static uint32_t _txWindowTaken = 0;					// window settings applied (ISR)
+static volatile uint32_t _txAckRequested = 0;		// packets acknowledged (main loop)
+static uint32_t _txAckTaken = 0;					// acknowledged packets released or dropped (ISR)
+static volatile uint32_t _txRewindRequested = 0;	// rewinds asked for (main loop)
+static uint32_t _txRewindTaken = 0;					// rewinds done or started (ISR)
+static volatile uint32_t _statsResetRequested = 0;	// count resets asked for (main loop)
+static uint32_t _statsResetTaken = 0;				// count resets done (ISR)
+static uint8_t _txControl[UART_FRAME_SIZE] = {0};	// control frame, sent ahead of the tx queue
+static volatile bool _txControlPending = false;		// control frame waiting to be sent
+static volatile bool _txControlInFlight = false;	// control frame being transmitted
+#if UART_PACKET_LINK_SIZE > 0
+static volatile uint8_t _rxPeerAck = 0;				// acknowledgement in the latest packet received (ISR)
+static volatile uint32_t _rxPeerAckCount = 0;		// packets received carrying one (ISR)
+static uint32_t _rxPeerAckTaken = 0;				// _rxPeerAckCount when last taken (main loop)
+#endif
+static void (*_txCompleteCallback)(void) = NULL;	// application hook on packet transmitted
+static void (*_rxEventCallback)(void) = NULL;		// application hook on bytes received
+static uint8_t _rxRing[UART_RX_RING_SIZE] = {0};	// circular DMA reception ring
+static volatile uint16_t _rxRingHead = 0;			// ring write index, updated on rx events
+static uint16_t _rxRingTail = 0;					// ring read index, owned by the rx event ISR
+static volatile uint32_t _rxEventTick = 0;			// tick of the most recent rx event
+static volatile bool _rxStopped = true;				// background reception stopped flag
+#ifdef UART_HW_FLOW_CONTROL
+static volatile bool _rxPaused = false;				// rx DMA requests held off, deasserting RTS
+#endif
+static uint32_t _rxResyncTimeout_ms = 0;			// age after which a partial packet is discarded
+static TransportStats _stats = {0};					// counts, kept across resets
 
 
 /* uartTransport_init
  *
- * Stores pointer to HAL UART handle and resets the other transport layer
- * operational variables.
+ * Stores pointer to HAL UART handle, resets the other transport layer
+ * operational variables and starts background reception.
  *
  * Note:  will not re-initalize until the layer has been de-initalized.
  */
 bool uartTransport_init(UART_HandleTypeDef* huart)
 {
 	// if module not already initialized and the uart handle passed is initialized
-	if (!IS_UART_HANDLE_INIT(_uartHandle) && IS_UART_HANDLE_INIT(huart))
+	if (!IS_UART_HANDLE_INIT(_uartHandle) && IS_UART_HANDLE_INIT(huart) && IS_UART_RX_DMA_CIRCULAR(huart)
+			&& IS_UART_FLOW_CONTROL_SET(huart))
 	{
 		_uartHandle = huart;		// store handle pointer
 		_transportLayer_reset();	// reset the module's operational variables
+
+		// background reception must be running for the layer to be usable
+		if (_rxStopped)
+		{
+			_uartHandle = NULL;
+			return false;
+		}
+
 		return true;				// return success
 	}
 
@@ -88,14 +196,17 @@ bool uartTransport_reset(void)
 
 /* uartTransport_deinit
  *
- * Sets the HAL UART handle pointer to NULL.  To be used before the UART is being
- * deinitialized by the HAL.
+ * Stops background reception and sets the HAL UART handle pointer to NULL.  To be
+ * used before the UART is being deinitialized by the HAL.
  */
 bool uartTransport_deinit(void)
 {
 	// if module initialized
 	if (IS_UART_HANDLE_INIT(_uartHandle))
 	{
+		HAL_UART_Abort(_uartHandle);	// stop the DMA transfers
+		_rxStopped = true;
+		_txInFlight = false;
 		_uartHandle = NULL;		// clear pointer to uart handle
 		return true;			// return success
 	}
@@ -108,32 +219,118 @@ bool uartTransport_deinit(void)
 }
 
 
+/* uartTransport_setBaudRate
+ *
+ * Stops transfers and reinitializes the UART with the new rate.  The HAL does not
+ * repeat the MSP initialization for a UART that is already set up, so the pins and
+ * DMA channels are left as they are.  If reinitialization fails, the previous rate
+ * is restored.
+ */
+bool uartTransport_setBaudRate(uint32_t baudRate)
+{
+	uint32_t previousBaudRate;
+	bool success;
+
+	// if module initialized
+	if (IS_UART_HANDLE_INIT(_uartHandle))
+	{
+		previousBaudRate = _uartHandle->Init.BaudRate;
+
+		// stop the DMA transfers and reconfigure the UART
+		HAL_UART_Abort(_uartHandle);
+		_uartHandle->Init.BaudRate = baudRate;
+		success = (HAL_UART_Init(_uartHandle) == HAL_OK);
+
+		// fall back to the rate the UART was running at
+		if (!success)
+		{
+			_uartHandle->Init.BaudRate = previousBaudRate;
+			HAL_UART_Init(_uartHandle);
+		}
+
+		// restart with empty queues, recomputing the resynchronization timeout
+		_transportLayer_reset();
+
+		return success && !_rxStopped;
+	}
+
+	// if module not initialized
+	else
+	{
+		return false;
+	}
+}
+
+
+/* uartTransport_getBaudRate
+ *
+ * Read from the UART handle's configuration.
+ */
+uint32_t uartTransport_getBaudRate(void)
+{
+	// if module initialized
+	if (IS_UART_HANDLE_INIT(_uartHandle))
+	{
+		return _uartHandle->Init.BaudRate;
+	}
+
+	// if module not initialized
+	else
+	{
+		return 0;
+	}
+}
+
+
+/* uartTransport_frameTime_ms
+ *
+ * UART_FRAME_SIZE bytes of UART_BITS_PER_BYTE bits each at the baud rate.
+ */
+uint32_t uartTransport_frameTime_ms(void)
+{
+	// if module initialized
+	if (IS_UART_HANDLE_INIT(_uartHandle))
+	{
+		return (1000 * UART_FRAME_SIZE * UART_BITS_PER_BYTE + _uartHandle->Init.BaudRate - 1)
+				/ _uartHandle->Init.BaudRate;
+	}
+
+	// if module not initialized
+	else
+	{
+		return 0;
+	}
+}
+
+
 /* uartTransport_enqueueTx
  *
- * Enqueues a packet for transmission.  Only successful if the layer has been
- * initialized.  Reports if queuing could or could not be performed due to the
- * tx buffer being full.
+ * Enqueues a packet for transmission and starts transmission if the UART is
+ * idle.  Only successful if the layer has been initialized.  Reports if queuing
+ * could or could not be performed due to the tx queue being full.  Does not wait
+ * for the packet to be transmitted.
  */
 TransportStatus uartTransport_bufferTx(uint8_t header[UART_PACKET_HEADER_SIZE], uint8_t body[UART_PACKET_PAYLOAD_SIZE])
 {
 	// if module initialized
 	if (IS_UART_HANDLE_INIT(_uartHandle))
 	{
-		// if the transmit buffer is in use (program has queued a packet but
-		// has not yet sent it)
-		if (_txBuffer_full)
+		PacketView view;
+
+		// if every slot of the transmit queue is waiting to be sent
+		if (uartTransport_acquireTx(&view) != TRANSPORT_OKAY)
 		{
 			return TRANSPORT_TX_FULL;
 		}
 
-		// the buffer is empty and ready to receive a new packet
+		// a slot is free and ready to receive a new packet
 		else
 		{
-			// Compose header and body into one message
-			composePacket(_txBuffer, header, body);
-			_txBuffer_full = true;
-
-			return TRANSPORT_OKAY;
+			// Copy header and body into the free slot, then queue and start
+			// transmission if the UART is idle
+			memcpy(view.header, header, UART_PACKET_HEADER_SIZE * sizeof(uint8_t));
+			memcpy(view.payload, body, UART_PACKET_PAYLOAD_SIZE * sizeof(uint8_t));
+			return uartTransport_commitTx();
 		}
 	}
 
@@ -149,15 +346,17 @@ TransportStatus uartTransport_bufferTx(uint8_t header[UART_PACKET_HEADER_SIZE],
  *
  * Dequeues a packet from those that have been received.  Only successful if
  * the layer has been initialized.  Reportes of dequeuing could or could not be
- * performed due to the rx buffer being empty.
+ * performed due to the rx queue being empty.
  */
 TransportStatus uartTransport_debufferRx(uint8_t header[UART_PACKET_HEADER_SIZE], uint8_t body[UART_PACKET_PAYLOAD_SIZE])
 {
 	// if the module has been initialized
 	if (IS_UART_HANDLE_INIT(_uartHandle))
 	{
+		PacketView view;
+
 		// if no packet has been received
-		if (!_rxBuffer_full)
+		if (uartTransport_peekRx(&view) != TRANSPORT_OKAY)
 		{
 			return TRANSPORT_RX_EMPTY;
 		}
@@ -165,10 +364,10 @@ TransportStatus uartTransport_debufferRx(uint8_t header[UART_PACKET_HEADER_SIZE]
 		// packet received and ready
 		else
 		{
-			// retrieve message from buffer
-			// decompose header and body from message
-			decomposePacket(header, body, _rxBuffer);
-			_rxBuffer_full = false;
+			// copy header and body (zero padded) from the packet, then free its slot
+			memcpy(header, view.header, UART_PACKET_HEADER_SIZE * sizeof(uint8_t));
+			memcpy(body, view.payload, UART_PACKET_PAYLOAD_SIZE * sizeof(uint8_t));
+			packetQueue_release(&_rxQueue);
 
 			return TRANSPORT_OKAY;
 		}
@@ -182,49 +381,126 @@ TransportStatus uartTransport_debufferRx(uint8_t header[UART_PACKET_HEADER_SIZE]
 }
 
 
-/* uartTransport_tx_polled
+/* uartTransport_acquireTx
  *
- * Transmits all packets in tx queue.  Reports if the tx queue is empty
- * (to start) or the state of the transmissions (success or failure).
- * Uses HAL calls.
+ * Acquires a slot in the bulk lane.
  */
-TransportStatus uartTransport_tx_polled(uint32_t timeout_ms)
+TransportStatus uartTransport_acquireTx(PacketView* view)
 {
-	HAL_StatusTypeDef hal_status;
+	return uartTransport_acquireTxLane(view, TX_LANE_BULK);
+}
 
-	// if the module has been initalized
+
+/* uartTransport_acquireTxLane
+ *
+ * Points the view at the free slot at the back of the lane's queue, so the caller
+ * can build a packet in place.  The slot is cleared so unused payload bytes are
+ * zero, as with uartTransport_bufferTx().  The lane is kept for the commit.
+ */
+TransportStatus uartTransport_acquireTxLane(PacketView* view, TransportTxLane lane)
+{
+	// if module initialized
 	if (IS_UART_HANDLE_INIT(_uartHandle))
 	{
-		// only transmit if a message has been queued
-		if (!_txBuffer_full)
-		{
-			return TRANSPORT_TX_EMPTY;
-		}
+		uint8_t* slot;
 
-		// transmit the message
-		hal_status = HAL_UART_Transmit(_uartHandle, (uint8_t*)_txBuffer, UART_PACKET_SIZE, timeout_ms);
+		// packets numbered for a window all go through the bulk lane, in order
+		_txBuildQueue = (lane == TX_LANE_URGENT && _txWindowSetting == 0) ? &_txUrgentQueue : &_txQueue;
+		slot = packetQueue_back(_txBuildQueue);
 
-		// alias the has status with transport layer status
-		if (hal_status == HAL_ERROR)
+		// if every slot of the lane is waiting to be sent
+		if (slot == NULL)
 		{
-			/*
-			 * Note †: this error occurs if pData passed into HAL_UART_Transmit() is NULL
-			 * or Size passed in is not greater than 0.
-			 */
-			return TRANSPORT_ERROR;
+			return TRANSPORT_TX_FULL;
 		}
-		else if (hal_status == HAL_TIMEOUT)
+
+		// hand out the free slot
+		else
 		{
-			return TRANSPORT_TIMEOUT;
+			memset(slot, 0, UART_FRAME_SIZE * sizeof(uint8_t));
+			packetView_init(view, slot);
+			return TRANSPORT_OKAY;
 		}
-		else if (hal_status == HAL_BUSY)
+	}
+
+	// the module has not been initialized
+	else
+	{
+		return TRANSPORT_NOT_INIT;
+	}
+}
+
+
+/* uartTransport_commitTx
+ *
+ * Commits the packet with its payload taken as text, ending at its trailing zero
+ * bytes.
+ */
+TransportStatus uartTransport_commitTx(void)
+{
+	// if module initialized
+	if (IS_UART_HANDLE_INIT(_uartHandle))
+	{
+		return uartTransport_commitTxLength(textPayloadLength(packetQueue_back(_txBuildQueue)));
+	}
+
+	// the module has not been initialized
+	else
+	{
+		return TRANSPORT_NOT_INIT;
+	}
+}
+
+
+/* uartTransport_commitTxLength
+ *
+ * Encodes the packet built in the slot from uartTransport_acquireTx() into its
+ * frame, queues it in its lane and starts transmission if the UART is idle.
+ */
+TransportStatus uartTransport_commitTxLength(uint16_t length)
+{
+	// if module initialized
+	if (IS_UART_HANDLE_INIT(_uartHandle))
+	{
+		TRACE_FRAME(TRACE_TX_QUEUE, (_txBuildQueue == &_txUrgentQueue) ? TRACE_LANE_URGENT : TRACE_LANE_BULK,
+				packetQueue_back(_txBuildQueue));
+		PROFILE_CALL(PROFILE_TX_ENCODE, encodeFrame(packetQueue_back(_txBuildQueue), length));
+		packetQueue_commit(_txBuildQueue);
+		_transportLayer_pend();
+		return TRANSPORT_OKAY;
+	}
+
+	// the module has not been initialized
+	else
+	{
+		return TRANSPORT_NOT_INIT;
+	}
+}
+
+
+/* uartTransport_peekRx
+ *
+ * Points the view at the oldest received packet in the rx queue, leaving it in
+ * the queue.  The view's length is the payload length received.
+ */
+TransportStatus uartTransport_peekRx(PacketView* view)
+{
+	// if the module has been initialized
+	if (IS_UART_HANDLE_INIT(_uartHandle))
+	{
+		uint8_t* packet = packetQueue_front(&_rxQueue);
+
+		// if no packet has been received
+		if (packet == NULL)
 		{
-			return TRANSPORT_BUSY;
+			return TRANSPORT_RX_EMPTY;
 		}
+
+		// packet received and ready
 		else
 		{
-			// transmission successful
-			_txBuffer_full = false;
+			packetView_init(view, packet);
+			view->length = receivedPayloadLength(packet);
 			return TRANSPORT_OKAY;
 		}
 	}
@@ -237,54 +513,80 @@ TransportStatus uartTransport_tx_polled(uint32_t timeout_ms)
 }
 
 
-/* uartTransport_rx_polled
+/* uartTransport_releaseRx
  *
- * Receives packets and enqueues them to the rx queue.  Reports of the
- * rx queue was full (to start) or the state of the receptions (success
- * or failure).  Uses HAL calls.
+ * Frees the slot of the oldest received packet for reception.  A frame left in
+ * the ring while the rx queue was full is moved into it by the UART interrupt,
+ * pended straight away rather than waiting for the next rx event.
  */
-TransportStatus uartTransport_rx_polled(uint32_t timeout_ms)
+TransportStatus uartTransport_releaseRx(void)
 {
-	HAL_StatusTypeDef hal_status;
-
 	// if the module has been initialized
 	if (IS_UART_HANDLE_INIT(_uartHandle))
 	{
-		// only receive if the buffer is empty
-		if (_rxBuffer_full)
+		packetQueue_release(&_rxQueue);
+
+		// take frames held in the ring into the freed slot, so the ring has room
+		// for what the sender may now send (the slot is granted back as credit,
+		// or RTS lets the sender go again)
+		_transportLayer_pend();
+		return TRANSPORT_OKAY;
+	}
+
+	// the module has not been initialized
+	else
+	{
+		return TRANSPORT_NOT_INIT;
+	}
+}
+
+
+/* uartTransport_tx_polled
+ *
+ * Starts transmission of the packets in the tx queue if it is not already under
+ * way, then waits up to the timeout for the queue to be emptied by the DMA.
+ * Reports if the tx queue is empty (to start) or the state of the transmissions.
+ */
+TransportStatus uartTransport_tx_polled(uint32_t timeout_ms)
+{
+	uint32_t tickstart;
+
+	// if the module has been initalized
+	if (IS_UART_HANDLE_INIT(_uartHandle))
+	{
+		// only transmit if a message has been queued
+		if (_txQueue_pending() == 0)
 		{
-			return TRANSPORT_RX_FULL;
+			return TRANSPORT_TX_EMPTY;
 		}
 
-		// receive a message
-		hal_status = HAL_UART_Receive(_uartHandle, (uint8_t*)_rxBuffer, UART_PACKET_SIZE, timeout_ms);
+		// start transmission if it is not running
+		_transportLayer_pend();
 
-		// alias the has status with transport layer status
-		if (hal_status == HAL_ERROR)
+		// the UART could not start transmitting (other than for a full window)
+		if (!_txInFlight && (packetQueue_count(&_txUrgentQueue) > 0 || _txWindow == 0 || _txSent < _txWindow))
 		{
-			/*
-			 * Note †: this error occurs if pData passed into HAL_UART_Transmit() is NULL
-			 * or Size passed in is not greater than 0.
-			 */
-			return TRANSPORT_ERROR;
+			return TRANSPORT_BUSY;
 		}
-		else if (hal_status == HAL_TIMEOUT)
+
+		// wait for the queue to be transmitted
+		tickstart = HAL_GetTick();
+		while (_txQueue_pending() > 0 && (HAL_GetTick() - tickstart) < timeout_ms)
 		{
-			return TRANSPORT_TIMEOUT;
 		}
-		else if (hal_status == HAL_BUSY)
+
+		// report if transmission is still under way after a non-zero timeout
+		if (timeout_ms > 0 && _txQueue_pending() > 0)
 		{
-			return TRANSPORT_BUSY;
+			return TRANSPORT_TIMEOUT;
 		}
 		else
 		{
-			// reception was successful and a packet was received
-			_rxBuffer_full = true;
 			return TRANSPORT_OKAY;
 		}
 	}
 
-	// the module is not initialized
+	// the module has not been initialized
 	else
 	{
 		return TRANSPORT_NOT_INIT;
@@ -292,16 +594,899 @@ TransportStatus uartTransport_rx_polled(uint32_t timeout_ms)
 }
 
 
-/* _transportLayer_reset
+/* uartTransport_setTxSchedule
  *
- * Resets operational variables other than the HAL UART handle pointer.
+ * Sets the schedule read by the transmit complete interrupt when it starts the
+ * next packet.
  */
-void _transportLayer_reset(void)
+bool uartTransport_setTxSchedule(TransportTxSchedule schedule, uint32_t urgentWeight)
+{
+	if ((schedule != TX_SCHEDULE_STRICT && schedule != TX_SCHEDULE_WEIGHTED) || urgentWeight == 0)
+	{
+		return false;
+	}
+
+	_txSchedule = schedule;
+	_txUrgentWeight = urgentWeight;
+	return true;
+}
+
+
+/* uartTransport_setTxWindow
+ *
+ * Records the window for the UART interrupt to apply (see _txQueue_takeRequests()),
+ * along with the acknowledgements made so far.  Acknowledgements recorded by
+ * reception before now are taken as old.
+ */
+void uartTransport_setTxWindow(uint32_t window)
+{
+	_txWindowSetting = window;
+	_txWindowAckMark = _txAckRequested;
+	_txWindowRequested++;
+
+#if UART_PACKET_LINK_SIZE > 0
+	_rxPeerAckTaken = _rxPeerAckCount;
+#endif
+
+	// a larger window may let transmission continue
+	if (IS_UART_HANDLE_INIT(_uartHandle))
+	{
+		_transportLayer_pend();
+	}
+}
+
+
+/* uartTransport_ackTx
+ *
+ * Adds to the running count of acknowledged packets, which the UART interrupt
+ * releases from the front of the tx queue as far as they have been sent.
+ */
+void uartTransport_ackTx(uint32_t count)
+{
+	_txAckRequested += count;
+
+	// acknowledgement opens the window for more packets
+	if (IS_UART_HANDLE_INIT(_uartHandle))
+	{
+		_transportLayer_pend();
+	}
+}
+
+
+/* uartTransport_rewindTx
+ *
+ * Asks the UART interrupt to resend the retained packets from the oldest.
+ */
+void uartTransport_rewindTx(void)
 {
-	// clear buffers and flags
-	memset(_txBuffer, 0, UART_PACKET_SIZE * sizeof(uint8_t));
-	memset(_rxBuffer, 0, UART_PACKET_SIZE * sizeof(uint8_t));
-	_txBuffer_full = false;
-	_rxBuffer_full = false;
+	_txRewindRequested++;
+
+	if (IS_UART_HANDLE_INIT(_uartHandle))
+	{
+		_transportLayer_pend();
+	}
+}
+
+
+/* uartTransport_acquireControlTx
+ *
+ * Hands out the control frame buffer if it is not waiting to be sent or being
+ * sent.  The buffer is cleared.
+ */
+TransportStatus uartTransport_acquireControlTx(PacketView* view)
+{
+	// if module initialized
+	if (IS_UART_HANDLE_INIT(_uartHandle))
+	{
+		// the control frame is still to be sent
+		if (_txControlPending || _txControlInFlight)
+		{
+			return TRANSPORT_TX_FULL;
+		}
+
+		// hand out the control frame
+		else
+		{
+			memset(_txControl, 0, UART_FRAME_SIZE * sizeof(uint8_t));
+			packetView_init(view, _txControl);
+			return TRANSPORT_OKAY;
+		}
+	}
+
+	// the module has not been initialized
+	else
+	{
+		return TRANSPORT_NOT_INIT;
+	}
 }
 
+
+/* uartTransport_commitControlTx
+ *
+ * Encodes the control frame and starts sending it, ahead of the tx queue, when
+ * the UART is next idle.
+ */
+TransportStatus uartTransport_commitControlTx(void)
+{
+	// if module initialized
+	if (IS_UART_HANDLE_INIT(_uartHandle))
+	{
+		TRACE_FRAME(TRACE_TX_QUEUE, TRACE_LANE_CONTROL, _txControl);
+		encodeFrame(_txControl, textPayloadLength(_txControl));
+		_txControlPending = true;
+		_transportLayer_pend();
+		return TRANSPORT_OKAY;
+	}
+
+	// the module has not been initialized
+	else
+	{
+		return TRANSPORT_NOT_INIT;
+	}
+}
+
+
+#if UART_PACKET_LINK_SIZE > 0
+/* uartTransport_peerAck
+ *
+ * Takes the acknowledgement recorded by the rx event ISR, if the ISR has counted
+ * one since the last taken.  The ISR may record a later one between the count
+ * and the acknowledgement being read, which is as new.
+ */
+bool uartTransport_peerAck(uint8_t* ack)
+{
+	uint32_t count = _rxPeerAckCount;
+	bool isNew = (count != _rxPeerAckTaken);
+
+	if (isNew)
+	{
+		_rxPeerAckTaken = count;
+		*ack = _rxPeerAck;
+	}
+
+	return isNew;
+}
+#endif
+
+
+/* uartTransport_setTxCompleteCallback
+ *
+ * Stores the function pointer to be called each time a packet is transmitted.
+ */
+void uartTransport_setTxCompleteCallback(void (*callback)(void))
+{
+	_txCompleteCallback = callback;
+}
+
+
+/* uartTransport_setRxEventCallback
+ *
+ * Sets the function called at the end of the rx event and error callbacks.
+ */
+void uartTransport_setRxEventCallback(void (*callback)(void))
+{
+	_rxEventCallback = callback;
+}
+
+
+/* uartTransport_txPending
+ *
+ * Counts the packets still to be sent.
+ */
+uint32_t uartTransport_txPending(void)
+{
+	if (IS_UART_HANDLE_INIT(_uartHandle))
+	{
+		return _txQueue_pending();
+	}
+	else
+	{
+		return 0;
+	}
+}
+
+
+/* uartTransport_rxPending
+ *
+ * Counts the packets in the rx queue.
+ */
+uint32_t uartTransport_rxPending(void)
+{
+	if (IS_UART_HANDLE_INIT(_uartHandle))
+	{
+		return packetQueue_count(&_rxQueue);
+	}
+	else
+	{
+		return 0;
+	}
+}
+
+
+/* uartTransport_stats
+ *
+ * Copies the counts, which the interrupts update, then takes the queues'
+ * high-water marks since the last reset into account in the copy.
+ */
+void uartTransport_stats(TransportStats* stats)
+{
+	*stats = _stats;
+	_stats_foldHighWater(stats);
+}
+
+
+/* uartTransport_resetStats
+ *
+ * Restarts the tx lanes' high-water marks, which the main context keeps as their
+ * producer, and asks the UART interrupt to zero the counts and restart the rx
+ * queue's.
+ */
+void uartTransport_resetStats(void)
+{
+	packetQueue_resetHighWater(&_txQueue);
+	packetQueue_resetHighWater(&_txUrgentQueue);
+	_statsResetRequested++;
+
+	if (IS_UART_HANDLE_INIT(_uartHandle))
+	{
+		_transportLayer_pend();
+	}
+}
+
+
+/* uartTransport_rx_polled
+ *
+ * Waits up to the timeout for a packet to be in the rx queue, which is filled in
+ * the background as packets are completed in the DMA reception ring.  Reports
+ * whether a packet is ready to be dequeued.
+ */
+TransportStatus uartTransport_rx_polled(uint32_t timeout_ms)
+{
+	uint32_t tickstart;
+
+	// if the module has been initialized
+	if (IS_UART_HANDLE_INIT(_uartHandle))
+	{
+		// have the UART interrupt restart background reception if a UART error
+		// stopped it, and take packets left in the ring while the rx queue was full
+		_transportLayer_pend();
+		if (_rxStopped)
+		{
+			return TRANSPORT_ERROR;
+		}
+
+		// wait for a packet to be queued
+		tickstart = HAL_GetTick();
+		while (packetQueue_count(&_rxQueue) == 0 && (HAL_GetTick() - tickstart) < timeout_ms)
+		{
+		}
+
+		// a packet was received
+		if (packetQueue_count(&_rxQueue) > 0)
+		{
+			return TRANSPORT_OKAY;
+		}
+
+		// no packet was received
+		else
+		{
+			// resynchronize if a partial packet has gone stale
+			_transportLayer_pend();
+			return TRANSPORT_TIMEOUT;
+		}
+	}
+
+	// the module is not initialized
+	else
+	{
+		return TRANSPORT_NOT_INIT;
+	}
+}
+
+
+/* uartTransport_IRQHandler
+ *
+ * Everything the main context leaves to the interrupts:  restarts reception if a
+ * UART error stopped it, zeroes the counts if asked to, takes frames left in the
+ * ring (and discards a stale partial one), takes the tx requests and starts the
+ * next packet if none is in flight.
+ */
+void uartTransport_IRQHandler(void)
+{
+	if (IS_UART_HANDLE_INIT(_uartHandle))
+	{
+		// restart background reception if a UART error stopped it
+		if (_rxStopped)
+		{
+			_stats.rxRestarts++;
+			_transportLayer_startRx();
+		}
+
+		// zero the counts, the rx queue's high-water mark is kept here as its producer
+		if (_statsResetTaken != _statsResetRequested)
+		{
+			_statsResetTaken = _statsResetRequested;
+			memset(&_stats, 0, sizeof(_stats));
+			packetQueue_resetHighWater(&_rxQueue);
+		}
+
+		_rxRing_service();
+
+		_txQueue_takeRequests();
+		if (!_txInFlight)
+		{
+			PROFILE_CALL(PROFILE_TX_START, _txQueue_startNext());
+		}
+	}
+}
+
+
+/* HAL_UARTEx_RxEventCallback
+ *
+ * Overrides the HAL weak callback.  Called from the UART/DMA interrupts on
+ * half-transfer, transfer-complete (ring wrap) and idle-line events with the
+ * ring position the DMA has written up to.  Complete packets are moved from the
+ * ring into the rx queue.
+ */
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size)
+{
+	if (huart == _uartHandle)
+	{
+		_rxRingHead = Size % UART_RX_RING_SIZE;
+		_rxEventTick = HAL_GetTick();
+		PROFILE_CALL(PROFILE_RX_EXTRACT, _rxRing_extract());
+
+		if (_rxEventCallback != NULL)
+		{
+			_rxEventCallback();
+		}
+	}
+}
+
+
+/* HAL_UART_TxCpltCallback
+ *
+ * Overrides the HAL weak callback.  Called from the DMA (or UART) interrupt when
+ * a packet has been transmitted.  Frees the packet's slot in the tx queue (or
+ * retains it, counted as sent, if a window is set) and chains transmission of
+ * the next queued packet.
+ */
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+	if (huart == _uartHandle)
+	{
+		TRACE_EVENT(TRACE_TX_DONE, _txControlInFlight ? TRACE_LANE_CONTROL
+				: _txUrgentInFlight ? TRACE_LANE_URGENT : TRACE_LANE_BULK, 0);
+
+		// free or retain the transmitted packet's slot (a control frame is not
+		// in a queue, and urgent packets are never retained)
+		if (_txControlInFlight)
+		{
+			_txControlInFlight = false;
+		}
+		else if (_txUrgentInFlight)
+		{
+			_txUrgentInFlight = false;
+			packetQueue_release(&_txUrgentQueue);
+		}
+		else if (_txWindow == 0)
+		{
+			packetQueue_release(&_txQueue);
+		}
+		else
+		{
+			_txSent++;
+		}
+
+		// take acknowledgements before going back to the oldest retained packet,
+		// if asked to, so acknowledged packets are not resent
+		_txQueue_takeRequests();
+		if (_txRewind)
+		{
+			_txRewind = false;
+			_txSent = 0;
+		}
+
+		// continue with the next packet
+		PROFILE_CALL(PROFILE_TX_START, _txQueue_startNext());
+
+		if (_txCompleteCallback != NULL)
+		{
+			_txCompleteCallback();
+		}
+	}
+}
+
+
+/* HAL_UART_ErrorCallback
+ *
+ * Overrides the HAL weak callback.  Counts the errors by type.  Blocking errors
+ * (such as overrun) stop the DMA reception, in which case it is flagged to be
+ * restarted by uartTransport_IRQHandler(), which follows in the UART interrupt
+ * (or is pended by uartTransport_rx_polled() for a DMA error).  Noise, framing
+ * and parity errors that do not stop reception are only counted.  If an error
+ * ended a transmission, the packet is left at the head of its lane, or the control
+ * frame pending, to be sent again.
+ */
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+	if (huart == _uartHandle)
+	{
+		_stats.errOverrun += ((huart->ErrorCode & HAL_UART_ERROR_ORE) != 0);
+		_stats.errFraming += ((huart->ErrorCode & HAL_UART_ERROR_FE) != 0);
+		_stats.errNoise += ((huart->ErrorCode & HAL_UART_ERROR_NE) != 0);
+		_stats.errParity += ((huart->ErrorCode & HAL_UART_ERROR_PE) != 0);
+		_stats.errDma += ((huart->ErrorCode & HAL_UART_ERROR_DMA) != 0);
+		TRACE_EVENT(TRACE_UART_ERROR, 0, huart->ErrorCode);
+
+		if (huart->RxState == HAL_UART_STATE_READY)
+		{
+			_rxStopped = true;
+
+			if (_rxEventCallback != NULL)
+			{
+				_rxEventCallback();
+			}
+		}
+
+		if (huart->gState == HAL_UART_STATE_READY)
+		{
+			// a control frame aborted is not in a lane, so is flagged to be sent again
+			_txControlPending = _txControlPending || _txControlInFlight;
+			_txInFlight = false;
+			_txControlInFlight = false;
+			_txUrgentInFlight = false;
+		}
+	}
+}
+
+
+/* _transportLayer_reset
+ *
+ * Resets operational variables other than the HAL UART handle pointer.
+ */
+void _transportLayer_reset(void)
+{
+	// stop any transmission and reception under way
+	HAL_UART_Abort(_uartHandle);
+
+	// clear queues (keeping their high-water marks in the counts), flags and requests
+	_stats_foldHighWater(&_stats);
+	packetQueue_reset(&_txQueue);
+	packetQueue_reset(&_txUrgentQueue);
+	packetQueue_reset(&_rxQueue);
+	_txInFlight = false;
+	_txUrgentInFlight = false;
+	_txBuildQueue = &_txQueue;
+	_txUrgentRun = 0;
+	_txSent = 0;
+	_txWindow = 0;
+	_txRewind = false;
+	_txWindowSetting = 0;
+	_txWindowTaken = _txWindowRequested;
+	_txAckTaken = _txAckRequested;
+	_txRewindTaken = _txRewindRequested;
+	_txControlPending = false;
+	_txControlInFlight = false;
+
+	// restart background reception with an empty ring
+	_transportLayer_startRx();
+}
+
+
+/* _transportLayer_startRx
+ *
+ * Starts the circular DMA reception into the ring with idle-line events, from
+ * the start of the ring.  The resynchronization timeout is set to twice the
+ * time the longest frame takes on the wire at the UART's baud rate.
+ */
+bool _transportLayer_startRx(void)
+{
+	// empty the ring
+	_rxRingHead = 0;
+	_rxRingTail = 0;
+#ifdef UART_HW_FLOW_CONTROL
+	_rxPaused = false;
+#endif
+	_rxEventTick = HAL_GetTick();
+	_rxResyncTimeout_ms = (2 * 1000 * UART_FRAME_SIZE * UART_BITS_PER_BYTE) / _uartHandle->Init.BaudRate + 1;
+
+	// start reception
+	_rxStopped = (HAL_UARTEx_ReceiveToIdle_DMA(_uartHandle, _rxRing, UART_RX_RING_SIZE) != HAL_OK);
+
+	return !_rxStopped;
+}
+
+
+/* _transportLayer_pend
+ *
+ * Pends the UART interrupt for uartTransport_IRQHandler() to take what the main
+ * context has asked for.  From thread mode the interrupt is taken straight away.
+ */
+void _transportLayer_pend(void)
+{
+	HAL_NVIC_SetPendingIRQ(UART_TRANSPORT_IRQn);
+}
+
+
+/* _txQueue_takeRequests
+ *
+ * Applies the main context's requests, from the interrupts.  A new window comes
+ * first:  turning retention on drops acknowledgements made before it was set, and
+ * without retention the retained packets are released and acknowledgements and
+ * rewinds are dropped, as they are for no packet.  Acknowledged packets are then
+ * released as far as they have been sent; the rest (packets being resent) are
+ * released once sent again.  A rewind is done by the transmit complete callback
+ * if a packet is in flight.
+ */
+void _txQueue_takeRequests(void)
+{
+	uint32_t count;
+
+	// a new window
+	if (_txWindowTaken != _txWindowRequested)
+	{
+		if (_txWindow == 0)
+		{
+			_txAckTaken = _txWindowAckMark;
+		}
+		_txWindowTaken = _txWindowRequested;
+		_txWindow = _txWindowSetting;
+	}
+
+	// no retention
+	if (_txWindow == 0)
+	{
+		while (_txSent > 0)
+		{
+			packetQueue_release(&_txQueue);
+			_txSent--;
+		}
+		_txRewind = false;
+		_txAckTaken = _txAckRequested;
+		_txRewindTaken = _txRewindRequested;
+		return;
+	}
+
+	// acknowledged packets that have been sent
+	count = _txAckRequested - _txAckTaken;
+	if (count > _txSent)
+	{
+		count = _txSent;
+	}
+	_txAckTaken += count;
+	_txSent -= count;
+	while (count-- > 0)
+	{
+		packetQueue_release(&_txQueue);
+	}
+
+	// resend from the oldest retained packet
+	if (_txRewindTaken != _txRewindRequested)
+	{
+		_txRewindTaken = _txRewindRequested;
+		TRACE_EVENT(TRACE_TX_REWIND, 0, _txSent);
+		if (_txInFlight)
+		{
+			_txRewind = true;
+		}
+		else
+		{
+			_txSent = 0;
+		}
+	}
+}
+
+
+/* _txQueue_startNext
+ *
+ * Starts transmission of the control frame if one is waiting, otherwise of the
+ * oldest frame in the lane the schedule picks:  the urgent lane, or the oldest
+ * frame in the bulk lane not yet sent (unless the window of retained frames is
+ * full).  With the weighted schedule, a waiting bulk frame is picked once
+ * _txUrgentWeight urgent frames have gone in a row.  Transmits by DMA if a DMA
+ * channel is linked to the UART for transmission, otherwise by TXE interrupts.
+ * The frame is transmitted in place and released (or retained) on transmit
+ * complete.
+ */
+void _txQueue_startNext(void)
+{
+	HAL_StatusTypeDef hal_status;
+	uint8_t* packet = NULL;
+	uint8_t* urgent = packetQueue_front(&_txUrgentQueue);
+	uint8_t* bulk = NULL;
+
+	// the next bulk frame not yet sent, while the window has room
+	if (_txWindow == 0 || _txSent < _txWindow)
+	{
+		bulk = packetQueue_at(&_txQueue, _txSent);
+	}
+
+	// a control frame goes ahead of the lanes
+	if (_txControlPending)
+	{
+		packet = _txControl;
+	}
+
+	// an urgent frame, unless bulk frames are owed their turn
+	else if (urgent != NULL && (bulk == NULL || _txSchedule == TX_SCHEDULE_STRICT
+			|| _txUrgentRun < _txUrgentWeight))
+	{
+		packet = urgent;
+	}
+	else
+	{
+		packet = bulk;
+	}
+
+	// nothing left to transmit
+	if (packet == NULL)
+	{
+		hal_status = HAL_ERROR;
+	}
+	else if (_uartHandle->hdmatx != NULL)
+	{
+		hal_status = HAL_UART_Transmit_DMA(_uartHandle, packet, frameLength(packet));
+	}
+	else
+	{
+		hal_status = HAL_UART_Transmit_IT(_uartHandle, packet, frameLength(packet));
+	}
+
+	_txInFlight = (hal_status == HAL_OK);
+	if (_txInFlight)
+	{
+		_stats.txPackets++;
+		_stats.txBytes += frameLength(packet);
+		TRACE_EVENT(TRACE_TX_START, (packet == _txControl) ? TRACE_LANE_CONTROL
+				: (packet == urgent) ? TRACE_LANE_URGENT : TRACE_LANE_BULK, frameLength(packet));
+	}
+	if (_txInFlight && packet == _txControl)
+	{
+		_txControlPending = false;
+		_txControlInFlight = true;
+	}
+	else if (_txInFlight && packet == urgent)
+	{
+		_txUrgentInFlight = true;
+		_txUrgentRun = (bulk != NULL) ? _txUrgentRun + 1 : 0;
+	}
+	else if (_txInFlight)
+	{
+		_txUrgentRun = 0;
+	}
+}
+
+
+/* _txQueue_pending
+ *
+ * Number of frames waiting to be sent:  those in the bulk lane past the retained
+ * frames, those in the urgent lane, and the control frame.
+ */
+uint32_t _txQueue_pending(void)
+{
+	return packetQueue_count(&_txQueue) - _txSent + packetQueue_count(&_txUrgentQueue)
+			+ (_txControlPending || _txControlInFlight);
+}
+
+
+/* _stats_foldHighWater
+ *
+ * Keeps the queues' high-water marks in a set of counts:  the layer's own before
+ * the queues are reset, or a copy being read out.
+ */
+void _stats_foldHighWater(TransportStats* stats)
+{
+	uint32_t highWater;
+
+	highWater = packetQueue_highWater(&_txQueue);
+	stats->txHighWater = (highWater > stats->txHighWater) ? highWater : stats->txHighWater;
+	highWater = packetQueue_highWater(&_txUrgentQueue);
+	stats->txUrgentHighWater = (highWater > stats->txUrgentHighWater) ? highWater : stats->txUrgentHighWater;
+	highWater = packetQueue_highWater(&_rxQueue);
+	stats->rxHighWater = (highWater > stats->rxHighWater) ? highWater : stats->rxHighWater;
+}
+
+
+/* _rxRing_count
+ *
+ * Number of bytes received into the ring and not yet read.
+ */
+uint16_t _rxRing_count(void)
+{
+	uint16_t head = _rxRingHead;	// single read of the volatile index
+
+	return (uint16_t)((head + UART_RX_RING_SIZE - _rxRingTail) % UART_RX_RING_SIZE);
+}
+
+
+/* _rxRing_read
+ *
+ * Copies count bytes out of the ring, handling the wrap at the end of the ring,
+ * and advances the read index.  If dest is NULL the bytes are discarded.
+ */
+void _rxRing_read(uint8_t* dest, uint16_t count)
+{
+	uint16_t firstPart = UART_RX_RING_SIZE - _rxRingTail;
+
+	if (dest != NULL)
+	{
+		if (count <= firstPart)
+		{
+			memcpy(dest, &_rxRing[_rxRingTail], count);
+		}
+		else
+		{
+			memcpy(dest, &_rxRing[_rxRingTail], firstPart);
+			memcpy(dest + firstPart, _rxRing, count - firstPart);
+		}
+	}
+
+	_rxRingTail = (_rxRingTail + count) % UART_RX_RING_SIZE;
+}
+
+
+/* _rxRing_frameLength
+ *
+ * Number of bytes in the ring that make up the next frame, or 0 if the frame
+ * is not complete.  For COBS frames this is up to and including the delimiter,
+ * which the ring is searched for.
+ */
+uint16_t _rxRing_frameLength(void)
+{
+	uint16_t count = _rxRing_count();
+
+#ifdef UART_FRAMING_COBS
+	uint16_t index = _rxRingTail;
+	uint16_t length;
+
+	for (length = 1; length <= count; length++)
+	{
+		if (_rxRing[index] == UART_FRAME_DELIMITER)
+		{
+			return length;
+		}
+		index = (index + 1) % UART_RX_RING_SIZE;
+	}
+
+	return 0;
+#else
+	return (count >= UART_FRAME_SIZE) ? UART_FRAME_SIZE : 0;
+#endif
+}
+
+
+/* _rxRing_extract
+ *
+ * Moves each complete frame in the ring into the rx queue, decoded, while the
+ * queue has space.  Frames that do not fit stay in the ring until the main
+ * context frees a slot.  Frames that are malformed or too long are discarded.
+ * Runs only in the UART interrupts, which own the ring read index and produce
+ * into the rx queue.
+ */
+void _rxRing_extract(void)
+{
+	uint8_t* slot;
+	uint16_t length;
+
+	while ((slot = packetQueue_back(&_rxQueue)) != NULL)
+	{
+		length = _rxRing_frameLength();
+
+		// no complete frame in the ring
+		if (length == 0)
+		{
+			// bytes that are already too many for a frame are noise
+			if (_rxRing_count() >= UART_FRAME_SIZE)
+			{
+				_stats.rxNoise += _rxRing_count();
+				TRACE_EVENT(TRACE_RX_DISCARD, TRACE_DISCARD_NOISE, _rxRing_count());
+				_rxRing_read(NULL, _rxRing_count());
+			}
+			break;
+		}
+
+		// a frame too long for a slot is discarded
+		else if (length > UART_FRAME_SIZE)
+		{
+			_stats.rxMalformed++;
+			TRACE_EVENT(TRACE_RX_DISCARD, TRACE_DISCARD_LONG, length);
+			_rxRing_read(NULL, length);
+		}
+
+		// take the frame (without any delimiter) and queue it if well formed
+		else
+		{
+			_rxRing_read(slot, length);
+			_stats.rxBytes += length;
+#ifdef UART_FRAMING_COBS
+			length--;
+#endif
+			if (!decodeFrame(slot, length))
+			{
+				_stats.rxMalformed++;
+				TRACE_EVENT(TRACE_RX_DISCARD, TRACE_DISCARD_MALFORMED, length);
+			}
+			else
+			{
+				_stats.rxPackets++;
+				TRACE_FRAME(TRACE_RX_FRAME, receivedPayloadLength(slot), slot);
+#if UART_PACKET_LINK_SIZE > 0
+				// record the acknowledgement (or credit) every sequenced packet
+				// carries, and drop packets that carry nothing else
+				PacketView view;
+
+				packetView_init(&view, slot);
+				if (view.link[UART_LINK_SEQ] != UART_LINK_UNSEQUENCED)
+				{
+					_rxPeerAck = view.link[UART_LINK_ACK];
+					_rxPeerAckCount++;
+				}
+				if (view.link[UART_LINK_SEQ] == UART_LINK_ACK_ONLY)
+				{
+					continue;
+				}
+#endif
+				packetQueue_commit(&_rxQueue);
+			}
+		}
+	}
+
+#ifdef UART_HW_FLOW_CONTROL
+	_rxRing_flowControl();
+#endif
+}
+
+
+/* _rxRing_service
+ *
+ * Ring housekeeping, from uartTransport_IRQHandler() as pended by the main
+ * context.  Extracts frames that were left in the ring while the rx queue was
+ * full.  If the bytes of a partial frame have sat in the ring for longer than a
+ * frame takes to arrive, the rest of that frame was lost; they are discarded so
+ * the next frame is taken correctly.
+ */
+void _rxRing_service(void)
+{
+	uint16_t count;
+
+	PROFILE_CALL(PROFILE_RX_EXTRACT, _rxRing_extract());
+
+	// with space in the rx queue, anything left in the ring is a partial frame
+	count = _rxRing_count();
+	if (count > 0 && !packetQueue_isFull(&_rxQueue) && (HAL_GetTick() - _rxEventTick) > _rxResyncTimeout_ms)
+	{
+		_stats.rxNoise += count;
+		TRACE_EVENT(TRACE_RX_DISCARD, TRACE_DISCARD_NOISE, count);
+		_rxRing_read(NULL, count);
+	}
+}
+
+
+#ifdef UART_HW_FLOW_CONTROL
+/* _rxRing_flowControl
+ *
+ * Holds off the sender while frames cannot be taken out of the ring.  With the rx
+ * queue full, DMA requests are stopped before the ring could overflow, so the
+ * received byte stays in the UART and the UART deasserts RTS.  Rx events come at
+ * least every half ring, so stopping once less than half the ring (and the
+ * sender's slack) is free keeps the ring from overflowing.  Requests are started
+ * again once frames can be taken.  Runs wherever _rxRing_extract() does.
+ */
+void _rxRing_flowControl(void)
+{
+	bool hold = packetQueue_isFull(&_rxQueue)
+			&& _rxRing_count() + UART_RX_RING_SIZE / 2 + UART_RX_FLOW_SLACK >= UART_RX_RING_SIZE;
+
+	if (hold && !_rxPaused)
+	{
+		CLEAR_BIT(_uartHandle->Instance->CR3, USART_CR3_DMAR);
+		_rxPaused = true;
+	}
+	else if (!hold && _rxPaused)
+	{
+		SET_BIT(_uartHandle->Instance->CR3, USART_CR3_DMAR);
+		_rxPaused = false;
+	}
+}
+#endif
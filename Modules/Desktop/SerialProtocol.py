@@ -3,12 +3,257 @@
 import SerialConnection
 import SerialPacket
 import serial
+import time
 
 
 # Defines message parameters
 HEADER_LENGTH = 4
 MESSAGE_LENGTH = 64
 
+# Defines message framing.  Must match how the MCU was built:  True if built
+# with UART_FRAMING_COBS (variable-length COBS frames), False for fixed-length
+# packets.
+FRAMING_COBS = False
+# Longest COBS frame, with the code, body length and delimiter characters.
+FRAME_LENGTH = MESSAGE_LENGTH + 3
+
+# Defines binary payloads.  Must match how the MCU was built:  True if built with
+# UART_PAYLOAD_BINARY.  Characters are 8-bit, and message bodies are bytes of an
+# explicit length (which may hold null bytes) rather than text.
+PAYLOAD_BINARY = False
+
+# Defines baud rate negotiation.  The rates offered to the MCU in the SYNC
+# message; the MCU answers with the highest one it also supports.
+SUPPORTED_BAUDS = [115200, 230400, 460800, 921600]
+# Characters on the wire per message character (start, data and stop bits).
+BITS_PER_CHARACTER = 10
+# Time, in seconds, allowed for the MCU to respond to a message, beyond the time
+# the response takes on the wire, until the response time is measured.
+RESPONSE_ALLOWANCE = 0.6
+# Time, in seconds, allowed for the rest of a message to arrive once its first
+# character has, beyond the time it takes on the wire (the serial adapter's
+# latency).
+FRAME_ALLOWANCE = 0.05
+# Time, in seconds, close() waits by default for the MCU to confirm the end of
+# the session, before closing the port without it.
+CLOSE_TIMEOUT = 1.0
+# Time, in seconds, the line must be quiet, beyond three characters on the
+# wire, for the MCU to be taken as between messages (the serial adapter's
+# latency in passing on what it received).
+IDLE_ALLOWANCE = 0.005
+
+# Defines adaptive timeouts.  The MCU's response time is estimated from the
+# round trips of the handshake, ECHO messages and, in windowed mode,
+# acknowledgements, as TCP does (RFC 6298), and each timeout is the estimate's
+# RTO plus the frames it covers at the baud rate.  False keeps the response
+# time at RESPONSE_ALLOWANCE.  RTO_MIN and RTO_MAX bound the RTO, in seconds.
+ADAPTIVE_TIMEOUTS = True
+RTO_MIN = 0.02
+RTO_MAX = 2.0
+ECHO_HEADER = 'ECHO'
+
+# Defines the sliding window.  Must match how the MCU was built:  True if built
+# with SESSION_WINDOWED, False for CTS stop-and-wait.  WINDOW_SIZE is the number
+# of messages sent ahead of being acknowledged, and must be no more than the
+# MCU's SESSION_WINDOW_SIZE.
+WINDOWED = False
+WINDOW_SIZE = 4
+# Defines credit-based flow control.  Must match how the MCU was built:  True
+# if built with SESSION_CREDIT.  Messages are sent up to the credit the MCU
+# grants, without waiting for CTS.  Not used together with WINDOWED.
+CREDIT = False
+# Link segment after the header:  sequence number, then the acknowledgement
+# (the sequence number of the next message expected) or the credit (the
+# sequence number messages may be sent up to, but not including).
+LINK_LENGTH = 2
+SEQ_MODULUS = 64
+# Sequence number of a message that only carries an acknowledgement or credit.
+ACK_ONLY = 0x40
+# Sequence number of a handshake message, which the MCU takes out of sequence
+# and without its acknowledgement, as the desktop may be starting over.
+UNSEQUENCED = 0x41
+
+# Defines session resumption.  The MCU issues a token with each handshake; a
+# desktop that lost the connection presents it, with the negotiated baud rate
+# (the session's ticket), in a RESUME_HEADER message to go on with the open
+# session in place of a new handshake.
+RESUME_HEADER = 'RSUM'
+
+
+def _frameTime(baudRate):
+    # Time, in seconds, the longest message takes on the wire at a baud rate.
+    return FRAME_LENGTH * BITS_PER_CHARACTER / baudRate
+
+
+def _clearInput(connection, baudRate):
+    # Discards what has been received, then whatever else arrives until the
+    # line has been quiet for a few characters, so the next message read
+    # starts at the start of a frame rather than in one the MCU was part way
+    # through sending (fixed-length frames have no delimiter to find it by).
+    connection._connection.reset_input_buffer()
+    while connection.waitReceive(IDLE_ALLOWANCE
+            + 3 * BITS_PER_CHARACTER / baudRate):
+        connection._connection.reset_input_buffer()
+
+
+def _headerLength():
+    # Characters before the body:  the header, and the link segment in windowed
+    # or credit mode.  The link characters are kept in the packet's header text.
+    return HEADER_LENGTH + (LINK_LENGTH if WINDOWED or CREDIT else 0)
+
+
+def _packet(commandStr, dataStr, seq=0, ack=0):
+    # Creates a SerialPacket object for a command and data, with a link segment
+    # holding the sequence number and acknowledgement in windowed or credit
+    # mode.
+    if WINDOWED or CREDIT:
+        commandStr += chr(seq) + chr(ack)
+    return SerialPacket.SerialPacket(MESSAGE_LENGTH, _headerLength(),
+        commandStr, dataStr)
+
+
+def _sendMessage(connection, message):
+    # Sends a SerialPacket object over the connection in the framing the MCU
+    # was built for.
+    if FRAMING_COBS:
+        connection.send(message.formatFrame())
+    elif PAYLOAD_BINARY:
+        connection.send(message.formatBinary())
+    else:
+        connection.send(message.format())
+
+
+def _receiveMessage(connection, timeout):
+    # Receives a message from the connection in the framing the MCU was built
+    # for, and returns it as a fixed-length packet string (with the body length
+    # for binary payloads).  The message must start within timeout seconds, and
+    # the rest of it is then read within the connection's read timeout.  If
+    # nothing or a malformed frame is received, the characters received are
+    # returned as is.
+    if not connection.waitReceive(timeout):
+        return ''
+    if FRAMING_COBS:
+        received = connection.receiveUntil(SerialPacket.FRAME_DELIMITER,
+            FRAME_LENGTH)
+        try:
+            packet = SerialPacket.parseFrame(MESSAGE_LENGTH, _headerLength(),
+                received, PAYLOAD_BINARY)
+        except ValueError:
+            return received
+        return packet.formatBinary() if PAYLOAD_BINARY else packet.format()
+    else:
+        return connection.receive(MESSAGE_LENGTH)
+
+
+def _parsePacket(packetString):
+    # Parses a fixed-length packet string from _receiveMessage() into a
+    # SerialPacket object.
+    #
+    # Raises a ValueError if the packet is malformed.
+    if PAYLOAD_BINARY:
+        return SerialPacket.parseBinary(MESSAGE_LENGTH, _headerLength(),
+            packetString)
+    return SerialPacket.SerialPacket(MESSAGE_LENGTH, _headerLength(),
+        packetString)
+
+
+def _segments(packetString):
+    # Splits a fixed-length packet string from _receiveMessage() into its
+    # command and data segments.  Binary data is returned as bytes of the
+    # length sent, or empty if the packet is malformed.
+    if PAYLOAD_BINARY:
+        try:
+            bodyText = _parsePacket(packetString)._bodyText
+        except ValueError:
+            bodyText = ''
+        return packetString[:HEADER_LENGTH], \
+            bodyText.encode(SerialConnection.BINARY_ENCODING)
+    return packetString[:HEADER_LENGTH], packetString[_headerLength():]
+
+
+class RoundTripEstimator:
+    # Estimates the MCU's response time from measured round trips (with the
+    # time on the wire taken out):  a smoothed round-trip time (SRTT) and its
+    # variation (RTTVAR), from which a timeout (RTO) is taken as SRTT plus four
+    # times RTTVAR, bounded by RTO_MIN and RTO_MAX.  A timeout that expires
+    # doubles the RTO until the next sample.  Samples must not be taken from
+    # messages that were resent (Karn's algorithm), as which send was answered
+    # is not known.
+
+    def __init__(self):
+        # No estimate until the first sample, and RESPONSE_ALLOWANCE until
+        # then.
+        self.srtt = None
+        self.rttvar = None
+        self.rto = RESPONSE_ALLOWANCE
+        self.samples = 0
+
+
+    def sample(self, roundTrip):
+        # Adds a round trip, in seconds, to the estimate.  The first sets SRTT
+        # to it and RTTVAR to half of it.  Ignored unless ADAPTIVE_TIMEOUTS.
+        if not ADAPTIVE_TIMEOUTS:
+            return
+        roundTrip = max(roundTrip, 0.0)
+        if self.srtt is None:
+            self.srtt = roundTrip
+            self.rttvar = roundTrip / 2
+        else:
+            self.rttvar = 0.75 * self.rttvar + 0.25 * abs(self.srtt - roundTrip)
+            self.srtt = 0.875 * self.srtt + 0.125 * roundTrip
+        self.samples += 1
+        self.rto = min(max(self.srtt + 4 * self.rttvar, RTO_MIN), RTO_MAX)
+
+
+    def backoff(self):
+        # Doubles the RTO after it expired.  Ignored unless ADAPTIVE_TIMEOUTS.
+        if ADAPTIVE_TIMEOUTS:
+            self.rto = min(self.rto * 2, RTO_MAX)
+
+
+def _resumeSession(connection, ticket, rtt):
+    # Presents a session's ticket, (token, baud rate), to the MCU at the
+    # ticket's baud rate.  Returns the sequence numbers the MCU goes on from:
+    # the oldest message it has not had acknowledged (or the next it sends, in
+    # credit mode) and the next it expects, and the acknowledgement or credit
+    # its reply carries, or None if the MCU did not take the session up.  The
+    # connection is returned to the default baud rate if not.
+    token, baudRate = ticket
+    if baudRate != SerialConnection.DEFAULT_BAUD:
+        connection.setBaudRate(baudRate, FRAME_ALLOWANCE + _frameTime(baudRate))
+    connection._connection.reset_output_buffer()
+    _clearInput(connection, baudRate)
+
+    # The RSUM and its reply are a round trip.  Messages the MCU sends in the
+    # meantime (a CTS, or messages being resent) are passed over, and a DISC
+    # is the MCU closing a session it does not take up.
+    started = time.monotonic()
+    deadline = started + RESPONSE_ALLOWANCE + _frameTime(baudRate)
+    _sendMessage(connection, _packet(RESUME_HEADER, token, UNSEQUENCED, 0))
+    while True:
+        received = _receiveMessage(connection,
+            max(deadline - time.monotonic(), 0))
+        try:
+            reply = _parsePacket(received)
+        except ValueError:
+            reply = None
+            if received != '':
+                continue
+        if reply is None or reply._headerText[:HEADER_LENGTH] == 'DISC':
+            connection.setBaudRate(SerialConnection.DEFAULT_BAUD,
+                SerialConnection.DEFAULT_READ_TIMEOUT)
+            return None
+        if reply._headerText[:HEADER_LENGTH] == RESUME_HEADER:
+            break
+    rtt.sample(time.monotonic() - started - 2 * _frameTime(baudRate))
+
+    # The sequence numbers, in windowed or credit mode.
+    fields = reply._bodyText.split()
+    if not (WINDOWED or CREDIT):
+        return 0, 0, 0
+    return int(fields[0]), int(fields[1]), \
+        ord(reply._headerText[HEADER_LENGTH + 1])
+
 
 class SerialProtocol:
     # 
@@ -16,78 +261,190 @@ class SerialProtocol:
     # connection object
     _connection = None
 
-
-    def __new__(cls, port):
+    # Sliding window state (windowed mode only).
+    # sequence number of the next message sent
+    _txSeq = 0
+    # sent messages not yet acknowledged, oldest first, as (seq, packet)
+    _unacked = None
+    # time the oldest unacknowledged message was last acknowledged or sent
+    _txProgressTime = 0
+    # sequence number of the next message expected from the MCU
+    _rxExpected = 0
+    # acknowledgement last sent to the MCU
+    _rxAckSent = 0
+    # sequence number of the message timed to its acknowledgement, or None
+    _timedSeq = None
+    # time the message timed was sent
+    _timedTime = 0
+
+    # Credit state (credit mode only).
+    # sequence number messages may be sent up to, or None until granted
+    _creditLimit = None
+
+    # Round-trip time estimate, which the timeouts are taken from.
+    _rtt = None
+    # token the MCU issued for the session
+    _token = None
+    # flag for the session being over, closed by either side
+    _closed = False
+    # flag for close() waiting on the MCU's confirmation
+    _closing = False
+    # time the ECHO timed was sent, or None
+    _echoTime = None
+
+
+    def __new__(cls, port, rtscts=False, ticket=None):
         # Attempts to open a connection on the port provided.  If successful,
         # a SerialProtocol object is created.  If not, an exception is thrown.
+        # If rtscts is True, hardware RTS/CTS flow control is used in place of
+        # CTS messages; the MCU must be built with UART_HW_FLOW_CONTROL.  If a
+        # ticket from an earlier object's ticket() is given, the session it
+        # was for is resumed, if the MCU still has it open, in place of a
+        # handshake.
+
+        def _switch_baud_rate(connection, baudRate):
+            # Switches to the baud rate chosen by the MCU, then confirms it by
+            # sending a BAUD message that the MCU sends back.  Falls back to
+            # the default baud rate (as does the MCU) if the confirmation is
+            # not received.
+
+            # Let the last message at the old rate leave the serial adapter.
+            time.sleep(_frameTime(SerialConnection.DEFAULT_BAUD) + 0.01)
+
+            # Switch, with the read timeout following the new rate.
+            if baudRate in SUPPORTED_BAUDS:
+                connection.setBaudRate(baudRate,
+                    FRAME_ALLOWANCE + _frameTime(baudRate))
+                connection._connection.reset_input_buffer()
+
+                # First exchange at the new rate, a round trip.  It is given
+                # the full allowance, as the MCU stays at the new rate if it
+                # answers too late.
+                started = time.monotonic()
+                _sendMessage(connection, _packet('BAUD', ''))
+                if _receiveMessage(connection, RESPONSE_ALLOWANCE
+                    + _frameTime(baudRate))[:HEADER_LENGTH] == 'BAUD':
+                    rtt.sample(time.monotonic() - started
+                        - 2 * _frameTime(baudRate))
+                    return True
+
+            # Fall back to the default baud rate.
+            print('Baud rate switch to {} failed.'.format(baudRate))
+            connection.setBaudRate(SerialConnection.DEFAULT_BAUD,
+                SerialConnection.DEFAULT_READ_TIMEOUT)
+            return False
 
         def _connect_handshake(connection):
             # 
 
             # clear send and receive buffers before trying handshake
-            connection._connection.reset_input_buffer()
             connection._connection.reset_output_buffer()
+            _clearInput(connection, SerialConnection.DEFAULT_BAUD)
 
-            # compose acknowledge message
-            synMessage = SerialPacket.SerialPacket(MESSAGE_LENGTH, 
-                HEADER_LENGTH, 'SYNC', '')
-            sendData = synMessage.format()
+            # compose sync message, offering the supported baud rates
+            synMessage = _packet('SYNC',
+                ','.join(str(rate) for rate in SUPPORTED_BAUDS), UNSEQUENCED)
             
             # send acknowledge message
-            connection.send(sendData)
+            started = time.monotonic()
+            _sendMessage(connection, synMessage)
             # print(connection._connection.out_waiting)
             
-            # listen for echo back
-            receivedData = connection.receive(MESSAGE_LENGTH)
-            try:
-                synackMessage = SerialPacket.SerialPacket(MESSAGE_LENGTH, 
-                    HEADER_LENGTH, receivedData)
-            except ValueError:
-                # Note: a value error can be thrown for several reasons while
-                # parsing a message string into a packet object.  This case,
-                # it can only happen when not enough characters were received
-                # from the MCU.  It is likely that the MCU is unresponsive to
-                # the SYNC message sent and did not respond with the proper
-                # ACKN message.
-                print('Malformed packet or no packet was received.')
-                return False
-
-            # test that received message is an acknowledge message
-            ackMessage = SerialPacket.SerialPacket(MESSAGE_LENGTH, 
-                HEADER_LENGTH, 'ACKN', '')
-            if synackMessage == ackMessage:
+            # listen for echo back.  Messages of a session the MCU still has
+            # open (such as a CTS) are passed over, and a DISC is the MCU
+            # closing that session, after which the SYNC is sent again.
+            deadline = started + RESPONSE_ALLOWANCE \
+                + _frameTime(SerialConnection.DEFAULT_BAUD)
+            resent = False
+            while True:
+                receivedData = _receiveMessage(connection,
+                    max(deadline - time.monotonic(), 0))
+                try:
+                    synackMessage = _parsePacket(receivedData)
+                except ValueError:
+                    # Note: a value error can be thrown for several reasons
+                    # while parsing a message string into a packet object.
+                    # Characters received are passed over.  Otherwise, it is
+                    # likely that the MCU is unresponsive to the SYNC message
+                    # sent and did not respond with the proper ACKN message.
+                    if receivedData != '':
+                        continue
+                    print('Malformed packet or no packet was received.')
+                    return None
+                header = synackMessage._headerText[:HEADER_LENGTH]
+                if header == 'ACKN':
+                    break
+                if header == 'DISC' and not resent:
+                    resent = True
+                    started = time.monotonic()
+                    deadline = started + RESPONSE_ALLOWANCE \
+                        + _frameTime(SerialConnection.DEFAULT_BAUD)
+                    _sendMessage(connection, synMessage)
+
+            # test that received message is an acknowledge message, which
+            # holds the session's token, then the baud rate chosen by the MCU
+            # (or nothing to stay at the default rate)
+            if synackMessage._headerText[:HEADER_LENGTH] == 'ACKN':
+                # the SYNC and ACKN were a round trip
+                rtt.sample(time.monotonic() - started
+                    - 2 * _frameTime(SerialConnection.DEFAULT_BAUD))
+
                 # compose synack message
-                synackMessage = SerialPacket.SerialPacket(MESSAGE_LENGTH,
-                    HEADER_LENGTH, 'SYNA', '')
-                sendData = synackMessage.format()
+                fields = synackMessage._bodyText.split()
+                token = fields[0] if fields else ''
+                chosenBaud = fields[1] if len(fields) > 1 else ''
+                synackMessage = _packet('SYNA', '')
 
                 # send synack message
-                connection.send(sendData)
+                _sendMessage(connection, synackMessage)
 
-                # return successful handshake
-                return True
+                # switch to the chosen baud rate
+                if chosenBaud != '':
+                    _switch_baud_rate(connection,
+                        int(chosenBaud) if chosenBaud.isdigit() else 0)
+
+                # return successful handshake, with the token
+                return token
 
             else:
                 # return handshake unsuccessful
-                return False
+                return None
 
         # Check port parameter.
         if not isinstance(port, str): raise TypeError
 
         # Create new UART Connection on port.
         # print('  ::CONNECTING::  Port ' + port)
-        tempConnection = SerialConnection.SerialConnection()
+        tempConnection = SerialConnection.SerialConnection(rtscts,
+            PAYLOAD_BINARY)
 
         # Attempt to open port.  If opening is unsuccessful, a
         # serial.SerialException is thrown.
         tempConnection.openPort(port)
 
-        # Attempt handshake with port.  If handshake successful, then create 
-        # object.
-        if _connect_handshake(tempConnection):
+        # Attempt to resume the ticket's session, or else handshake with
+        # port, measuring the round trips.  If either is successful, then
+        # create object.
+        rtt = RoundTripEstimator()
+        resumed = _resumeSession(tempConnection, ticket, rtt) \
+            if ticket is not None else None
+        token = ticket[0] if resumed is not None \
+            else _connect_handshake(tempConnection)
+        if token is not None:
             instance = super().__new__(cls)
-            instance.__init__(port)
+            instance.__init__(port, rtscts, ticket)
             instance._connection = tempConnection
+            instance._unacked = []
+            instance._txProgressTime = time.monotonic()
+            instance._creditLimit = None
+            instance._rtt = rtt
+            instance._timedSeq = None
+            instance._echoTime = None
+            instance._token = token
+            if resumed is not None:
+                instance._txSeq = resumed[1]
+                instance._rxExpected = resumed[0]
+                instance._goOn(*resumed)
             return instance
 
         # If handshake unsuccessful, return None.
@@ -95,37 +452,94 @@ class SerialProtocol:
             return None
 
 
-    def __init__(self, port):
+    def __init__(self, port, rtscts=False, ticket=None):
         # All initialization was performed in __new__().
         pass
 
 
     def __del__(self):
-        # 
-
-        def _disconnect_handshake(connection):
-            #
-
-            print('  ::DISCONNECTING::  Port ' + connection._connection.port)
-
-            # Clear send and receive buffers before trying handshake.
-            connection._connection.reset_input_buffer()
-            connection._connection.reset_output_buffer()
-
-            # Wait for CTS.
-            while self.receive()[0] != 'CTS\0':
-                pass
-
-            # Send disconnection command
+        # Closes the session, if it is still open, and the port, as close()
+        # does.
+        if self._connection is not None:
+            self.close()
+
+
+    def __enter__(self):
+        # Returns the object, whose session is closed on leaving the with
+        # statement.
+        return self
+
+
+    def __exit__(self, excType, excValue, traceback):
+        # Closes the session and the port, as close() does.
+        self.close()
+        return False
+
+
+    def close(self, timeout=CLOSE_TIMEOUT):
+        # Closes the session with the disconnection handshake, then the port,
+        # returning within timeout seconds (and the read of a message begun by
+        # then) whether or not the MCU answered.
+        # The DISC is sent once the MCU can take it (a CTS, or room in the
+        # window or credit), and the MCU answers with a DISC (or sends its own,
+        # closing the session at the same time).  Messages received meanwhile
+        # are dropped.  Returns True if the MCU confirmed, or closed the
+        # session itself, and False if not.  Once closed, does nothing more.
+
+        port = self._connection._connection
+
+        def _receive_by(deadline):
+            # Receives a message that starts by the deadline, and returns its
+            # header.  The port's read timeout is left as it is, so a message
+            # begun by then is read whole.
+            return self.receive(max(deadline - time.monotonic(), 0))[0]
+
+        def _disconnect_handshake(deadline):
+            # Sends the DISC and waits for the answer, until the deadline.
+            # Returns if answered.
+
+            # In windowed or credit mode, or with hardware flow control, send
+            # the disconnection command once the window has room (or credit is
+            # granted).  Otherwise, wait for a CTS.
+            if WINDOWED or CREDIT or self.hardwareFlowControl():
+                while not self.windowOpen():
+                    if time.monotonic() >= deadline:
+                        return False
+                    if _receive_by(deadline) == 'DISC':
+                        return True
+            else:
+                while True:
+                    if time.monotonic() >= deadline:
+                        return False
+                    header = _receive_by(deadline)
+                    if header == 'DISC':
+                        return True
+                    if header == 'CTS\0':
+                        break
+
+            # Send disconnection command, and wait for it to be answered.
             self.send('DISC', '')
+            while time.monotonic() < deadline:
+                if _receive_by(deadline) == 'DISC':
+                    return True
+            return False
+
+        if not port.is_open:
+            return self._closed
+        confirmed = True
+        if not self._closed:
+            print('  ::DISCONNECTING::  Port ' + port.port)
+            self._closing = True
+            confirmed = _disconnect_handshake(time.monotonic() + timeout)
+            self._closing = False
+            self._closed = True
+        self._connection.closePort()
+        return confirmed
 
-            # Wait for disconnection acknowledgement
-            while self.receive()[0] != 'DISC':
-                pass
 
-        # close connection
-        _disconnect_handshake(self._connection)
-        self._connection.closePort()
+    def closed(self):
+        # Returns if the session is over, closed by close() or by the MCU.
+        return self._closed
 
 
     def send(self, commandStr, dataStr):
@@ -134,29 +548,254 @@ class SerialProtocol:
         # Test command is of valid type.
         if not isinstance(commandStr, str): raise TypeError
 
-        # Test that data is of valid type.
+        # Test that data is of valid type.  Binary data may be given as bytes,
+        # which are sent as the characters of the same codes.
+        if PAYLOAD_BINARY and isinstance(dataStr, (bytes, bytearray)):
+            dataStr = bytes(dataStr).decode(SerialConnection.BINARY_ENCODING)
         if not isinstance(dataStr, str): raise TypeError
 
-        message = SerialPacket.SerialPacket(
-            MESSAGE_LENGTH, HEADER_LENGTH, commandStr, dataStr)
-        self._connection.send(message.format())
-        
+        # In windowed mode, stamp the message with the next sequence number
+        # and the acknowledgement, and keep it until it is acknowledged.
+        if WINDOWED:
+            message = _packet(commandStr, dataStr, self._txSeq,
+                self._rxExpected)
+            if not self._unacked:
+                self._txProgressTime = time.monotonic()
+            if self._timedSeq is None:
+                self._timedSeq = self._txSeq
+                self._timedTime = time.monotonic()
+            self._unacked.append((self._txSeq, message))
+            self._txSeq = (self._txSeq + 1) % SEQ_MODULUS
+            self._rxAckSent = self._rxExpected
+        # In credit mode, stamp the message with the next sequence number,
+        # using up one credit.
+        elif CREDIT:
+            message = _packet(commandStr, dataStr, self._txSeq, 0)
+            self._txSeq = (self._txSeq + 1) % SEQ_MODULUS
+        else:
+            message = _packet(commandStr, dataStr)
+
+        # Time an ECHO to its reply, one at a time (an ECHO not answered
+        # within the longest RTO is taken as lost).
+        if commandStr == ECHO_HEADER and (self._echoTime is None
+            or time.monotonic() - self._echoTime > RTO_MAX):
+            self._echoTime = time.monotonic()
+        _sendMessage(self._connection, message)
+
+
+    def ticket(self):
+        # Returns the session's ticket, (token, baud rate), which resumes the
+        # session if the connection is lost:  given to resume(), or to a new
+        # object (such as in a restarted desktop application) while the MCU
+        # still has the session open.
+        return self._token, self._connection._connection.baudrate
+
+
+    def resume(self):
+        # Reopens the port and resumes the session after the connection was
+        # lost (such as the serial adapter being unplugged), keeping the
+        # messages not yet acknowledged.  Returns True if the MCU took the
+        # session up, or False if the session is over (a new object must then
+        # be made).
+        #
+        # Raises a serial.SerialException if reopening the port fails.
+        ticket = self.ticket()
+        port = self._connection._connection.port
+        self._connection.closePort()
 
-    def receive(self):
+        # A new connection, as the adapter may have come back as a new device.
+        self._connection = SerialConnection.SerialConnection(
+            self.hardwareFlowControl(), PAYLOAD_BINARY)
+        self._connection.openPort(port)
+        resumed = _resumeSession(self._connection, ticket, self._rtt)
+        if resumed is None:
+            return False
+        self._goOn(*resumed)
+        return True
+
+
+    def _goOn(self, mcuNext, mcuExpected, ack):
+        # Takes up where the MCU goes on from, from its reply to a resumption.
+        # In windowed mode, the messages it has received are dropped from the
+        # unacknowledged list and the rest are sent again.  The MCU sends again
+        # the messages it has not had acknowledged, and those already received
+        # are dropped as out of sequence and acknowledged.
+        if WINDOWED:
+            self._timedSeq = None
+            self._echoTime = None
+            self._takeAck(mcuExpected)
+            self._rxAckSent = None
+            self.sendAck()
+            for _, message in self._unacked:
+                _sendMessage(self._connection, message)
+            self._txProgressTime = time.monotonic()
+        elif CREDIT:
+            self._txSeq = mcuExpected
+            self._creditLimit = ack
+
+
+    def roundTrip(self):
+        # Returns the estimate of the MCU's response time that the timeouts
+        # are taken from:  SRTT, RTTVAR (both None before the first sample)
+        # and RTO, in seconds.
+        return self._rtt.srtt, self._rtt.rttvar, self._rtt.rto
+
+
+    def _frameTimeNow(self):
+        # Time, in seconds, the longest message takes on the wire at the
+        # current baud rate.
+        return _frameTime(self._connection._connection.baudrate)
+
+
+    def _responseTimeout(self):
+        # Time, in seconds, to wait for a message from the MCU:  its response
+        # time and the message on the wire.
+        return self._rtt.rto + self._frameTimeNow()
+
+
+    def _sampleRoundTrip(self, started):
+        # Takes the time since an exchange started, less its two messages on
+        # the wire, as a round-trip sample.
+        self._rtt.sample(time.monotonic() - started - 2 * self._frameTimeNow())
+
+
+    def _segments(self, packetString):
+        # Splits a received packet string into its command and data segments,
+        # taking the round trip of a timed ECHO from its reply.
+        segments = _segments(packetString)
+        if segments[0] == ECHO_HEADER and self._echoTime is not None:
+            self._sampleRoundTrip(self._echoTime)
+            self._echoTime = None
+        return segments
+
+
+    def hardwareFlowControl(self):
+        # Returns if hardware RTS/CTS flow control is used in place of CTS
+        # messages.
+        return self._connection.hardwareFlowControl()
+
+
+    def windowOpen(self):
+        # Returns if a message can be sent without waiting for an
+        # acknowledgement (or credit).  Always true outside of windowed and
+        # credit modes.
+        if WINDOWED:
+            return len(self._unacked) < WINDOW_SIZE
+        elif CREDIT:
+            return self._creditLimit is not None \
+                and 0 < (self._creditLimit - self._txSeq) % SEQ_MODULUS \
+                < SEQ_MODULUS // 2
+        else:
+            return True
+
+
+    def sendAck(self):
+        # Acknowledges the messages received, in windowed mode, if no message
+        # sent since has carried the acknowledgement.
+        if WINDOWED and self._rxAckSent != self._rxExpected:
+            _sendMessage(self._connection,
+                _packet('ACK\0', '', ACK_ONLY, self._rxExpected))
+            self._rxAckSent = self._rxExpected
+
+
+    def _takeAck(self, ack):
+        # Drops the messages an acknowledgement covers from the unacknowledged
+        # list.  Acknowledgements outside the window are stale and ignored.
+        # The message timed, once acknowledged, is a round-trip sample.
+        count = (ack - self._unacked[0][0]) % SEQ_MODULUS \
+            if self._unacked else 0
+        if 0 < count <= len(self._unacked):
+            if self._timedSeq is not None and \
+                (self._timedSeq - self._unacked[0][0]) % SEQ_MODULUS < count:
+                self._sampleRoundTrip(self._timedTime)
+                self._timedSeq = None
+            del self._unacked[:count]
+            self._txProgressTime = time.monotonic()
+
+
+    def _resend(self):
+        # Resends every unacknowledged message, oldest first (go-back-N), if
+        # none has been acknowledged within the MCU's response time and a
+        # window of messages each way.  Resending drops the timings, as the
+        # answers could then be to either send, and backs the RTO off.
+        timeout = self._rtt.rto + 2 * WINDOW_SIZE * self._frameTimeNow()
+        if self._unacked and time.monotonic() - self._txProgressTime > timeout:
+            for _, message in self._unacked:
+                _sendMessage(self._connection, message)
+            self._txProgressTime = time.monotonic()
+            self._timedSeq = None
+            self._echoTime = None
+            self._rtt.backoff()
+
+
+    def receive(self, timeout=None):
+        # Receives a message from the MCU, waiting timeout seconds for it to
+        # start (the MCU's response timeout if None), and returns its command
+        # and data segments.  A DISC from the MCU, which is closing the
+        # session, is answered with a DACK, and the session is then closed.
+        segments = self._receive(self._responseTimeout() if timeout is None
+            else timeout)
+        if segments[0] == 'DISC' and not (self._closing or self._closed):
+            _sendMessage(self._connection, _packet('DACK', '', UNSEQUENCED))
+            self._closed = True
+        return segments
+
+
+    def _receive(self, timeout):
         # 
 
+        # In windowed mode, take the acknowledgement every message carries and
+        # return the next message in sequence.  Acknowledgement-only messages
+        # and messages out of sequence are not returned; out of sequence ones
+        # are acknowledged again so the MCU resends from the right place.  If
+        # nothing is received, unacknowledged messages may be resent.  Empty
+        # segments are returned when no message is returned.
+        if WINDOWED:
+            tempMessage = _receiveMessage(self._connection, timeout)
+            if len(tempMessage) != MESSAGE_LENGTH:
+                self._resend()
+                return '', ''
+            seq = ord(tempMessage[HEADER_LENGTH])
+            self._takeAck(ord(tempMessage[HEADER_LENGTH + 1]))
+            # A DISC ends the session whatever its sequence number, as the MCU
+            # gives up on what was not acknowledged when closing.
+            if tempMessage[:HEADER_LENGTH] == 'DISC':
+                return self._segments(tempMessage)
+            if seq == self._rxExpected:
+                self._rxExpected = (self._rxExpected + 1) % SEQ_MODULUS
+                if (self._rxExpected - self._rxAckSent) % SEQ_MODULUS \
+                    >= max(WINDOW_SIZE // 2, 1):
+                    self.sendAck()
+                return self._segments(tempMessage)
+            elif seq != ACK_ONLY:
+                self._rxAckSent = None
+                self.sendAck()
+            return '', ''
+
+        # In credit mode, take the credit every message carries.  Credit-only
+        # messages are not returned, and empty segments are returned instead.
+        if CREDIT:
+            tempMessage = _receiveMessage(self._connection, timeout)
+            if len(tempMessage) != MESSAGE_LENGTH:
+                return '', ''
+            self._creditLimit = ord(tempMessage[HEADER_LENGTH + 1])
+            if ord(tempMessage[HEADER_LENGTH]) == ACK_ONLY:
+                return '', ''
+            return self._segments(tempMessage)
+
         # Receive message from MCU.
-        tempMessage = self._connection.receive(MESSAGE_LENGTH)
+        tempMessage = _receiveMessage(self._connection, timeout)
 
         # Return message parsed into command and data segments.
-        return tempMessage[:HEADER_LENGTH], tempMessage[HEADER_LENGTH:]
+        return self._segments(tempMessage)
 
 
     def receive_raw_noNull_noWhitespace(self):
         # 
 
         # Receive message from MCU.
-        tempMessage = self._connection.receive(MESSAGE_LENGTH)
+        tempMessage = _receiveMessage(self._connection,
+            self._responseTimeout())
 
         # Return message parsed into command and data segments.
         return tempMessage.replace('\0', '\\0').replace('\t', '\\t')\
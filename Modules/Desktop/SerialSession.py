@@ -1,10 +1,112 @@
 # Author: Kevin Imlay
 
+import SerialConnection
+import SerialPacket
 import SerialProtocol
 import queue
+import struct
+import time
 
 # Define session parameters.
 NUM_HANDSHAKE_ATTEMTPS = 3
+# Time, in seconds, to wait for the MCU to answer a session command.
+COMMAND_TIMEOUT = 5.0
+# Layout of the STAT command's answer (see desktop_app_session.h), the bytes
+# once unpacked from 7-bit characters.
+STAT_VERSION = 1
+STAT_LAYOUT = '<B4I15H2B'
+STAT_COUNTERS = ('txPackets', 'rxPackets', 'txBytes', 'rxBytes',
+	'rxMalformed', 'rxNoise', 'rxRestarts', 'errOverrun', 'errFraming',
+	'errNoise', 'errParity', 'errDma', 'handshakes', 'handshakeFailures',
+	'sessions', 'timeouts', 'resends', 'outOfSequence', 'dropped')
+# Layout of the TRAC command's entries (see event_trace.h), and the names of
+# the events and their arguments.
+TRACE_VERSION = 1
+TRACE_ENTRY = '<IBBH'
+TRACE_EVENTS = (None, 'tx queue', 'tx start', 'tx done', 'tx rewind',
+	'rx frame', 'rx discard', 'uart error', 'dispatch', 'deliver', 'session',
+	'timeout')
+TRACE_LANES = ('bulk', 'urgent', 'control')
+TRACE_DISCARDS = ('malformed', 'too long', 'noise')
+TRACE_STATES = ('closed', 'acknowledged', 'switching', 'confirming', 'open',
+	'closing', 'draining', 'stopping')
+
+
+def printProfile(stages, unit):
+	# Prints the stage times returned by STM32SerialCom.profile() as a table.
+	print('{:<10}  {:>8}  {:>10}  {:>10}  {:>10}  ({})'.format('stage',
+		'count', 'min', 'max', 'mean', unit))
+	for name, count, minimum, maximum, mean in stages:
+		print('{:<10}  {:>8}  {:>10}  {:>10}  {:>10}'.format(name, count,
+			minimum, maximum, mean))
+
+
+def printStats(stats):
+	# Prints the counts returned by STM32SerialCom.stats(), one to a line.
+	for name, value in stats.items():
+		print('{:<18}  {:>10}'.format(name, value))
+
+
+def _traceHeader(value):
+	# The first two characters of a header, as a trace entry carries them.
+	return ''.join(chr(c) if 0x20 <= c < 0x7F else '.'
+		for c in (value & 0xFF, value >> 8))
+
+
+def _traceDetail(event, arg, value):
+	# Describes a trace entry's arguments.
+	name = TRACE_EVENTS[event] if event < len(TRACE_EVENTS) else None
+	lane = TRACE_LANES[arg] if arg < len(TRACE_LANES) else str(arg)
+	if name == 'tx queue':
+		return '{} {}'.format(lane, _traceHeader(value))
+	if name == 'tx start':
+		return '{} {} bytes'.format(lane, value)
+	if name == 'tx done':
+		return lane
+	if name == 'tx rewind':
+		return '{} sent'.format(value)
+	if name == 'rx frame':
+		return '{} length {}'.format(_traceHeader(value), arg)
+	if name == 'rx discard':
+		reason = TRACE_DISCARDS[arg] if arg < len(TRACE_DISCARDS) else str(arg)
+		return '{} {} bytes'.format(reason, value)
+	if name == 'uart error':
+		return 'code 0x{:02X}'.format(value)
+	if name == 'dispatch':
+		return '{} {}'.format(_traceHeader(value),
+			'handled' if arg else 'to application')
+	if name == 'deliver':
+		return _traceHeader(value)
+	if name == 'session':
+		return TRACE_STATES[arg] if arg < len(TRACE_STATES) else str(arg)
+	if name == 'timeout':
+		return ''
+	return '{} {}'.format(arg, value)
+
+
+def printTrace(trace, clockHz=None):
+	# Prints the entries returned by STM32SerialCom.trace() as a timeline:  the
+	# time since the first entry, the time since the previous one, the event
+	# and its arguments.  Times in cycles are converted to microseconds if the
+	# core's clock is given in Hz, and times in ns always are.
+	entries, unit, lost = trace
+	if unit == 'ns':
+		scale, unit = 1e-3, 'us'
+	elif clockHz:
+		scale, unit = 1e6 / clockHz, 'us'
+	else:
+		scale = 1
+	if lost:
+		print('({} earlier entries overwritten)'.format(lost))
+	print('{:>12}  {:>10}  {:<10}  ({})'.format('time', 'delta', 'event', unit))
+	previous = entries[0][0] if entries else 0
+	for time, event, arg, value in entries:
+		name = TRACE_EVENTS[event] if event < len(TRACE_EVENTS) else None
+		print('{:>12.1f}  {:>10.1f}  {:<10}  {}'.format(time * scale,
+			(time - previous) * scale, name or '?{}'.format(event),
+			_traceDetail(event, arg, value)))
+		previous = time
+
 
 class STM32SerialCom:
 	# STM32 Serial Communication maps actions on the application level to
@@ -16,35 +118,91 @@ class STM32SerialCom:
 	_outMessageQueue = queue.Queue(maxsize = 0)
 
 
-	def __new__(cls, port):
-		# Attempt to open connection on port.
+	def __new__(cls, port, rtscts=False, ticket=None):
+		# Attempt to open connection on port.  If rtscts is True, hardware
+		# RTS/CTS flow control is used in place of CTS messages.  If a ticket
+		# from an earlier session's ticket() is given (such as one saved by
+		# the application before it was restarted), the session is resumed
+		# if the MCU still has it open, and handshakes are attempted if not.
 		tempStm32McuConnection = None
 		for attempt_num in range(1, NUM_HANDSHAKE_ATTEMTPS + 1):
-			tempStm32McuConnection = SerialProtocol.SerialProtocol(port)
+			tempStm32McuConnection = SerialProtocol.SerialProtocol(port, rtscts,
+				ticket if attempt_num == 1 else None)
 			if tempStm32McuConnection is not None:
 				break
 
 		# Check if connection was opened.
 		if tempStm32McuConnection is not None:
 			instance = super().__new__(cls)
-			instance.__init__(port)
+			instance.__init__(port, rtscts, ticket)
 			instance._connection = tempStm32McuConnection
 			return instance
 		else:
 			return None
 
 
-	def __init__(self, port):
+	def __init__(self, port, rtscts=False, ticket=None):
 		# All initialization was performed in __new__().
 		pass
 
 
 	def __del__(self):
-		# Deleting connection object will perform disconnection handshake
-		# and close the connection.
-		del self._connection
+		# Deleting the object performs the disconnection handshake, if the
+		# session is still open, and closes the connection.
+		self.close()
+
+	def __enter__(self):
+		# Returns the object, whose session is closed on leaving the with
+		# statement.
+		return self
+
+	def __exit__(self, excType, excValue, traceback):
+		# Closes the session and the connection, as close() does.
+		self.close()
+		return False
+
+	def close(self, timeout=SerialProtocol.CLOSE_TIMEOUT):
+		# Closes the session with the disconnection handshake, and the
+		# connection, within timeout seconds.  Messages still in the out
+		# message queue are not sent.  Returns True if the MCU confirmed (or
+		# closed the session itself), and False if not.
+		return self._connection.close(timeout)
+
+	def closed(self):
+		# Returns if the session is over, closed by close() or by the MCU
+		# (desktopAppSession_stop()).  Updates then send nothing more.
+		return self._connection.closed()
 
 	def update(self):
+		# Nothing is sent or received once the session is over.
+		if self._connection.closed():
+			return
+
+		# In windowed or credit mode, or with hardware flow control, no CTS is
+		# waited for.  Messages are sent while the window has room (or credit
+		# is granted), receiving (which takes acknowledgements or credit, and
+		# resends on timeout) while it is not.  With hardware flow control
+		# the window is always open, and the serial port holds sending while
+		# the MCU deasserts RTS.
+		if SerialProtocol.WINDOWED or SerialProtocol.CREDIT \
+			or self._connection.hardwareFlowControl():
+			while self._connection._connection._connection.in_waiting > 0:
+				tempInMessage = self._connection.receive()
+				if tempInMessage[0] != '':
+					self._inMessageQueue.put(tempInMessage)
+			while not self._outMessageQueue.empty():
+				while not self._connection.windowOpen():
+					tempInMessage = self._connection.receive()
+					if tempInMessage[0] != '':
+						self._inMessageQueue.put(tempInMessage)
+					if self._connection.closed():
+						return
+				tempOutMessage = self._outMessageQueue.get()
+				print('  ::SENDING::  {}{}'.format(*tempOutMessage))
+				self._connection.send(tempOutMessage[0], tempOutMessage[1])
+			self._connection.sendAck()
+			return
+
 		# Empty any received messages into the inMessageQueue to process.
 		# This will disreguard any CTS messages sent while the desktop
 		# application was not in a state to send anything, will store non-CTS
@@ -65,9 +223,161 @@ class STM32SerialCom:
 					self._inMessageQueue.put(tempInMessage)
 				else:
 					break
+				if self._connection.closed():
+					return
 			tempOutMessage = self._outMessageQueue.get()
-			print('  ::SENDING::  ' + tempOutMessage[0] + tempOutMessage[1])
+			print('  ::SENDING::  {}{}'.format(*tempOutMessage))
 			self._connection.send(tempOutMessage[0], tempOutMessage[1])
 
 	def setMcuTime():
-		pass
\ No newline at end of file
+		pass
+
+
+	def _command(self, commandStr, dataStr, timeout=COMMAND_TIMEOUT):
+		# Sends a session command and updates the session until the answer,
+		# the first message received with the same header, arrives.  Returns
+		# the answer's data as text, without padding, or None if it did not
+		# arrive within timeout seconds.  Other messages received meanwhile
+		# are kept in the in message queue, in order.
+		self._outMessageQueue.put((commandStr, dataStr))
+		return self._await(commandStr, timeout)
+
+	def _await(self, commandStr, timeout=COMMAND_TIMEOUT):
+		# Updates the session until the next message with a header arrives,
+		# as _command() does for its answer.
+		end = time.monotonic() + timeout
+		while time.monotonic() < end:
+			self.update()
+			others = []
+			answer = None
+			while not self._inMessageQueue.empty():
+				message = self._inMessageQueue.get()
+				if answer is None and message[0] == commandStr:
+					answer = message[1]
+				else:
+					others.append(message)
+			for message in others:
+				self._inMessageQueue.put(message)
+			if answer is not None:
+				if isinstance(answer, bytes):
+					answer = answer.decode(SerialConnection.BINARY_ENCODING)
+				return answer.rstrip('\0')
+		return None
+
+	def ping(self, timeout=COMMAND_TIMEOUT):
+		# Sends an ECHO message and waits for the MCU to send it back.  The
+		# exchange is also a sample of the MCU's response time, which the
+		# timeouts are taken from.  Returns the round trip in seconds, or None
+		# if the echo did not arrive within timeout seconds.
+		started = time.monotonic()
+		if self._command('ECHO', 'ping', timeout) is None:
+			return None
+		return time.monotonic() - started
+
+	def ticket(self):
+		# Returns the session's ticket, (token, baud rate), which resumes the
+		# session after the connection is lost.  It can be saved (it is a
+		# string and an int) and given to a new STM32SerialCom.
+		return self._connection.ticket()
+
+	def resume(self):
+		# Reopens the port and resumes the session after the connection was
+		# lost, keeping the messages queued.  Returns True if the MCU took the
+		# session up, or False if a new STM32SerialCom must be made.
+		return self._connection.resume()
+
+	def roundTrip(self):
+		# Returns the estimate of the MCU's response time that the timeouts
+		# are taken from:  the smoothed round-trip time and its variation
+		# (None before the first sample) and the timeout, in seconds.
+		return self._connection.roundTrip()
+
+	def profile(self, timeout=COMMAND_TIMEOUT):
+		# Reads the times of each stage of the MCU's transport and session
+		# layers with the PROF command, one stage per command.  The MCU must be
+		# built with SESSION_PROFILE.  Returns a list of (name, count, min,
+		# max, mean) tuples and the units of the times ('cyc' for core clock
+		# cycles, 'ns' for a host build), or None if the MCU did not answer.
+		stages = []
+		unit = None
+		index = 0
+		total = 1
+		while index < total:
+			answer = self._command('PROF', str(index), timeout)
+			if answer is None:
+				return None
+			fields = answer.split()
+			if len(fields) != 8:
+				return None
+			total = int(fields[1])
+			unit = fields[2]
+			stages.append((fields[3], *(int(field) for field in fields[4:])))
+			index += 1
+		return stages, unit
+
+	def resetProfile(self, timeout=COMMAND_TIMEOUT):
+		# Clears the MCU's stage times, so the next profile() covers only what
+		# happens from now.  Returns if the MCU answered.
+		return self._command('PROF', 'reset', timeout) == 'reset'
+
+	def stats(self, reset=False, timeout=COMMAND_TIMEOUT):
+		# Reads the MCU's link statistics with the STAT command.  If reset is
+		# True, the MCU zeroes them after answering.  Returns a dict of the
+		# counts by name, 16-bit ones saturating at 65535 and high-water marks
+		# at 15, or None if the MCU did not answer or answered with a layout
+		# this does not know.
+		answer = self._command('STAT', 'reset' if reset else '', timeout)
+		if answer is None:
+			return None
+		try:
+			data = SerialPacket.unpackSevenBit(answer,
+				struct.calcsize(STAT_LAYOUT))
+		except ValueError:
+			return None
+		fields = struct.unpack(STAT_LAYOUT, data)
+		if fields[0] != STAT_VERSION:
+			return None
+		stats = dict(zip(STAT_COUNTERS, fields[1:-2]))
+		stats['txHighWater'] = fields[-2] & 0x0F
+		stats['txUrgentHighWater'] = fields[-2] >> 4
+		stats['rxHighWater'] = fields[-1] & 0x0F
+		stats['receiveHighWater'] = fields[-1] >> 4
+		return stats
+
+	def trace(self, reset=False, timeout=COMMAND_TIMEOUT):
+		# Dumps the MCU's event trace with the TRAC command.  The MCU must be
+		# built with SESSION_TRACE.  If reset is True, the MCU empties the
+		# trace once dumped.  Returns a list of (time, event, arg, value)
+		# tuples, oldest first, with the times counted from the first entry
+		# (32-bit wraps taken out), the units of the times, and the number of
+		# entries overwritten before the first, or None if the MCU did not
+		# answer all of the dump.
+		answer = self._command('TRAC', 'reset' if reset else '', timeout)
+		if answer is None:
+			return None
+		fields = answer.split()
+		if len(fields) != 5 or int(fields[0]) != TRACE_VERSION:
+			return None
+		count, lost, unit, perPacket = int(fields[1]), int(fields[2]), \
+			fields[3], int(fields[4])
+		size = struct.calcsize(TRACE_ENTRY)
+		entries = []
+		last = None
+		elapsed = 0
+		while len(entries) < count:
+			answer = self._await('TRAC', timeout)
+			if answer is None:
+				return None
+			number = min(perPacket, count - len(entries))
+			try:
+				data = SerialPacket.unpackSevenBit(answer, number * size)
+			except ValueError:
+				return None
+			for stamp, event, arg, value in struct.iter_unpack(TRACE_ENTRY,
+					data):
+				if last is None:
+					last = stamp
+				elapsed += (stamp - last) & 0xFFFFFFFF
+				last = stamp
+				entries.append((elapsed, event, arg, value))
+		return entries, unit, lost
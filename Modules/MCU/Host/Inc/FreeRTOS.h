@@ -0,0 +1,72 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ *
+ * Purpose:
+ *		A stand-in for the FreeRTOS kernel, for building the session's RTOS
+ *	service on a Linux host.  Only the types and the task, notification and
+ *	queue functions the service and the host application use are declared
+ *	(here, in task.h and in queue.h), with the kernel's names and behaviour.
+ *		Each task is a thread, but the simulated core runs one task at a time:
+ *	the highest priority task that is ready, taking turns with the tasks of the
+ *	same priority as each blocks.  A task that makes a task of a higher priority
+ *	ready (by a queue or a notification) gives way to it at once.  The host
+ *	cannot interrupt a running thread, so the tick (and its hook, from which the
+ *	application raises the simulated UART's events) is taken while no task is
+ *	running, or by the running task at its next kernel call.  The time a task
+ *	spends running between kernel calls is not sliced.
+ *		Built against the kernel with its POSIX port instead, the service and
+ *	the application compile unchanged.
+ *
+ *	Note:  Stack sizes are ignored; each task has the host's thread stack.
+ */
+
+#ifndef INC_FREERTOS_H_
+#define INC_FREERTOS_H_
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/*
+ * Kernel configuration, as FreeRTOSConfig.h sets it on the MCU.
+ */
+#ifndef configTICK_RATE_HZ
+#define configTICK_RATE_HZ 1000
+#endif
+#ifndef configMAX_PRIORITIES
+#define configMAX_PRIORITIES 8
+#endif
+#ifndef configMINIMAL_STACK_SIZE
+#define configMINIMAL_STACK_SIZE 128
+#endif
+#define configSTACK_DEPTH_TYPE uint16_t
+
+/*
+ * Port types.
+ */
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFFUL)
+#define portYIELD_FROM_ISR(xSwitchRequired) ((void)(xSwitchRequired))
+
+/*
+ * Kernel return values.
+ */
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE ((BaseType_t)1)
+#define pdFAIL (pdFALSE)
+#define pdPASS (pdTRUE)
+#define errQUEUE_EMPTY ((BaseType_t)0)
+#define errQUEUE_FULL ((BaseType_t)0)
+
+/*
+ * Milliseconds to ticks.
+ */
+#define pdMS_TO_TICKS(xTimeInMs) ((TickType_t)(((TickType_t)(xTimeInMs) * (TickType_t)configTICK_RATE_HZ) / (TickType_t)1000U))
+
+
+#endif /* INC_FREERTOS_H_ */
@@ -0,0 +1,100 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ *
+ * Purpose:
+ *		The queue functions of the stand-in FreeRTOS kernel (see FreeRTOS.h).
+ *	Items are copied in and out, as in the kernel.
+ */
+
+#ifndef INC_QUEUE_H_
+#define INC_QUEUE_H_
+
+
+#include <FreeRTOS.h>
+
+
+/*
+ * Queue handle type, as in the kernel.
+ */
+typedef struct QueueDefinition* QueueHandle_t;
+
+
+/* xQueueCreate
+ *
+ * Function:
+ * 	Creates a queue.
+ *
+ * Parameters:
+ * 	uxQueueLength - number of items the queue holds
+ * 	uxItemSize - size of an item in bytes
+ *
+ * Return:
+ * 	QueueHandle_t - the queue, NULL if it could not be created
+ */
+QueueHandle_t xQueueCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize);
+
+/* xQueueSend
+ *
+ * Function:
+ * 	Copies an item to the back of a queue, blocking while it is full for at most
+ * 	a number of ticks.
+ *
+ * Parameters:
+ * 	xQueue - queue
+ * 	pvItemToQueue - item copied in
+ * 	xTicksToWait - most ticks to block for, portMAX_DELAY for no limit
+ *
+ * Return:
+ * 	BaseType_t - pdPASS if sent, errQUEUE_FULL if the queue stayed full
+ */
+BaseType_t xQueueSend(QueueHandle_t xQueue, const void* pvItemToQueue, TickType_t xTicksToWait);
+
+/* xQueueReceive
+ *
+ * Function:
+ * 	Copies out and removes the item at the front of a queue, blocking while it is
+ * 	empty for at most a number of ticks.
+ *
+ * Parameters:
+ * 	xQueue - queue
+ * 	pvBuffer - where the item is copied
+ * 	xTicksToWait - most ticks to block for, portMAX_DELAY for no limit
+ *
+ * Return:
+ * 	BaseType_t - pdPASS if received, errQUEUE_EMPTY if the queue stayed empty
+ */
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void* pvBuffer, TickType_t xTicksToWait);
+
+/* xQueuePeek
+ *
+ * Function:
+ * 	Copies out the item at the front of a queue without removing it, blocking
+ * 	while it is empty for at most a number of ticks.
+ *
+ * Parameters:
+ * 	xQueue - queue
+ * 	pvBuffer - where the item is copied
+ * 	xTicksToWait - most ticks to block for, portMAX_DELAY for no limit
+ *
+ * Return:
+ * 	BaseType_t - pdPASS if an item was copied, errQUEUE_EMPTY if not
+ */
+BaseType_t xQueuePeek(QueueHandle_t xQueue, void* pvBuffer, TickType_t xTicksToWait);
+
+/* uxQueueMessagesWaiting
+ *
+ * Function:
+ * 	Returns the number of items in a queue.
+ */
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t xQueue);
+
+/* uxQueueSpacesAvailable
+ *
+ * Function:
+ * 	Returns the number of free spaces in a queue.
+ */
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t xQueue);
+
+
+#endif /* INC_QUEUE_H_ */
@@ -0,0 +1,105 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ *
+ * Purpose:
+ *		A stand-in for the STM32 sequencer utility (UTIL_SEQ), for building the
+ *	session's sequencer integration on a Linux host.  Only the task functions the
+ *	integration and the host application use are declared, with the sequencer's
+ *	names and behaviour:  UTIL_SEQ_Run() runs the pending tasks in the mask,
+ *	highest priority (lowest number) first and then by task ID, and calls
+ *	UTIL_SEQ_Idle() with interrupts masked once none is pending.
+ *		Events (UTIL_SEQ_SetEvt/WaitEvt) and pausing tasks are not simulated.
+ *
+ *	Note:  the simulation is single threaded, as the stand-in HAL is.
+ */
+
+#ifndef INC_STM32_SEQ_H_
+#define INC_STM32_SEQ_H_
+
+
+#include <stm32wlxx_hal.h>
+
+
+/*
+ * Task bitmask type, the reserved flags value and the mask of every task, as in
+ * the sequencer.
+ */
+typedef uint32_t UTIL_SEQ_bm_t;
+
+#define UTIL_SEQ_RFU 0
+#define UTIL_SEQ_DEFAULT (~0U)
+
+/*
+ * Number of task priorities.  Set by the application's utilities_conf.h on the MCU.
+ */
+#ifndef UTIL_SEQ_CONF_PRIO_NBR
+#define UTIL_SEQ_CONF_PRIO_NBR 2
+#endif
+
+
+/* UTIL_SEQ_Init
+ *
+ * Function:
+ * 	Clears the registered and pending tasks.
+ */
+void UTIL_SEQ_Init(void);
+
+/* UTIL_SEQ_RegTask
+ *
+ * Function:
+ * 	Registers the function run for a task.
+ *
+ * Parameters:
+ * 	TaskId_bm - task ID bitmask (one bit)
+ * 	Flags - UTIL_SEQ_RFU
+ * 	Task - function to run
+ */
+void UTIL_SEQ_RegTask(UTIL_SEQ_bm_t TaskId_bm, uint32_t Flags, void (*Task)(void));
+
+/* UTIL_SEQ_SetTask
+ *
+ * Function:
+ * 	Sets a task pending at a priority.  May be called from interrupt context.
+ *
+ * Parameters:
+ * 	TaskId_bm - task ID bitmask
+ * 	Task_Prio - priority, 0 the highest
+ */
+void UTIL_SEQ_SetTask(UTIL_SEQ_bm_t TaskId_bm, uint32_t Task_Prio);
+
+/* UTIL_SEQ_IsSchedulableTask
+ *
+ * Function:
+ * 	Returns whether a task is pending.
+ *
+ * Parameters:
+ * 	TaskId_bm - task ID bitmask
+ *
+ * Return:
+ * 	uint32_t - 1 if pending, 0 if not
+ */
+uint32_t UTIL_SEQ_IsSchedulableTask(UTIL_SEQ_bm_t TaskId_bm);
+
+/* UTIL_SEQ_Run
+ *
+ * Function:
+ * 	Runs the pending tasks in a mask until none is pending, then calls
+ * 	UTIL_SEQ_Idle() with interrupts masked (unless a task was set in between)
+ * 	and returns.  Called repeatedly from the main loop.
+ *
+ * Parameters:
+ * 	Mask_bm - tasks that may run, UTIL_SEQ_DEFAULT for all
+ */
+void UTIL_SEQ_Run(UTIL_SEQ_bm_t Mask_bm);
+
+/* UTIL_SEQ_Idle
+ *
+ * Function:
+ * 	Called when no task is pending.  Weak; does nothing unless the
+ * 	application overrides it (usually to wait for an interrupt).
+ */
+void UTIL_SEQ_Idle(void);
+
+
+#endif /* INC_STM32_SEQ_H_ */
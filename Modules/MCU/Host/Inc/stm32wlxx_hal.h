@@ -0,0 +1,344 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ *
+ * Purpose:
+ *		A stand-in for the STM32WLxx HAL, for building the Desktop Communication
+ *	module on a Linux host.  Only the parts of the HAL the module uses are
+ *	declared, with the same names, so the module's sources compile unchanged.
+ *		The UART is simulated over a pseudo-terminal:  bytes the module transmits
+ *	are written to the pty and bytes written to the pty by the desktop
+ *	application are received into the module's DMA ring.  Byte timing can be
+ *	throttled to the UART's baud rate (start bit, 8 data bits and the stop bits
+ *	per byte), so the module sees the same pacing as on the MCU.
+ *		There are no interrupts on the host.  Events that would interrupt the MCU
+ *	(rx events, transmit complete) are raised from HAL_GetTick(), which the module
+ *	calls in each of its polling loops, unless interrupts are masked.  An
+ *	interrupt can therefore only occur where the module reads the tick, which is
+ *	one of the interleavings possible on the MCU.  An interrupt pended by the
+ *	module runs its handler from HAL_NVIC_SetPendingIRQ(), as it would be taken
+ *	straight away from thread mode.
+ *
+ *		The two cores are simulated by threads, each taking a core's identity
+ *	(HAL_Host_setCurrentCPUID(), the CM0+ by default).  The IPCC channels between
+ *	them are shared, and a core's IPCC rx interrupts are raised from its own reads
+ *	of the tick, as its UART's are on the core that initialized the UART.
+ *
+ *	Note:  each core's part of the simulation is single threaded; its calls must
+ *	come from one thread at a time (as they do from the tasks of the stand-in
+ *	FreeRTOS kernel, which runs one at a time).
+ */
+
+#ifndef INC_STM32WLXX_HAL_H_
+#define INC_STM32WLXX_HAL_H_
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/*
+ * HAL status and states.
+ */
+typedef enum {
+	HAL_OK = 0x00,
+	HAL_ERROR = 0x01,
+	HAL_BUSY = 0x02,
+	HAL_TIMEOUT = 0x03
+} HAL_StatusTypeDef;
+
+typedef enum {
+	HAL_UART_STATE_RESET = 0x00,
+	HAL_UART_STATE_READY = 0x20,
+	HAL_UART_STATE_BUSY = 0x24,
+	HAL_UART_STATE_BUSY_TX = 0x21,
+	HAL_UART_STATE_BUSY_RX = 0x22
+} HAL_UART_StateTypeDef;
+
+/*
+ * Register bit helpers, as in CMSIS.
+ */
+#define SET_BIT(REG, BIT) ((REG) |= (BIT))
+#define CLEAR_BIT(REG, BIT) ((REG) &= ~(BIT))
+#define READ_BIT(REG, BIT) ((REG) & (BIT))
+
+/*
+ * UART and DMA configuration values.  Values match the HAL where the simulation
+ * reads them.
+ */
+#define UART_WORDLENGTH_7B 0x10000000U
+#define UART_WORDLENGTH_8B 0x00000000U
+#define UART_WORDLENGTH_9B 0x00001000U
+#define UART_STOPBITS_1 0x00000000U
+#define UART_STOPBITS_2 0x00002000U
+#define UART_PARITY_NONE 0x00000000U
+#define UART_PARITY_EVEN 0x00000400U
+#define UART_PARITY_ODD 0x00000600U
+#define UART_MODE_TX_RX 0x0000000CU
+#define UART_HWCONTROL_NONE 0x00000000U
+#define UART_HWCONTROL_RTS_CTS 0x00000300U
+#define DMA_NORMAL 0x00000000U
+#define DMA_CIRCULAR 0x00000020U
+#define USART_CR3_DMAR 0x00000040U
+#define HAL_UART_ERROR_NONE 0x00000000U
+#define HAL_UART_ERROR_PE 0x00000001U
+#define HAL_UART_ERROR_NE 0x00000002U
+#define HAL_UART_ERROR_FE 0x00000004U
+#define HAL_UART_ERROR_ORE 0x00000008U
+#define HAL_UART_ERROR_DMA 0x00000010U
+
+/*
+ * Peripheral registers.  Only the control register the module writes is kept;
+ * the simulation reads USART_CR3_DMAR from it to hold off reception (and so the
+ * desktop application, through the pty's buffer) as RTS would.
+ */
+typedef struct {
+	volatile uint32_t CR3;
+} USART_TypeDef;
+
+extern USART_TypeDef HostUsart2;
+#define USART2 (&HostUsart2)
+
+/*
+ * DMA and UART handles.
+ */
+typedef struct {
+	uint32_t Mode;
+} DMA_InitTypeDef;
+
+typedef struct {
+	DMA_InitTypeDef Init;
+} DMA_HandleTypeDef;
+
+typedef struct {
+	uint32_t BaudRate;
+	uint32_t WordLength;
+	uint32_t StopBits;
+	uint32_t Parity;
+	uint32_t Mode;
+	uint32_t HwFlowCtl;
+} UART_InitTypeDef;
+
+typedef struct __UART_HandleTypeDef {
+	USART_TypeDef* Instance;
+	UART_InitTypeDef Init;
+	DMA_HandleTypeDef* hdmatx;
+	DMA_HandleTypeDef* hdmarx;
+	volatile HAL_UART_StateTypeDef gState;
+	volatile HAL_UART_StateTypeDef RxState;
+	volatile uint32_t ErrorCode;
+} UART_HandleTypeDef;
+
+/*
+ * Cores, as returned by HAL_GetCurrentCPUID().
+ */
+#define CM4_CPUID 0x00000004U
+#define CM0PLUS_CPUID 0x00000000U
+
+/*
+ * IPCC channels, directions and channel states.  A core's tx channel is the other
+ * core's rx channel of the same index.
+ */
+#define IPCC_CHANNEL_1 0x00000000U
+#define IPCC_CHANNEL_2 0x00000001U
+#define IPCC_CHANNEL_3 0x00000002U
+#define IPCC_CHANNEL_4 0x00000003U
+#define IPCC_CHANNEL_5 0x00000004U
+#define IPCC_CHANNEL_6 0x00000005U
+#define IPCC_CHANNEL_NUMBER 6U
+
+typedef enum {
+	IPCC_CHANNEL_DIR_TX = 0x00U,
+	IPCC_CHANNEL_DIR_RX = 0x01U
+} IPCC_CHANNELDirTypeDef;
+
+typedef enum {
+	IPCC_CHANNEL_STATUS_FREE = 0x00U,
+	IPCC_CHANNEL_STATUS_OCCUPIED = 0x01U
+} IPCC_CHANNELStatusTypeDef;
+
+/*
+ * IPCC handle, one per core.  Only the rx channel callbacks are kept.
+ */
+typedef struct __IPCC_HandleTypeDef {
+	void (*ChannelCallbackRx[IPCC_CHANNEL_NUMBER])(struct __IPCC_HandleTypeDef* hipcc, uint32_t ChannelIndex,
+			IPCC_CHANNELDirTypeDef ChannelDir);
+} IPCC_HandleTypeDef;
+
+
+/*
+ * Interrupt masking.  Masked interrupts are held until unmasked and the tick is
+ * next read.
+ */
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t priMask);
+void __disable_irq(void);
+void __enable_irq(void);
+
+/*
+ * Interrupt numbers.  Only the UART's interrupt is simulated, with the CM0+'s
+ * number.
+ */
+typedef enum {
+	USART2_IRQn = 28
+} IRQn_Type;
+
+/* HAL_NVIC_SetPendingIRQ
+ *
+ * Function:
+ * 	Pends an interrupt on the calling core.  Its handler runs before the call
+ * 	returns, unless interrupts are masked or an event is being raised, in which
+ * 	case it runs on the next tick read.
+ *
+ * Parameters:
+ * 	IRQn - interrupt number
+ */
+void HAL_NVIC_SetPendingIRQ(IRQn_Type IRQn);
+
+/*
+ * Interrupt handlers, weak so the application overrides them as in
+ * stm32wlxx_it.c.
+ */
+void USART2_IRQHandler(void);
+
+/*
+ * Wait for interrupt.  Sleeps until an event can be due:  bytes on the pty for a
+ * UART that is receiving with the line idle, the end of the transmission in
+ * flight, an IPCC channel set by the other core, or the next millisecond (the
+ * SysTick, which wakes the MCU each tick).  The time slept is counted as the
+ * core's idle time (see HAL_Host_idleTime_us()).  The events are raised on the
+ * next tick read, as they are when interrupts are masked.
+ */
+void __WFI(void);
+
+/* HAL_GetTick
+ *
+ * Function:
+ * 	Returns the milliseconds since the simulation started.  Raises any UART
+ * 	and IPCC events that are due on the calling core, unless interrupts are
+ * 	masked.
+ *
+ * Return:
+ * 	uint32_t - tick in milliseconds
+ */
+uint32_t HAL_GetTick(void);
+
+/* HAL_Delay
+ *
+ * Function:
+ * 	Waits for a number of milliseconds, raising UART events as they fall due.
+ *
+ * Parameters:
+ * 	Delay - milliseconds to wait
+ */
+void HAL_Delay(uint32_t Delay);
+
+/*
+ * UART functions.  Each behaves as the HAL's for a UART whose line is the pty.
+ */
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart);
+HAL_StatusTypeDef HAL_UART_Abort(UART_HandleTypeDef *huart);
+HAL_StatusTypeDef HAL_UART_Transmit_IT(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UARTEx_ReceiveToIdle_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size);
+
+/*
+ * UART callbacks, weak as in the HAL so the module overrides them.
+ */
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart);
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart);
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size);
+
+/* HAL_GetCurrentCPUID
+ *
+ * Function:
+ * 	Returns the core the caller runs on.
+ *
+ * Return:
+ * 	uint32_t - CM4_CPUID or CM0PLUS_CPUID
+ */
+uint32_t HAL_GetCurrentCPUID(void);
+
+/*
+ * IPCC functions.  Each behaves as the HAL's, for the calling core.  Notifying a
+ * tx channel sets it, and the other core's rx callback for the channel (if
+ * activated) is raised with the channel's rx interrupt masked until it notifies
+ * the channel back (IPCC_CHANNEL_DIR_RX), which frees it.  The tx channel free
+ * interrupts are not simulated, so only rx notifications can be activated.
+ */
+HAL_StatusTypeDef HAL_IPCC_Init(IPCC_HandleTypeDef *hipcc);
+HAL_StatusTypeDef HAL_IPCC_ActivateNotification(IPCC_HandleTypeDef *hipcc, uint32_t ChannelIndex,
+		IPCC_CHANNELDirTypeDef ChannelDir, void (*cb)(IPCC_HandleTypeDef *hipcc, uint32_t ChannelIndex,
+				IPCC_CHANNELDirTypeDef ChannelDir));
+HAL_StatusTypeDef HAL_IPCC_DeActivateNotification(IPCC_HandleTypeDef *hipcc, uint32_t ChannelIndex,
+		IPCC_CHANNELDirTypeDef ChannelDir);
+IPCC_CHANNELStatusTypeDef HAL_IPCC_GetChannelStatus(IPCC_HandleTypeDef const *const hipcc, uint32_t ChannelIndex,
+		IPCC_CHANNELDirTypeDef ChannelDir);
+HAL_StatusTypeDef HAL_IPCC_NotifyCPU(IPCC_HandleTypeDef const *const hipcc, uint32_t ChannelIndex,
+		IPCC_CHANNELDirTypeDef ChannelDir);
+
+
+/* HAL_Host_openPty
+ *
+ * Function:
+ * 	(Host only) Opens the pseudo-terminal that is the simulated UART's line.
+ * 	The desktop application opens the pty's slave device as its serial port.
+ *
+ * Parameters:
+ * 	throttle - true to pace bytes at the UART's baud rate, false to pass
+ * 			them as fast as the pty takes them
+ * 	linkPath - path for a symbolic link to the slave device (replacing any
+ * 			link already there), or NULL for none
+ *
+ * Return:
+ * 	const char* - path of the slave device, or NULL if the pty could not be
+ * 			opened
+ *
+ * Note:
+ * 	Must be called before the UART is used.
+ */
+const char* HAL_Host_openPty(bool throttle, const char* linkPath);
+
+/* HAL_Host_closePty
+ *
+ * Function:
+ * 	(Host only) Closes the pseudo-terminal and removes its link, if any.
+ */
+void HAL_Host_closePty(void);
+
+/* HAL_Host_setTxLoss
+ *
+ * Function:
+ * 	(Host only) Drops a share of the UART's transmissions, each one a frame,
+ * 	as a lossy line would:  the bytes take their time but never reach the
+ * 	pty.  Drops are drawn from a fixed seed, so runs are repeatable.
+ *
+ * Parameters:
+ * 	permille - transmissions dropped in a thousand, 0 for none
+ */
+void HAL_Host_setTxLoss(uint32_t permille);
+
+/* HAL_Host_setCurrentCPUID
+ *
+ * Function:
+ * 	(Host only) Sets the core the calling thread runs as.  Threads run as the
+ * 	CM0+ until set.
+ *
+ * Parameters:
+ * 	cpuId - CM4_CPUID or CM0PLUS_CPUID
+ */
+void HAL_Host_setCurrentCPUID(uint32_t cpuId);
+
+/* HAL_Host_idleTime_us
+ *
+ * Function:
+ * 	(Host only) Returns the time the calling core spent waiting in __WFI()
+ * 	since the pty was opened.
+ *
+ * Return:
+ * 	uint64_t - idle time in microseconds
+ */
+uint64_t HAL_Host_idleTime_us(void);
+
+
+#endif /* INC_STM32WLXX_HAL_H_ */
@@ -0,0 +1,140 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ *
+ * Purpose:
+ *		The task and task notification functions of the stand-in FreeRTOS
+ *	kernel (see FreeRTOS.h).
+ */
+
+#ifndef INC_TASK_H_
+#define INC_TASK_H_
+
+
+#include <FreeRTOS.h>
+
+
+/*
+ * Task handle and function types, as in the kernel.
+ */
+typedef struct tskTaskControlBlock* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+#define tskIDLE_PRIORITY ((UBaseType_t)0U)
+
+
+/* xTaskCreate
+ *
+ * Function:
+ * 	Creates a task, ready to run once the scheduler is started (at once if it
+ * 	is already running and the task's priority is higher).
+ *
+ * Parameters:
+ * 	pxTaskCode - function the task runs, which must not return
+ * 	pcName - name of the task
+ * 	usStackDepth - stack size in words (ignored on the host)
+ * 	pvParameters - parameter passed to the task's function
+ * 	uxPriority - priority, tskIDLE_PRIORITY the lowest
+ * 	pxCreatedTask - where the task's handle is stored, or NULL
+ *
+ * Return:
+ * 	BaseType_t - pdPASS if created, pdFAIL if not
+ */
+BaseType_t xTaskCreate(TaskFunction_t pxTaskCode, const char* pcName, configSTACK_DEPTH_TYPE usStackDepth,
+		void* pvParameters, UBaseType_t uxPriority, TaskHandle_t* pxCreatedTask);
+
+/* vTaskStartScheduler
+ *
+ * Function:
+ * 	Starts running the tasks.  Returns once a task calls vTaskEndScheduler().
+ */
+void vTaskStartScheduler(void);
+
+/* vTaskEndScheduler
+ *
+ * Function:
+ * 	Stops running the tasks and returns from vTaskStartScheduler().  No task
+ * 	runs again (nor does the calling task return).
+ */
+void vTaskEndScheduler(void);
+
+/* vTaskDelay
+ *
+ * Function:
+ * 	Blocks the calling task for a number of ticks.
+ *
+ * Parameters:
+ * 	xTicksToDelay - ticks to block for
+ */
+void vTaskDelay(TickType_t xTicksToDelay);
+
+/* xTaskGetTickCount
+ *
+ * Function:
+ * 	Returns the ticks since the scheduler was started.
+ *
+ * Return:
+ * 	TickType_t - tick count
+ */
+TickType_t xTaskGetTickCount(void);
+
+/* xTaskGetCurrentTaskHandle
+ *
+ * Function:
+ * 	Returns the handle of the calling task.
+ *
+ * Return:
+ * 	TaskHandle_t - handle of the running task
+ */
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+
+/* ulTaskNotifyTake
+ *
+ * Function:
+ * 	Takes the calling task's notifications, blocking until there is one or for
+ * 	a number of ticks.
+ *
+ * Parameters:
+ * 	xClearCountOnExit - pdTRUE to clear the count, pdFALSE to take one
+ * 	xTicksToWait - most ticks to block for, portMAX_DELAY for no limit
+ *
+ * Return:
+ * 	uint32_t - notification count before it was taken, 0 on timeout
+ */
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait);
+
+/* xTaskNotifyGive
+ *
+ * Function:
+ * 	Gives a task a notification.
+ *
+ * Parameters:
+ * 	xTaskToNotify - task notified
+ *
+ * Return:
+ * 	BaseType_t - pdPASS
+ */
+BaseType_t xTaskNotifyGive(TaskHandle_t xTaskToNotify);
+
+/* vTaskNotifyGiveFromISR
+ *
+ * Function:
+ * 	Gives a task a notification from interrupt context.
+ *
+ * Parameters:
+ * 	xTaskToNotify - task notified
+ * 	pxHigherPriorityTaskWoken - set to pdTRUE if the task notified has a higher
+ * 			priority than the task interrupted, or NULL
+ */
+void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify, BaseType_t* pxHigherPriorityTaskWoken);
+
+/* vApplicationTickHook
+ *
+ * Function:
+ * 	Called on each tick from the tick interrupt.  Weak; does nothing unless the
+ * 	application overrides it (as with configUSE_TICK_HOOK on the MCU).
+ */
+void vApplicationTickHook(void);
+
+
+#endif /* INC_TASK_H_ */
@@ -0,0 +1,706 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ */
+
+
+#define _GNU_SOURCE
+#include <FreeRTOS.h>
+#include <task.h>
+#include <queue.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+/*
+ * Task states.  A task that is ready may be the one running.
+ */
+typedef enum {
+	TASK_READY,
+	TASK_BLOCKED
+} TaskState;
+
+/*
+ * A task, run by its own thread while it holds the simulated core.
+ */
+struct tskTaskControlBlock {
+	pthread_t thread;						// thread running the task
+	TaskFunction_t code;					// function the task runs
+	void* parameters;						// parameter of the function
+	const char* name;						// name of the task
+	UBaseType_t priority;					// priority, higher runs first
+	TaskState state;						// ready or blocked
+	const void* blockedOn;					// event waited on (the task itself, for a notification)
+	uint32_t blockedOrder;					// order the task blocked in, first readied first
+	bool timed;								// flag for a block with a timeout
+	TickType_t wake;						// tick the block times out at
+	bool timedOut;							// flag for the block having timed out
+	uint32_t notifications;					// notification count
+	pthread_cond_t turn;					// signalled when the task is given the core
+	struct tskTaskControlBlock* next;		// next task created
+};
+
+/*
+ * A queue of items copied in and out.
+ */
+struct QueueDefinition {
+	uint8_t* storage;						// items, length * itemSize bytes
+	UBaseType_t length;						// number of items held at most
+	UBaseType_t itemSize;					// size of an item
+	UBaseType_t count;						// number of items held
+	UBaseType_t head;						// index of the front item
+	char roomEvent;							// blocked on by tasks waiting for room
+	char itemEvent;							// blocked on by tasks waiting for an item
+};
+
+
+// Private Function Prototypes
+void* _rtos_taskMain(void* task);
+void _rtos_enter(void);
+void _rtos_exit(void);
+struct tskTaskControlBlock* _rtos_pick(void);
+void _rtos_dispatch(void);
+void _rtos_switch(struct tskTaskControlBlock* self);
+bool _rtos_block(const void* object, TickType_t ticks);
+void _rtos_ready(struct tskTaskControlBlock* task);
+void _rtos_readyWaiting(const void* object);
+void _rtos_readyFirst(const void* object);
+TickType_t _rtos_remaining(TickType_t start, TickType_t ticks);
+BaseType_t _rtos_queueTake(QueueHandle_t xQueue, void* pvBuffer, TickType_t xTicksToWait, bool remove);
+
+
+// Private Variables
+static pthread_mutex_t _lock = PTHREAD_MUTEX_INITIALIZER;		// Guards the kernel's state
+static pthread_cond_t _tickCond;								// Wakes the tick thread early (at the end)
+static struct tskTaskControlBlock* _tasks = NULL;				// Tasks, in the order created
+static struct tskTaskControlBlock* _current = NULL;				// Task holding the core, NULL if idle
+static struct tskTaskControlBlock* _last = NULL;				// Task last given the core, for turns
+static struct tskTaskControlBlock _interrupt;					// Holds the core for the tick, and at the end
+static volatile TickType_t _tick = 0;							// Ticks since the scheduler started
+static uint32_t _blocks = 0;									// Blocks so far, orders the tasks blocked
+static bool _tickPending = false;								// Tick hook for the running task to take
+static bool _running = false;									// Flag for the scheduler running
+static bool _ended = false;										// Flag for vTaskEndScheduler() called
+static __thread struct tskTaskControlBlock* _self = NULL;		// Task of the calling thread
+
+
+/* xTaskCreate
+ *
+ * Starts a thread for the task, which waits to be given the core.
+ */
+BaseType_t xTaskCreate(TaskFunction_t pxTaskCode, const char* pcName, configSTACK_DEPTH_TYPE usStackDepth,
+		void* pvParameters, UBaseType_t uxPriority, TaskHandle_t* pxCreatedTask)
+{
+	struct tskTaskControlBlock* task = calloc(1, sizeof(struct tskTaskControlBlock));
+	struct tskTaskControlBlock** end;
+
+	if (task == NULL)
+	{
+		return pdFAIL;
+	}
+	task->code = pxTaskCode;
+	task->parameters = pvParameters;
+	task->name = pcName;
+	task->priority = (uxPriority < configMAX_PRIORITIES) ? uxPriority : configMAX_PRIORITIES - 1;
+	task->state = TASK_READY;
+	pthread_cond_init(&task->turn, NULL);
+
+	_rtos_enter();
+	if (pthread_create(&task->thread, NULL, _rtos_taskMain, task) != 0)
+	{
+		_rtos_exit();
+		pthread_cond_destroy(&task->turn);
+		free(task);
+		return pdFAIL;
+	}
+	for (end = &_tasks; *end != NULL; end = &(*end)->next)
+	{
+	}
+	*end = task;
+	if (pxCreatedTask != NULL)
+	{
+		*pxCreatedTask = task;
+	}
+	_rtos_exit();
+
+	return pdPASS;
+}
+
+
+/* vTaskStartScheduler
+ *
+ * Gives the core to the first task, then becomes the tick:  once a millisecond,
+ * times out the blocks that are due and calls the tick hook, or leaves the hook to
+ * the running task.
+ */
+void vTaskStartScheduler(void)
+{
+	pthread_condattr_t attributes;
+	struct timespec next;
+	struct tskTaskControlBlock* task;
+
+	pthread_condattr_init(&attributes);
+	pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+	pthread_cond_init(&_tickCond, &attributes);
+	pthread_condattr_destroy(&attributes);
+
+	pthread_mutex_lock(&_lock);
+	_running = true;
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	_rtos_dispatch();
+
+	while (!_ended)
+	{
+		next.tv_nsec += 1000000000L / configTICK_RATE_HZ;
+		if (next.tv_nsec >= 1000000000L)
+		{
+			next.tv_nsec -= 1000000000L;
+			next.tv_sec++;
+		}
+		while (!_ended && pthread_cond_timedwait(&_tickCond, &_lock, &next) != ETIMEDOUT)
+		{
+		}
+		if (_ended)
+		{
+			break;
+		}
+
+		_tick++;
+		for (task = _tasks; task != NULL; task = task->next)
+		{
+			if (task->state == TASK_BLOCKED && task->timed && (int32_t)(_tick - task->wake) >= 0)
+			{
+				task->timedOut = true;
+				_rtos_ready(task);
+			}
+		}
+
+		// the tick interrupt, taken now if the core is idle
+		if (_current == NULL)
+		{
+			_current = &_interrupt;
+			pthread_mutex_unlock(&_lock);
+			vApplicationTickHook();
+			pthread_mutex_lock(&_lock);
+			if (!_ended)
+			{
+				_rtos_dispatch();
+			}
+		}
+		else
+		{
+			_tickPending = true;
+		}
+	}
+
+	_running = false;
+	pthread_mutex_unlock(&_lock);
+}
+
+
+/* vTaskEndScheduler
+ *
+ * Keeps the core from every task and wakes the tick thread to return.
+ */
+void vTaskEndScheduler(void)
+{
+	pthread_mutex_lock(&_lock);
+	_ended = true;
+	_current = &_interrupt;
+	pthread_cond_signal(&_tickCond);
+
+	if (_self != NULL)
+	{
+		for (;;)
+		{
+			pthread_cond_wait(&_self->turn, &_lock);
+		}
+	}
+	pthread_mutex_unlock(&_lock);
+}
+
+
+/* vTaskDelay
+ *
+ * Blocks for the ticks, or with none, gives the core to the next ready task of the
+ * same priority.
+ */
+void vTaskDelay(TickType_t xTicksToDelay)
+{
+	_rtos_enter();
+	if (_self != NULL && _running)
+	{
+		if (xTicksToDelay > 0)
+		{
+			_rtos_block(NULL, xTicksToDelay);
+		}
+		else
+		{
+			_rtos_switch(_self);
+		}
+	}
+	_rtos_exit();
+}
+
+
+/* xTaskGetTickCount
+ *
+ * Returns the tick count.
+ */
+TickType_t xTaskGetTickCount(void)
+{
+	return _tick;
+}
+
+
+/* xTaskGetCurrentTaskHandle
+ *
+ * Returns the calling thread's task.
+ */
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+	return _self;
+}
+
+
+/* ulTaskNotifyTake
+ *
+ * Blocks on the task itself until notified or timed out.
+ */
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait)
+{
+	uint32_t count;
+
+	_rtos_enter();
+	if (_self->notifications == 0 && xTicksToWait > 0)
+	{
+		_rtos_block(_self, xTicksToWait);
+	}
+	count = _self->notifications;
+	if (count > 0)
+	{
+		_self->notifications = xClearCountOnExit ? 0 : count - 1;
+	}
+	_rtos_exit();
+
+	return count;
+}
+
+
+/* xTaskNotifyGive
+ *
+ * Counts the notification and readies the task if it waits for one.
+ */
+BaseType_t xTaskNotifyGive(TaskHandle_t xTaskToNotify)
+{
+	_rtos_enter();
+	xTaskToNotify->notifications++;
+	_rtos_readyWaiting(xTaskToNotify);
+	_rtos_exit();
+
+	return pdPASS;
+}
+
+
+/* vTaskNotifyGiveFromISR
+ *
+ * As xTaskNotifyGive(), without switching tasks.  The task interrupted is the one
+ * holding the core, or the idle task (priority tskIDLE_PRIORITY).
+ */
+void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify, BaseType_t* pxHigherPriorityTaskWoken)
+{
+	UBaseType_t interrupted;
+
+	pthread_mutex_lock(&_lock);
+	xTaskToNotify->notifications++;
+	_rtos_readyWaiting(xTaskToNotify);
+	interrupted = (_current != NULL) ? _current->priority : tskIDLE_PRIORITY;
+	if (pxHigherPriorityTaskWoken != NULL && xTaskToNotify->priority > interrupted)
+	{
+		*pxHigherPriorityTaskWoken = pdTRUE;
+	}
+	pthread_mutex_unlock(&_lock);
+}
+
+
+/* vApplicationTickHook
+ *
+ * Does nothing unless overridden.
+ */
+__attribute__((weak)) void vApplicationTickHook(void)
+{
+}
+
+
+/* xQueueCreate
+ *
+ * Allocates the queue and its storage.
+ */
+QueueHandle_t xQueueCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize)
+{
+	struct QueueDefinition* queue;
+
+	if (uxQueueLength == 0 || uxItemSize == 0)
+	{
+		return NULL;
+	}
+	queue = calloc(1, sizeof(struct QueueDefinition));
+	if (queue == NULL)
+	{
+		return NULL;
+	}
+	queue->storage = malloc(uxQueueLength * uxItemSize);
+	if (queue->storage == NULL)
+	{
+		free(queue);
+		return NULL;
+	}
+	queue->length = uxQueueLength;
+	queue->itemSize = uxItemSize;
+
+	return queue;
+}
+
+
+/* xQueueSend
+ *
+ * Blocks on the queue while it is full, then copies the item in behind the others
+ * and readies the first task waiting for an item.
+ */
+BaseType_t xQueueSend(QueueHandle_t xQueue, const void* pvItemToQueue, TickType_t xTicksToWait)
+{
+	TickType_t start;
+
+	_rtos_enter();
+	start = _tick;
+	while (xQueue->count == xQueue->length)
+	{
+		if (_self == NULL || !_running || _rtos_remaining(start, xTicksToWait) == 0
+				|| !_rtos_block(&xQueue->roomEvent, _rtos_remaining(start, xTicksToWait)))
+		{
+			_rtos_exit();
+			return errQUEUE_FULL;
+		}
+	}
+
+	memcpy(xQueue->storage + ((xQueue->head + xQueue->count) % xQueue->length) * xQueue->itemSize,
+			pvItemToQueue, xQueue->itemSize);
+	xQueue->count++;
+	_rtos_readyFirst(&xQueue->itemEvent);
+	_rtos_exit();
+
+	return pdPASS;
+}
+
+
+/* xQueueReceive
+ *
+ * Takes the front item.
+ */
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void* pvBuffer, TickType_t xTicksToWait)
+{
+	return _rtos_queueTake(xQueue, pvBuffer, xTicksToWait, true);
+}
+
+
+/* xQueuePeek
+ *
+ * Copies the front item, leaving it in the queue.
+ */
+BaseType_t xQueuePeek(QueueHandle_t xQueue, void* pvBuffer, TickType_t xTicksToWait)
+{
+	return _rtos_queueTake(xQueue, pvBuffer, xTicksToWait, false);
+}
+
+
+/* uxQueueMessagesWaiting
+ *
+ * Reads the item count.
+ */
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t xQueue)
+{
+	UBaseType_t count;
+
+	pthread_mutex_lock(&_lock);
+	count = xQueue->count;
+	pthread_mutex_unlock(&_lock);
+
+	return count;
+}
+
+
+/* uxQueueSpacesAvailable
+ *
+ * Reads the free spaces.
+ */
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t xQueue)
+{
+	UBaseType_t spaces;
+
+	pthread_mutex_lock(&_lock);
+	spaces = xQueue->length - xQueue->count;
+	pthread_mutex_unlock(&_lock);
+
+	return spaces;
+}
+
+
+/* _rtos_taskMain
+ *
+ * Thread of a task.  Waits to be given the core, then runs the task's function.  A
+ * function that returns leaves its task blocked for good.
+ */
+void* _rtos_taskMain(void* task)
+{
+	_self = task;
+
+	pthread_mutex_lock(&_lock);
+	while (_current != _self)
+	{
+		pthread_cond_wait(&_self->turn, &_lock);
+	}
+	pthread_mutex_unlock(&_lock);
+
+	_self->code(_self->parameters);
+
+	pthread_mutex_lock(&_lock);
+	_self->state = TASK_BLOCKED;
+	_self->blockedOn = &_interrupt;
+	_self->timed = false;
+	_rtos_switch(_self);
+	pthread_mutex_unlock(&_lock);
+	return NULL;
+}
+
+
+/* _rtos_enter
+ *
+ * Enters the kernel:  takes the lock, and takes the tick interrupt if one came while
+ * the task ran.
+ */
+void _rtos_enter(void)
+{
+	pthread_mutex_lock(&_lock);
+	while (_tickPending && _current == _self)
+	{
+		_tickPending = false;
+		pthread_mutex_unlock(&_lock);
+		vApplicationTickHook();
+		pthread_mutex_lock(&_lock);
+	}
+}
+
+
+/* _rtos_exit
+ *
+ * Leaves the kernel:  gives the core to a task of a higher priority made ready, then
+ * releases the lock.
+ */
+void _rtos_exit(void)
+{
+	struct tskTaskControlBlock* next;
+
+	if (_self != NULL && _running && _current == _self)
+	{
+		next = _rtos_pick();
+		if (next != NULL && next->priority > _self->priority)
+		{
+			_rtos_switch(_self);
+		}
+	}
+	pthread_mutex_unlock(&_lock);
+}
+
+
+/* _rtos_pick
+ *
+ * Returns the ready task of the highest priority, the first after the task last given
+ * the core among those of the same priority, or NULL if none is ready.
+ */
+struct tskTaskControlBlock* _rtos_pick(void)
+{
+	struct tskTaskControlBlock* start;
+	struct tskTaskControlBlock* task;
+	struct tskTaskControlBlock* best = NULL;
+
+	if (_tasks == NULL)
+	{
+		return NULL;
+	}
+	start = (_last != NULL && _last->next != NULL) ? _last->next : _tasks;
+	task = start;
+	do
+	{
+		if (task->state == TASK_READY && (best == NULL || task->priority > best->priority))
+		{
+			best = task;
+		}
+		task = (task->next != NULL) ? task->next : _tasks;
+	} while (task != start);
+
+	return best;
+}
+
+
+/* _rtos_dispatch
+ *
+ * Gives the core to the task picked, or leaves it idle.  Lock held.
+ */
+void _rtos_dispatch(void)
+{
+	_current = _rtos_pick();
+	if (_current != NULL)
+	{
+		_last = _current;
+		pthread_cond_broadcast(&_current->turn);
+	}
+}
+
+
+/* _rtos_switch
+ *
+ * Gives up the core and waits to be given it back.  Lock held.
+ */
+void _rtos_switch(struct tskTaskControlBlock* self)
+{
+	_rtos_dispatch();
+	while (_current != self)
+	{
+		pthread_cond_wait(&self->turn, &_lock);
+	}
+}
+
+
+/* _rtos_block
+ *
+ * Blocks the calling task on an object (NULL for a delay) for at most a number of
+ * ticks, portMAX_DELAY for no limit.  Lock held.
+ *
+ * Return:
+ * 	bool - true if readied, false if timed out
+ */
+bool _rtos_block(const void* object, TickType_t ticks)
+{
+	_self->state = TASK_BLOCKED;
+	_self->blockedOn = object;
+	_self->blockedOrder = _blocks++;
+	_self->timed = (ticks != portMAX_DELAY);
+	_self->wake = _tick + ticks;
+	_self->timedOut = false;
+	_rtos_switch(_self);
+
+	return !_self->timedOut;
+}
+
+
+/* _rtos_ready
+ *
+ * Readies a blocked task.  Lock held.
+ */
+void _rtos_ready(struct tskTaskControlBlock* task)
+{
+	if (task->state == TASK_BLOCKED)
+	{
+		task->state = TASK_READY;
+		task->blockedOn = NULL;
+	}
+}
+
+
+/* _rtos_readyWaiting
+ *
+ * Readies the tasks blocked on an event.  Lock held.
+ */
+void _rtos_readyWaiting(const void* object)
+{
+	struct tskTaskControlBlock* task;
+
+	for (task = _tasks; task != NULL; task = task->next)
+	{
+		if (task->state == TASK_BLOCKED && task->blockedOn == object)
+		{
+			_rtos_ready(task);
+		}
+	}
+}
+
+
+/* _rtos_readyFirst
+ *
+ * Readies the task of the highest priority blocked on an event, the one blocked
+ * longest among those of the same priority, as the kernel's event lists do.  Lock
+ * held.
+ */
+void _rtos_readyFirst(const void* object)
+{
+	struct tskTaskControlBlock* task;
+	struct tskTaskControlBlock* first = NULL;
+
+	for (task = _tasks; task != NULL; task = task->next)
+	{
+		if (task->state == TASK_BLOCKED && task->blockedOn == object
+				&& (first == NULL || task->priority > first->priority
+						|| (task->priority == first->priority
+								&& (int32_t)(task->blockedOrder - first->blockedOrder) < 0)))
+		{
+			first = task;
+		}
+	}
+	if (first != NULL)
+	{
+		_rtos_ready(first);
+	}
+}
+
+
+/* _rtos_remaining
+ *
+ * Returns the ticks left of a wait started at a tick, portMAX_DELAY for no limit.
+ * Lock held.
+ */
+TickType_t _rtos_remaining(TickType_t start, TickType_t ticks)
+{
+	if (ticks == portMAX_DELAY)
+	{
+		return portMAX_DELAY;
+	}
+	return (_tick - start < ticks) ? ticks - (_tick - start) : 0;
+}
+
+
+/* _rtos_queueTake
+ *
+ * Blocks on the queue while it is empty, then copies the front item out, removing it
+ * and readying the first task waiting for room if asked to.
+ */
+BaseType_t _rtos_queueTake(QueueHandle_t xQueue, void* pvBuffer, TickType_t xTicksToWait, bool remove)
+{
+	TickType_t start;
+
+	_rtos_enter();
+	start = _tick;
+	while (xQueue->count == 0)
+	{
+		if (_self == NULL || !_running || _rtos_remaining(start, xTicksToWait) == 0
+				|| !_rtos_block(&xQueue->itemEvent, _rtos_remaining(start, xTicksToWait)))
+		{
+			_rtos_exit();
+			return errQUEUE_EMPTY;
+		}
+	}
+
+	memcpy(pvBuffer, xQueue->storage + xQueue->head * xQueue->itemSize, xQueue->itemSize);
+	if (remove)
+	{
+		xQueue->head = (xQueue->head + 1) % xQueue->length;
+		xQueue->count--;
+		_rtos_readyFirst(&xQueue->roomEvent);
+	}
+	_rtos_exit();
+
+	return pdPASS;
+}
@@ -0,0 +1,1107 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ *
+ * Purpose:
+ *		The example MCU application, built for the host.  The Desktop
+ *	Communication module runs unchanged against the simulated UART, so the
+ *	desktop application scripts can open a session with it through the pty as
+ *	they would with the Nucleo.  The LEDs are printed rather than lit.
+ *
+ *	Usage:  desktop_com_host [-t] [-r] [-l link] [-b budget] [-j]
+ *			[-o policy] [-a period] [-i] [-q producers] [-s] [-c]
+ *			[-x loss] [-k period] [-w]
+ *		-t  throttle bytes to the UART's baud rate
+ *		-r  set RTS/CTS flow control on the UART (for builds with
+ *			UART_HW_FLOW_CONTROL)
+ *		-l  make a symbolic link to the pty's slave device at link
+ *		-b  update the session within a budget of microseconds
+ *		-j  print a histogram of the main loop's period on exit, to
+ *			compare the loop's jitter with and without traffic
+ *		-o  receive queue overflow policy:  hold, reject, oldest or newest
+ *		-a  read at most one message for the application every period
+ *			milliseconds, as a slow application loop would, and print the
+ *			receive queue's statistics on exit
+ *		-i  print the share of the time the CPU was idle on exit
+ *		-q  run a number of producer tasks sending messages to the desktop
+ *			as fast as the session takes them, and print what each sent and
+ *			how long it blocked on exit (for builds with SESSION_RTOS)
+ *		-s  print the times of each stage of the transport and session
+ *			layers on exit (for builds with SESSION_PROFILE)
+ *		-c  print the link statistics (as the STAT command reads them) and
+ *			the estimate of the desktop's response time on exit
+ *		-x  drop loss frames in a thousand sent to the desktop, as a lossy
+ *			line would
+ *		-k  close each session from the MCU once it has been open period
+ *			milliseconds (desktopAppSession_stop()), and print how long the
+ *			closing took
+ *		-w  time each call to desktopAppSession_start() and to the update,
+ *			and print the longest and a histogram, with and without a
+ *			session open, on exit
+ *
+ *		Built with SESSION_SEQUENCER, the session is run by a task of the stub
+ *	sequencer (stm32_seq.h) on UART events rather than by the main loop, and the
+ *	core waits for interrupts in between.  Built with SESSION_RTOS, the session is
+ *	run by the comms task of session_rtos.h on the stand-in FreeRTOS kernel
+ *	(FreeRTOS.h), and the application reads its messages in a task of its own.
+ *	Built with SESSION_MAILBOX, the main thread is the CM0+, which forwards the
+ *	messages through the mailbox of session_mailbox.h to the application on the
+ *	CM4, run by a thread of its own.  -b, -j and -w apply to the main loop only, and
+ *	-k to the main loop and the sequencer.
+ */
+
+
+#include <desktop_app_session.h>
+#include <session_mailbox.h>
+#include <session_rtos.h>
+#include <session_sequencer.h>
+#include <stage_profile.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+
+/*
+ * Loop period histogram buckets.  Bucket n counts periods under 2^n
+ * microseconds, the last counts the rest.
+ */
+#define LOOP_PERIOD_BUCKETS 24
+
+/*
+ * Call time histogram buckets.  Bucket n counts calls under 2^n nanoseconds, the
+ * last counts the rest.  Calls to desktopAppSession_start() and to the update are
+ * kept apart, and by whether a session was open when called.
+ */
+#define CALL_TIME_BUCKETS 32
+#define CALL_START 0
+#define CALL_UPDATE 1
+
+/*
+ * Sequencer task ID and priority of the session task, as the application's
+ * utilities_def.h would set them.
+ */
+#define SEQ_TASK_SESSION (1U << 0)
+#define SEQ_PRIO_SESSION 0
+
+/*
+ * Task priorities, the comms task above the tasks using it.  Producers block for
+ * at most RTOS_SEND_TIMEOUT_MS on a full send queue, and the application for at
+ * most RTOS_RECEIVE_TIMEOUT_MS for a message before checking for the exit.
+ */
+#define RTOS_PRIO_SESSION 3
+#define RTOS_PRIO_APPLICATION 2
+#define RTOS_PRIO_PRODUCER 1
+#define RTOS_PRODUCERS_MAX 16
+#define RTOS_SEND_TIMEOUT_MS 100
+#define RTOS_RECEIVE_TIMEOUT_MS 100
+
+#if defined(SESSION_MAILBOX) && defined(SESSION_RTOS)
+#error "the host's mailbox link is pumped by the main loop or sequencer task, not the comms task"
+#endif
+
+/*
+ * What a producer task sent.
+ */
+typedef struct {
+	uint32_t index;			// number of the producer
+	uint32_t sent;			// messages queued
+	uint32_t timeouts;		// sends that timed out on a full queue
+	uint32_t longest_ms;	// longest time blocked in one send
+} ProducerStats;
+
+
+// Private Function Prototypes
+void _setLed(const char* led, bool* state, bool on);
+DesktopComSessionStatus _toggleBlueLed(const PacketView* message, void* context);
+void _application(void);
+void _closeSession(void);
+bool _initUart(uint32_t baudRate, bool rtscts);
+void _stop(int signal);
+uint64_t _now_us(void);
+void _recordLoopPeriod(void);
+void _printLoopPeriods(void);
+uint64_t _now_ns(void);
+uint64_t _cpu_ns(void);
+void _recordCallTime(int call, bool open, uint64_t start_ns, uint64_t startCpu_ns);
+void _printCallTimes(void);
+bool _parseRxOverflow(const char* name, SessionRxOverflow* policy);
+void _printRxStats(void);
+void _printIdle(uint64_t start_us);
+#ifdef SESSION_PROFILE
+void _printProfile(void);
+#endif
+void _printLinkStats(void);
+#ifdef SESSION_RTOS
+void _applicationTask(void* parameters);
+void _producerTask(void* parameters);
+void _printProducers(void);
+#endif
+#ifdef SESSION_MAILBOX
+bool _startApplicationCore(pthread_t* thread, bool* blueLedOn);
+void* _applicationCore(void* parameters);
+#endif
+
+
+// Private Variables
+static UART_HandleTypeDef huart2;						// Simulated USART2
+static DMA_HandleTypeDef hdma_usart2_rx;				// Simulated USART2 rx DMA channel
+static DMA_HandleTypeDef hdma_usart2_tx;				// Simulated USART2 tx DMA channel
+static volatile sig_atomic_t _running = 1;				// Cleared to exit the main loop
+static uint64_t _loopPeriods[LOOP_PERIOD_BUCKETS];		// Loop period histogram
+static uint64_t _loopMax_us = 0;						// Longest loop period
+static uint64_t _loopLast_us = 0;						// Start of the previous loop
+static uint64_t _callTimes[2][2][CALL_TIME_BUCKETS];	// Call time histograms, by call and session open
+static uint64_t _callMax_ns[2][2];						// Longest call, by call and session open
+static uint64_t _callMaxCpu_ns[2][2];					// Most CPU time of a call, by call and session open
+static uint64_t _callTotal_ns[2][2];					// Time in calls, by call and session open
+static bool _greenLedOn = false;						// Simulated green LED
+static uint32_t _readPeriod_ms = 0;						// Least time between messages read, 0 for none
+#ifndef SESSION_MAILBOX
+static uint32_t _readTick = 0;							// Tick of the last message read
+#endif
+static uint32_t _producerCount = 0;						// Number of producer tasks
+static uint32_t _closeAfter_ms = 0;						// Time a session is left open before the MCU closes it, 0 for never
+static uint32_t _openedTick = 0;						// Tick the session was last seen closed
+static uint64_t _closeStart_us = 0;						// Time the MCU started closing the session, 0 if not closing
+#ifdef SESSION_RTOS
+static ProducerStats _producers[RTOS_PRODUCERS_MAX];	// Producer tasks' statistics
+static uint32_t _openTicks = 0;							// Ticks a session was open, seen by the application task
+#endif
+#ifdef SESSION_MAILBOX
+static SessionMailbox _mailbox;							// Mailbox, in the SRAM both cores see
+static IPCC_HandleTypeDef hipcc_cm0plus;				// IPCC as seen from the CM0+
+static IPCC_HandleTypeDef hipcc_cm4;					// IPCC as seen from the CM4
+#endif
+
+
+int main(int argc, char** argv)
+{
+	bool blueLedOn = false;
+	bool throttle = false;
+	bool rtscts = false;
+	bool jitter = false;
+	bool callTimes = false;
+	bool idle = false;
+	bool profile = false;
+	bool linkStats = false;
+	uint32_t budget_us = 0;
+	uint32_t loss = 0;
+	uint64_t start_us = _now_us();
+	SessionRxOverflow overflow = SESSION_RX_OVERFLOW;
+	const char* link = NULL;
+	const char* port;
+	int option;
+#ifdef SESSION_MAILBOX
+	pthread_t applicationCore;
+#endif
+
+	while ((option = getopt(argc, argv, "trl:b:jo:a:iq:scx:k:w")) != -1)
+	{
+		if (option == 't')
+		{
+			throttle = true;
+		}
+		else if (option == 'r')
+		{
+			rtscts = true;
+		}
+		else if (option == 'l')
+		{
+			link = optarg;
+		}
+		else if (option == 'b')
+		{
+			budget_us = (uint32_t)strtoul(optarg, NULL, 10);
+		}
+		else if (option == 'j')
+		{
+			jitter = true;
+		}
+		else if (option == 'o' && _parseRxOverflow(optarg, &overflow))
+		{
+			// the policy is set once the session manager is initialized
+		}
+		else if (option == 'a')
+		{
+			_readPeriod_ms = (uint32_t)strtoul(optarg, NULL, 10);
+		}
+		else if (option == 'i')
+		{
+			idle = true;
+		}
+		else if (option == 'q')
+		{
+			_producerCount = (uint32_t)strtoul(optarg, NULL, 10);
+			if (_producerCount > RTOS_PRODUCERS_MAX)
+			{
+				_producerCount = RTOS_PRODUCERS_MAX;
+			}
+		}
+		else if (option == 's')
+		{
+			profile = true;
+		}
+		else if (option == 'c')
+		{
+			linkStats = true;
+		}
+		else if (option == 'x')
+		{
+			loss = (uint32_t)strtoul(optarg, NULL, 10);
+		}
+		else if (option == 'k')
+		{
+			_closeAfter_ms = (uint32_t)strtoul(optarg, NULL, 10);
+		}
+		else if (option == 'w')
+		{
+			callTimes = true;
+		}
+		else
+		{
+			fprintf(stderr, "usage: %s [-t] [-r] [-l link] [-b budget] [-j] [-o hold|reject|oldest|newest]"
+					" [-a period] [-i] [-q producers] [-s] [-c] [-x loss] [-k period] [-w]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	// the line
+	port = HAL_Host_openPty(throttle, link);
+	if (port == NULL)
+	{
+		perror("pty");
+		return 1;
+	}
+	printf("UART on %s%s\n", port, throttle ? " (throttled)" : "");
+	fflush(stdout);
+	HAL_Host_setTxLoss(loss);
+	signal(SIGINT, _stop);
+	signal(SIGTERM, _stop);
+
+	// USART2 as configured in STM32CubeMX for the example
+	if (!_initUart(9600, rtscts))
+	{
+		fprintf(stderr, "UART initialization failed\n");
+		return 1;
+	}
+
+	// initialize the Desktop App Communication
+	if (!desktopAppSession_init(&huart2))
+	{
+		fprintf(stderr, "session initialization failed\n");
+		return 1;
+	}
+
+#ifndef SESSION_MAILBOX
+	// "LED/0" commands are dispatched to their handler by the session updates
+	desktopAppSession_registerHandler("LED\0", _toggleBlueLed, &blueLedOn);
+#endif
+	desktopAppSession_setRxOverflow(overflow);
+
+#ifdef SESSION_SEQUENCER
+	// the session task runs on UART events (and its poll), the core waits for
+	// interrupts in between
+	if (budget_us > 0)
+	{
+		fprintf(stderr, "-b ignored, the session task updates without a budget\n");
+	}
+	if (callTimes)
+	{
+		fprintf(stderr, "-w ignored, the session task is not called by the main loop\n");
+	}
+	UTIL_SEQ_Init();
+	sessionSequencer_init(SEQ_TASK_SESSION, SEQ_PRIO_SESSION, _application);
+#ifdef SESSION_MAILBOX
+	if (!_startApplicationCore(&applicationCore, &blueLedOn))
+	{
+		return 1;
+	}
+#endif
+	while (_running)
+	{
+		UTIL_SEQ_Run(UTIL_SEQ_DEFAULT);
+	}
+#elif defined(SESSION_RTOS)
+	// the comms task owns the session, the application and producer tasks talk to
+	// it through its queues
+	if (budget_us > 0)
+	{
+		fprintf(stderr, "-b ignored, the comms task updates without a budget\n");
+	}
+	if (callTimes)
+	{
+		fprintf(stderr, "-w ignored, the comms task is not called by the main loop\n");
+	}
+	if (!sessionRtos_init(RTOS_PRIO_SESSION)
+			|| xTaskCreate(_applicationTask, "application", configMINIMAL_STACK_SIZE, NULL,
+					RTOS_PRIO_APPLICATION, NULL) != pdPASS)
+	{
+		fprintf(stderr, "task creation failed\n");
+		return 1;
+	}
+	for (uint32_t i = 0; i < _producerCount; i++)
+	{
+		_producers[i].index = i;
+		xTaskCreate(_producerTask, "producer", configMINIMAL_STACK_SIZE, &_producers[i], RTOS_PRIO_PRODUCER, NULL);
+	}
+	vTaskStartScheduler();
+#else
+#ifdef SESSION_MAILBOX
+	if (!_startApplicationCore(&applicationCore, &blueLedOn))
+	{
+		return 1;
+	}
+#endif
+	while (_running)
+	{
+		uint32_t backlog;
+		uint64_t call_ns;
+		uint64_t callCpu_ns;
+		bool open;
+
+		if (jitter)
+		{
+			_recordLoopPeriod();
+		}
+
+		// Attempt to open a session,
+		// will skip attempt if a session is already open
+		open = sessionOpen();
+		call_ns = _now_ns();
+		callCpu_ns = _cpu_ns();
+		desktopAppSession_start();
+		if (callTimes)
+		{
+			_recordCallTime(CALL_START, open, call_ns, callCpu_ns);
+		}
+
+		// update the session manager
+		open = sessionOpen();
+		call_ns = _now_ns();
+		callCpu_ns = _cpu_ns();
+		if (budget_us > 0)
+		{
+			desktopAppSession_updateWithin(budget_us, &backlog);
+		}
+		else
+		{
+			desktopAppSession_update();
+		}
+		if (callTimes)
+		{
+			_recordCallTime(CALL_UPDATE, open, call_ns, callCpu_ns);
+		}
+
+		_application();
+	}
+#endif
+#ifdef SESSION_MAILBOX
+	pthread_join(applicationCore, NULL);
+#endif
+
+	if (jitter)
+	{
+		_printLoopPeriods();
+	}
+#if !defined(SESSION_SEQUENCER) && !defined(SESSION_RTOS)
+	if (callTimes)
+	{
+		_printCallTimes();
+	}
+#endif
+	if (_readPeriod_ms > 0)
+	{
+		_printRxStats();
+	}
+	if (idle)
+	{
+		_printIdle(start_us);
+	}
+#if defined(SESSION_RTOS) || defined(SESSION_MAILBOX)
+	if (_closeAfter_ms > 0)
+	{
+		fprintf(stderr, "-k ignored, the application does not own the session\n");
+	}
+#endif
+#ifdef SESSION_RTOS
+	if (_producerCount > 0)
+	{
+		_printProducers();
+	}
+#else
+	if (_producerCount > 0)
+	{
+		fprintf(stderr, "-q ignored, producer tasks need SESSION_RTOS\n");
+	}
+#endif
+#ifdef SESSION_PROFILE
+	if (profile)
+	{
+		_printProfile();
+	}
+#else
+	if (profile)
+	{
+		fprintf(stderr, "-s ignored, stage times need SESSION_PROFILE\n");
+	}
+#endif
+	if (linkStats)
+	{
+		_printLinkStats();
+	}
+	HAL_Host_closePty();
+	return 0;
+}
+
+
+/* _setLed
+ *
+ * Prints a simulated LED when it changes.
+ */
+void _setLed(const char* led, bool* state, bool on)
+{
+	if (*state != on)
+	{
+		*state = on;
+		printf("%s LED %s\n", led, on ? "on" : "off");
+		fflush(stdout);
+	}
+}
+
+
+/* _toggleBlueLed
+ *
+ * Handler for "LED/0" commands.  If the payload is "toggle blue LED" and nothing
+ * more, toggles the blue LED and reports it to the desktop, building the message in
+ * place in the tx queue.  The LED is left as it is until a tx slot is free for the
+ * report.
+ */
+DesktopComSessionStatus _toggleBlueLed(const PacketView* message, void* context)
+{
+	bool* blueLedOn = context;
+	PacketView reply;
+
+	// the whole command, and no more (the payload is zeroed past the length received)
+	if (message->length < strlen("toggle blue LED")
+		|| memcmp(message->payload, "toggle blue LED", sizeof("toggle blue LED")) != 0)
+	{
+		return SESSION_OKAY;
+	}
+
+	if (desktopAppSession_acquireMessage(&reply, SESSION_PRIORITY_URGENT) != SESSION_OKAY)
+	{
+		return SESSION_BUFFER_FULL;
+	}
+
+	_setLed("blue", blueLedOn, !*blueLedOn);
+	memcpy(reply.header, "LED/0", UART_PACKET_HEADER_SIZE);
+	strncpy((char*)reply.payload, *blueLedOn ? "blue LED is now on\0" : "blue LED is now off\0", reply.length);
+	desktopAppSession_commitMessage();
+	return SESSION_OKAY;
+}
+
+
+/* _application
+ *
+ * The application's part of each pass of the main loop (or run of the session
+ * task).  Shows the session on the green LED and frees the slots of messages with
+ * no handler, which are not used, at most one per period to stand in for a slow
+ * application.  With the mailbox, the application is on the CM4 and this only
+ * forwards its messages.
+ */
+void _application(void)
+{
+#ifdef SESSION_MAILBOX
+	sessionMailbox_updateLink();
+#else
+	PacketView received;
+
+	_setLed("green", &_greenLedOn, sessionOpen());
+
+	if ((_readPeriod_ms == 0 || HAL_GetTick() - _readTick >= _readPeriod_ms)
+			&& desktopAppSession_peekMessage(&received) == SESSION_OKAY)
+	{
+		desktopAppSession_releaseMessage();
+		_readTick = HAL_GetTick();
+	}
+
+	if (_closeAfter_ms > 0)
+	{
+		_closeSession();
+	}
+#endif
+}
+
+
+/* _closeSession
+ *
+ * Closes the session from the MCU once it has been open for the -k period, a step
+ * each pass, and prints how long the closing took (from the first step to the
+ * desktop's confirmation, or the timeout).
+ */
+void _closeSession(void)
+{
+	DesktopComSessionStatus status;
+
+	if (_closeStart_us == 0)
+	{
+		if (!sessionOpen())
+		{
+			_openedTick = HAL_GetTick();
+			return;
+		}
+		if (HAL_GetTick() - _openedTick < _closeAfter_ms)
+		{
+			return;
+		}
+		_closeStart_us = _now_us();
+	}
+
+	status = desktopAppSession_stop();
+	if (status != SESSION_BUSY)
+	{
+		printf("session closed by the MCU in %.1f ms%s\n", (double)(_now_us() - _closeStart_us) / 1000.0,
+				(status == SESSION_OKAY) ? "" : ", not confirmed");
+		fflush(stdout);
+		_closeStart_us = 0;
+		_openedTick = HAL_GetTick();
+	}
+}
+
+
+/* USART2_IRQHandler
+ *
+ * Overrides the HAL's weak handler, as stm32wlxx_it.c does on the MCU, for the
+ * interrupt the transport layer pends.
+ */
+void USART2_IRQHandler(void)
+{
+	uartTransport_IRQHandler();
+}
+
+
+#ifdef SESSION_SEQUENCER
+/* UTIL_SEQ_Idle
+ *
+ * Overrides the sequencer's weak idle.  Waits for an interrupt unless the session
+ * is due an update.
+ */
+void UTIL_SEQ_Idle(void)
+{
+	if (!sessionSequencer_idle())
+	{
+		__WFI();
+	}
+}
+#endif
+
+
+#ifdef SESSION_RTOS
+/* vApplicationTickHook
+ *
+ * Overrides the kernel's weak tick hook.  Reads the tick, which raises the UART's
+ * due events as the SysTick interrupt would let them be taken.
+ */
+void vApplicationTickHook(void)
+{
+	HAL_GetTick();
+}
+
+
+/* _applicationTask
+ *
+ * The application's task.  Shows the session on the green LED and reads the
+ * messages with no handler, which are not used, at most one per period to stand in
+ * for a slow application.  Ends the scheduler on exit.
+ */
+void _applicationTask(void* parameters)
+{
+	SessionRtosMessage received;
+	TickType_t last = xTaskGetTickCount();
+	TickType_t now;
+
+	for (;;)
+	{
+		_setLed("green", &_greenLedOn, sessionRtos_isOpen());
+
+		if (sessionRtos_receive(&received, pdMS_TO_TICKS(RTOS_RECEIVE_TIMEOUT_MS)) == SESSION_OKAY
+				&& _readPeriod_ms > 0)
+		{
+			vTaskDelay(pdMS_TO_TICKS(_readPeriod_ms));
+		}
+
+		now = xTaskGetTickCount();
+		if (sessionRtos_isOpen())
+		{
+			_openTicks += now - last;
+		}
+		last = now;
+
+		if (!_running)
+		{
+			vTaskEndScheduler();
+		}
+	}
+}
+
+
+/* _producerTask
+ *
+ * A producer task.  Sends numbered bulk messages to the desktop as fast as the send
+ * queue takes them, timing each send.
+ */
+void _producerTask(void* parameters)
+{
+	ProducerStats* stats = parameters;
+	char body[UART_PACKET_PAYLOAD_SIZE];
+	TickType_t start;
+	uint32_t waited_ms;
+
+	for (;;)
+	{
+		snprintf(body, sizeof(body), "producer %u message %u", (unsigned)stats->index, (unsigned)stats->sent);
+		start = xTaskGetTickCount();
+		if (sessionRtos_send("PROD", body, SESSION_PRIORITY_BULK, pdMS_TO_TICKS(RTOS_SEND_TIMEOUT_MS)) == SESSION_OKAY)
+		{
+			stats->sent++;
+		}
+		else
+		{
+			stats->timeouts++;
+		}
+		waited_ms = (uint32_t)(xTaskGetTickCount() - start) * 1000 / configTICK_RATE_HZ;
+		if (waited_ms > stats->longest_ms)
+		{
+			stats->longest_ms = waited_ms;
+		}
+	}
+}
+
+
+/* _printProducers
+ *
+ * Prints what each producer task sent, and the messages sent per second while a
+ * session was open.
+ */
+void _printProducers(void)
+{
+	uint32_t total = 0;
+	uint32_t i;
+
+	printf("producer  sent  timeouts  longest block (ms)\n");
+	for (i = 0; i < _producerCount; i++)
+	{
+		printf("%8u  %4u  %8u  %18u\n", (unsigned)i, (unsigned)_producers[i].sent, (unsigned)_producers[i].timeouts,
+				(unsigned)_producers[i].longest_ms);
+		total += _producers[i].sent;
+	}
+	printf("%u messages in %.1f s open (%.1f/s), comms task updates %u\n", (unsigned)total,
+			(double)_openTicks / configTICK_RATE_HZ,
+			_openTicks > 0 ? (double)total * configTICK_RATE_HZ / _openTicks : 0.0, (unsigned)sessionRtos_wakes());
+}
+#endif
+
+
+#ifdef SESSION_MAILBOX
+/* _startApplicationCore
+ *
+ * Initializes the CM0+'s side of the mailbox, its doorbell notifying the session
+ * task when there is one, and starts the CM4's thread.
+ */
+bool _startApplicationCore(pthread_t* thread, bool* blueLedOn)
+{
+#ifdef SESSION_SEQUENCER
+	void (*notify)(void) = sessionSequencer_notify;
+#else
+	void (*notify)(void) = NULL;
+#endif
+
+	if (HAL_IPCC_Init(&hipcc_cm0plus) != HAL_OK || !sessionMailbox_initLink(&_mailbox, &hipcc_cm0plus, notify)
+			|| pthread_create(thread, NULL, _applicationCore, blueLedOn) != 0)
+	{
+		fprintf(stderr, "mailbox initialization failed\n");
+		return false;
+	}
+
+	return true;
+}
+
+
+/* _applicationCore
+ *
+ * The CM4's application.  Shows the session on the green LED and handles the
+ * "LED/0" commands forwarded by the CM0+, as _toggleBlueLed() does, replying
+ * through the mailbox.  Other messages are not used.  Waits for the CM0+'s doorbell
+ * while there is nothing to read.
+ */
+void* _applicationCore(void* parameters)
+{
+	bool* blueLedOn = parameters;
+	char header[UART_PACKET_HEADER_SIZE];
+	char body[UART_PACKET_PAYLOAD_SIZE];
+	const char* reply;
+
+	HAL_Host_setCurrentCPUID(CM4_CPUID);
+	HAL_IPCC_Init(&hipcc_cm4);
+	while (_running && !sessionMailbox_initApp(&_mailbox, &hipcc_cm4, NULL))
+	{
+		__WFI();
+	}
+
+	while (_running)
+	{
+		// the tick read takes the doorbell's interrupt
+		HAL_GetTick();
+		_setLed("green", &_greenLedOn, sessionMailbox_isOpen());
+
+		memset(body, 0, UART_PACKET_PAYLOAD_SIZE);
+		if (sessionMailbox_dequeueMessage(header, body) != SESSION_OKAY)
+		{
+			__WFI();
+			continue;
+		}
+		if (memcmp(header, "LED\0", UART_PACKET_HEADER_SIZE) || strncmp(body, "toggle blue LED", UART_PACKET_PAYLOAD_SIZE))
+		{
+			continue;
+		}
+
+		_setLed("blue", blueLedOn, !*blueLedOn);
+		reply = *blueLedOn ? "blue LED is now on" : "blue LED is now off";
+		memset(body, 0, UART_PACKET_PAYLOAD_SIZE);
+		memcpy(body, reply, strlen(reply));
+		while (_running && sessionMailbox_enqueueMessage("LED/0", body, SESSION_PRIORITY_URGENT) == SESSION_BUFFER_FULL)
+		{
+			__WFI();
+			HAL_GetTick();
+		}
+	}
+
+	return NULL;
+}
+#endif
+
+
+/* _initUart
+ *
+ * Initializes the simulated USART2 as configured in STM32CubeMX for the example, at
+ * a baud rate.
+ */
+bool _initUart(uint32_t baudRate, bool rtscts)
+{
+	hdma_usart2_rx.Init.Mode = DMA_CIRCULAR;
+	hdma_usart2_tx.Init.Mode = DMA_NORMAL;
+	huart2.Instance = USART2;
+	huart2.Init.BaudRate = baudRate;
+	huart2.Init.WordLength = UART_WORDLENGTH_8B;
+	huart2.Init.StopBits = UART_STOPBITS_2;
+	huart2.Init.Parity = UART_PARITY_NONE;
+	huart2.Init.Mode = UART_MODE_TX_RX;
+	huart2.Init.HwFlowCtl = rtscts ? UART_HWCONTROL_RTS_CTS : UART_HWCONTROL_NONE;
+	huart2.hdmarx = &hdma_usart2_rx;
+	huart2.hdmatx = &hdma_usart2_tx;
+	return HAL_UART_Init(&huart2) == HAL_OK;
+}
+
+
+/* _stop
+ *
+ * Signal handler, exits the main loop.
+ */
+void _stop(int signal)
+{
+	(void)signal;
+	_running = 0;
+}
+
+
+/* _now_us
+ *
+ * Returns the host's monotonic time in microseconds.
+ */
+uint64_t _now_us(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000;
+}
+
+
+/* _recordLoopPeriod
+ *
+ * Adds the time since the previous loop started to the histogram.
+ */
+void _recordLoopPeriod(void)
+{
+	uint64_t now = _now_us();
+	uint64_t period;
+	int bucket = 0;
+
+	if (_loopLast_us != 0)
+	{
+		period = now - _loopLast_us;
+		while (bucket < LOOP_PERIOD_BUCKETS - 1 && period >= (1ULL << bucket))
+		{
+			bucket++;
+		}
+		_loopPeriods[bucket]++;
+		if (period > _loopMax_us)
+		{
+			_loopMax_us = period;
+		}
+	}
+	_loopLast_us = now;
+}
+
+
+/* _printLoopPeriods
+ *
+ * Prints the non-empty buckets of the histogram and the longest period.
+ */
+void _printLoopPeriods(void)
+{
+	int bucket;
+
+	printf("loop period histogram (us):\n");
+	for (bucket = 0; bucket < LOOP_PERIOD_BUCKETS; bucket++)
+	{
+		if (_loopPeriods[bucket] > 0)
+		{
+			printf("  < %8llu  %llu\n", 1ULL << bucket, (unsigned long long)_loopPeriods[bucket]);
+		}
+	}
+	printf("  max %llu\n", (unsigned long long)_loopMax_us);
+}
+
+
+/* _now_ns
+ *
+ * Returns the host's monotonic time in nanoseconds.
+ */
+uint64_t _now_ns(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+
+/* _cpu_ns
+ *
+ * Returns the CPU time of the calling thread in nanoseconds, which leaves out the
+ * time the host ran other threads.
+ */
+uint64_t _cpu_ns(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+	return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+
+/* _recordCallTime
+ *
+ * Adds the time since a call started to its histogram, and notes the CPU time it
+ * took.
+ */
+void _recordCallTime(int call, bool open, uint64_t start_ns, uint64_t startCpu_ns)
+{
+	uint64_t time = _now_ns() - start_ns;
+	uint64_t cpu = _cpu_ns() - startCpu_ns;
+	int bucket = 0;
+
+	while (bucket < CALL_TIME_BUCKETS - 1 && time >= (1ULL << bucket))
+	{
+		bucket++;
+	}
+	_callTimes[call][open][bucket]++;
+	_callTotal_ns[call][open] += time;
+	if (time > _callMax_ns[call][open])
+	{
+		_callMax_ns[call][open] = time;
+	}
+	if (cpu > _callMaxCpu_ns[call][open])
+	{
+		_callMaxCpu_ns[call][open] = cpu;
+	}
+}
+
+
+/* _printCallTimes
+ *
+ * Prints, for each call with and without a session open, the number of calls, the
+ * mean time, the bound under which 99.9% of the calls returned, the longest call,
+ * the most CPU time a call took (the longest call less the time the host was
+ * running something else) and the non-empty buckets of the histogram.
+ */
+void _printCallTimes(void)
+{
+	static const char* calls[] = {"start", "update"};
+	static const char* states[] = {"no session", "session open"};
+	uint64_t count;
+	uint64_t under;
+	int call;
+	int open;
+	int bucket;
+	int p999;
+
+	printf("call time (us):\n");
+	for (call = CALL_START; call <= CALL_UPDATE; call++)
+	{
+		for (open = 0; open < 2; open++)
+		{
+			count = 0;
+			for (bucket = 0; bucket < CALL_TIME_BUCKETS; bucket++)
+			{
+				count += _callTimes[call][open][bucket];
+			}
+			if (count == 0)
+			{
+				continue;
+			}
+			under = 0;
+			p999 = 0;
+			while (p999 < CALL_TIME_BUCKETS - 1 && (under += _callTimes[call][open][p999]) * 1000 < count * 999)
+			{
+				p999++;
+			}
+			printf("  %-6s %-12s  %10llu calls  mean %.2f  99.9%% under %.2f  max %.1f  max CPU %.1f\n", calls[call],
+					states[open], (unsigned long long)count, (double)_callTotal_ns[call][open] / count / 1000,
+					(double)(1ULL << p999) / 1000, (double)_callMax_ns[call][open] / 1000,
+					(double)_callMaxCpu_ns[call][open] / 1000);
+			for (bucket = 0; bucket < CALL_TIME_BUCKETS; bucket++)
+			{
+				if (_callTimes[call][open][bucket] > 0)
+				{
+					printf("    < %10.3f  %llu\n", (double)(1ULL << bucket) / 1000,
+							(unsigned long long)_callTimes[call][open][bucket]);
+				}
+			}
+		}
+	}
+}
+
+
+/* _parseRxOverflow
+ *
+ * Reads a receive queue overflow policy by name.
+ */
+bool _parseRxOverflow(const char* name, SessionRxOverflow* policy)
+{
+	static const char* names[] = {"hold", "reject", "oldest", "newest"};
+	static const SessionRxOverflow policies[] = {SESSION_RX_HOLD, SESSION_RX_REJECT,
+			SESSION_RX_DROP_OLDEST, SESSION_RX_DROP_NEWEST};
+	uint32_t i;
+
+	for (i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+	{
+		if (!strcmp(name, names[i]))
+		{
+			*policy = policies[i];
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+/* _printRxStats
+ *
+ * Prints the receive queue's statistics for the last session.
+ */
+void _printRxStats(void)
+{
+	SessionRxStats stats;
+
+	desktopAppSession_rxStats(&stats);
+	printf("receive queue:  depth %u/%u, high water %u, pending %u, rejected %u, dropped oldest %u,"
+			" dropped newest %u\n", (unsigned)stats.depth, (unsigned)stats.capacity,
+			(unsigned)stats.highWater, (unsigned)stats.pending, (unsigned)stats.rejected,
+			(unsigned)stats.droppedOldest, (unsigned)stats.droppedNewest);
+}
+
+
+#ifdef SESSION_PROFILE
+/* _printProfile
+ *
+ * Prints the times of each stage, as the PROF command reports them.
+ */
+void _printProfile(void)
+{
+	StageProfileStats stats;
+	uint32_t stage;
+
+	printf("%-10s  %8s  %10s  %10s  %10s  (%s)\n", "stage", "count", "min", "max", "mean", stageProfile_unit());
+	for (stage = 0; stage < PROFILE_STAGES; stage++)
+	{
+		stageProfile_read((ProfileStage)stage, &stats);
+		printf("%-10s  %8lu  %10lu  %10lu  %10lu\n", stageProfile_name((ProfileStage)stage), (unsigned long)stats.count,
+				(unsigned long)stats.min, (unsigned long)stats.max,
+				(unsigned long)(stats.count > 0 ? stats.total / stats.count : 0));
+	}
+}
+#endif
+
+
+/* _printIdle
+ *
+ * Prints the share of the run the process was not using the CPU.  With the
+ * sequencer, also the share spent waiting in __WFI() and the runs of the session
+ * task.
+ */
+void _printIdle(uint64_t start_us)
+{
+	struct timespec cpu;
+	double elapsed_us = (double)(_now_us() - start_us);
+	double busy_us;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+	busy_us = (double)cpu.tv_sec * 1e6 + (double)cpu.tv_nsec / 1e3;
+	printf("CPU idle:  %.1f%% of %.1f s (process CPU time %.2f s)\n", 100.0 * (1.0 - busy_us / elapsed_us),
+			elapsed_us / 1e6, busy_us / 1e6);
+#ifdef SESSION_SEQUENCER
+	printf("waiting for interrupts:  %.1f%%, session task runs %u\n",
+			100.0 * (double)HAL_Host_idleTime_us() / elapsed_us, (unsigned)sessionSequencer_runs());
+#endif
+}
+
+
+/* _printLinkStats
+ *
+ * Prints the transport layer's and the session's counts.
+ */
+void _printLinkStats(void)
+{
+	SessionLinkStats stats;
+	RttEstimator rtt;
+
+	desktopAppSession_linkStats(&stats);
+	printf("tx  %lu packets  %lu bytes  high-water %lu (urgent %lu)\n", (unsigned long)stats.transport.txPackets,
+			(unsigned long)stats.transport.txBytes, (unsigned long)stats.transport.txHighWater,
+			(unsigned long)stats.transport.txUrgentHighWater);
+	printf("rx  %lu packets  %lu bytes  high-water %lu (receive queue %lu)\n",
+			(unsigned long)stats.transport.rxPackets, (unsigned long)stats.transport.rxBytes,
+			(unsigned long)stats.transport.rxHighWater, (unsigned long)stats.receiveHighWater);
+	printf("rx  %lu malformed  %lu noise bytes  %lu restarts\n", (unsigned long)stats.transport.rxMalformed,
+			(unsigned long)stats.transport.rxNoise, (unsigned long)stats.transport.rxRestarts);
+	printf("uart errors  %lu overrun  %lu framing  %lu noise  %lu parity  %lu dma\n",
+			(unsigned long)stats.transport.errOverrun, (unsigned long)stats.transport.errFraming,
+			(unsigned long)stats.transport.errNoise, (unsigned long)stats.transport.errParity,
+			(unsigned long)stats.transport.errDma);
+	printf("session  %lu handshakes (%lu failed)  %lu opened  %lu timeouts  %lu resends  %lu out of sequence"
+			"  %lu dropped\n", (unsigned long)stats.handshakes, (unsigned long)stats.handshakeFailures,
+			(unsigned long)stats.sessions, (unsigned long)stats.timeouts, (unsigned long)stats.resends,
+			(unsigned long)stats.outOfSequence, (unsigned long)stats.dropped);
+
+	desktopAppSession_roundTrip(&rtt);
+	printf("round trip  %lu ms smoothed  %lu ms variation  %lu ms timeout  (%lu samples)\n",
+			(unsigned long)rttEstimator_smoothed(&rtt), (unsigned long)rttEstimator_variation(&rtt),
+			(unsigned long)rttEstimator_timeout(&rtt), (unsigned long)rtt.samples);
+}
@@ -0,0 +1,158 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ */
+
+
+#include <stm32_seq.h>
+#include <stddef.h>
+
+
+/*
+ * Number of task IDs, one per bit of the task bitmask.
+ */
+#define SEQ_TASKS 32
+
+
+// Private Function Prototypes
+uint32_t _seq_index(UTIL_SEQ_bm_t TaskId_bm);
+
+
+// Private Variables
+static void (*_tasks[SEQ_TASKS])(void);						// Function of each task
+static volatile UTIL_SEQ_bm_t _pending[UTIL_SEQ_CONF_PRIO_NBR];	// Pending tasks, per priority
+
+
+/* UTIL_SEQ_Init
+ *
+ * Clears the task functions and the pending tasks.
+ */
+void UTIL_SEQ_Init(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < SEQ_TASKS; i++)
+	{
+		_tasks[i] = NULL;
+	}
+	for (i = 0; i < UTIL_SEQ_CONF_PRIO_NBR; i++)
+	{
+		_pending[i] = 0;
+	}
+}
+
+
+/* UTIL_SEQ_RegTask
+ *
+ * Keeps the function of the task's lowest set bit.
+ */
+void UTIL_SEQ_RegTask(UTIL_SEQ_bm_t TaskId_bm, uint32_t Flags, void (*Task)(void))
+{
+	if (TaskId_bm != 0)
+	{
+		_tasks[_seq_index(TaskId_bm)] = Task;
+	}
+}
+
+
+/* UTIL_SEQ_SetTask
+ *
+ * Marks the task pending at its priority, with interrupts masked.
+ */
+void UTIL_SEQ_SetTask(UTIL_SEQ_bm_t TaskId_bm, uint32_t Task_Prio)
+{
+	uint32_t primask = __get_PRIMASK();
+
+	if (Task_Prio >= UTIL_SEQ_CONF_PRIO_NBR)
+	{
+		Task_Prio = UTIL_SEQ_CONF_PRIO_NBR - 1;
+	}
+
+	__disable_irq();
+	_pending[Task_Prio] |= TaskId_bm;
+	__set_PRIMASK(primask);
+}
+
+
+/* UTIL_SEQ_IsSchedulableTask
+ *
+ * Checks every priority for the task.
+ */
+uint32_t UTIL_SEQ_IsSchedulableTask(UTIL_SEQ_bm_t TaskId_bm)
+{
+	uint32_t i;
+
+	for (i = 0; i < UTIL_SEQ_CONF_PRIO_NBR; i++)
+	{
+		if (_pending[i] & TaskId_bm)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+
+/* UTIL_SEQ_Run
+ *
+ * Takes the lowest task ID of the highest priority pending, clears it and runs it,
+ * until none in the mask is pending.  Then idles with interrupts masked, so an
+ * interrupt that sets a task between the check and the idle still wakes the core.
+ * The events held while masked are raised on the next tick read, as the
+ * interrupts would be taken on unmasking.
+ */
+void UTIL_SEQ_Run(UTIL_SEQ_bm_t Mask_bm)
+{
+	uint32_t primask;
+	uint32_t prio;
+	UTIL_SEQ_bm_t ready;
+	UTIL_SEQ_bm_t task;
+
+	for (;;)
+	{
+		primask = __get_PRIMASK();
+		__disable_irq();
+		ready = 0;
+		for (prio = 0; prio < UTIL_SEQ_CONF_PRIO_NBR && ready == 0; prio++)
+		{
+			ready = _pending[prio] & Mask_bm;
+		}
+
+		// none pending, idle
+		if (ready == 0)
+		{
+			UTIL_SEQ_Idle();
+			__set_PRIMASK(primask);
+			HAL_GetTick();
+			return;
+		}
+
+		task = ready & (~ready + 1);
+		_pending[prio - 1] &= ~task;
+		__set_PRIMASK(primask);
+
+		if (_tasks[_seq_index(task)] != NULL)
+		{
+			_tasks[_seq_index(task)]();
+		}
+	}
+}
+
+
+/* UTIL_SEQ_Idle
+ *
+ * Does nothing unless overridden, as in the sequencer.
+ */
+__attribute__((weak)) void UTIL_SEQ_Idle(void)
+{
+}
+
+
+/* _seq_index
+ *
+ * Returns the index of the lowest set bit of a task bitmask.
+ */
+uint32_t _seq_index(UTIL_SEQ_bm_t TaskId_bm)
+{
+	return (uint32_t)__builtin_ctz(TaskId_bm);
+}
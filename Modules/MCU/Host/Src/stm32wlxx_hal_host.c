@@ -0,0 +1,892 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ */
+
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+// termios.h names a delay mask CR3, which is also the USART register's name
+#undef CR3
+#include <stm32wlxx_hal.h>
+
+
+/*
+ * Most bytes moved between the pty and the UART per event check.  Bounds the
+ * time spent in one check when not throttled.
+ */
+#define HOST_PTY_CHUNK 64
+
+/*
+ * Simulated cores, indexed by _host_core().
+ */
+#define HOST_CORES 2
+
+
+// Private Function Prototypes
+uint64_t _host_now_us(void);
+uint32_t _host_byteTime_us(void);
+void _host_service(void);
+void _host_serviceTx(uint64_t now);
+void _host_serviceRx(uint64_t now);
+void _host_rxEvent(uint16_t position);
+uint32_t _host_core(void);
+uint32_t _host_ipccPending(void);
+void _host_serviceIpcc(void);
+void _host_ipccOpen(void);
+void _host_serviceNvic(void);
+
+
+// Private Variables
+USART_TypeDef HostUsart2;								// Registers of the simulated USART2
+static __thread uint32_t _cpuId = CM0PLUS_CPUID;		// Core the calling thread runs as
+static uint32_t _primask[HOST_CORES];					// Interrupts masked when set, per core
+static bool _inInterrupt[HOST_CORES];					// Flag for an event being raised, per core
+static uint64_t _idle_us[HOST_CORES];					// Time spent in __WFI(), per core
+static uint32_t _nvicPending[HOST_CORES];				// Interrupts pended, a bit per number, per core
+static uint64_t _startTime_us = 0;						// Host time the tick counts from
+static int _ptyMaster = -1;								// Pty master, the UART's side of the line
+static int _ptySlave = -1;								// Pty slave, held open so the line stays up
+static char _ptyLink[256] = "";							// Symbolic link to the slave, if made
+static bool _throttle = false;							// Flag to pace bytes at the baud rate
+static UART_HandleTypeDef* _uart = NULL;				// UART simulated on the pty
+static uint32_t _uartCpu = CM0PLUS_CPUID;				// Core that initialized the UART
+static const uint8_t* _txData = NULL;					// Bytes being transmitted
+static uint16_t _txSize = 0;							// Number of bytes being transmitted
+static uint16_t _txIndex = 0;							// Number of bytes written to the pty
+static uint64_t _txStart_us = 0;						// Host time the transmission started
+static bool _txDropped = false;							// Flag for the transmission being lost
+static uint32_t _txLoss = 0;							// Transmissions dropped in a thousand
+static uint32_t _txLossSeed = 1;						// State of the drop generator
+static uint8_t* _rxRing = NULL;							// DMA ring receiving
+static uint16_t _rxSize = 0;							// Size of the DMA ring
+static uint16_t _rxIndex = 0;							// Position the DMA writes next
+static uint16_t _rxReported = 0;						// Position of the last rx event
+static uint64_t _rxNext_us = 0;							// Host time the next byte can complete
+static bool _rxLineIdle = true;							// No bytes on the line at the last check
+static atomic_uint _ipccSet[HOST_CORES];				// Tx channels set by each core, a bit per channel
+static IPCC_HandleTypeDef* _ipcc[HOST_CORES];			// Each core's IPCC handle
+static uint32_t _ipccRxActive[HOST_CORES];				// Rx notifications each core activated
+static uint32_t _ipccRxMasked[HOST_CORES];				// Rx interrupts masked until notified back
+static int _ipccWake[HOST_CORES] = {-1, -1};			// Wakes each core from __WFI() when notified
+static pthread_once_t _ipccOnce = PTHREAD_ONCE_INIT;	// Opens the wake descriptors once
+
+
+/* __get_PRIMASK
+ *
+ * Returns the interrupt mask.
+ */
+uint32_t __get_PRIMASK(void)
+{
+	return _primask[_host_core()];
+}
+
+
+/* __set_PRIMASK
+ *
+ * Sets the interrupt mask.
+ */
+void __set_PRIMASK(uint32_t priMask)
+{
+	_primask[_host_core()] = priMask & 1;
+}
+
+
+/* __disable_irq
+ *
+ * Masks interrupts.
+ */
+void __disable_irq(void)
+{
+	_primask[_host_core()] = 1;
+}
+
+
+/* __enable_irq
+ *
+ * Unmasks interrupts.
+ */
+void __enable_irq(void)
+{
+	_primask[_host_core()] = 0;
+}
+
+
+/* HAL_NVIC_SetPendingIRQ
+ *
+ * Runs the handler at once if the core would take the interrupt now.
+ */
+void HAL_NVIC_SetPendingIRQ(IRQn_Type IRQn)
+{
+	uint32_t core = _host_core();
+
+	_nvicPending[core] |= 1U << IRQn;
+	if (!_primask[core] && !_inInterrupt[core])
+	{
+		_inInterrupt[core] = true;
+		_host_serviceNvic();
+		_inInterrupt[core] = false;
+	}
+}
+
+
+/* __WFI
+ *
+ * Polls the pty for the events that would interrupt the MCU, and the core's IPCC
+ * wake descriptor, with a timeout of the next tick or transmit complete.  While
+ * bytes are arriving on a throttled line the pty is not polled (it would be
+ * readable ahead of the bytes' time), so the tick wakes it, which counts less idle
+ * time than the MCU would have.  Returns at once if an IPCC channel is already
+ * waiting to interrupt the core.
+ */
+void __WFI(void)
+{
+	struct pollfd events[2] = { { -1, 0, 0 }, { -1, POLLIN, 0 } };
+	struct timespec timeout;
+	uint64_t start = _host_now_us();
+	uint64_t wake = start - (start - _startTime_us) % 1000 + 1000;
+	uint64_t txDone;
+	uint64_t count;
+	ssize_t taken;
+
+	if (_uart != NULL && _ptyMaster >= 0 && _cpuId == _uartCpu)
+	{
+		events[0].fd = _ptyMaster;
+
+		// bytes from the desktop application, once the line has gone idle
+		if (_rxRing != NULL && READ_BIT(_uart->Instance->CR3, USART_CR3_DMAR)
+				&& (!_throttle || _rxLineIdle))
+		{
+			events[0].events |= POLLIN;
+		}
+
+		// the transmission's end, or room in the pty for it
+		if (_txData != NULL)
+		{
+			txDone = _txStart_us + (uint64_t)_txSize * _host_byteTime_us();
+			if (!_throttle)
+			{
+				events[0].events |= POLLOUT;
+			}
+			else if (txDone < wake)
+			{
+				wake = (txDone > start) ? txDone : start;
+			}
+		}
+	}
+
+	// a channel set by the other core
+	events[1].fd = _ipccWake[_host_core()];
+	if (_host_ipccPending() != 0)
+	{
+		wake = start;
+	}
+
+	timeout.tv_sec = (time_t)((wake - start) / 1000000);
+	timeout.tv_nsec = (long)((wake - start) % 1000000) * 1000;
+	ppoll(events, 2, &timeout, NULL);
+
+	// take the wake, the channels themselves are read on the next tick
+	if (events[1].revents & POLLIN)
+	{
+		taken = read(events[1].fd, &count, sizeof(count));
+		(void)taken;
+	}
+
+	_idle_us[_host_core()] += _host_now_us() - start;
+}
+
+
+/* HAL_GetTick
+ *
+ * Raises the due events first, as if their interrupts had been taken just before
+ * the tick was read.
+ */
+uint32_t HAL_GetTick(void)
+{
+	_host_service();
+	return (uint32_t)((_host_now_us() - _startTime_us) / 1000);
+}
+
+
+/* HAL_Delay
+ *
+ * Waits in steps of a tenth of a millisecond so events are raised close to when
+ * they fall due.
+ */
+void HAL_Delay(uint32_t Delay)
+{
+	struct timespec step = { 0, 100000 };
+	uint32_t tickstart = HAL_GetTick();
+
+	while ((HAL_GetTick() - tickstart) < Delay)
+	{
+		nanosleep(&step, NULL);
+	}
+}
+
+
+/* HAL_UART_Init
+ *
+ * Takes the handle as the UART on the pty.  The baud rate only sets the pacing
+ * when throttled.
+ */
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart)
+{
+	if (huart == NULL || huart->Instance == NULL || huart->Init.BaudRate == 0)
+	{
+		return HAL_ERROR;
+	}
+
+	_uart = huart;
+	_uartCpu = _cpuId;
+	huart->gState = HAL_UART_STATE_READY;
+	huart->RxState = HAL_UART_STATE_READY;
+	huart->ErrorCode = HAL_UART_ERROR_NONE;
+	return HAL_OK;
+}
+
+
+/* HAL_UART_Abort
+ *
+ * Stops transmission and reception.  Bytes not yet written to the pty are
+ * dropped, as are any that arrive until reception is restarted.
+ */
+HAL_StatusTypeDef HAL_UART_Abort(UART_HandleTypeDef *huart)
+{
+	_txData = NULL;
+	_rxRing = NULL;
+	CLEAR_BIT(huart->Instance->CR3, USART_CR3_DMAR);
+	huart->gState = HAL_UART_STATE_READY;
+	huart->RxState = HAL_UART_STATE_READY;
+	return HAL_OK;
+}
+
+
+/* HAL_UART_Transmit_IT
+ *
+ * Transmitted the same as by DMA; the simulation has no byte interrupts.
+ */
+HAL_StatusTypeDef HAL_UART_Transmit_IT(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size)
+{
+	return HAL_UART_Transmit_DMA(huart, pData, Size);
+}
+
+
+/* HAL_UART_Transmit_DMA
+ *
+ * Starts writing the bytes to the pty.  HAL_UART_TxCpltCallback() is raised once
+ * the last is written.
+ */
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size)
+{
+	if (huart != _uart || pData == NULL || Size == 0)
+	{
+		return HAL_ERROR;
+	}
+	if (huart->gState != HAL_UART_STATE_READY)
+	{
+		return HAL_BUSY;
+	}
+
+	_txData = pData;
+	_txSize = Size;
+	_txIndex = 0;
+	_txStart_us = _host_now_us();
+	_txLossSeed = _txLossSeed * 1103515245U + 12345U;
+	_txDropped = ((_txLossSeed >> 16) % 1000) < _txLoss;
+	huart->gState = HAL_UART_STATE_BUSY_TX;
+	return HAL_OK;
+}
+
+
+/* HAL_UARTEx_ReceiveToIdle_DMA
+ *
+ * Starts receiving from the pty into a circular DMA ring.  As with the HAL in
+ * circular mode, HAL_UARTEx_RxEventCallback() is raised at half and full ring
+ * and when the line goes idle, with the position the DMA has written up to.
+ */
+HAL_StatusTypeDef HAL_UARTEx_ReceiveToIdle_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size)
+{
+	if (huart != _uart || pData == NULL || Size == 0)
+	{
+		return HAL_ERROR;
+	}
+	if (huart->RxState != HAL_UART_STATE_READY)
+	{
+		return HAL_BUSY;
+	}
+
+	_rxRing = pData;
+	_rxSize = Size;
+	_rxIndex = 0;
+	_rxReported = 0;
+	_rxNext_us = _host_now_us();
+	_rxLineIdle = true;
+	SET_BIT(huart->Instance->CR3, USART_CR3_DMAR);
+	huart->RxState = HAL_UART_STATE_BUSY_RX;
+	return HAL_OK;
+}
+
+
+/*
+ * Weak callbacks, overridden by the module.
+ */
+__attribute__((weak)) void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+	(void)huart;
+}
+
+__attribute__((weak)) void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+	(void)huart;
+}
+
+__attribute__((weak)) void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size)
+{
+	(void)huart;
+	(void)Size;
+}
+
+__attribute__((weak)) void USART2_IRQHandler(void)
+{
+}
+
+
+/* HAL_GetCurrentCPUID
+ *
+ * Returns the core the calling thread runs as.
+ */
+uint32_t HAL_GetCurrentCPUID(void)
+{
+	return _cpuId;
+}
+
+
+/* HAL_IPCC_Init
+ *
+ * Takes the handle as the calling core's, with no notifications activated.
+ */
+HAL_StatusTypeDef HAL_IPCC_Init(IPCC_HandleTypeDef *hipcc)
+{
+	uint32_t core = _host_core();
+
+	if (hipcc == NULL)
+	{
+		return HAL_ERROR;
+	}
+
+	pthread_once(&_ipccOnce, _host_ipccOpen);
+	memset(hipcc->ChannelCallbackRx, 0, sizeof(hipcc->ChannelCallbackRx));
+	_ipcc[core] = hipcc;
+	_ipccRxActive[core] = 0;
+	_ipccRxMasked[core] = 0;
+	return HAL_OK;
+}
+
+
+/* HAL_IPCC_ActivateNotification
+ *
+ * Sets the rx callback of a channel and unmasks its interrupt.
+ */
+HAL_StatusTypeDef HAL_IPCC_ActivateNotification(IPCC_HandleTypeDef *hipcc, uint32_t ChannelIndex,
+		IPCC_CHANNELDirTypeDef ChannelDir, void (*cb)(IPCC_HandleTypeDef *hipcc, uint32_t ChannelIndex,
+				IPCC_CHANNELDirTypeDef ChannelDir))
+{
+	uint32_t core = _host_core();
+
+	if (hipcc != _ipcc[core] || ChannelIndex >= IPCC_CHANNEL_NUMBER || ChannelDir != IPCC_CHANNEL_DIR_RX
+			|| cb == NULL)
+	{
+		return HAL_ERROR;
+	}
+
+	hipcc->ChannelCallbackRx[ChannelIndex] = cb;
+	_ipccRxActive[core] |= 1U << ChannelIndex;
+	_ipccRxMasked[core] &= ~(1U << ChannelIndex);
+	return HAL_OK;
+}
+
+
+/* HAL_IPCC_DeActivateNotification
+ *
+ * Masks a channel's rx interrupt.
+ */
+HAL_StatusTypeDef HAL_IPCC_DeActivateNotification(IPCC_HandleTypeDef *hipcc, uint32_t ChannelIndex,
+		IPCC_CHANNELDirTypeDef ChannelDir)
+{
+	uint32_t core = _host_core();
+
+	if (hipcc != _ipcc[core] || ChannelIndex >= IPCC_CHANNEL_NUMBER || ChannelDir != IPCC_CHANNEL_DIR_RX)
+	{
+		return HAL_ERROR;
+	}
+
+	_ipccRxActive[core] &= ~(1U << ChannelIndex);
+	return HAL_OK;
+}
+
+
+/* HAL_IPCC_GetChannelStatus
+ *
+ * Reads the calling core's channel (tx) or the other core's (rx).
+ */
+IPCC_CHANNELStatusTypeDef HAL_IPCC_GetChannelStatus(IPCC_HandleTypeDef const *const hipcc, uint32_t ChannelIndex,
+		IPCC_CHANNELDirTypeDef ChannelDir)
+{
+	uint32_t core = _host_core();
+	uint32_t owner = (ChannelDir == IPCC_CHANNEL_DIR_TX) ? core : HOST_CORES - 1 - core;
+
+	if (ChannelIndex >= IPCC_CHANNEL_NUMBER)
+	{
+		return IPCC_CHANNEL_STATUS_FREE;
+	}
+
+	return (atomic_load(&_ipccSet[owner]) & (1U << ChannelIndex)) ? IPCC_CHANNEL_STATUS_OCCUPIED
+			: IPCC_CHANNEL_STATUS_FREE;
+}
+
+
+/* HAL_IPCC_NotifyCPU
+ *
+ * Sets the calling core's channel and wakes the other core (tx), or frees the other
+ * core's channel and unmasks its rx interrupt (rx).
+ */
+HAL_StatusTypeDef HAL_IPCC_NotifyCPU(IPCC_HandleTypeDef const *const hipcc, uint32_t ChannelIndex,
+		IPCC_CHANNELDirTypeDef ChannelDir)
+{
+	uint32_t core = _host_core();
+	uint32_t other = HOST_CORES - 1 - core;
+	uint64_t one = 1;
+	ssize_t written;
+
+	if (ChannelIndex >= IPCC_CHANNEL_NUMBER)
+	{
+		return HAL_ERROR;
+	}
+
+	if (ChannelDir == IPCC_CHANNEL_DIR_TX)
+	{
+		atomic_fetch_or(&_ipccSet[core], 1U << ChannelIndex);
+		if (_ipccWake[other] >= 0)
+		{
+			written = write(_ipccWake[other], &one, sizeof(one));
+			(void)written;
+		}
+	}
+	else
+	{
+		atomic_fetch_and(&_ipccSet[other], ~(1U << ChannelIndex));
+		_ipccRxMasked[core] &= ~(1U << ChannelIndex);
+	}
+	return HAL_OK;
+}
+
+
+/* HAL_Host_setTxLoss
+ *
+ * Drawn by a linear congruential generator as each transmission starts.
+ */
+void HAL_Host_setTxLoss(uint32_t permille)
+{
+	_txLoss = permille;
+	_txLossSeed = 1;
+}
+
+
+/* HAL_Host_setCurrentCPUID
+ *
+ * Sets the core of the calling thread.
+ */
+void HAL_Host_setCurrentCPUID(uint32_t cpuId)
+{
+	_cpuId = cpuId;
+}
+
+
+/* HAL_Host_openPty
+ *
+ * Opens a pty in raw mode and non-blocking on the master side.  The slave is set
+ * raw before the desktop application opens it so nothing is echoed back, and is
+ * held open so the master does not see a hang-up between desktop connections.
+ */
+const char* HAL_Host_openPty(bool throttle, const char* linkPath)
+{
+	struct termios attributes;
+	const char* slaveName;
+
+	_startTime_us = _host_now_us();
+	_throttle = throttle;
+	memset(_idle_us, 0, sizeof(_idle_us));
+
+	_ptyMaster = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (_ptyMaster < 0 || grantpt(_ptyMaster) != 0 || unlockpt(_ptyMaster) != 0
+			|| (slaveName = ptsname(_ptyMaster)) == NULL)
+	{
+		HAL_Host_closePty();
+		return NULL;
+	}
+
+	_ptySlave = open(slaveName, O_RDWR | O_NOCTTY);
+	if (_ptySlave < 0 || tcgetattr(_ptySlave, &attributes) != 0)
+	{
+		HAL_Host_closePty();
+		return NULL;
+	}
+	cfmakeraw(&attributes);
+	tcsetattr(_ptySlave, TCSANOW, &attributes);
+
+	if (linkPath != NULL)
+	{
+		unlink(linkPath);
+		if (symlink(slaveName, linkPath) == 0)
+		{
+			strncpy(_ptyLink, linkPath, sizeof(_ptyLink) - 1);
+		}
+	}
+
+	return slaveName;
+}
+
+
+/* HAL_Host_closePty
+ *
+ * Closes both sides of the pty.
+ */
+void HAL_Host_closePty(void)
+{
+	if (_ptyLink[0] != '\0')
+	{
+		unlink(_ptyLink);
+		_ptyLink[0] = '\0';
+	}
+	if (_ptySlave >= 0)
+	{
+		close(_ptySlave);
+		_ptySlave = -1;
+	}
+	if (_ptyMaster >= 0)
+	{
+		close(_ptyMaster);
+		_ptyMaster = -1;
+	}
+}
+
+
+/* HAL_Host_idleTime_us
+ *
+ * Returns the time counted by the calling core's __WFI().
+ */
+uint64_t HAL_Host_idleTime_us(void)
+{
+	return _idle_us[_host_core()];
+}
+
+
+/* _host_now_us
+ *
+ * Returns the host's monotonic time in microseconds.
+ */
+uint64_t _host_now_us(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000;
+}
+
+
+/* _host_byteTime_us
+ *
+ * Returns the time a byte takes on the line at the UART's baud rate:  a start
+ * bit, the word (which includes parity) and the stop bits.
+ */
+uint32_t _host_byteTime_us(void)
+{
+	uint32_t bits = 1 + 8 + (_uart->Init.StopBits == UART_STOPBITS_2 ? 2 : 1);
+
+	if (_uart->Init.WordLength == UART_WORDLENGTH_7B)
+	{
+		bits -= 1;
+	}
+	else if (_uart->Init.WordLength == UART_WORDLENGTH_9B)
+	{
+		bits += 1;
+	}
+
+	return (uint32_t)(((uint64_t)bits * 1000000 + _uart->Init.BaudRate - 1) / _uart->Init.BaudRate);
+}
+
+
+/* _host_service
+ *
+ * Raises the calling core's events that are due, as their interrupts would be:
+ * the UART's on the core that initialized it, the IPCC's, and those pended while
+ * they could not be taken.  Does nothing while interrupts are masked or from
+ * within an event.
+ */
+void _host_service(void)
+{
+	uint32_t core = _host_core();
+	uint64_t now;
+
+	if (_primask[core] || _inInterrupt[core])
+	{
+		return;
+	}
+
+	_inInterrupt[core] = true;
+	if (_uart != NULL && _ptyMaster >= 0 && _cpuId == _uartCpu)
+	{
+		now = _host_now_us();
+		_host_serviceTx(now);
+		_host_serviceRx(now);
+	}
+	_host_serviceIpcc();
+	_host_serviceNvic();
+	_inInterrupt[core] = false;
+}
+
+
+/* _host_serviceTx
+ *
+ * Writes the bytes of the transmission that are due to the pty.  Raises transmit
+ * complete once the last is written.  A desktop application that is not reading
+ * holds transmission up once the pty's buffer is full, as a paused line would.
+ */
+void _host_serviceTx(uint64_t now)
+{
+	uint32_t due;
+	ssize_t written;
+
+	if (_txData == NULL)
+	{
+		return;
+	}
+
+	// bytes that have had the time to go out
+	due = _txSize;
+	if (_throttle)
+	{
+		due = (uint32_t)((now - _txStart_us) / _host_byteTime_us());
+		if (due > _txSize)
+		{
+			due = _txSize;
+		}
+	}
+
+	if (due > _txIndex && _txDropped)
+	{
+		_txIndex = (uint16_t)due;
+	}
+	else if (due > _txIndex)
+	{
+		written = write(_ptyMaster, _txData + _txIndex, due - _txIndex);
+		if (written > 0)
+		{
+			_txIndex += (uint16_t)written;
+		}
+	}
+
+	// done
+	if (_txIndex == _txSize)
+	{
+		_txData = NULL;
+		_uart->gState = HAL_UART_STATE_READY;
+		HAL_UART_TxCpltCallback(_uart);
+	}
+}
+
+
+/* _host_serviceRx
+ *
+ * Moves the bytes the desktop application wrote to the pty into the DMA ring, as
+ * many as have had the time to arrive.  Raises the half and full ring events as
+ * the position reaches them, and the idle event when the pty has no more bytes.
+ * Nothing is taken while DMA requests are stopped (USART_CR3_DMAR clear), so the
+ * desktop application is held off by the pty's buffer filling, as by RTS.
+ */
+void _host_serviceRx(uint64_t now)
+{
+	uint8_t bytes[HOST_PTY_CHUNK];
+	uint32_t allowed = HOST_PTY_CHUNK;
+	uint32_t byteTime_us;
+	uint16_t boundary;
+	ssize_t count;
+	ssize_t i;
+
+	if (_rxRing == NULL || !READ_BIT(_uart->Instance->CR3, USART_CR3_DMAR))
+	{
+		// a sender held off stops
+		_rxLineIdle = true;
+		return;
+	}
+
+	// bytes that have had the time to arrive, after an idle line the first
+	// is taken as arriving now (the line is only idle once seen with nothing
+	// on it, so bytes keep arriving at the baud rate however seldom they are
+	// checked for)
+	if (_throttle)
+	{
+		byteTime_us = _host_byteTime_us();
+		if (_rxLineIdle && _rxNext_us + byteTime_us < now)
+		{
+			_rxNext_us = now - byteTime_us;
+		}
+		allowed = (uint32_t)((now - _rxNext_us) / byteTime_us);
+		if (allowed > HOST_PTY_CHUNK)
+		{
+			allowed = HOST_PTY_CHUNK;
+		}
+	}
+
+	// up to the next half or full ring, so events are only raised after the last
+	// byte read (an event may stop DMA requests)
+	boundary = (_rxIndex < _rxSize / 2) ? _rxSize / 2 : _rxSize;
+	if (allowed > (uint32_t)(boundary - _rxIndex))
+	{
+		allowed = boundary - _rxIndex;
+	}
+	if (allowed == 0)
+	{
+		return;
+	}
+
+	count = read(_ptyMaster, bytes, allowed);
+	_rxLineIdle = (count <= 0);
+	if (count <= 0)
+	{
+		// nothing more on the line, report the position if not already
+		if ((count == 0 || errno == EAGAIN) && _rxIndex != _rxReported)
+		{
+			_host_rxEvent(_rxIndex);
+		}
+		return;
+	}
+	if (_throttle)
+	{
+		_rxNext_us += (uint64_t)count * _host_byteTime_us();
+	}
+
+	// DMA the bytes into the ring
+	for (i = 0; i < count; i++)
+	{
+		_rxRing[_rxIndex++] = bytes[i];
+	}
+
+	// half or full ring
+	if (_rxIndex == _rxSize / 2)
+	{
+		_host_rxEvent(_rxIndex);
+	}
+	else if (_rxIndex == _rxSize)
+	{
+		_rxIndex = 0;
+		_host_rxEvent(_rxSize);
+	}
+}
+
+
+/* _host_rxEvent
+ *
+ * Raises an rx event at a ring position.
+ */
+void _host_rxEvent(uint16_t position)
+{
+	_rxReported = position % _rxSize;
+	HAL_UARTEx_RxEventCallback(_uart, position);
+}
+
+
+/* _host_core
+ *
+ * Returns the index of the calling core.
+ */
+uint32_t _host_core(void)
+{
+	return (_cpuId == CM4_CPUID) ? 0 : 1;
+}
+
+
+/* _host_ipccPending
+ *
+ * Returns the channels set by the other core whose rx interrupt the calling core
+ * would take, a bit per channel.
+ */
+uint32_t _host_ipccPending(void)
+{
+	uint32_t core = _host_core();
+
+	if (_ipcc[core] == NULL)
+	{
+		return 0;
+	}
+
+	return atomic_load(&_ipccSet[HOST_CORES - 1 - core]) & _ipccRxActive[core] & ~_ipccRxMasked[core];
+}
+
+
+/* _host_serviceIpcc
+ *
+ * Raises the rx callbacks of the channels pending, masking each channel's interrupt
+ * until the callback (or later code) notifies it back, as the HAL's interrupt
+ * handler does.
+ */
+void _host_serviceIpcc(void)
+{
+	uint32_t core = _host_core();
+	uint32_t pending = _host_ipccPending();
+	uint32_t channel;
+
+	for (channel = 0; pending != 0 && channel < IPCC_CHANNEL_NUMBER; channel++)
+	{
+		if (pending & (1U << channel))
+		{
+			_ipccRxMasked[core] |= 1U << channel;
+			_ipcc[core]->ChannelCallbackRx[channel](_ipcc[core], channel, IPCC_CHANNEL_DIR_RX);
+		}
+	}
+}
+
+
+/* _host_ipccOpen
+ *
+ * Opens the descriptors that wake each core from __WFI().
+ */
+void _host_ipccOpen(void)
+{
+	uint32_t core;
+
+	for (core = 0; core < HOST_CORES; core++)
+	{
+		_ipccWake[core] = eventfd(0, EFD_NONBLOCK);
+	}
+}
+
+
+/* _host_serviceNvic
+ *
+ * Runs the handlers of the calling core's pended interrupts, clearing each before
+ * its handler runs so the handler can pend it again.
+ */
+void _host_serviceNvic(void)
+{
+	uint32_t core = _host_core();
+
+	while (_nvicPending[core] & (1U << USART2_IRQn))
+	{
+		_nvicPending[core] &= ~(1U << USART2_IRQn);
+		USART2_IRQHandler();
+	}
+}
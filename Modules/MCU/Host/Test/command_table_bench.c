@@ -0,0 +1,89 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ *
+ * Benchmark of the command table (command_table.h).
+ */
+
+
+#include <host_test.h>
+#include <command_table.h>
+#include <stdio.h>
+#include <string.h>
+
+
+/*
+ * Lookups of each registered header are timed over a table large enough to stay
+ * half empty at the most headers.
+ */
+#define TABLE_BENCH_SIZE 512
+#define TABLE_BENCH_HEADERS_MAX 200
+#define TABLE_BENCH_LOOKUPS 2000000
+
+
+COMMAND_TABLE_DEFINE(_table, TABLE_BENCH_SIZE);		// table timed
+
+
+/* commandTableBench_run
+ *
+ * Times finding each of a number of headers through the command table and through
+ * a chain of header comparisons (as an if/else ladder of strncmp() does), looking up
+ * the registered headers in turn.  Prints the time per lookup.
+ */
+void commandTableBench_run(void)
+{
+	static const uint32_t counts[] = {5, 50, 200};
+	static char headers[TABLE_BENCH_HEADERS_MAX][UART_PACKET_HEADER_SIZE + 1];
+	volatile uint32_t sink = 0;
+	uint64_t start;
+	double table_ns;
+	double chain_ns;
+	uint32_t count;
+	uint32_t lookup;
+	uint32_t i;
+	uint32_t c;
+
+	for (i = 0; i < TABLE_BENCH_HEADERS_MAX; i++)
+	{
+		snprintf(headers[i], sizeof(headers[i]), "C%03u", (unsigned)i);
+	}
+
+	printf("headers  table (ns/lookup)  strncmp chain (ns/lookup)\n");
+	for (c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+	{
+		count = counts[c];
+		commandTable_reset(&_table);
+		for (i = 0; i < count; i++)
+		{
+			commandTable_insert(&_table, commandId((const uint8_t*)headers[i]));
+		}
+
+		// through the table
+		start = test_now_ns();
+		for (lookup = 0; lookup < TABLE_BENCH_LOOKUPS; lookup++)
+		{
+			sink += commandTable_find(&_table, commandId((const uint8_t*)headers[lookup % count]));
+		}
+		table_ns = (double)(test_now_ns() - start) / TABLE_BENCH_LOOKUPS;
+
+		// through the chain of comparisons
+		start = test_now_ns();
+		for (lookup = 0; lookup < TABLE_BENCH_LOOKUPS; lookup++)
+		{
+			const char* header = headers[lookup % count];
+
+			for (i = 0; i < count; i++)
+			{
+				if (!strncmp(header, headers[i], UART_PACKET_HEADER_SIZE))
+				{
+					break;
+				}
+			}
+			sink += i;
+		}
+		chain_ns = (double)(test_now_ns() - start) / TABLE_BENCH_LOOKUPS;
+
+		printf("%7u  %18.1f  %25.1f\n", (unsigned)count, table_ns, chain_ns);
+	}
+	(void)sink;
+}
@@ -0,0 +1,703 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ *
+ * Checks of sessions with the desktop application (desktop_app_session.h) over the
+ * simulated UART, the checks taking the desktop's part.  The link segment's checks
+ * run in the mode the module is built with.
+ */
+
+
+#include <host_test.h>
+#include <desktop_app_session.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+
+/*
+ * Time to wait for a frame that should arrive, and to wait out one that should
+ * not.  Retransmission waits for the retransmit timeout, backed off after a
+ * resend, so waits that span it are longer.
+ */
+#define FRAME_TIMEOUT_MS 200
+#define QUIET_TIME_MS 20
+#define RETRANSMIT_WAIT_MS 1000
+
+/*
+ * Number of hexadecimal digits of the session token in the ACKN.
+ */
+#define TOKEN_DIGITS 8
+
+/*
+ * Time the budget checks' handler takes, a budget shorter than it, and one ample
+ * for several messages.
+ */
+#define SLOW_HANDLER_US 200
+#define SHORT_BUDGET_US 50
+#define AMPLE_BUDGET_US 100000
+#define SLOW_MESSAGES 3
+
+/*
+ * Offsets in the STAT reply of the packets received and the sessions opened (see
+ * desktop_app_session.h).
+ */
+#define STAT_RX_PACKETS 5
+#define STAT_SESSIONS 37
+
+
+/*
+ * Private helper function prototypes.
+ */
+bool _open(void);
+void _close(void);
+void _pump(void);
+void _enqueue(const char* body);
+bool _receiveMessage(const char header[UART_PACKET_HEADER_SIZE], uint8_t seq, uint8_t ack, const char* body);
+bool _quiet(void);
+bool _dequeued(const char* body);
+uint32_t _checkHandshake(void);
+uint32_t _checkBudget(void);
+uint32_t _checkStat(void);
+uint32_t _checkResume(void);
+uint32_t _checkResumeRefused(const char* name, const char* token);
+bool _receiveStat(uint8_t bytes[SESSION_STAT_SIZE]);
+uint32_t _statCount(const uint8_t bytes[SESSION_STAT_SIZE], uint8_t offset, uint8_t size);
+DesktopComSessionStatus _slowHandler(const PacketView* message, void* context);
+void _pumpBudgeted(void);
+#ifdef SESSION_WINDOWED
+uint32_t _checkWindowed(void);
+#endif
+#ifdef SESSION_CREDIT
+uint32_t _checkCredit(void);
+bool _receiveCredit(uint8_t credit, uint32_t timeout_ms);
+bool _dequeuedNumber(uint32_t number);
+#endif
+
+
+// Private Variables
+static char _token[TOKEN_DIGITS + 1];		// Token of the session opened
+
+
+/* desktopAppSessionTest_check
+ *
+ * Runs each group of checks on a session of its own.
+ */
+uint32_t desktopAppSessionTest_check(void)
+{
+	uint32_t failed = 0;
+
+	failed += _checkHandshake();
+	failed += _checkBudget();
+	failed += _checkStat();
+	failed += _checkResume();
+#ifdef SESSION_WINDOWED
+	failed += _checkWindowed();
+#endif
+#ifdef SESSION_CREDIT
+	failed += _checkCredit();
+#endif
+
+	return failed;
+}
+
+
+/* _checkHandshake
+ *
+ * Checks that a SYNC is answered with an ACKN holding the session token, and that
+ * the SYNA opens the session.
+ */
+uint32_t _checkHandshake(void)
+{
+	uint32_t failed = 0;
+	bool hex = true;
+	uint32_t i;
+
+	failed += test_check("handshake:  session opened", _open());
+	for (i = 0; i < TOKEN_DIGITS; i++)
+	{
+		hex = hex && isxdigit((unsigned char)_token[i]);
+	}
+	failed += test_check("handshake:  ACKN carries the session token", hex);
+
+	_close();
+	return failed;
+}
+
+
+/* _checkBudget
+ *
+ * Checks that with a budget shorter than a handler, each update dispatches one
+ * message, and that the stage after dispatching (acknowledging, granting credit or
+ * opening a CTS window) is run by a later update rather than skipped for good.
+ * Then that an ample budget dispatches several messages in one update.
+ */
+uint32_t _checkBudget(void)
+{
+	char header[UART_PACKET_HEADER_SIZE] = {'S', 'L', 'O', 'W'};
+#if UART_PACKET_LINK_SIZE == 0 && !defined(UART_HW_FLOW_CONTROL)
+	PacketView view;
+#endif
+	uint32_t handled = 0;
+	uint32_t most = 0;
+	uint32_t before;
+	uint32_t updates;
+	uint32_t failed = 0;
+	bool receiving = true;
+	uint8_t i;
+
+	if (test_check("budget:  session opened", _open()) != 0)
+	{
+		_close();
+		return 1;
+	}
+	desktopAppSession_registerHandler(header, _slowHandler, &handled);
+
+	// messages received before the updates run
+	testLink_setPump(NULL);
+	testLink_drain(QUIET_TIME_MS);
+	for (i = 0; i < SLOW_MESSAGES; i++)
+	{
+		testLink_send(header, i, 0, "");
+	}
+	testLink_run(QUIET_TIME_MS);
+
+	// a short budget takes one message an update
+	for (updates = 0; updates < 4 * SLOW_MESSAGES && handled < SLOW_MESSAGES; updates++)
+	{
+		before = handled;
+		desktopAppSession_updateWithin(SHORT_BUDGET_US, NULL);
+		most = (handled - before > most) ? handled - before : most;
+	}
+	failed += test_check("budget:  one message an update with a budget shorter than a handler",
+			handled == SLOW_MESSAGES && most == 1);
+
+	// the stage after dispatching runs on a later update
+	testLink_setPump(_pumpBudgeted);
+#if defined(SESSION_WINDOWED)
+	receiving = _receiveMessage(ACK_HEADER, UART_LINK_ACK_ONLY, SLOW_MESSAGES, "");
+#elif defined(SESSION_CREDIT)
+	receiving = _receiveCredit(SLOW_MESSAGES + SESSION_CREDITS, FRAME_TIMEOUT_MS);
+#elif UART_PACKET_LINK_SIZE == 0 && !defined(UART_HW_FLOW_CONTROL)
+	receiving = testLink_receiveHeader(&view, CTS_HEADER, FRAME_TIMEOUT_MS);
+#endif
+	failed += test_check("budget:  stages left over run by the next updates", receiving);
+
+	// an ample budget takes every message
+	testLink_setPump(NULL);
+	for (i = SLOW_MESSAGES; i < 2 * SLOW_MESSAGES - 1; i++)
+	{
+		testLink_send(header, i, 0, "");
+	}
+	testLink_run(QUIET_TIME_MS);
+	// (with RTS/CTS flow control, messages are taken in after the dispatch stage)
+	most = 0;
+	for (updates = 0; updates < 2 && handled < 2 * SLOW_MESSAGES - 1; updates++)
+	{
+		before = handled;
+		desktopAppSession_updateWithin(AMPLE_BUDGET_US, NULL);
+		most = (handled - before > most) ? handled - before : most;
+	}
+	failed += test_check("budget:  several messages an update with an ample budget",
+			most == SLOW_MESSAGES - 1);
+
+	_close();
+	return failed;
+}
+
+
+/* _checkStat
+ *
+ * Checks that STAT is answered with the layout version and the link statistics,
+ * packed into 7-bit characters, and that "reset" zeroes them once answered.
+ */
+uint32_t _checkStat(void)
+{
+	SessionLinkStats stats;
+	uint8_t bytes[SESSION_STAT_SIZE];
+	uint32_t failed = 0;
+	bool received;
+
+	if (test_check("stat:  session opened", _open()) != 0)
+	{
+		_close();
+		return 1;
+	}
+
+	// the statistics, as read on the MCU
+	testLink_send(STAT_HEADER, 0, 0, "");
+	received = _receiveStat(bytes);
+	desktopAppSession_linkStats(&stats);
+	failed += test_check("stat:  answered with the layout version", received && bytes[0] == SESSION_STAT_VERSION);
+	failed += test_check("stat:  packets received and sessions opened as the link statistics",
+			received && _statCount(bytes, STAT_RX_PACKETS, 4) == stats.transport.rxPackets
+			&& _statCount(bytes, STAT_SESSIONS, 2) == stats.sessions);
+
+	// zeroed once answered
+	testLink_send(STAT_HEADER, 1, 0, "reset");
+	received = _receiveStat(bytes);
+	desktopAppSession_linkStats(&stats);
+	failed += test_check("stat:  \"reset\" answered, then zeroed",
+			received && _statCount(bytes, STAT_SESSIONS, 2) == 1 && stats.transport.rxPackets == 0 && stats.sessions == 0);
+
+	_close();
+	return failed;
+}
+
+
+/* _checkResume
+ *
+ * Checks that a RSUM with the session's token is answered with a RSUM, with where
+ * each side goes on from in link modes, and that the session stays open, with the
+ * message not acknowledged sent again in windowed mode.  Then that a RSUM with
+ * another token, or a zero one, gets a DISC and closes the session, and that a
+ * RSUM to a closed session gets a DISC.
+ */
+uint32_t _checkResume(void)
+{
+	PacketView view;
+	uint32_t failed = 0;
+	bool replied;
+
+	if (test_check("resume:  session opened", _open()) != 0)
+	{
+		_close();
+		return 1;
+	}
+
+#ifdef SESSION_WINDOWED
+	// a message the desktop lost with the connection
+	_enqueue("m0");
+	failed += test_check("resume:  message sent before the connection was lost", _receiveMessage("TEST", 0, 0, "m0"));
+#endif
+
+	// the right token
+	testLink_send(RESUME_HEADER, UART_LINK_UNSEQUENCED, 0, _token);
+	replied = testLink_receiveHeader(&view, RESUME_HEADER, FRAME_TIMEOUT_MS);
+#if UART_PACKET_LINK_SIZE > 0
+	replied = replied && strcmp((const char*)view.payload, "0 0") == 0;
+#endif
+	failed += test_check("resume:  right token answered with a RSUM", replied);
+#ifdef SESSION_WINDOWED
+	// (at once, well ahead of the retransmit timeout)
+	failed += test_check("resume:  message not acknowledged sent again", testLink_receive(&view, QUIET_TIME_MS)
+			&& memcmp(view.header, "TEST", UART_PACKET_HEADER_SIZE) == 0 && view.link[UART_LINK_SEQ] == 0);
+#endif
+	testLink_run(QUIET_TIME_MS);
+	failed += test_check("resume:  session still open", sessionOpen());
+	_close();
+
+	// other tokens
+	failed += _checkResumeRefused("resume:  wrong token answered with a DISC, session closed", "0BADF00D");
+	failed += _checkResumeRefused("resume:  zero token answered with a DISC, session closed", "00000000");
+
+	return failed;
+}
+
+
+/* _checkResumeRefused
+ *
+ * Checks that a RSUM with a token other than the session's gets a DISC and closes
+ * the session, and then that one to the closed session gets a DISC too.
+ */
+uint32_t _checkResumeRefused(const char* name, const char* token)
+{
+	PacketView view;
+	uint32_t failed = 0;
+	bool refused;
+
+	if (!_open())
+	{
+		_close();
+		return test_check(name, false);
+	}
+	if (strcmp(token, _token) == 0)
+	{
+		token = "0000000F";
+	}
+
+	// an open session
+	testLink_send(RESUME_HEADER, UART_LINK_UNSEQUENCED, 0, token);
+	refused = testLink_receiveHeader(&view, HANDSHAKE_HEADER_DISC, FRAME_TIMEOUT_MS);
+	testLink_run(QUIET_TIME_MS);
+	failed += test_check(name, refused && !sessionOpen());
+
+	// the closed session
+	testLink_drain(QUIET_TIME_MS);
+	testLink_send(RESUME_HEADER, UART_LINK_UNSEQUENCED, 0, _token);
+	failed += test_check("resume:  RSUM to a closed session answered with a DISC",
+			testLink_receiveHeader(&view, HANDSHAKE_HEADER_DISC, FRAME_TIMEOUT_MS) && !sessionOpen());
+
+	_close();
+	return failed;
+}
+
+
+#ifdef SESSION_WINDOWED
+/* _checkWindowed
+ *
+ * Checks that messages sent are numbered in sequence, that an acknowledgement of
+ * the first leaves only the second to be resent once the retransmit timeout
+ * passes, and that acknowledging it stops the resending.  Then that messages
+ * received are acknowledged, and that one out of sequence is dropped and the
+ * acknowledgement sent again, so the desktop resends from the one missing.
+ */
+uint32_t _checkWindowed(void)
+{
+	SessionLinkStats stats;
+	uint32_t failed = 0;
+
+	if (test_check("window:  session opened", _open()) != 0)
+	{
+		_close();
+		return 1;
+	}
+
+	// two messages, numbered from zero
+	_enqueue("m0");
+	_enqueue("m1");
+	failed += test_check("sequence:  messages sent numbered 0 and 1",
+			_receiveMessage("TEST", 0, 0, "m0") && _receiveMessage("TEST", 1, 0, "m1"));
+
+	// the first acknowledged, the second resent alone
+	testLink_send(ACK_HEADER, UART_LINK_ACK_ONLY, 1, "");
+	failed += test_check("go-back-N:  only the unacknowledged message resent",
+			_receiveMessage("TEST", 1, 0, "m1") && _quiet());
+	desktopAppSession_linkStats(&stats);
+	failed += test_check("go-back-N:  one resend counted", stats.resends == 1);
+
+	// both acknowledged, nothing more resent
+	testLink_send(ACK_HEADER, UART_LINK_ACK_ONLY, 2, "");
+	testLink_drain(RETRANSMIT_WAIT_MS);
+	desktopAppSession_linkStats(&stats);
+	failed += test_check("go-back-N:  acknowledged messages not resent", stats.resends == 1);
+
+	// a message received is acknowledged and handed to the application
+	testLink_send("TEST", 0, 2, "d0");
+	failed += test_check("acknowledgement:  message received acknowledged",
+			_receiveMessage(ACK_HEADER, UART_LINK_ACK_ONLY, 1, "") && _dequeued("d0"));
+
+	// one out of sequence is dropped and the acknowledgement sent again
+	testLink_send("TEST", 2, 2, "d2");
+	failed += test_check("out of sequence:  acknowledgement sent again",
+			_receiveMessage(ACK_HEADER, UART_LINK_ACK_ONLY, 1, ""));
+	desktopAppSession_linkStats(&stats);
+	failed += test_check("out of sequence:  message dropped and counted", stats.outOfSequence == 1 && !_dequeued("d2"));
+
+	// the one missing is taken when resent
+	testLink_send("TEST", 1, 2, "d1");
+	failed += test_check("out of sequence:  missing message taken when resent",
+			_receiveMessage(ACK_HEADER, UART_LINK_ACK_ONLY, 2, "") && _dequeued("d1"));
+
+	_close();
+	return failed;
+}
+#endif
+
+#ifdef SESSION_CREDIT
+/*
+ * The credit checks fill the receive queue and send one more message within the
+ * first grant.
+ */
+_Static_assert(SESSION_RX_QUEUE_LENGTH < SESSION_CREDITS, "credit checks need a grant past the receive queue");
+
+
+/* _checkCredit
+ *
+ * Checks that the session opens with a grant of SESSION_CREDITS, that each message
+ * moved into the receive queue grants one more, and that a message held for want of
+ * room in the queue grants none until the application takes one.  Then that the
+ * MCU's messages carry the credit, that a message after one lost grants past the
+ * one lost, and that the credit is sent again while nothing is received.
+ */
+uint32_t _checkCredit(void)
+{
+	SessionRxStats stats;
+	PacketView view;
+	char body[UART_PACKET_PAYLOAD_SIZE];
+	uint32_t failed = 0;
+	uint8_t credit = SESSION_CREDITS;
+	bool taken = true;
+	uint32_t i;
+
+	if (test_check("credit:  session opened", _open()) != 0)
+	{
+		_close();
+		return 1;
+	}
+	failed += test_check("credit:  first grant of SESSION_CREDITS", _receiveCredit(credit, FRAME_TIMEOUT_MS));
+
+	// messages taken into the receive queue are granted back
+	for (i = 0; i < SESSION_RX_QUEUE_LENGTH; i++)
+	{
+		snprintf(body, sizeof(body), "d%lu", (unsigned long)i);
+		testLink_send("TEST", (uint8_t)i, 0, body);
+	}
+	credit += SESSION_RX_QUEUE_LENGTH;
+	failed += test_check("credit:  one more granted for each message taken", _receiveCredit(credit, FRAME_TIMEOUT_MS));
+
+	// one more is held in the rx queue, and grants nothing until one is taken
+	snprintf(body, sizeof(body), "d%lu", (unsigned long)i);
+	testLink_send("TEST", (uint8_t)i, 0, body);
+	failed += test_check("credit:  none granted for a message held", !_receiveCredit(credit + 1, QUIET_TIME_MS));
+	desktopAppSession_rxStats(&stats);
+	failed += test_check("credit:  message held while the receive queue is full",
+			stats.depth == SESSION_RX_QUEUE_LENGTH && stats.pending == 1);
+	taken = _dequeuedNumber(0);
+	credit++;
+	failed += test_check("credit:  granted once the application takes a message",
+			taken && _receiveCredit(credit, FRAME_TIMEOUT_MS));
+
+	// the MCU's messages carry the credit
+	_enqueue("m0");
+	failed += test_check("credit:  carried on the MCU's messages", testLink_receiveHeader(&view, "TEST", FRAME_TIMEOUT_MS)
+			&& view.link[UART_LINK_SEQ] == 0 && view.link[UART_LINK_CREDIT] == credit);
+
+	// a message after one lost grants past the one lost
+	for (i = 1; i <= SESSION_RX_QUEUE_LENGTH; i++)
+	{
+		taken = _dequeuedNumber(i) && taken;
+	}
+	failed += test_check("credit:  messages taken in order", taken);
+	testLink_send("TEST", SESSION_RX_QUEUE_LENGTH + 2, 0, "lost one");
+	credit += 2;
+	failed += test_check("credit:  granted past a message lost", _receiveCredit(credit, FRAME_TIMEOUT_MS)
+			&& _dequeued("lost one"));
+
+	// sent again while idle
+	testLink_drain(QUIET_TIME_MS);
+	failed += test_check("credit:  sent again while nothing is received", _receiveCredit(credit, RETRANSMIT_WAIT_MS));
+
+	_close();
+	return failed;
+}
+#endif
+
+
+/* _open
+ *
+ * Opens the link, initializes the session on it and handshakes as the desktop does
+ * (without rate negotiation), keeping the session token.  Returns if the session
+ * opened.
+ */
+bool _open(void)
+{
+	PacketView view;
+
+	memset(_token, 0, sizeof(_token));
+	if (!testLink_open())
+	{
+		return false;
+	}
+	if (!desktopAppSession_init(testLink_uart()))
+	{
+		testLink_close();
+		return false;
+	}
+	testLink_setPump(_pump);
+
+	// SYNC, answered with an ACKN holding the token
+	testLink_send(HANDSHAKE_HEADER_SYNC, UART_LINK_UNSEQUENCED, 0, "");
+	if (!testLink_receiveHeader(&view, HANDSHAKE_HEADER_ACKN, FRAME_TIMEOUT_MS))
+	{
+		return false;
+	}
+	memcpy(_token, view.payload, TOKEN_DIGITS);
+
+	// SYNA
+	testLink_send(HANDSHAKE_HEADER_SYNACK, UART_LINK_UNSEQUENCED, 0, "");
+	testLink_run(QUIET_TIME_MS);
+	return sessionOpen();
+}
+
+
+/* _slowHandler
+ *
+ * Takes SLOW_HANDLER_US, as a handler with work to do would, and counts the
+ * messages it was called with.
+ */
+DesktopComSessionStatus _slowHandler(const PacketView* message, void* context)
+{
+	uint64_t start = test_now_ns();
+
+	(void)message;
+	while (test_now_ns() - start < SLOW_HANDLER_US * 1000ULL)
+	{
+	}
+	(*(uint32_t*)context)++;
+
+	return SESSION_OKAY;
+}
+
+
+/* _pumpBudgeted
+ *
+ * The application's main loop, updating the session within a short budget.
+ */
+void _pumpBudgeted(void)
+{
+	desktopAppSession_updateWithin(SHORT_BUDGET_US, NULL);
+}
+
+
+/* _close
+ *
+ * Abandons the session and closes the link.
+ */
+void _close(void)
+{
+	testLink_setPump(NULL);
+	desktopAppSession_deinit();
+	testLink_close();
+}
+
+
+/* _pump
+ *
+ * The application's main loop:  the session is updated while open, and the
+ * handshake advanced otherwise.
+ */
+void _pump(void)
+{
+	if (sessionOpen())
+	{
+		desktopAppSession_update();
+	}
+	else
+	{
+		desktopAppSession_start();
+	}
+}
+
+
+/* _enqueue
+ *
+ * Queues a message with a text body for the desktop, in the bulk lane.
+ */
+void _enqueue(const char* body)
+{
+	char header[UART_PACKET_HEADER_SIZE] = {'T', 'E', 'S', 'T'};
+	char payload[UART_PACKET_PAYLOAD_SIZE] = {0};
+
+	strncpy(payload, body, sizeof(payload) - 1);
+	desktopAppSession_enqueueMessage(header, payload, SESSION_PRIORITY_BULK);
+}
+
+
+/* _receiveMessage
+ *
+ * Returns if the next frame received has a header, link segment (in link modes)
+ * and text body.
+ */
+bool _receiveMessage(const char header[UART_PACKET_HEADER_SIZE], uint8_t seq, uint8_t ack, const char* body)
+{
+	PacketView view;
+
+	if (!testLink_receive(&view, RETRANSMIT_WAIT_MS))
+	{
+		return false;
+	}
+#if UART_PACKET_LINK_SIZE > 0
+	if (view.link[UART_LINK_SEQ] != seq || view.link[UART_LINK_ACK] != ack)
+	{
+		return false;
+	}
+#endif
+	return memcmp(view.header, header, UART_PACKET_HEADER_SIZE) == 0 && strcmp((const char*)view.payload, body) == 0;
+}
+
+
+#ifdef SESSION_CREDIT
+/* _receiveCredit
+ *
+ * Returns if a credit frame granting up to a sequence number is received within a
+ * time, dropping other frames and smaller grants.
+ */
+bool _receiveCredit(uint8_t credit, uint32_t timeout_ms)
+{
+	PacketView view;
+	uint32_t start = HAL_GetTick();
+	uint32_t elapsed;
+
+	while ((elapsed = HAL_GetTick() - start) < timeout_ms)
+	{
+		if (testLink_receiveHeader(&view, CREDIT_HEADER, timeout_ms - elapsed)
+				&& view.link[UART_LINK_SEQ] == UART_LINK_ACK_ONLY && view.link[UART_LINK_CREDIT] == credit)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+/* _dequeuedNumber
+ *
+ * Returns if the next message for the application is the numbered one sent by
+ * _checkCredit().
+ */
+bool _dequeuedNumber(uint32_t number)
+{
+	char body[UART_PACKET_PAYLOAD_SIZE];
+
+	snprintf(body, sizeof(body), "d%lu", (unsigned long)number);
+	return _dequeued(body);
+}
+#endif
+
+
+/* _receiveStat
+ *
+ * Receives a STAT reply and unpacks its bytes.  Returns false if none is received
+ * or it is not 7-bit.
+ */
+bool _receiveStat(uint8_t bytes[SESSION_STAT_SIZE])
+{
+	PacketView view;
+
+	return testLink_receiveHeader(&view, STAT_HEADER, FRAME_TIMEOUT_MS)
+			&& uartPacketHelpersTest_unpackSevenBit(view.payload, SESSION_STAT_SIZE, bytes);
+}
+
+
+/* _statCount
+ *
+ * Reads a little-endian count of a STAT reply.
+ */
+uint32_t _statCount(const uint8_t bytes[SESSION_STAT_SIZE], uint8_t offset, uint8_t size)
+{
+	uint32_t count = 0;
+
+	while (size-- > 0)
+	{
+		count = (count << 8) | bytes[offset + size];
+	}
+
+	return count;
+}
+
+
+/* _quiet
+ *
+ * Returns if no frame is received within a quiet time.
+ */
+bool _quiet(void)
+{
+	PacketView view;
+
+	return !testLink_receive(&view, QUIET_TIME_MS);
+}
+
+
+/* _dequeued
+ *
+ * Returns if the next message for the application has a text body.
+ */
+bool _dequeued(const char* body)
+{
+	char header[UART_PACKET_HEADER_SIZE];
+	char payload[UART_PACKET_PAYLOAD_SIZE];
+
+	return desktopAppSession_dequeueMessage(header, payload) == SESSION_OKAY && strcmp(payload, body) == 0;
+}
@@ -0,0 +1,72 @@
+# Author: Kevin Imlay
+#
+# The desktop application's side of the packet helpers' checks
+# (uart_packet_helpers_test.c).  Reads frames encoded by the MCU's
+# encodeFrame(), a line each with the header and link segments and the payload
+# the frame was built from, all in hexadecimal ("-" for none), and parses each
+# frame with SerialPacket as SerialProtocol does a message received.  Exits
+# with 1 if any frame fails to parse or parses differently.
+#
+#   frame_interop.py cobs|fixed binary|text linkLength
+
+import os
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)),
+    '..', '..', '..', 'Desktop'))
+import SerialPacket
+
+
+# Defines message parameters, as in SerialProtocol.
+HEADER_LENGTH = 4
+MESSAGE_LENGTH = 64
+# Encoding of a string of bytes, one character per byte.
+ENCODING = 'latin-1'
+
+
+def _text(hexString):
+    # Returns the string of the bytes written in hexadecimal.
+    if hexString == '-':
+        return ''
+    return bytes.fromhex(hexString).decode(ENCODING)
+
+
+def _parse(framing, binary, headerLength, frameString):
+    # Parses a frame as SerialProtocol does one received in the framing.
+    if framing == 'cobs':
+        return SerialPacket.parseFrame(MESSAGE_LENGTH, headerLength,
+            frameString, binary)
+    if binary:
+        return SerialPacket.parseBinary(MESSAGE_LENGTH, headerLength,
+            frameString)
+    return SerialPacket.SerialPacket(MESSAGE_LENGTH, headerLength, frameString)
+
+
+def main(argv):
+    # Parses every frame read, reporting those that do not come out as built.
+    framing, payload, linkLength = argv[1], argv[2], int(argv[3])
+    binary = (payload == 'binary')
+    headerLength = HEADER_LENGTH + linkLength
+    failed = 0
+
+    for line in sys.stdin:
+        frameHex, headerHex, payloadHex = line.split()
+        try:
+            packet = _parse(framing, binary, headerLength, _text(frameHex))
+        except ValueError:
+            print('frame_interop:  malformed frame ' + frameHex,
+                file=sys.stderr)
+            failed += 1
+            continue
+        if packet._headerText != _text(headerHex) \
+                or packet._bodyText != _text(payloadHex):
+            print('frame_interop:  frame ' + frameHex + ' parsed as '
+                + repr(packet._headerText) + ', '
+                + repr(packet._bodyText), file=sys.stderr)
+            failed += 1
+
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
@@ -0,0 +1,290 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ *
+ * Purpose:
+ *		Checks and benchmarks of the parts of the Desktop Communication module,
+ *	built and run on a Linux host (see Makefile).  Each part has its checks in
+ *	<part>_test.c and, where its speed matters, its benchmarks in <part>_bench.c.
+ *	Checks print each outcome and return the number that failed; benchmarks
+ *	print their timings.
+ *		The transport and session layers are checked over the stand-in HAL's
+ *	simulated UART (../Inc/stm32wlxx_hal.h), with the checks taking the desktop
+ *	application's end of the line (test_link.c).
+ */
+
+#ifndef HOST_TEST_H_
+#define HOST_TEST_H_
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stm32wlxx_hal.h>
+#include <packet_queue.h>
+#include <uart_packet_helpers.h>
+
+
+/* test_check
+ *
+ * Function:
+ * 	Prints the outcome of a check.
+ *
+ * Parameters:
+ * 	name - what was checked
+ * 	passed - true if the check passed
+ *
+ * Return:
+ * 	uint32_t - 1 if the check failed, 0 if it passed, for counting failures
+ */
+uint32_t test_check(const char* name, bool passed);
+
+/* test_now_ns
+ *
+ * Function:
+ * 	Reads the monotonic clock, for timing benchmarks.
+ *
+ * Return:
+ * 	uint64_t - time in nanoseconds
+ */
+uint64_t test_now_ns(void);
+
+/* packetQueueTest_check
+ *
+ * Function:
+ * 	Checks the packet queue (packet_queue_test.c).
+ *
+ * Return:
+ * 	uint32_t - number of checks failed
+ */
+uint32_t packetQueueTest_check(void);
+
+/* packetQueueTest_stream
+ *
+ * Function:
+ * 	Streams numbered packets through a queue from a producer thread to the
+ * 	calling thread, as an interrupt and the main loop would, each side yielding
+ * 	while the queue is full or empty.
+ *
+ * Parameters:
+ * 	queue - pointer to the queue, empty
+ * 	packets - number of packets to stream
+ * 	inPlace - true to write and read packets in place (back/commit and
+ * 			front/release), false to copy them (push/pop)
+ *
+ * Return:
+ * 	uint32_t - number of packets that came out in order
+ */
+uint32_t packetQueueTest_stream(PacketQueue* queue, uint32_t packets, bool inPlace);
+
+/* uartPacketHelpersTest_check
+ *
+ * Function:
+ * 	Checks the packet helpers' framing, that the desktop application parses
+ * 	the frames encoded, and the 7-bit packing (uart_packet_helpers_test.c).
+ *
+ * Return:
+ * 	uint32_t - number of checks failed
+ */
+uint32_t uartPacketHelpersTest_check(void);
+
+/* uartPacketHelpersTest_unpackSevenBit
+ *
+ * Function:
+ * 	Unpacks bytes from 7-bit characters, as the desktop application does those
+ * 	packed by packSevenBit().
+ *
+ * Parameters:
+ * 	chars - the SEVEN_BIT_LENGTH(count) characters
+ * 	count - number of bytes to unpack
+ * 	bytes - byte array where the bytes are to be stored
+ *
+ * Return:
+ * 	bool - true if every character was 7-bit
+ */
+bool uartPacketHelpersTest_unpackSevenBit(const uint8_t* chars, uint16_t count, uint8_t* bytes);
+
+/* uartTransportTest_check
+ *
+ * Function:
+ * 	Checks the transport layer's window of retained packets, acknowledgements
+ * 	and rewinds over the simulated UART (uart_transport_layer_test.c).
+ *
+ * Return:
+ * 	uint32_t - number of checks failed
+ */
+uint32_t uartTransportTest_check(void);
+
+/* desktopAppSessionTest_check
+ *
+ * Function:
+ * 	Checks sessions with the desktop over the simulated UART:  the handshake,
+ * 	and the link segment's sequencing and resending as built
+ * 	(desktop_app_session_test.c).
+ *
+ * Return:
+ * 	uint32_t - number of checks failed
+ */
+uint32_t desktopAppSessionTest_check(void);
+
+/* testLink_open
+ *
+ * Function:
+ * 	Opens the simulated UART's pty unthrottled, initializes the UART as the
+ * 	example configures USART2, and opens the desktop application's end.
+ *
+ * Return:
+ * 	bool - true if the link was opened
+ */
+bool testLink_open(void);
+
+/* testLink_openThrottled
+ *
+ * Function:
+ * 	Opens the link as testLink_open() does, with the pty passing bytes at the
+ * 	UART's baud rate, so frames take the time they would on the wire.
+ *
+ * Parameters:
+ * 	baudRate - baud rate of the UART, or 0 for the link unthrottled
+ *
+ * Return:
+ * 	bool - true if the link was opened
+ */
+bool testLink_openThrottled(uint32_t baudRate);
+
+/* testLink_uart
+ *
+ * Function:
+ * 	Returns the UART handle initialized by testLink_open(), for the transport
+ * 	or session layer to be initialized with.
+ *
+ * Return:
+ * 	UART_HandleTypeDef* - the simulated USART2's handle
+ */
+UART_HandleTypeDef* testLink_uart(void);
+
+/* testLink_close
+ *
+ * Function:
+ * 	Closes the desktop application's end and the pty.
+ */
+void testLink_close(void);
+
+/* testLink_setPump
+ *
+ * Function:
+ * 	Sets a function run repeatedly while the desktop application's end waits
+ * 	(such as a session update), as the MCU's main loop would run.
+ *
+ * Parameters:
+ * 	pump - function to run, or NULL to only raise the UART's events
+ */
+void testLink_setPump(void (*pump)(void));
+
+/* testLink_run
+ *
+ * Function:
+ * 	Runs the pump for a time, holding the frames received meanwhile.
+ *
+ * Parameters:
+ * 	time_ms - time to run for
+ */
+void testLink_run(uint32_t time_ms);
+
+/* testLink_drain
+ *
+ * Function:
+ * 	Runs the pump for a time and drops the frames received.
+ *
+ * Parameters:
+ * 	time_ms - time to run for
+ */
+void testLink_drain(uint32_t time_ms);
+
+/* testLink_send
+ *
+ * Function:
+ * 	Sends a packet from the desktop application's end, with a text body.
+ *
+ * Parameters:
+ * 	header - header of the packet
+ * 	seq - sequence number in the link segment (ignored without one)
+ * 	ack - acknowledgement or credit in the link segment (ignored without one)
+ * 	body - text of the payload
+ */
+void testLink_send(const char header[UART_PACKET_HEADER_SIZE], uint8_t seq, uint8_t ack, const char* body);
+
+/* testLink_receive
+ *
+ * Function:
+ * 	Receives the next frame at the desktop application's end, running the
+ * 	pump while waiting.
+ *
+ * Parameters:
+ * 	view - view to point at the packet received, which is valid until the
+ * 			next frame is received
+ * 	timeout_ms - most time to wait
+ *
+ * Return:
+ * 	bool - true if a frame was received
+ */
+bool testLink_receive(PacketView* view, uint32_t timeout_ms);
+
+/* testLink_receiveHeader
+ *
+ * Function:
+ * 	Receives frames until one with a header, dropping the others.
+ *
+ * Parameters:
+ * 	view - view to point at the packet received
+ * 	header - header to wait for
+ * 	timeout_ms - most time to wait
+ *
+ * Return:
+ * 	bool - true if a frame with the header was received
+ */
+bool testLink_receiveHeader(PacketView* view, const char header[UART_PACKET_HEADER_SIZE], uint32_t timeout_ms);
+
+/* packetQueueBench_run
+ *
+ * Function:
+ * 	Times packets through a packet queue (packet_queue_bench.c).
+ */
+void packetQueueBench_run(void);
+
+/* commandTableBench_run
+ *
+ * Function:
+ * 	Times header lookups through the command table against a chain of header
+ * 	comparisons, at 5, 50 and 200 headers (command_table_bench.c).
+ */
+void commandTableBench_run(void);
+
+/* uartTransportBench_run
+ *
+ * Function:
+ * 	Times urgent packets injected into a bulk transfer over the throttled link,
+ * 	through one lane and through the urgent lane with each schedule
+ * 	(uart_transport_layer_bench.c).
+ */
+void uartTransportBench_run(void);
+
+/* rttEstimatorBench_run
+ *
+ * Function:
+ * 	Simulates exchanges over lossy links, each timed out with the fixed timeout
+ * 	and with the one taken from the measured round trips, and prints how long
+ * 	recovering from a lost frame took (rtt_estimator_bench.c).
+ */
+void rttEstimatorBench_run(void);
+
+/* sessionMailboxBench_run
+ *
+ * Function:
+ * 	Times messages sent from the CM4 to the CM0+ and back through the mailbox,
+ * 	with each core waiting for the other's doorbell and with both polling
+ * 	(session_mailbox_bench.c, built with SESSION_MAILBOX).
+ */
+void sessionMailboxBench_run(void);
+
+
+#endif /* HOST_TEST_H_ */
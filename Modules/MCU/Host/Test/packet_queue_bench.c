@@ -0,0 +1,79 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ *
+ * Benchmark of the packet queue (packet_queue.h).
+ */
+
+
+#include <host_test.h>
+#include <stdio.h>
+#include <string.h>
+
+
+/*
+ * Depth of the queue timed, packets timed through it in one thread and packets
+ * streamed between threads.
+ */
+#define QUEUE_BENCH_DEPTH 8
+#define QUEUE_BENCH_PACKETS 20000000
+#define QUEUE_BENCH_STREAMED 2000000
+
+
+PACKET_QUEUE_DEFINE(_queue, QUEUE_BENCH_DEPTH);		// queue timed
+
+
+/* packetQueueBench_run
+ *
+ * Times packets through a queue of QUEUE_BENCH_DEPTH packets in one thread, a
+ * packet in and out at a time, copied (push/pop) and in place (back/commit and
+ * front/release), then streamed from a producer thread to the consumer.  Prints the
+ * time per packet.
+ */
+void packetQueueBench_run(void)
+{
+	static const char* ways[] = {"push/pop (copied)", "back/commit, front/release"};
+	uint8_t packet[UART_FRAME_SIZE];
+	volatile uint32_t sink = 0;
+	uint64_t start;
+	double single_ns;
+	double streamed_ns;
+	uint32_t n;
+	uint32_t w;
+
+	memset(packet, 0, UART_FRAME_SIZE);
+	printf("%u byte packets, queue of %u\n", (unsigned)UART_FRAME_SIZE, (unsigned)QUEUE_BENCH_DEPTH);
+	printf("%-28s  one thread (ns/packet)  streamed between threads (ns/packet)\n", "");
+	for (w = 0; w < sizeof(ways) / sizeof(ways[0]); w++)
+	{
+		packetQueue_reset(&_queue);
+		start = test_now_ns();
+		for (n = 0; n < QUEUE_BENCH_PACKETS; n++)
+		{
+			if (w == 0)
+			{
+				packet[0] = (uint8_t)n;
+				packetQueue_push(&_queue, packet);
+				packetQueue_pop(&_queue, packet);
+				sink += packet[0];
+			}
+			else
+			{
+				packetQueue_back(&_queue)[0] = (uint8_t)n;
+				packetQueue_commit(&_queue);
+				sink += packetQueue_front(&_queue)[0];
+				packetQueue_release(&_queue);
+			}
+		}
+		single_ns = (double)(test_now_ns() - start) / QUEUE_BENCH_PACKETS;
+
+		packetQueue_reset(&_queue);
+		start = test_now_ns();
+		n = packetQueueTest_stream(&_queue, QUEUE_BENCH_STREAMED, w == 1);
+		streamed_ns = (double)(test_now_ns() - start) / QUEUE_BENCH_STREAMED;
+
+		printf("%-28s  %22.1f  %37.1f%s\n", ways[w], single_ns, streamed_ns,
+				(n == QUEUE_BENCH_STREAMED) ? "" : "  (out of order)");
+	}
+	(void)sink;
+}
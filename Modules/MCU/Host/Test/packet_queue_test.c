@@ -0,0 +1,282 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ *
+ * Checks of the packet queue (packet_queue.h).
+ */
+
+
+#include <host_test.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+
+
+/*
+ * Depth of the queue checked, laps of it taken for the wraparound check and
+ * packets streamed between threads.
+ */
+#define QUEUE_CHECK_DEPTH 4
+#define QUEUE_CHECK_ROUNDS 1000
+#define QUEUE_CHECK_STREAMED 200000
+
+
+/*
+ * A stream of packets from the producer thread of packetQueueTest_stream().
+ */
+typedef struct {
+	PacketQueue* queue;
+	uint32_t packets;
+	bool inPlace;
+} QueueStream;
+
+
+/*
+ * Private helper function prototypes.
+ */
+void* _streamProducer(void* parameters);
+void _setPacketNumber(uint8_t* packet, uint32_t number);
+uint32_t _packetNumber(const uint8_t* packet);
+
+
+PACKET_QUEUE_DEFINE(_queue, QUEUE_CHECK_DEPTH);		// queue checked
+
+
+/* packetQueueTest_check
+ *
+ * Checks a queue of QUEUE_CHECK_DEPTH packets:  empty and full, the count and
+ * high-water mark, the order packets come out in, through copies (push/pop) and in
+ * place (back/commit and front/release), the indexes wrapping around the queue and
+ * around their 32 bits, and packets streamed from a producer thread.  Packets are
+ * numbered in their first bytes to check their order.
+ */
+uint32_t packetQueueTest_check(void)
+{
+	uint8_t packet[UART_FRAME_SIZE];
+	uint8_t* slot;
+	uint32_t failed = 0;
+	uint32_t next = 0;
+	uint32_t expected = 0;
+	uint32_t i;
+	uint32_t r;
+	bool inOrder;
+	bool passed;
+
+	// empty
+	packetQueue_reset(&_queue);
+	packetQueue_release(&_queue);
+	failed += test_check("empty:  no packets, front NULL, pop fails, release ignored",
+			packetQueue_count(&_queue) == 0 && !packetQueue_isFull(&_queue)
+			&& packetQueue_front(&_queue) == NULL && !packetQueue_pop(&_queue, packet));
+
+	// full
+	passed = true;
+	for (i = 0; i < QUEUE_CHECK_DEPTH; i++)
+	{
+		_setPacketNumber(packet, next++);
+		passed = passed && packetQueue_push(&_queue, packet);
+	}
+	failed += test_check("full:  depth packets pushed, then push and back fail",
+			passed && packetQueue_isFull(&_queue) && packetQueue_count(&_queue) == QUEUE_CHECK_DEPTH
+			&& !packetQueue_push(&_queue, packet) && packetQueue_back(&_queue) == NULL);
+	failed += test_check("high-water mark:  depth once full", packetQueue_highWater(&_queue) == QUEUE_CHECK_DEPTH);
+
+	// pop, in order, back to empty
+	inOrder = true;
+	while (packetQueue_pop(&_queue, packet))
+	{
+		inOrder = inOrder && _packetNumber(packet) == expected++;
+	}
+	failed += test_check("pop:  packets in the order pushed, then empty",
+			inOrder && expected == QUEUE_CHECK_DEPTH && packetQueue_count(&_queue) == 0);
+	failed += test_check("high-water mark:  kept once emptied", packetQueue_highWater(&_queue) == QUEUE_CHECK_DEPTH);
+
+	// back and commit, front and release
+	slot = packetQueue_back(&_queue);
+	passed = slot != NULL;
+	if (passed)
+	{
+		_setPacketNumber(slot, next);
+		passed = packetQueue_count(&_queue) == 0 && packetQueue_front(&_queue) == NULL;
+		packetQueue_commit(&_queue);
+		passed = passed && packetQueue_front(&_queue) == slot && _packetNumber(slot) == next
+				&& packetQueue_back(&_queue) != slot;
+		packetQueue_release(&_queue);
+		next++;
+		expected++;
+	}
+	failed += test_check("back/commit:  not queued until committed, read in place",
+			passed && packetQueue_count(&_queue) == 0);
+
+	// wrapping around the queue, with the fill level changing each round
+	inOrder = true;
+	for (r = 0; r < QUEUE_CHECK_ROUNDS; r++)
+	{
+		for (i = 0; i < r % QUEUE_CHECK_DEPTH + 1; i++)
+		{
+			slot = packetQueue_back(&_queue);
+			if (slot != NULL)
+			{
+				_setPacketNumber(slot, next++);
+				packetQueue_commit(&_queue);
+			}
+		}
+		for (i = 0; i < (r + 1) % QUEUE_CHECK_DEPTH + 1; i++)
+		{
+			slot = packetQueue_front(&_queue);
+			if (slot != NULL)
+			{
+				inOrder = inOrder && _packetNumber(slot) == expected++;
+				packetQueue_release(&_queue);
+			}
+		}
+	}
+	while ((slot = packetQueue_front(&_queue)) != NULL)
+	{
+		inOrder = inOrder && _packetNumber(slot) == expected++;
+		packetQueue_release(&_queue);
+	}
+	failed += test_check("wraparound:  in order over many laps of the queue", inOrder && expected == next);
+
+	// reset
+	_setPacketNumber(packet, next++);
+	packetQueue_push(&_queue, packet);
+	packetQueue_reset(&_queue);
+	failed += test_check("reset:  empty, high-water mark cleared",
+			packetQueue_count(&_queue) == 0 && packetQueue_highWater(&_queue) == 0
+			&& packetQueue_front(&_queue) == NULL);
+
+	// the indexes wrapping around their 32 bits
+	atomic_store(&_queue.head, UINT32_MAX - 1);
+	atomic_store(&_queue.tail, UINT32_MAX - 1);
+	passed = true;
+	for (i = 0; i < QUEUE_CHECK_DEPTH; i++)
+	{
+		_setPacketNumber(packet, i);
+		passed = passed && packetQueue_push(&_queue, packet);
+	}
+	passed = passed && packetQueue_count(&_queue) == QUEUE_CHECK_DEPTH && packetQueue_isFull(&_queue);
+	for (i = 0; i < QUEUE_CHECK_DEPTH; i++)
+	{
+		passed = passed && packetQueue_pop(&_queue, packet) && _packetNumber(packet) == i;
+	}
+	failed += test_check("index wraparound:  count and order across 2^32",
+			passed && packetQueue_count(&_queue) == 0 && packetQueue_front(&_queue) == NULL);
+
+	// streamed between threads, copied and in place
+	packetQueue_reset(&_queue);
+	failed += test_check("streaming:  every packet from a producer thread, in order (copied)",
+			packetQueueTest_stream(&_queue, QUEUE_CHECK_STREAMED, false) == QUEUE_CHECK_STREAMED);
+	packetQueue_reset(&_queue);
+	failed += test_check("streaming:  every packet from a producer thread, in order (in place)",
+			packetQueueTest_stream(&_queue, QUEUE_CHECK_STREAMED, true) == QUEUE_CHECK_STREAMED);
+	packetQueue_reset(&_queue);
+
+	return failed;
+}
+
+
+/* packetQueueTest_stream
+ *
+ * The calling thread is the consumer.  On a single core the yields let the other
+ * side run.
+ */
+uint32_t packetQueueTest_stream(PacketQueue* queue, uint32_t packets, bool inPlace)
+{
+	QueueStream stream = {queue, packets, inPlace};
+	uint8_t packet[UART_FRAME_SIZE];
+	uint8_t* slot;
+	pthread_t producer;
+	uint32_t expected = 0;
+	uint32_t n;
+
+	if (pthread_create(&producer, NULL, _streamProducer, &stream) != 0)
+	{
+		fprintf(stderr, "thread creation failed\n");
+		return 0;
+	}
+	for (n = 0; n < packets; n++)
+	{
+		if (inPlace)
+		{
+			while ((slot = packetQueue_front(queue)) == NULL)
+			{
+				sched_yield();
+			}
+			expected += (_packetNumber(slot) == expected);
+			packetQueue_release(queue);
+		}
+		else
+		{
+			while (!packetQueue_pop(queue, packet))
+			{
+				sched_yield();
+			}
+			expected += (_packetNumber(packet) == expected);
+		}
+	}
+	pthread_join(producer, NULL);
+
+	return expected;
+}
+
+
+/* _streamProducer
+ *
+ * Producer thread of packetQueueTest_stream().
+ */
+void* _streamProducer(void* parameters)
+{
+	QueueStream* stream = parameters;
+	uint8_t packet[UART_FRAME_SIZE];
+	uint8_t* slot;
+	uint32_t n;
+
+	memset(packet, 0, UART_FRAME_SIZE);
+	for (n = 0; n < stream->packets; n++)
+	{
+		if (stream->inPlace)
+		{
+			while ((slot = packetQueue_back(stream->queue)) == NULL)
+			{
+				sched_yield();
+			}
+			_setPacketNumber(slot, n);
+			packetQueue_commit(stream->queue);
+		}
+		else
+		{
+			_setPacketNumber(packet, n);
+			while (!packetQueue_push(stream->queue, packet))
+			{
+				sched_yield();
+			}
+		}
+	}
+
+	return NULL;
+}
+
+
+/* _setPacketNumber
+ *
+ * Writes a number into the first bytes of a packet.
+ */
+void _setPacketNumber(uint8_t* packet, uint32_t number)
+{
+	memcpy(packet, &number, sizeof(number));
+}
+
+
+/* _packetNumber
+ *
+ * Reads the number written by _setPacketNumber().
+ */
+uint32_t _packetNumber(const uint8_t* packet)
+{
+	uint32_t number;
+
+	memcpy(&number, packet, sizeof(number));
+	return number;
+}
@@ -0,0 +1,183 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ *
+ * Benchmark of the round-trip estimator (rtt_estimator.h):  recovery from lost
+ * frames with the fixed timeout and with the adaptive one, on simulated links.
+ */
+
+
+#include <host_test.h>
+#include <desktop_app_session.h>
+#include <rtt_estimator.h>
+#include <stdio.h>
+
+
+/*
+ * Exchanges (a message and its answer) over a simulated link that loses frames each
+ * way, resent when the timeout expires, as the windowed session resends a message
+ * that is not acknowledged.
+ */
+#define RECOVERY_BAUD_RATE 115200
+#define RECOVERY_BITS_PER_BYTE 11		// start, 8 data and 2 stop bits, as USART2
+#define RECOVERY_EXCHANGES 5000
+#define RECOVERY_LOSS_PERMILLE 50
+
+
+/*
+ * Private helper function prototypes.
+ */
+uint32_t _linkRandom(uint32_t* state);
+
+
+/* rttEstimatorBench_run
+ *
+ * Simulates exchanges over links that lose RECOVERY_LOSS_PERMILLE of the frames each
+ * way, with the desktop's response time drawn for each:  from a quick desktop, from
+ * one behind a USB serial adapter's latency timer, and from a busy one that stalls
+ * now and then.  A message not answered within the timeout is resent, the timeout
+ * covering the response and a frame each way, until an answer arrives.  Each link is
+ * run with the fixed timeout (RECEIVE_TIMEOUT_MS) and with the timeout taken from the
+ * round trips measured so far (rtt_estimator.h), sampled and backed off as the
+ * session does.  Prints the mean time of an exchange, the mean and longest time of
+ * one whose first message or answer was lost, the resends and how many of them were
+ * needless (the answer was on its way), and the mean timeout a message was first
+ * sent with.
+ */
+void rttEstimatorBench_run(void)
+{
+	static const struct {
+		const char* name;
+		uint32_t base_us;		// least response time
+		uint32_t jitter_us;		// spread of the response time above the least
+		uint32_t stallPermille;	// responses in a thousand held up by a stall
+		uint32_t stall_us;		// length of a stall
+	} links[] = {
+		{"quick desktop", 1000, 2000, 0, 0},
+		{"USB adapter", 8000, 24000, 0, 0},
+		{"busy desktop", 5000, 10000, 20, 150000}
+	};
+	uint64_t frame_us = 1000000ULL * UART_FRAME_SIZE * RECOVERY_BITS_PER_BYTE / RECOVERY_BAUD_RATE;
+	RttEstimator rtt;
+	uint32_t seed;
+	uint32_t response_us;
+	uint32_t n;
+	uint32_t l;
+	uint32_t resends;
+	uint32_t spurious;
+	uint32_t recovered;
+	uint32_t attempt;
+	uint64_t sent;
+	uint64_t answered;
+	uint64_t timeout_us;
+	uint64_t total;
+	uint64_t recoveryTotal;
+	uint64_t recoveryMax;
+	uint64_t timeoutTotal;
+	bool adaptive;
+	bool firstLost;
+
+	printf("%u baud, %.1f ms frames, %.1f%% of frames lost each way, %u exchanges a run\n",
+			(unsigned)RECOVERY_BAUD_RATE, (double)frame_us / 1000, (double)RECOVERY_LOSS_PERMILLE / 10,
+			(unsigned)RECOVERY_EXCHANGES);
+	printf("%-14s %-9s %9s %11s %9s %8s %9s %13s\n", "link", "timeout", "mean (ms)", "after loss", "max (ms)",
+			"resends", "needless", "timeout (ms)");
+	for (l = 0; l < sizeof(links) / sizeof(links[0]); l++)
+	{
+		for (adaptive = false; ; adaptive = true)
+		{
+			rttEstimator_init(&rtt, RECEIVE_TIMEOUT_MS);
+			seed = 1;
+			resends = 0;
+			spurious = 0;
+			recovered = 0;
+			total = 0;
+			recoveryTotal = 0;
+			recoveryMax = 0;
+			timeoutTotal = 0;
+
+			for (n = 0; n < RECOVERY_EXCHANGES; n++)
+			{
+				// each attempt is answered (if neither it nor its answer is lost) after a
+				// frame each way and the response time, and resent once the timeout
+				// expires with no answer in
+				sent = 0;
+				answered = UINT64_MAX;
+				firstLost = false;
+				for (attempt = 0; ; attempt++)
+				{
+					response_us = links[l].base_us + _linkRandom(&seed) % links[l].jitter_us;
+					if (_linkRandom(&seed) % 1000 < links[l].stallPermille)
+					{
+						response_us += links[l].stall_us;
+					}
+					if (_linkRandom(&seed) % 1000 >= RECOVERY_LOSS_PERMILLE
+							&& _linkRandom(&seed) % 1000 >= RECOVERY_LOSS_PERMILLE)
+					{
+						if (sent + 2 * frame_us + response_us < answered)
+						{
+							answered = sent + 2 * frame_us + response_us;
+						}
+					}
+					else if (attempt == 0)
+					{
+						firstLost = true;
+					}
+
+					timeout_us = (uint64_t)(adaptive ? rttEstimator_timeout(&rtt) : RECEIVE_TIMEOUT_MS) * 1000
+							+ 2 * frame_us;
+					if (attempt == 0)
+					{
+						timeoutTotal += timeout_us;
+					}
+					if (sent + timeout_us >= answered)
+					{
+						break;
+					}
+					spurious += (answered != UINT64_MAX);
+					resends++;
+					sent += timeout_us;
+					if (adaptive)
+					{
+						rttEstimator_backoff(&rtt);
+					}
+				}
+
+				// the round trip less the frames, unless resent
+				if (adaptive && attempt == 0)
+				{
+					rttEstimator_sample(&rtt, (uint32_t)((answered - 2 * frame_us) / 1000));
+				}
+				total += answered;
+				if (firstLost)
+				{
+					recovered++;
+					recoveryTotal += answered;
+					recoveryMax = (answered > recoveryMax) ? answered : recoveryMax;
+				}
+			}
+
+			printf("%-14s %-9s %9.2f %11.2f %9.2f %8lu %9lu %13.2f\n", adaptive ? "" : links[l].name,
+					adaptive ? "adaptive" : "fixed", (double)total / RECOVERY_EXCHANGES / 1000,
+					recovered ? (double)recoveryTotal / recovered / 1000 : 0.0, (double)recoveryMax / 1000,
+					(unsigned long)resends, (unsigned long)spurious, (double)timeoutTotal / RECOVERY_EXCHANGES / 1000);
+			if (adaptive)
+			{
+				break;
+			}
+		}
+	}
+}
+
+
+/* _linkRandom
+ *
+ * Xorshift generator, so the links are the same from run to run.
+ */
+uint32_t _linkRandom(uint32_t* state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return *state;
+}
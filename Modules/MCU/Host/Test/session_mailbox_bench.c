@@ -0,0 +1,204 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ *
+ * Benchmark of the dual-core mailbox (session_mailbox.h), with the calling thread
+ * as the CM4 and a thread of its own as the CM0+.  Built with SESSION_MAILBOX.
+ */
+
+#ifdef SESSION_MAILBOX
+
+
+#include <host_test.h>
+#include <session_mailbox.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+
+
+/*
+ * Messages sent one at a time, each waiting for its echo, and messages streamed
+ * with the rings kept full.
+ */
+#define MAILBOX_BENCH_ROUND_TRIPS 100000
+#define MAILBOX_BENCH_STREAMED 1000000
+
+
+/*
+ * Private helper function prototypes.
+ */
+void* _echoCore(void* parameters);
+void _waitCore(void);
+
+
+// Private Variables
+static SessionMailbox _mailbox;				// Mailbox, in the SRAM both cores see
+static IPCC_HandleTypeDef hipcc_cm0plus;	// IPCC as seen from the CM0+
+static IPCC_HandleTypeDef hipcc_cm4;		// IPCC as seen from the CM4
+static atomic_bool _echoing;				// Cleared to end the echo
+static bool _polling = false;				// Flag for the cores polling
+
+
+/* sessionMailboxBench_run
+ *
+ * Runs the calling thread as the CM4 and a thread as the CM0+ that echoes every
+ * message back through the mailbox.  Times messages sent one at a time, each
+ * waiting for its echo, then streams messages with both rings kept full.  Done
+ * with both cores waiting in __WFI() for the other's doorbell, then with both
+ * polling.  Prints the mean and longest round trip and the messages per second.
+ */
+void sessionMailboxBench_run(void)
+{
+	static const char* modes[] = {"doorbell (WFI)", "polling"};
+	char header[UART_PACKET_HEADER_SIZE];
+	char body[UART_PACKET_PAYLOAD_SIZE];
+	pthread_t echo;
+	uint64_t start;
+	uint64_t sentAt;
+	uint64_t latency;
+	uint64_t total;
+	uint64_t longest;
+	double roundTrips;
+	bool progressed;
+	uint32_t sent;
+	uint32_t received;
+	uint32_t i;
+	uint32_t m;
+
+	HAL_Host_setCurrentCPUID(CM4_CPUID);
+	HAL_IPCC_Init(&hipcc_cm4);
+	memset(body, 0, UART_PACKET_PAYLOAD_SIZE);
+
+	printf("%u message rings, %u round trips, %u messages streamed\n", (unsigned)SESSION_MAILBOX_DEPTH,
+			(unsigned)MAILBOX_BENCH_ROUND_TRIPS, (unsigned)MAILBOX_BENCH_STREAMED);
+	printf("%-16s  round trip mean (us)  max (us)  round trips/s  streamed (messages/s)\n", "cores waiting by");
+	for (m = 0; m < sizeof(modes) / sizeof(modes[0]); m++)
+	{
+		_polling = (m == 1);
+		atomic_store(&_mailbox.ready, 0);
+		atomic_store(&_echoing, true);
+		if (pthread_create(&echo, NULL, _echoCore, NULL) != 0)
+		{
+			fprintf(stderr, "thread creation failed\n");
+			return;
+		}
+		while (!sessionMailbox_initApp(&_mailbox, &hipcc_cm4, NULL))
+		{
+			sched_yield();
+		}
+
+		// one at a time
+		total = 0;
+		longest = 0;
+		start = test_now_ns();
+		for (i = 0; i < MAILBOX_BENCH_ROUND_TRIPS; i++)
+		{
+			sentAt = test_now_ns();
+			memcpy(body, &i, sizeof(i));
+			sessionMailbox_enqueueMessage("ECHO", body, SESSION_PRIORITY_BULK);
+			while (sessionMailbox_dequeueMessage(header, body) != SESSION_OKAY)
+			{
+				_waitCore();
+			}
+			latency = test_now_ns() - sentAt;
+			total += latency;
+			longest = (latency > longest) ? latency : longest;
+		}
+		roundTrips = (double)MAILBOX_BENCH_ROUND_TRIPS * 1000000000 / (double)(test_now_ns() - start);
+
+		// streamed
+		sent = 0;
+		received = 0;
+		start = test_now_ns();
+		while (received < MAILBOX_BENCH_STREAMED)
+		{
+			progressed = false;
+			while (sent < MAILBOX_BENCH_STREAMED
+					&& sessionMailbox_enqueueMessage("ECHO", body, SESSION_PRIORITY_BULK) == SESSION_OKAY)
+			{
+				sent++;
+				progressed = true;
+			}
+			while (sessionMailbox_dequeueMessage(header, body) == SESSION_OKAY)
+			{
+				received++;
+				progressed = true;
+			}
+			if (!progressed)
+			{
+				_waitCore();
+			}
+		}
+
+		printf("%-16s  %20.2f  %8.1f  %13.0f  %21.0f\n", modes[m], (double)total / MAILBOX_BENCH_ROUND_TRIPS / 1000,
+				(double)longest / 1000, roundTrips,
+				(double)MAILBOX_BENCH_STREAMED * 1000000000 / (double)(test_now_ns() - start));
+
+		atomic_store(&_echoing, false);
+		pthread_join(echo, NULL);
+	}
+}
+
+
+/* _echoCore
+ *
+ * The CM0+.  Initializes the link side of the mailbox and moves each message in
+ * the ring from the CM4 to the ring back, ringing the CM4's doorbell after each
+ * batch.
+ */
+void* _echoCore(void* parameters)
+{
+	MailboxMessage* in;
+	MailboxMessage* out;
+	bool moved;
+
+	HAL_IPCC_Init(&hipcc_cm0plus);
+	sessionMailbox_initLink(&_mailbox, &hipcc_cm0plus, NULL);
+
+	while (atomic_load(&_echoing))
+	{
+		moved = false;
+		while ((in = mailboxRing_front(&_mailbox.toLink)) != NULL && (out = mailboxRing_back(&_mailbox.fromLink)) != NULL)
+		{
+			memcpy(out, in, sizeof(MailboxMessage));
+			mailboxRing_release(&_mailbox.toLink);
+			mailboxRing_commit(&_mailbox.fromLink);
+			moved = true;
+		}
+
+		if (moved)
+		{
+			mailboxDoorbell_ring(&hipcc_cm0plus, SESSION_MAILBOX_CHANNEL_FROM_LINK);
+		}
+		else
+		{
+			_waitCore();
+		}
+	}
+
+	return NULL;
+}
+
+
+/* _waitCore
+ *
+ * Waits for the other core's doorbell (and takes its interrupt), or only reads the
+ * tick when polling.  A polling core yields the host CPU, as the two threads may
+ * share one where the cores would each spin on their own.
+ */
+void _waitCore(void)
+{
+	if (!_polling)
+	{
+		__WFI();
+	}
+	else
+	{
+		sched_yield();
+	}
+	HAL_GetTick();
+}
+
+
+#endif /* SESSION_MAILBOX */
@@ -0,0 +1,322 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ *
+ * The desktop's end of the simulated UART, for the checks of the transport and
+ * session layers.  Frames are sent and received in the framing the module is built
+ * with, through the module's own packet helpers.
+ */
+
+
+#include <host_test.h>
+#include <uart_transport_layer.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+
+/*
+ * Baud rate of the UART unthrottled, which only sets the frame time.
+ */
+#define TEST_LINK_BAUD_RATE 115200
+
+/*
+ * Bytes held from the line, enough for several frames.
+ */
+#define TEST_LINK_BUFFER_SIZE (8 * UART_FRAME_SIZE)
+
+
+/*
+ * Private helper function prototypes.
+ */
+bool _takeFrame(void);
+void _readLine(void);
+
+
+// Private Variables
+static UART_HandleTypeDef huart2;						// Simulated USART2
+static DMA_HandleTypeDef hdma_usart2_rx;				// Simulated USART2 rx DMA channel
+static DMA_HandleTypeDef hdma_usart2_tx;				// Simulated USART2 tx DMA channel
+static int _desktop = -1;								// Desktop's end of the pty
+static void (*_pump)(void) = NULL;						// Runs the MCU while the desktop waits
+static uint8_t _line[TEST_LINK_BUFFER_SIZE];			// Bytes read from the line, not yet framed
+static uint32_t _lineLength = 0;						// Number of bytes in _line
+static uint8_t _frame[UART_FRAME_SIZE];					// Last frame received, decoded
+
+
+/* testLink_open
+ *
+ * Opens the link unthrottled.
+ */
+bool testLink_open(void)
+{
+	return testLink_openThrottled(0);
+}
+
+
+/* testLink_openThrottled
+ *
+ * Opens the pty, throttled unless the baud rate is 0, initializes the UART as the
+ * example configures USART2, and opens the pty's slave as the desktop would.
+ */
+bool testLink_openThrottled(uint32_t baudRate)
+{
+	const char* port = HAL_Host_openPty(baudRate != 0, NULL);
+
+	if (port == NULL)
+	{
+		return false;
+	}
+	_desktop = open(port, O_RDWR | O_NOCTTY | O_NONBLOCK);
+	_lineLength = 0;
+	_pump = NULL;
+
+	hdma_usart2_rx.Init.Mode = DMA_CIRCULAR;
+	hdma_usart2_tx.Init.Mode = DMA_NORMAL;
+	huart2.Instance = USART2;
+	huart2.Init.BaudRate = (baudRate != 0) ? baudRate : TEST_LINK_BAUD_RATE;
+	huart2.Init.WordLength = UART_WORDLENGTH_8B;
+	huart2.Init.StopBits = UART_STOPBITS_2;
+	huart2.Init.Parity = UART_PARITY_NONE;
+	huart2.Init.Mode = UART_MODE_TX_RX;
+#ifdef UART_HW_FLOW_CONTROL
+	huart2.Init.HwFlowCtl = UART_HWCONTROL_RTS_CTS;
+#else
+	huart2.Init.HwFlowCtl = UART_HWCONTROL_NONE;
+#endif
+	huart2.hdmarx = &hdma_usart2_rx;
+	huart2.hdmatx = &hdma_usart2_tx;
+
+	if (_desktop < 0 || HAL_UART_Init(&huart2) != HAL_OK)
+	{
+		testLink_close();
+		return false;
+	}
+	return true;
+}
+
+
+/* testLink_uart
+ *
+ * Returns the handle initialized by testLink_open().
+ */
+UART_HandleTypeDef* testLink_uart(void)
+{
+	return &huart2;
+}
+
+
+/* testLink_close
+ *
+ * Closes the desktop's end, then the pty.
+ */
+void testLink_close(void)
+{
+	if (_desktop >= 0)
+	{
+		close(_desktop);
+		_desktop = -1;
+	}
+	HAL_Host_closePty();
+}
+
+
+/* testLink_setPump
+ *
+ * Sets the function run while the desktop waits, NULL to only raise the UART's
+ * events.
+ */
+void testLink_setPump(void (*pump)(void))
+{
+	_pump = pump;
+}
+
+
+/* testLink_run
+ *
+ * Runs the pump, or raises the UART's events, for a time.  Frames received
+ * meanwhile are held for testLink_receive().
+ */
+void testLink_run(uint32_t time_ms)
+{
+	struct timespec step = { 0, 100000 };
+	uint32_t start = HAL_GetTick();
+
+	while (HAL_GetTick() - start < time_ms)
+	{
+		if (_pump != NULL)
+		{
+			_pump();
+		}
+		_readLine();
+		nanosleep(&step, NULL);
+	}
+}
+
+
+/* testLink_send
+ *
+ * Builds the packet in a frame buffer through a packet view, as the module does,
+ * encodes it and writes it to the line.
+ */
+void testLink_send(const char header[UART_PACKET_HEADER_SIZE], uint8_t seq, uint8_t ack, const char* body)
+{
+	uint8_t frame[UART_FRAME_SIZE];
+	PacketView view;
+	uint16_t length = (uint16_t)strlen(body);
+	uint16_t size;
+	ssize_t written;
+
+	memset(frame, 0, sizeof(frame));
+	packetView_init(&view, frame);
+	memcpy(view.header, header, UART_PACKET_HEADER_SIZE);
+#if UART_PACKET_LINK_SIZE > 0
+	view.link[UART_LINK_SEQ] = seq;
+	view.link[UART_LINK_ACK] = ack;
+#else
+	(void)seq;
+	(void)ack;
+#endif
+	memcpy(view.payload, body, (length < view.length) ? length : view.length);
+	size = encodeFrame(frame, length);
+
+	written = write(_desktop, frame, size);
+	(void)written;
+}
+
+
+/* testLink_receive
+ *
+ * Runs the pump, or raises the UART's events, until a frame is read from the line
+ * or the timeout passes.  Frames that do not decode are skipped.
+ */
+bool testLink_receive(PacketView* view, uint32_t timeout_ms)
+{
+	struct timespec step = { 0, 100000 };
+	uint32_t start = HAL_GetTick();
+
+	while (!_takeFrame())
+	{
+		if (HAL_GetTick() - start >= timeout_ms)
+		{
+			return false;
+		}
+		if (_pump != NULL)
+		{
+			_pump();
+		}
+		_readLine();
+		nanosleep(&step, NULL);
+	}
+
+	packetView_init(view, _frame);
+	view->length = receivedPayloadLength(_frame);
+	return true;
+}
+
+
+/* testLink_receiveHeader
+ *
+ * Receives frames until one with a header, skipping the others, or the timeout.
+ */
+bool testLink_receiveHeader(PacketView* view, const char header[UART_PACKET_HEADER_SIZE], uint32_t timeout_ms)
+{
+	uint32_t start = HAL_GetTick();
+	uint32_t elapsed;
+
+	while ((elapsed = HAL_GetTick() - start) <= timeout_ms)
+	{
+		if (!testLink_receive(view, timeout_ms - elapsed))
+		{
+			return false;
+		}
+		if (memcmp(view->header, header, UART_PACKET_HEADER_SIZE) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+/* testLink_drain
+ *
+ * Runs for a time and drops the frames received.
+ */
+void testLink_drain(uint32_t time_ms)
+{
+	testLink_run(time_ms);
+	_lineLength = 0;
+}
+
+
+/* USART2_IRQHandler
+ *
+ * As the example's stm32wlxx_it.c, after the HAL's handler.
+ */
+void USART2_IRQHandler(void)
+{
+	uartTransport_IRQHandler();
+}
+
+
+/* _takeFrame
+ *
+ * Takes the first whole frame off the bytes read and decodes it.  Returns false if
+ * none is whole yet.
+ */
+bool _takeFrame(void)
+{
+	uint32_t length;
+	uint32_t taken;
+
+	do
+	{
+#ifdef UART_FRAMING_COBS
+		// up to the delimiter
+		for (length = 0; length < _lineLength && _line[length] != UART_FRAME_DELIMITER; length++)
+		{
+		}
+		if (length == _lineLength)
+		{
+			return false;
+		}
+		taken = length + 1;
+#else
+		// a frame's length
+		if (_lineLength < UART_FRAME_SIZE)
+		{
+			return false;
+		}
+		length = UART_FRAME_SIZE;
+		taken = length;
+#endif
+		memset(_frame, 0, sizeof(_frame));
+		memcpy(_frame, _line, (length < UART_FRAME_SIZE) ? length : UART_FRAME_SIZE);
+		memmove(_line, _line + taken, _lineLength - taken);
+		_lineLength -= taken;
+	} while (length > UART_FRAME_SIZE || !decodeFrame(_frame, (uint16_t)length));
+
+	return true;
+}
+
+
+/* _readLine
+ *
+ * Reads what the module has written to the line.
+ */
+void _readLine(void)
+{
+	ssize_t count;
+
+	if (_lineLength < sizeof(_line))
+	{
+		count = read(_desktop, _line + _lineLength, sizeof(_line) - _lineLength);
+		if (count > 0)
+		{
+			_lineLength += (uint32_t)count;
+		}
+	}
+}
@@ -0,0 +1,130 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ *
+ * Runs the checks of the module's parts, or their benchmarks.
+ *
+ *	desktop_com_test [-b] [part ...]
+ *
+ * Every part is run if none is named.  -b runs the benchmarks rather than the
+ * checks.  Exits with 1 if a check failed.
+ */
+
+
+#include <host_test.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+
+/*
+ * A part of the module, with its checks and its benchmarks (each NULL for none).
+ */
+typedef struct {
+	const char* name;
+	uint32_t (*check)(void);
+	void (*bench)(void);
+} TestPart;
+
+/*
+ * The parts, in the order they are run.
+ */
+static const TestPart _parts[] = {
+	{"packet_queue", packetQueueTest_check, packetQueueBench_run},
+	{"command_table", NULL, commandTableBench_run},
+	{"uart_packet_helpers", uartPacketHelpersTest_check, NULL},
+	{"uart_transport_layer", uartTransportTest_check, uartTransportBench_run},
+	{"desktop_app_session", desktopAppSessionTest_check, NULL},
+	{"rtt_estimator", NULL, rttEstimatorBench_run},
+#ifdef SESSION_MAILBOX
+	{"session_mailbox", NULL, sessionMailboxBench_run},
+#endif
+};
+
+
+int main(int argc, char** argv)
+{
+	bool bench = false;
+	bool named;
+	uint32_t failed = 0;
+	size_t p;
+	int a;
+	int first = 1;
+
+	if (argc > 1 && strcmp(argv[1], "-b") == 0)
+	{
+		bench = true;
+		first = 2;
+	}
+
+	// every named part must exist
+	for (a = first; a < argc; a++)
+	{
+		for (p = 0; p < sizeof(_parts) / sizeof(_parts[0]) && strcmp(argv[a], _parts[p].name) != 0; p++)
+		{
+		}
+		if (p == sizeof(_parts) / sizeof(_parts[0]))
+		{
+			fprintf(stderr, "usage: %s [-b] [part ...]\nparts:", argv[0]);
+			for (p = 0; p < sizeof(_parts) / sizeof(_parts[0]); p++)
+			{
+				fprintf(stderr, " %s", _parts[p].name);
+			}
+			fprintf(stderr, "\n");
+			return 2;
+		}
+	}
+
+	for (p = 0; p < sizeof(_parts) / sizeof(_parts[0]); p++)
+	{
+		named = (first == argc);
+		for (a = first; a < argc && !named; a++)
+		{
+			named = (strcmp(argv[a], _parts[p].name) == 0);
+		}
+		if (!named || (bench && _parts[p].bench == NULL) || (!bench && _parts[p].check == NULL))
+		{
+			continue;
+		}
+
+		printf("== %s\n", _parts[p].name);
+		if (bench)
+		{
+			_parts[p].bench();
+		}
+		else
+		{
+			failed += _parts[p].check();
+		}
+	}
+
+	if (!bench)
+	{
+		printf("%u checks failed\n", (unsigned)failed);
+	}
+	return (failed == 0) ? 0 : 1;
+}
+
+
+/* test_check
+ *
+ * Prints the check's name and outcome on a line.
+ */
+uint32_t test_check(const char* name, bool passed)
+{
+	printf("%-70s  %s\n", name, passed ? "ok" : "FAILED");
+	return passed ? 0 : 1;
+}
+
+
+/* test_now_ns
+ *
+ * CLOCK_MONOTONIC.
+ */
+uint64_t test_now_ns(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
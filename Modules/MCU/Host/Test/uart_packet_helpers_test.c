@@ -0,0 +1,376 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ *
+ * Checks of the packet helpers (uart_packet_helpers.h), in the framing the module
+ * is built with.
+ */
+
+
+#include <host_test.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+
+
+/*
+ * Command running the desktop application's side of the framing checks (see
+ * frame_interop.py), given the framing, the payloads and the link segment's size.
+ */
+#define FRAME_INTEROP_COMMAND "python3 " TEST_DIR "/frame_interop.py"
+#ifdef UART_FRAMING_COBS
+#define FRAME_INTEROP_FRAMING "cobs"
+#else
+#define FRAME_INTEROP_FRAMING "fixed"
+#endif
+#ifdef UART_PAYLOAD_BINARY
+#define FRAME_INTEROP_PAYLOAD "binary"
+#else
+#define FRAME_INTEROP_PAYLOAD "text"
+#endif
+
+/*
+ * Exit status of the shell when the command is not found.
+ */
+#define SHELL_NOT_FOUND 127
+
+/*
+ * Header and link segments of the frames checked.
+ */
+static const uint8_t _header[UART_PACKET_HEADER_SIZE] = {'T', 'E', 'S', 'T'};
+#if UART_PACKET_LINK_SIZE > 0
+static const uint8_t _link[UART_PACKET_LINK_SIZE] = {0x21, 0x3F};
+#endif
+
+
+/*
+ * Private helper function prototypes.
+ */
+uint16_t _buildFrame(uint8_t frame[UART_FRAME_SIZE], const uint8_t* payload, uint16_t length);
+bool _roundTrip(const uint8_t* payload, uint16_t length);
+uint32_t _checkDesktopParsing(void);
+void _sendToDesktop(FILE* desktop, const uint8_t* payload, uint16_t length);
+void _printHex(FILE* stream, const uint8_t* bytes, uint16_t count);
+uint32_t _checkSevenBit(void);
+
+
+/* uartPacketHelpersTest_check
+ *
+ * Checks frames encoded and decoded again with a short text payload, an empty one,
+ * a full-length one and ones of zero bytes, that short frames are discarded, and
+ * that the desktop application parses the frames encoded.  With COBS framing also
+ * checks the frame lengths and that frames with a corrupted code or length byte
+ * are discarded.  Then checks bytes packed into 7-bit characters.
+ */
+uint32_t uartPacketHelpersTest_check(void)
+{
+	uint8_t zeros[UART_PACKET_PAYLOAD_SIZE];
+	uint8_t full[UART_PACKET_PAYLOAD_SIZE];
+	uint8_t mixed[UART_PACKET_PAYLOAD_SIZE];
+	uint8_t frame[UART_FRAME_SIZE];
+	uint32_t failed = 0;
+	uint16_t i;
+
+	memset(zeros, 0, sizeof(zeros));
+	for (i = 0; i < UART_PACKET_PAYLOAD_SIZE; i++)
+	{
+		full[i] = (uint8_t)('a' + i % 26);
+		mixed[i] = (i % 3 == 0) ? 0 : (uint8_t)i;
+	}
+
+	// round trips
+	failed += test_check("round trip:  text payload", _roundTrip((const uint8_t*)"hello", 5));
+	failed += test_check("round trip:  empty payload", _roundTrip(zeros, 0));
+	failed += test_check("round trip:  full-length payload", _roundTrip(full, UART_PACKET_PAYLOAD_SIZE));
+	failed += test_check("round trip:  full-length payload of zero bytes", _roundTrip(zeros, UART_PACKET_PAYLOAD_SIZE));
+	failed += test_check("round trip:  zero bytes within the payload", _roundTrip(mixed, UART_PACKET_PAYLOAD_SIZE - 1));
+
+	// incomplete frames
+	_buildFrame(frame, full, UART_PACKET_PAYLOAD_SIZE);
+	failed += test_check("decode:  short frame discarded", !decodeFrame(frame, 2));
+
+#ifdef UART_FRAMING_COBS
+	// frame lengths
+	failed += test_check("frame length:  empty payload sends the header, link, length, code and delimiter",
+			_buildFrame(frame, zeros, 0) == UART_PACKET_HEADER_SIZE + UART_PACKET_LINK_SIZE + 3
+			&& frameLength(frame) == UART_PACKET_HEADER_SIZE + UART_PACKET_LINK_SIZE + 3);
+	failed += test_check("frame length:  full-length payload fills the frame buffer",
+			_buildFrame(frame, full, UART_PACKET_PAYLOAD_SIZE) == UART_FRAME_SIZE
+			&& frameLength(frame) == UART_FRAME_SIZE);
+	failed += test_check("frame length:  longer payload cut to the full length",
+			_buildFrame(frame, full, UART_PACKET_PAYLOAD_SIZE + 1) == UART_FRAME_SIZE);
+	failed += test_check("decode:  frame longer than the buffer discarded", !decodeFrame(frame, UART_FRAME_SIZE));
+
+	// corrupted code bytes
+	i = _buildFrame(frame, zeros, UART_PACKET_PAYLOAD_SIZE) - 1;
+	frame[i - 1] = 0;
+	failed += test_check("corrupted code byte:  zero, discarded", !decodeFrame(frame, i));
+	i = _buildFrame(frame, zeros, UART_PACKET_PAYLOAD_SIZE) - 1;
+	frame[0] = (uint8_t)(i + 1);
+	failed += test_check("corrupted code byte:  past the end of the frame, discarded", !decodeFrame(frame, i));
+	i = _buildFrame(frame, (const uint8_t*)"hello", 5) - 1;
+	frame[0]--;
+	failed += test_check("corrupted code byte:  chain not ending at the end of the frame, discarded",
+			!decodeFrame(frame, i));
+
+	// length byte disagreeing with the payload received
+	i = _buildFrame(frame, (const uint8_t*)"hello", 5) - 1;
+	frame[1 + UART_PACKET_HEADER_SIZE + UART_PACKET_LINK_SIZE]++;
+	failed += test_check("corrupted length byte:  discarded", !decodeFrame(frame, i));
+#endif
+
+	// the desktop application's side
+	failed += _checkDesktopParsing();
+
+	// 7-bit packing
+	failed += _checkSevenBit();
+
+	return failed;
+}
+
+
+/* uartPacketHelpersTest_unpackSevenBit
+ *
+ * Gathers the characters' bits, least significant first, emitting a byte for every
+ * 8, as the desktop application's unpackSevenBit() does.
+ */
+bool uartPacketHelpersTest_unpackSevenBit(const uint8_t* chars, uint16_t count, uint8_t* bytes)
+{
+	uint32_t bits = 0;
+	uint8_t held = 0;
+	uint16_t length = 0;
+	uint16_t i;
+
+	for (i = 0; i < SEVEN_BIT_LENGTH(count); i++)
+	{
+		if (chars[i] > 0x7F)
+		{
+			return false;
+		}
+		bits |= (uint32_t)chars[i] << held;
+		held += 7;
+		if (held >= 8 && length < count)
+		{
+			bytes[length++] = (uint8_t)bits;
+			bits >>= 8;
+			held -= 8;
+		}
+	}
+
+	return true;
+}
+
+
+/* _checkSevenBit
+ *
+ * Checks the characters a byte of ones packs into, the number of characters for no
+ * bytes and for seven, and that every byte value packs into 7-bit characters that
+ * unpack to it again.
+ */
+uint32_t _checkSevenBit(void)
+{
+	static const uint8_t ones[] = {0xFF};
+	uint8_t bytes[256];
+	uint8_t unpacked[256];
+	uint8_t chars[SEVEN_BIT_LENGTH(256)];
+	uint32_t failed = 0;
+	uint16_t length;
+	uint16_t i;
+
+	for (i = 0; i < sizeof(bytes); i++)
+	{
+		bytes[i] = (uint8_t)(0xFF - i);
+	}
+
+	failed += test_check("7-bit:  a byte of ones packs into 0x7F and 0x01",
+			packSevenBit(ones, 1, chars) == 2 && chars[0] == 0x7F && chars[1] == 0x01);
+	failed += test_check("7-bit:  no bytes pack into no characters", packSevenBit(bytes, 0, chars) == 0);
+	failed += test_check("7-bit:  seven bytes pack into eight characters",
+			packSevenBit(bytes, 7, chars) == 8 && SEVEN_BIT_LENGTH(7) == 8);
+
+	length = packSevenBit(bytes, sizeof(bytes), chars);
+	failed += test_check("7-bit:  every byte value packed and unpacked again",
+			length == SEVEN_BIT_LENGTH(sizeof(bytes))
+			&& uartPacketHelpersTest_unpackSevenBit(chars, sizeof(bytes), unpacked)
+			&& memcmp(unpacked, bytes, sizeof(bytes)) == 0);
+
+	return failed;
+}
+
+
+/* _buildFrame
+ *
+ * Writes the header, link segment and payload into a frame buffer through a
+ * packet view and encodes it.  Bytes past the payload are set to a marker that
+ * decoding must clear, unless they are sent (fixed-length text payloads).
+ */
+uint16_t _buildFrame(uint8_t frame[UART_FRAME_SIZE], const uint8_t* payload, uint16_t length)
+{
+	PacketView view;
+
+	memset(frame, 0xEE, UART_FRAME_SIZE);
+	packetView_init(&view, frame);
+	memcpy(view.header, _header, UART_PACKET_HEADER_SIZE);
+#if UART_PACKET_LINK_SIZE > 0
+	memcpy(view.link, _link, UART_PACKET_LINK_SIZE);
+#endif
+#if !defined(UART_FRAMING_COBS) && !defined(UART_PAYLOAD_BINARY)
+	memset(view.payload, 0, view.length);
+#endif
+	memcpy(view.payload, payload, (length < view.length) ? length : view.length);
+
+	return encodeFrame(frame, length);
+}
+
+
+/* _roundTrip
+ *
+ * Encodes a frame and decodes it again as if received, checking that the frame
+ * holds no delimiter but its last byte (COBS framing), that its length is what
+ * frameLength() reads, and that the packet comes back with the payload length
+ * received and its padding zeroed.
+ */
+bool _roundTrip(const uint8_t* payload, uint16_t length)
+{
+	uint8_t frame[UART_FRAME_SIZE];
+	PacketView view;
+	uint16_t sent = _buildFrame(frame, payload, length);
+	uint16_t received;
+	uint16_t i;
+	bool passed = (frameLength(frame) == sent);
+
+#ifdef UART_FRAMING_COBS
+	// one delimiter, ending the frame
+	for (i = 0; i + 1 < sent; i++)
+	{
+		passed = passed && frame[i] != UART_FRAME_DELIMITER;
+	}
+	passed = passed && frame[sent - 1] == UART_FRAME_DELIMITER;
+	received = sent - 1;
+#else
+	passed = passed && sent == UART_FRAME_SIZE;
+	received = sent;
+#endif
+	if (!passed || !decodeFrame(frame, received))
+	{
+		return false;
+	}
+
+	// the packet, as received
+	packetView_init(&view, frame);
+	passed = memcmp(view.header, _header, UART_PACKET_HEADER_SIZE) == 0
+			&& memcmp(view.payload, payload, length) == 0;
+#if UART_PACKET_LINK_SIZE > 0
+	passed = passed && memcmp(view.link, _link, UART_PACKET_LINK_SIZE) == 0;
+#endif
+#if defined(UART_FRAMING_COBS) || defined(UART_PAYLOAD_BINARY)
+	passed = passed && receivedPayloadLength(frame) == length;
+#else
+	passed = passed && receivedPayloadLength(frame) == UART_PACKET_PAYLOAD_SIZE;
+#endif
+	for (i = length; i < UART_PACKET_PAYLOAD_SIZE; i++)
+	{
+		passed = passed && view.payload[i] == 0;
+	}
+
+	return passed;
+}
+
+
+/* _checkDesktopParsing
+ *
+ * Encodes frames and passes them, with the header, link segment and payload each
+ * was built from, to the desktop application's SerialPacket (frame_interop.py),
+ * which parses them as it does frames received and fails if any comes out
+ * differently.  Text payloads hold no zero bytes, as the desktop application
+ * ends text at the first one.  The check is skipped if Python is not installed.
+ */
+uint32_t _checkDesktopParsing(void)
+{
+	static const char* name = "desktop application:  frames parsed by SerialPacket";
+	static const char* texts[] = {"hello", "", "ECHO this message back"};
+	uint8_t full[UART_PACKET_PAYLOAD_SIZE];
+	char command[256];
+	FILE* desktop;
+	uint16_t i;
+	int status;
+
+	snprintf(command, sizeof(command), "%s %s %s %u", FRAME_INTEROP_COMMAND, FRAME_INTEROP_FRAMING,
+			FRAME_INTEROP_PAYLOAD, (unsigned)UART_PACKET_LINK_SIZE);
+	desktop = popen(command, "w");
+	if (desktop == NULL)
+	{
+		return test_check(name, false);
+	}
+	signal(SIGPIPE, SIG_IGN);
+
+	// text payloads
+	for (i = 0; i < sizeof(texts) / sizeof(texts[0]); i++)
+	{
+		_sendToDesktop(desktop, (const uint8_t*)texts[i], (uint16_t)strlen(texts[i]));
+	}
+	for (i = 0; i < UART_PACKET_PAYLOAD_SIZE; i++)
+	{
+		full[i] = (uint8_t)('A' + i % 26);
+	}
+	_sendToDesktop(desktop, full, UART_PACKET_PAYLOAD_SIZE);
+#ifdef UART_PAYLOAD_BINARY
+	// binary payloads, which may hold and end in zero bytes
+	for (i = 0; i < UART_PACKET_PAYLOAD_SIZE; i++)
+	{
+		full[i] = (i % 3 == 0) ? 0 : (uint8_t)(0xFF - i);
+	}
+	_sendToDesktop(desktop, full, UART_PACKET_PAYLOAD_SIZE);
+	_sendToDesktop(desktop, full, 1);
+#endif
+
+	status = pclose(desktop);
+	signal(SIGPIPE, SIG_DFL);
+	if (WIFEXITED(status) && WEXITSTATUS(status) == SHELL_NOT_FOUND)
+	{
+		printf("%-70s  %s\n", name, "skipped (no python3)");
+		return 0;
+	}
+	return test_check(name, WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+
+/* _sendToDesktop
+ *
+ * Writes a line to frame_interop.py:  the frame encoded, the header and link
+ * segments and the payload, in hexadecimal.
+ */
+void _sendToDesktop(FILE* desktop, const uint8_t* payload, uint16_t length)
+{
+	uint8_t frame[UART_FRAME_SIZE];
+
+	_printHex(desktop, frame, _buildFrame(frame, payload, length));
+	fputc(' ', desktop);
+	_printHex(desktop, _header, UART_PACKET_HEADER_SIZE);
+#if UART_PACKET_LINK_SIZE > 0
+	_printHex(desktop, _link, UART_PACKET_LINK_SIZE);
+#endif
+	fputc(' ', desktop);
+	_printHex(desktop, payload, length);
+	fputc('\n', desktop);
+}
+
+
+/* _printHex
+ *
+ * Prints bytes as two hexadecimal digits each, or "-" for none.
+ */
+void _printHex(FILE* stream, const uint8_t* bytes, uint16_t count)
+{
+	uint16_t i;
+
+	if (count == 0)
+	{
+		fputc('-', stream);
+	}
+	for (i = 0; i < count; i++)
+	{
+		fprintf(stream, "%02x", bytes[i]);
+	}
+}
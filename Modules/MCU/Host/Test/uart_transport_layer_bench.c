@@ -0,0 +1,152 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ *
+ * Benchmark of the transport layer's priority lanes (uart_transport_layer.h) over
+ * the simulated UART, throttled to the baud rate.
+ */
+
+
+#include <host_test.h>
+#include <uart_transport_layer.h>
+#include <stdio.h>
+#include <string.h>
+
+
+/*
+ * Urgent packets are injected into a bulk transfer that keeps the bulk lane full,
+ * at an interval that is not a multiple of the frame time so that they land at
+ * every point of the frame in flight.  The time is from the packet being ready to
+ * be queued to it being received at the desktop's end.
+ */
+#define PRIORITY_BENCH_BAUD_RATE 115200
+#define PRIORITY_BENCH_INJECTIONS 60
+#define PRIORITY_BENCH_INTERVAL_NS 50300000ULL
+#define PRIORITY_BENCH_TIMEOUT_MS 1000
+
+
+/*
+ * Private helper function prototypes.
+ */
+void _pumpTransfer(void);
+
+
+// Private Variables
+static TransportTxLane _urgentLane;			// Lane the urgent packets are queued in
+static uint32_t _injected;					// Urgent packets received at the desktop's end
+static uint32_t _bulkSent;					// Bulk packets queued
+static uint64_t _due_ns;					// Time the next urgent packet is ready
+static bool _waiting;						// Flag for an urgent packet ready and not yet received
+static bool _queued;						// Flag for the urgent packet waiting being queued
+
+
+/* uartTransportBench_run
+ *
+ * Runs a bulk transfer over the throttled link through the transport layer, keeping
+ * the bulk lane full, and injects urgent packets into it:  first queued behind the
+ * transfer in the bulk lane (one lane, first in first out), then in the urgent lane
+ * with the strict and weighted schedules.  Prints the mean and longest time for an
+ * urgent packet to go out, and the bulk packets sent per second.
+ */
+void uartTransportBench_run(void)
+{
+	static const struct {
+		const char* name;
+		TransportTxLane lane;
+		TransportTxSchedule schedule;
+		uint32_t weight;
+	} runs[] = {
+		{"one lane (FIFO)", TX_LANE_BULK, TX_SCHEDULE_STRICT, 1},
+		{"urgent lane, strict", TX_LANE_URGENT, TX_SCHEDULE_STRICT, 1},
+		{"urgent lane, weighted 1:1", TX_LANE_URGENT, TX_SCHEDULE_WEIGHTED, 1}
+	};
+	PacketView view;
+	uint64_t start;
+	uint64_t latency;
+	uint64_t total;
+	uint64_t longest;
+	uint32_t r;
+
+	if (!testLink_openThrottled(PRIORITY_BENCH_BAUD_RATE) || !uartTransport_init(testLink_uart()))
+	{
+		fprintf(stderr, "link or transport layer initialization failed\n");
+		testLink_close();
+		return;
+	}
+	testLink_setPump(_pumpTransfer);
+
+	printf("%u baud, %u byte frames, %u bulk slots, %u urgent packets each\n", (unsigned)PRIORITY_BENCH_BAUD_RATE,
+			(unsigned)UART_FRAME_SIZE, (unsigned)UART_TX_QUEUE_LENGTH, (unsigned)PRIORITY_BENCH_INJECTIONS);
+	printf("%-26s  mean (ms)  max (ms)  bulk (packets/s)\n", "urgent packets sent by");
+	for (r = 0; r < sizeof(runs) / sizeof(runs[0]); r++)
+	{
+		uartTransport_setTxSchedule(runs[r].schedule, runs[r].weight);
+		_urgentLane = runs[r].lane;
+		_injected = 0;
+		_bulkSent = 0;
+		_waiting = false;
+		_queued = false;
+		total = 0;
+		longest = 0;
+		start = test_now_ns();
+		_due_ns = start + PRIORITY_BENCH_INTERVAL_NS;
+
+		// the desktop's end, for the urgent packets
+		while (_injected < PRIORITY_BENCH_INJECTIONS)
+		{
+			if (!testLink_receiveHeader(&view, "URGT", PRIORITY_BENCH_TIMEOUT_MS))
+			{
+				fprintf(stderr, "urgent packet %u not received\n", (unsigned)_injected);
+				break;
+			}
+			latency = test_now_ns() - _due_ns;
+			total += latency;
+			longest = (latency > longest) ? latency : longest;
+			_waiting = false;
+			_injected++;
+			_due_ns += PRIORITY_BENCH_INTERVAL_NS;
+		}
+
+		printf("%-26s  %9.2f  %8.2f  %16.0f\n", runs[r].name, (double)total / (_injected ? _injected : 1) / 1000000,
+				(double)longest / 1000000,
+				(double)(_bulkSent - UART_TX_QUEUE_LENGTH) * 1000000000 / (double)(test_now_ns() - start));
+	}
+
+	testLink_setPump(NULL);
+	uartTransport_deinit();
+	testLink_close();
+}
+
+
+/* _pumpTransfer
+ *
+ * Queues the urgent packet once it is due and its lane has a slot, and keeps the
+ * bulk lane full.
+ */
+void _pumpTransfer(void)
+{
+	PacketView view;
+
+	// the urgent packet
+	if (!_waiting && _injected < PRIORITY_BENCH_INJECTIONS && test_now_ns() >= _due_ns)
+	{
+		_waiting = true;
+		_queued = false;
+	}
+	if (_waiting && !_queued && uartTransport_acquireTxLane(&view, _urgentLane) == TRANSPORT_OKAY)
+	{
+		memcpy(view.header, "URGT", UART_PACKET_HEADER_SIZE);
+		snprintf((char*)view.payload, view.length, "%u", (unsigned)_injected);
+		uartTransport_commitTx();
+		_queued = true;
+	}
+
+	// the bulk lane
+	while (uartTransport_acquireTx(&view) == TRANSPORT_OKAY)
+	{
+		memcpy(view.header, "BULK", UART_PACKET_HEADER_SIZE);
+		snprintf((char*)view.payload, view.length, "%u", (unsigned)_bulkSent);
+		uartTransport_commitTx();
+		_bulkSent++;
+	}
+}
@@ -0,0 +1,153 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ *
+ * Checks of the transport layer (uart_transport_layer.h) over the simulated UART.
+ */
+
+
+#include <host_test.h>
+#include <uart_transport_layer.h>
+#include <stdio.h>
+#include <string.h>
+
+
+/*
+ * Time to wait for a frame that should arrive, and to wait out one that should
+ * not.  The link is unthrottled, so frames arrive in well under a millisecond.
+ */
+#define FRAME_TIMEOUT_MS 200
+#define QUIET_TIME_MS 20
+
+
+/*
+ * Private helper function prototypes.
+ */
+bool _queuePacket(uint32_t number);
+bool _receivePackets(const uint32_t* numbers, uint32_t count);
+uint32_t _checkWindow(void);
+
+
+/* uartTransportTest_check
+ *
+ * Opens the link and runs the checks on a transport layer initialized on it.
+ */
+uint32_t uartTransportTest_check(void)
+{
+	uint32_t failed = 0;
+
+	if (!testLink_open())
+	{
+		return test_check("link:  pty opened", false);
+	}
+	if (!uartTransport_init(testLink_uart()))
+	{
+		testLink_close();
+		return test_check("transport:  initialized", false);
+	}
+
+	failed += _checkWindow();
+
+	uartTransport_deinit();
+	testLink_close();
+	return failed;
+}
+
+
+/* _checkWindow
+ *
+ * Checks that a window of two holds the third and fourth packets back until the
+ * first is acknowledged, that a rewind resends the retained packets from the
+ * oldest, that acknowledgements release them, and that removing the window
+ * releases the packets still retained.
+ */
+uint32_t _checkWindow(void)
+{
+	static const uint32_t first[] = {0, 1};
+	static const uint32_t third[] = {2};
+	static const uint32_t rewound[] = {1, 2};
+	static const uint32_t fourth[] = {3};
+	static const uint32_t unwindowed[] = {4, 5, 6, 7};
+	uint32_t failed = 0;
+	bool queued = true;
+	uint32_t i;
+
+	// four packets, a window of two
+	uartTransport_setTxWindow(2);
+	for (i = 0; i < 4; i++)
+	{
+		queued = queued && _queuePacket(i);
+	}
+	failed += test_check("window:  four packets queued", queued);
+	failed += test_check("window:  only the first two sent", _receivePackets(first, 2));
+	failed += test_check("window:  queue full while two are retained and two wait",
+			uartTransport_txPending() == 2 && !_queuePacket(99));
+
+	// acknowledging one lets one more go
+	uartTransport_ackTx(1);
+	failed += test_check("ack:  one acknowledged, the third sent", _receivePackets(third, 1));
+
+	// rewinding resends the retained packets, the second and the third
+	uartTransport_rewindTx();
+	failed += test_check("rewind:  retained packets resent from the oldest", _receivePackets(rewound, 2));
+
+	// acknowledging those lets the fourth go
+	uartTransport_ackTx(2);
+	failed += test_check("ack:  two acknowledged, the fourth sent", _receivePackets(fourth, 1));
+	failed += test_check("ack:  nothing left to send", uartTransport_txPending() == 0);
+
+	// removing the window releases the fourth, so the queue has room for four
+	uartTransport_setTxWindow(0);
+	queued = true;
+	for (i = 4; i < 8; i++)
+	{
+		queued = queued && _queuePacket(i);
+	}
+	failed += test_check("no window:  retained packet released", queued);
+	failed += test_check("no window:  packets sent without acknowledgement", _receivePackets(unwindowed, 4));
+
+	return failed;
+}
+
+
+/* _queuePacket
+ *
+ * Queues a packet numbered in its payload.  Returns false if the tx queue is full.
+ */
+bool _queuePacket(uint32_t number)
+{
+	PacketView view;
+
+	if (uartTransport_acquireTx(&view) != TRANSPORT_OKAY)
+	{
+		return false;
+	}
+	memcpy(view.header, "TEST", UART_PACKET_HEADER_SIZE);
+	snprintf((char*)view.payload, view.length, "P%lu", (unsigned long)number);
+	return uartTransport_commitTx() == TRANSPORT_OKAY;
+}
+
+
+/* _receivePackets
+ *
+ * Returns if exactly the numbered packets are received, in order, and no other
+ * follows within a quiet time.
+ */
+bool _receivePackets(const uint32_t* numbers, uint32_t count)
+{
+	char expected[UART_PACKET_PAYLOAD_SIZE];
+	PacketView view;
+	uint32_t i;
+
+	for (i = 0; i < count; i++)
+	{
+		snprintf(expected, sizeof(expected), "P%lu", (unsigned long)numbers[i]);
+		if (!testLink_receive(&view, FRAME_TIMEOUT_MS) || memcmp(view.header, "TEST", UART_PACKET_HEADER_SIZE) != 0
+				|| strcmp((const char*)view.payload, expected) != 0)
+		{
+			return false;
+		}
+	}
+
+	return !testLink_receive(&view, QUIET_TIME_MS);
+}
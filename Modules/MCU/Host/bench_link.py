@@ -0,0 +1,142 @@
+# Author: Kevin Imlay
+#
+# Measures messages per second from the desktop to the MCU through the host
+# build, for each of the link setups in RUNS at each of the baud rates in
+# BAUD_RATES.  Each setup's desktop_com_host is built with its options (into
+# build/bench/<setup>), run throttled to the baud rate, and opened by the
+# desktop application scripts (Modules/Desktop) set to match.  Messages are
+# queued all at once and timed until the MCU answers a ping sent after them,
+# less the ping's own round trip.  With --framing, the setups are those of
+# FRAMING_RUNS instead, each streaming the bodies of BODIES, and goodput (body
+# characters per second) is what compares them.
+#
+#   python3 bench_link.py [--framing] [setup ...]
+
+import contextlib
+import io
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+HOST_DIR = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, os.path.join(HOST_DIR, '..', '..', 'Desktop'))
+
+import SerialProtocol
+import SerialSession
+
+
+# Link setups:  name, module options for the host build, and the desktop's
+# SerialProtocol settings to match.  A window of 16 needs the tx queue to hold
+# it and the rx queue and ring room for 17 packets.
+RUNS = [
+    ('CTS', '', {}),
+    ('window 1', '-DSESSION_WINDOWED -DSESSION_WINDOW_SIZE=1',
+        {'WINDOWED': True, 'WINDOW_SIZE': 1}),
+    ('window 4', '-DSESSION_WINDOWED -DSESSION_WINDOW_SIZE=4',
+        {'WINDOWED': True, 'WINDOW_SIZE': 4}),
+    ('window 16', '-DSESSION_WINDOWED -DSESSION_WINDOW_SIZE=16'
+        ' -DUART_TX_QUEUE_LENGTH=16 -DUART_RX_QUEUE_LENGTH=16',
+        {'WINDOWED': True, 'WINDOW_SIZE': 16}),
+]
+# Framings, compared with a window of 16 so the link rather than the
+# acknowledgements bounds the rate.
+FRAMING_RUNS = [
+    ('fixed', RUNS[3][1], RUNS[3][2]),
+    ('COBS', RUNS[3][1] + ' -DUART_FRAMING_COBS',
+        dict(RUNS[3][2], FRAMING_COBS=True)),
+]
+# Bodies streamed in the framing runs:  name and body length, None for a full
+# body.
+BODIES = [
+    ('short', 18),
+    ('full', None),
+]
+# SerialProtocol's settings, restored after each run.
+_DEFAULTS = {key: getattr(SerialProtocol, key)
+    for _, _, settings in RUNS + FRAMING_RUNS for key in settings}
+_DEFAULTS['SUPPORTED_BAUDS'] = SerialProtocol.SUPPORTED_BAUDS
+# Baud rates, the first the default (no negotiation), the others negotiated.
+BAUD_RATES = [9600, 921600]
+# Messages streamed in each run, about three seconds of the link's time.
+def _messages(baudRate):
+    return max(40, baudRate // 200)
+# Pings timed for a round trip, the quickest taken.
+PINGS = 5
+
+
+def _build(name, defs):
+    # Builds the host program for a setup, and returns its path.
+    build = os.path.join('build', 'bench', name.replace(' ', '_'))
+    subprocess.run(['make', '-s', '-C', HOST_DIR, 'BUILD=' + build,
+        'DEFS=' + defs], check=True)
+    return os.path.join(HOST_DIR, build, 'desktop_com_host')
+
+
+def _measure(program, settings, baudRate, bodyLength=None):
+    # Runs the host program and streams messages with bodies of bodyLength
+    # characters (None for a full body) to it.  Returns messages per second
+    # and body characters per second, or None if no session opened.
+    link = os.path.join(tempfile.mkdtemp(), 'tty')
+    host = subprocess.Popen([program, '-t', '-l', link],
+        stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    try:
+        while not os.path.exists(link):
+            time.sleep(0.01)
+        for key, value in settings.items():
+            setattr(SerialProtocol, key, value)
+        SerialProtocol.SUPPORTED_BAUDS = [] if baudRate == 9600 \
+            else [baudRate]
+
+        # the desktop scripts print each message sent
+        with contextlib.redirect_stdout(io.StringIO()):
+            session = SerialSession.STM32SerialCom(link)
+            if session is None:
+                return None
+            roundTrip = min(session.ping() for _ in range(PINGS))
+            body = 'x' * (SerialProtocol.MESSAGE_LENGTH
+                - SerialProtocol._headerLength())
+            if bodyLength is not None:
+                body = body[:bodyLength]
+            messages = _messages(baudRate)
+            started = time.monotonic()
+            for _ in range(messages):
+                session._outMessageQueue.put(('DATA', body))
+            session.ping()
+            elapsed = time.monotonic() - started - roundTrip
+            session.close()
+        return messages / elapsed, messages * len(body) / elapsed
+    finally:
+        host.terminate()
+        host.wait()
+        for key, value in _DEFAULTS.items():
+            setattr(SerialProtocol, key, value)
+
+
+def _result(result):
+    # Formats the result of a run for the table.
+    return '  %33s' % ('no session' if result is None
+        else '%8.1f  %9.0f' % result)
+
+
+if __name__ == '__main__':
+    names = sys.argv[1:]
+    framing = '--framing' in names
+    if framing:
+        names.remove('--framing')
+
+    print('%-18s' % 'setup' + ''.join('  %8d baud (msg/s, body B/s)' % b
+        for b in BAUD_RATES))
+    for name, defs, settings in (FRAMING_RUNS if framing else RUNS):
+        if names and name not in names:
+            continue
+        program = _build(name, defs)
+        if framing:
+            for bodyName, bodyLength in BODIES:
+                print('%-18s' % ('%s, %s body' % (name, bodyName))
+                    + ''.join(_result(_measure(program, settings, baudRate,
+                        bodyLength)) for baudRate in BAUD_RATES))
+        else:
+            print('%-18s' % name + ''.join(_result(_measure(program,
+                settings, baudRate)) for baudRate in BAUD_RATES))
@@ -25,8 +25,103 @@
  *	blocking and deterministic behavior.
  *
  *
- *	Note:  In place of a proper queue for message reception and transmission,
- *	the transport layer buffer is used.  This is a point for future development.
+ *		Messages can be built and read in place in the transport layer's queues
+ *	(acquire/commit and peek/release), without copying them in or out.
+ *		Messages are sent with a priority:  urgent messages (the session's own
+ *	replies and flow control, and the application's commands and their
+ *	acknowledgements) go in the transport layer's urgent lane and are sent ahead
+ *	of bulk messages (data), so they do not wait behind a bulk transfer (see
+ *	uart_transport_layer.h).  In windowed mode every message is sent in order
+ *	through the bulk lane, as the window resends them by sequence number.
+ *		Received messages are either dispatched by header code to handlers the
+ *	application registers, through a hash table that finds a handler in one
+ *	compare (see command_table.h), or left for the application to peek or
+ *	dequeue.  The session's own commands (echo, disconnect) are handled through
+ *	the same table.
+ *		If SESSION_PROFILE is defined at build time, the session also answers
+ *	the PROF command with the times of a stage of the transport and session
+ *	layers (see stage_profile.h).  The payload is the stage's index in decimal
+ *	(none for the first), and the reply is the index, the number of stages, the
+ *	units, the stage's name and its count, minimum, maximum and mean time,
+ *	separated by spaces.  A payload of "reset" clears the times.
+ *		The session and transport layers count packets and bytes each way, UART
+ *	errors by type, handshakes and their failures, timeouts, resends, dropped
+ *	messages and the most each queue has held (desktopAppSession_linkStats()).
+ *	The counts are kept across sessions.  The STAT command answers with them
+ *	in one packet:  SESSION_STAT_SIZE bytes in the layout below, packed into
+ *	7-bit characters (see packSevenBit()) so they pass as text.  A payload of
+ *	"reset" zeroes them once they have been answered with.
+ *		If SESSION_TRACE is defined at build time, the session also answers the
+ *	TRAC command with the event trace (see event_trace.h):  the trace is frozen,
+ *	and its entries are streamed in the bulk lane by the following updates,
+ *	in the layout below, until the last is queued.  A payload of "reset"
+ *	empties the trace once it has been dumped.
+ *		Messages for the application are moved out of the transport layer's rx
+ *	queue into the session's own receive queue, SESSION_RX_QUEUE_LENGTH messages
+ *	deep, so a burst from the desktop waits there for a slow application loop
+ *	while session commands behind it are still answered.  What happens to a
+ *	message that arrives with the receive queue full is the overflow policy (see
+ *	SessionRxOverflow), and the queue's depth and what it has dropped can be read
+ *	with desktopAppSession_rxStats().
+ *		Payloads are text unless sent with an explicit length (enqueueBinary or
+ *	commitMessageLength), which lets them hold zero bytes.  With
+ *	UART_PAYLOAD_BINARY (or COBS framing) the length is carried to the other
+ *	side, and a received payload's length is the one sent (see
+ *	uart_packet_helpers.h).
+ *		If SESSION_WINDOWED is defined at build time, the session uses a sliding
+ *	window in place of CTS stop-and-wait.  Every packet carries a sequence number
+ *	and a cumulative acknowledgement in its link segment (see
+ *	uart_packet_helpers.h), and up to SESSION_WINDOW_SIZE packets are sent in
+ *	each direction ahead of being acknowledged.  Sent packets are kept in the
+ *	transport layer's tx queue until acknowledged and are all resent (go-back-N)
+ *	if no acknowledgement arrives in time.  Received packets are acknowledged as
+ *	the session takes them out of the rx queue, so the window is also the flow
+ *	control.  An acknowledgement with nothing to piggyback on is sent on its own,
+ *	ahead of queued messages.  The desktop application must be set to the same
+ *	mode.
+ *		If SESSION_CREDIT is defined at build time instead, the session uses
+ *	credit-based flow control in place of CTS.  Every packet carries a sequence
+ *	number and a credit limit in its link segment:  the sequence number the
+ *	desktop application may send up to.  The MCU grants SESSION_CREDITS packets
+ *	past the last one taken out of the rx queue, so the desktop sends as many
+ *	as the MCU can hold without waiting.  Credit rides on the messages sent to
+ *	the desktop, or is sent on its own when it changes.  Nothing is resent.
+ *		If the transport layer is built with UART_HW_FLOW_CONTROL (hardware
+ *	RTS/CTS) and neither of the above, no software flow control is used at all.
+ *		Timeouts that wait on the desktop are taken from its measured response
+ *	time (see rtt_estimator.h) rather than fixed:  the handshake's ACKN to SYNA
+ *	exchange, and in windowed mode the time a message takes to be acknowledged,
+ *	less the frames' time on the wire, are round-trip samples, and each timeout
+ *	is the estimate's RTO plus the frames it covers at the current baud rate.  A
+ *	resend in windowed mode backs the RTO off.  The estimate starts over with
+ *	each handshake.  If SESSION_FIXED_TIMEOUTS is defined at build time, the RTO
+ *	stays at RECEIVE_TIMEOUT_MS.
+ *		Each handshake issues a session token, sent in hex ahead of the baud rate
+ *	in the ACKN payload.  A desktop application that lost the connection (its
+ *	serial adapter was unplugged, or it was restarted) resumes the open session
+ *	by sending the token in a RESUME_HEADER message at the negotiated baud rate,
+ *	in place of a new handshake.  The session's queues, baud rate and round-trip
+ *	estimate are kept, and the reply, sent ahead of queued messages, holds the
+ *	sequence numbers each side goes on from ("<next sent> <next expected>", in
+ *	windowed and credit modes); in windowed mode the messages not acknowledged
+ *	are sent again.  A RESUME_HEADER message with another token, or a SYNC, to
+ *	an open session closes it, as a DISC does, so the desktop's next SYNC starts
+ *	a new one.  Handshake messages to an open session are sent unsequenced (see
+ *	UART_LINK_UNSEQUENCED), as the desktop may not know the sequence numbers.
+ *		Either side may close the session.  The desktop sends a DISC, which the
+ *	MCU answers with a DISC.  The MCU (desktopAppSession_stop()) first sends the
+ *	messages it has queued, then sends a DISC, which the desktop answers with a
+ *	HANDSHAKE_HEADER_DISCACK message.  Each side waits a bounded time for the
+ *	answer, and a DISC crossing the other side's DISC is taken as the answer.
+ *
+ *
+ *	Note:  Messages queued for transmission are held in the transport layer's
+ *	tx queue.  Received messages for the application are held in the session's
+ *	receive queue until the application releases them.  While a message is held
+ *	in the transport layer's rx queue (the receive queue is full, with the
+ *	SESSION_RX_HOLD policy), no further messages are listened for (in windowed
+ *	mode, no further messages are acknowledged, and in credit mode, no further
+ *	credit is granted).
  */
 
 #ifndef INC_DESKTOP_APP_SESSION_LAYER_H_
@@ -34,15 +129,74 @@
 
 
 #include <stdbool.h>
+#include <command_table.h>
+#include <rtt_estimator.h>
 #include <uart_packet_helpers.h>
 #include <uart_transport_layer.h>
 
 /*
  * Timeout values, in milliseconds, for operations performed by the session manager.
+ * The receive and send timeouts are allowances on top of the time frames take on
+ * the wire at the current baud rate, so they follow a negotiated rate.  The receive
+ * timeout is the desktop's response time until it is measured (see rtt_estimator.h),
+ * and always with SESSION_FIXED_TIMEOUTS.
  */
 #define RECEIVE_TIMEOUT_MS 100
 #define SEND_TIMEOUT_MS 100
-#define SESSION_START_TIMEOUT_MS 1000
+#define SESSION_START_TIMEOUT_MS 1000		// Wait for the BAUD confirmation after switching
+
+/*
+ * Time budget of desktopAppSession_updateWithin() for an update without one, as
+ * desktopAppSession_update() is.
+ */
+#define SESSION_BUDGET_NONE UINT32_MAX
+
+/*
+ * Baud rates, in bits per second, the MCU offers to switch to during the handshake.
+ * The highest rate the desktop application also supports is used for the session.
+ * The UART returns to the rate it was initialized with when the session closes.
+ */
+#ifndef SESSION_BAUD_RATES
+#define SESSION_BAUD_RATES {115200, 230400, 460800, 921600}
+#endif
+
+/*
+ * Number of packets sent ahead of being acknowledged, in windowed mode.  It can be
+ * no more than the tx queue length, and the rx queue and ring must hold a full
+ * window from the desktop application.
+ */
+#ifndef SESSION_WINDOW_SIZE
+#define SESSION_WINDOW_SIZE 4
+#endif
+
+/*
+ * Number of packets the desktop may send ahead of the session taking them out of
+ * the rx queue, in credit mode.  By default, all the rx queue and ring can hold.
+ */
+#ifndef SESSION_CREDITS
+#define SESSION_CREDITS (UART_RX_QUEUE_LENGTH + UART_RX_RING_SIZE / UART_FRAME_SIZE - 1)
+#endif
+
+/*
+ * Number of slots in the handler table, for the session's commands and the
+ * application's.  Must be a power of two, and should be at least twice the number
+ * of headers registered so that lookups stay at one compare.
+ */
+#ifndef SESSION_HANDLERS
+#define SESSION_HANDLERS 16
+#endif
+
+/*
+ * Number of received messages the session holds for the application, and the
+ * policy for a message that arrives while they are all held (a SessionRxOverflow).
+ * The length must be a power of two.
+ */
+#ifndef SESSION_RX_QUEUE_LENGTH
+#define SESSION_RX_QUEUE_LENGTH 4
+#endif
+#ifndef SESSION_RX_OVERFLOW
+#define SESSION_RX_OVERFLOW SESSION_RX_HOLD
+#endif
 
 /*
  * Flow control message header (command) codes.
@@ -54,6 +208,59 @@
 #define HANDSHAKE_HEADER_DISCACK "DACK\0"
 #define CTS_HEADER "CTS\0\0"
 #define ECHO_HEADER "ECHO\0"
+#define BAUD_HEADER "BAUD\0"
+#define ACK_HEADER "ACK\0\0"
+#define CREDIT_HEADER "CRED\0"
+#define NAK_HEADER "NAK\0\0"
+#define PROF_HEADER "PROF\0"
+#define STAT_HEADER "STAT\0"
+#define TRAC_HEADER "TRAC\0"
+#define RESUME_HEADER "RSUM\0"
+
+/*
+ * IDs of the header codes, for the handler table (see command_table.h).
+ */
+#define HANDSHAKE_ID_SYNC COMMAND_ID('S', 'Y', 'N', 'C')
+#define HANDSHAKE_ID_ACKN COMMAND_ID('A', 'C', 'K', 'N')
+#define HANDSHAKE_ID_SYNACK COMMAND_ID('S', 'Y', 'N', 'A')
+#define HANDSHAKE_ID_DISC COMMAND_ID('D', 'I', 'S', 'C')
+#define HANDSHAKE_ID_DISCACK COMMAND_ID('D', 'A', 'C', 'K')
+#define CTS_ID COMMAND_ID('C', 'T', 'S', '\0')
+#define ECHO_ID COMMAND_ID('E', 'C', 'H', 'O')
+#define BAUD_ID COMMAND_ID('B', 'A', 'U', 'D')
+#define ACK_ID COMMAND_ID('A', 'C', 'K', '\0')
+#define CREDIT_ID COMMAND_ID('C', 'R', 'E', 'D')
+#define NAK_ID COMMAND_ID('N', 'A', 'K', '\0')
+#define PROF_ID COMMAND_ID('P', 'R', 'O', 'F')
+#define STAT_ID COMMAND_ID('S', 'T', 'A', 'T')
+#define TRAC_ID COMMAND_ID('T', 'R', 'A', 'C')
+#define RESUME_ID COMMAND_ID('R', 'S', 'U', 'M')
+
+/*
+ * STAT reply.  Multi-byte counts are little-endian.  16-bit counts stop at 0xFFFF,
+ * and high-water marks, two to a byte (low nibble first), at 15.
+ * 	0		layout version, SESSION_STAT_VERSION
+ * 	1		packets sent, received (32-bit)
+ * 	9		bytes sent, received (32-bit)
+ * 	17		frames malformed, bytes of noise, reception restarts, UART overrun,
+ * 			framing, noise and parity errors, DMA errors, handshakes, handshake
+ * 			failures, sessions opened, timeouts, resends, messages out of
+ * 			sequence, messages dropped (16-bit)
+ * 	47		high-water marks of the bulk and urgent tx lanes
+ * 	48		high-water marks of the rx queue and the receive queue
+ */
+#define SESSION_STAT_VERSION 1
+#define SESSION_STAT_SIZE 49
+
+/*
+ * TRAC reply.  The first packet is text:  the layout version, the number of
+ * entries that follow, the number overwritten before them, the units of their
+ * times and the entries to a packet.  Each following packet holds that many
+ * entries (fewer in the last), of TRACE_ENTRY_SIZE bytes each (see
+ * eventTrace_encode()), packed into 7-bit characters.
+ */
+#define SESSION_TRACE_VERSION 1
+#define SESSION_TRACE_PER_PACKET (UART_PACKET_PAYLOAD_SIZE * 7 / 8 / TRACE_ENTRY_SIZE)
 
 /*
  * Session Manager status codes for returns.
@@ -70,6 +277,71 @@ typedef enum {
 	SESSION_BUFFER_FULL
 } DesktopComSessionStatus;
 
+/*
+ * What becomes of a message for the application that is received while the
+ * session's receive queue is full.
+ * 	SESSION_RX_HOLD - it is left in the transport layer's rx queue until the
+ * 		application releases a message, so flow control holds the desktop off.
+ * 		Nothing is lost.
+ * 	SESSION_RX_REJECT - it is discarded and a NAK_HEADER message, with the
+ * 		rejected message's header code as its payload, is sent to the desktop.
+ * 	SESSION_RX_DROP_OLDEST - the oldest message held is discarded to make room.
+ * 	SESSION_RX_DROP_NEWEST - it is discarded.
+ */
+typedef enum {
+	SESSION_RX_HOLD,
+	SESSION_RX_REJECT,
+	SESSION_RX_DROP_OLDEST,
+	SESSION_RX_DROP_NEWEST
+} SessionRxOverflow;
+
+/*
+ * Priority of a message sent to the desktop, which is the transport layer tx lane
+ * it is queued in.
+ */
+typedef enum {
+	SESSION_PRIORITY_URGENT,
+	SESSION_PRIORITY_BULK
+} SessionPriority;
+
+/*
+ * Statistics of the session's receive queue, since the session was opened.
+ */
+typedef struct {
+	uint32_t depth;			// messages held for the application
+	uint32_t capacity;		// SESSION_RX_QUEUE_LENGTH
+	uint32_t highWater;		// most messages held at once
+	uint32_t pending;		// messages received and not yet dispatched or moved into the queue
+	uint32_t rejected;		// messages rejected (SESSION_RX_REJECT)
+	uint32_t droppedOldest;	// messages discarded for room (SESSION_RX_DROP_OLDEST)
+	uint32_t droppedNewest;	// messages discarded on arrival (SESSION_RX_DROP_NEWEST)
+} SessionRxStats;
+
+/*
+ * Counts kept by the session and transport layers, since initialization or the
+ * last reset.
+ */
+typedef struct {
+	TransportStats transport;	// the transport layer's counts
+	uint32_t handshakes;		// SYNC messages answered
+	uint32_t handshakeFailures;	// handshakes abandoned (another message in place of the SYNA, or none)
+	uint32_t sessions;			// sessions opened
+	uint32_t timeouts;			// CTS Message windows closed with nothing received
+	uint32_t resends;			// times unacknowledged messages were resent (windowed mode)
+	uint32_t outOfSequence;		// messages dropped out of sequence (windowed mode)
+	uint32_t dropped;			// messages for the application rejected or discarded with the receive queue full
+	uint32_t receiveHighWater;	// most messages held by the receive queue
+} SessionLinkStats;
+
+/*
+ * A handler for the messages received with a header code, called by the session
+ * update with a view of the message in place in the rx queue and the context it
+ * was registered with.  Returning SESSION_BUFFER_FULL (such as when no tx slot is
+ * free for a reply) leaves the message to be handled again on the next update.
+ * Any other return releases the message.
+ */
+typedef DesktopComSessionStatus (*SessionHandler)(const PacketView* message, void* context);
+
 
 /* desktopAppSession_init
  *
@@ -111,9 +383,10 @@ bool desktopAppSession_deinit(void);
 /* desktopAppSession_start
  *
  * Function:
- *	Attempts to start a session with the desktop application.  Performs start
- *	handshake with desktop computer if present, starting the session.  Waits
- *	on timeout.
+ *	Attempts to start a session with the desktop application.  Advances the
+ *	start handshake with desktop computer by a step if one is in progress,
+ *	starting the session once it completes.  Does not wait:  call repeatedly
+ *	(such as once per main loop) until it returns SESSION_OKAY.
  *
  * Return:
  *	DesktopComSessionStatus
@@ -122,29 +395,49 @@ bool desktopAppSession_deinit(void);
  *		SESSION_OKAY - if a session is already open or if successfully opened
  *		SESSION_ERROR - if an error occurred during UART communication
  *		SESSION_TIMEOUT - if the desktop application did not attempt to start
- *				a session.
- * 		SESSION_OPEN - a session is already open
+ *				a session, or stopped answering during the handshake
+ *		SESSION_BUSY - if the handshake is in progress, a closed session
+ *				is finishing sending its disconnection confirmation, or the
+ *				session is being stopped (see desktopAppSession_stop())
  *
  * Note:
  * 	Software flow control is not used while listening for first step of
  * 	handshake, which can cause difficulty for the desktop application to
  * 	establish a handshake successfully.  This is a point for future development.
+ * 	The baud rate is negotiated during the handshake.  If switching to the
+ * 	negotiated rate fails, the session is opened at the default rate.  An open
+ * 	session is resumed by the desktop without a handshake (see RESUME_HEADER).
  */
 DesktopComSessionStatus desktopAppSession_start(void);
 
 /* desktopAppSession_stop
  *
  * Function:
- *	Force-closes a session with the desktop application if a session is open.
+ *	Closes the session with the desktop application.  The messages queued
+ *	for the desktop are sent first (in windowed mode, until acknowledged),
+ *	then a DISC, and the desktop's DACK is waited for.  Advances the closing
+ *	by a step if one is in progress.  Does not wait:  call repeatedly (such
+ *	as once per main loop) until it no longer returns SESSION_BUSY.  Only
+ *	this function advances the closing; desktopAppSession_start() and
+ *	desktopAppSession_update() wait for it to finish.
  *
  * Return:
  * 	DesktopComSessionStatus
  *		SESSION_NOT_INIT - if desktopAppSession_init() has not been performed
  *				prior
- *		SESSION_OKAY - if a session is already closed or if successfully opened
+ *		SESSION_OKAY - if a session is already closed or if the desktop
+ *				confirmed the closing
+ *		SESSION_TIMEOUT - if the session was closed without the desktop's
+ *				confirmation
+ *		SESSION_BUSY - if the closing is in progress
  *
  * Note:
- * 	Undefined - this function's implementation is a point for future development.
+ * 	Sending the queued messages is bounded by the send timeout (and a retransmit
+ * 	timeout, in windowed mode), after which the rest are dropped, and the wait
+ * 	for the DACK by the reply timeout.  Meanwhile no messages are taken from the
+ * 	application (SESSION_NOT_OPEN), session commands are still answered, and a
+ * 	DISC from the desktop closes the session as it would an open one.  A
+ * 	handshake in progress is abandoned.
  */
 DesktopComSessionStatus desktopAppSession_stop(void);
 
@@ -160,18 +453,209 @@ DesktopComSessionStatus desktopAppSession_stop(void);
  *		SESSION_NOT_INIT - if desktopAppSession_init() has not been performed
  *				prior
  *		SESSION_NOT_OPEN - if a session has not been opened with the desktop
- *			application
+ *			application (a closed session finishes closing)
  *		SESSION_ERROR - if an error occurred with the UART communication
+ *		SESSION_CLOSED - if the desktop application closed the session
+ *		SESSION_BUFFER_FULL - if a session command could not be answered as
+ *			the tx queue is full (it is answered on a later update)
+ *		other - as returned by a registered handler
  *		SESSION_OKAY - otherwise (does not distinguish whether or not any
  *			messages were received.
  *
  * Note:
- * 	Updating the session only stores received messages in a queue.  Getting
- * 	received messages requires the use of the desktopAppSession_dequeueMessage()
- * 	function.
+ * 	Messages with a registered handler are dispatched to it.  Updating the
+ * 	session only moves other received messages into the receive queue.  Getting
+ * 	them requires the use of the desktopAppSession_peekMessage()
+ * 	or desktopAppSession_dequeueMessage() functions.  If the receive queue is
+ * 	full, the overflow policy is applied (see SessionRxOverflow).
+ * 	The update does not wait.  In CTS mode the CTS window is kept open across
+ * 	updates until a message arrives or the window times out (SESSION_TIMEOUT).
+ * 	In windowed mode, the update does not wait for messages:  it takes
+ * 	acknowledgements, resends unacknowledged messages on timeout, answers
+ * 	session commands and acknowledges released messages.  In credit mode, it
+ * 	answers session commands and grants credit for released messages.
  */
 DesktopComSessionStatus desktopAppSession_update(void);
 
+/* desktopAppSession_updateWithin
+ *
+ * Function:
+ *	Performs an update of the state of the session manager, as
+ *	desktopAppSession_update() does, within a time budget.  The update's
+ *	stages (taking acknowledgements and resending in windowed mode, queueing a
+ *	trace dump, starting transmission, dispatching received messages, and
+ *	acknowledging, granting credit or listening) each run only while the
+ *	budget lasts, and messages are dispatched one at a time while it lasts.
+ *	The stages and messages left over are taken up by the next update, which
+ *	starts from the stage this one stopped at.  Reports the work left over.
+ *
+ * Parameters:
+ *	budget_us - time budget for the update, in microseconds, or
+ *		SESSION_BUDGET_NONE for none
+ *	backlog - pointer to store the number of packets waiting to be sent plus
+ *		the number received and not yet dispatched or moved into the receive
+ *		queue, or NULL
+ *
+ * Return:
+ *	DesktopComSessionStatus - as desktopAppSession_update()
+ *
+ * Note:
+ * 	Nothing in an update waits on the UART.  The budget is checked before each
+ * 	stage and each message, so an update can overrun it by one stage or one
+ * 	message's handler:  the first stage always runs, and the dispatch stage
+ * 	always takes one message, so that updates make progress even when the
+ * 	budget is zero.  The budget is measured with the stage profile's time
+ * 	source (see stage_profile.h):  the DWT cycle counter on the CM4, the
+ * 	SysTick counter on the CM0+ and the monotonic clock on a host, so it has a
+ * 	resolution of a core clock cycle (a nanosecond on a host).  Budgets longer
+ * 	than STAGE_PROFILE_SPAN in those units (about 44 s at 48 MHz, 2.1 s on a
+ * 	host) are cut to it.
+ */
+DesktopComSessionStatus desktopAppSession_updateWithin(uint32_t budget_us, uint32_t* backlog);
+
+/* desktopAppSession_registerHandler
+ *
+ * Function:
+ *	Registers a handler for the messages received with a header code.  Updates
+ *	dispatch such messages to the handler, found in the handler table in
+ *	constant time, rather than leaving them for desktopAppSession_peekMessage().
+ *
+ * Parameters:
+ *	header - char array message header code
+ *	handler - function to call with each message, or NULL to leave messages
+ *			with the header for desktopAppSession_peekMessage() again
+ *	context - pointer passed to the handler
+ *
+ * Return:
+ *	DesktopComSessionStatus
+ *		SESSION_NOT_INIT - if desktopAppSession_init() has not been performed
+ *				prior
+ *		SESSION_ERROR - if the header is one of the session's own
+ *		SESSION_BUFFER_FULL - if the handler table is full
+ *		SESSION_OKAY - if the handler was registered (replacing any before)
+ *
+ * Note:
+ * 	A header's slot in the table is kept once registered, even with a NULL
+ * 	handler, so registering and unregistering the same headers does not fill
+ * 	the table.
+ */
+DesktopComSessionStatus desktopAppSession_registerHandler(const char header[UART_PACKET_HEADER_SIZE],
+		SessionHandler handler, void* context);
+
+/* desktopAppSession_setRxOverflow
+ *
+ * Function:
+ *	Sets the policy for messages received while the session's receive queue is
+ *	full.  The policy is SESSION_RX_OVERFLOW until set.
+ *
+ * Parameters:
+ *	policy - SessionRxOverflow policy
+ *
+ * Return:
+ *	DesktopComSessionStatus
+ *		SESSION_NOT_INIT - if desktopAppSession_init() has not been performed
+ *				prior
+ *		SESSION_ERROR - if the policy is not a SessionRxOverflow
+ *		SESSION_OKAY - if the policy was set
+ *
+ * Note:
+ * 	With SESSION_RX_DROP_OLDEST, the message desktopAppSession_peekMessage()
+ * 	handed out may be discarded by an update, so its view is only valid until
+ * 	the next update.
+ */
+DesktopComSessionStatus desktopAppSession_setRxOverflow(SessionRxOverflow policy);
+
+/* desktopAppSession_rxStats
+ *
+ * Function:
+ *	Reads the statistics of the session's receive queue.
+ *
+ * Parameters:
+ *	stats - pointer to store the statistics
+ *
+ * Return:
+ *	DesktopComSessionStatus
+ *		SESSION_NOT_INIT - if desktopAppSession_init() has not been performed
+ *				prior
+ *		SESSION_OKAY - if the statistics were read
+ *
+ * Note:
+ * 	The statistics are cleared when a session is opened.
+ */
+DesktopComSessionStatus desktopAppSession_rxStats(SessionRxStats* stats);
+
+/* desktopAppSession_linkStats
+ *
+ * Function:
+ *	Reads the counts kept by the session and transport layers.
+ *
+ * Parameters:
+ *	stats - pointer to store the counts
+ *
+ * Return:
+ *	DesktopComSessionStatus
+ *		SESSION_NOT_INIT - if desktopAppSession_init() has not been performed
+ *				prior
+ *		SESSION_OKAY - if the counts were read
+ *
+ * Note:
+ * 	Unlike desktopAppSession_rxStats(), the counts are kept across sessions.
+ */
+DesktopComSessionStatus desktopAppSession_linkStats(SessionLinkStats* stats);
+
+/* desktopAppSession_resetLinkStats
+ *
+ * Function:
+ *	Zeroes the counts kept by the session and transport layers.
+ *
+ * Return:
+ *	DesktopComSessionStatus
+ *		SESSION_NOT_INIT - if desktopAppSession_init() has not been performed
+ *				prior
+ *		SESSION_OKAY - if the counts were zeroed
+ */
+DesktopComSessionStatus desktopAppSession_resetLinkStats(void);
+
+/* desktopAppSession_roundTrip
+ *
+ * Function:
+ *	Reads the estimate of the desktop's response time that the timeouts are
+ *	taken from (see rtt_estimator.h).
+ *
+ * Parameters:
+ *	rtt - pointer to store the estimate
+ *
+ * Return:
+ *	DesktopComSessionStatus
+ *		SESSION_NOT_INIT - if desktopAppSession_init() has not been performed
+ *				prior
+ *		SESSION_OKAY - if the estimate was read
+ *
+ * Note:
+ * 	The estimate starts over with each handshake.
+ */
+DesktopComSessionStatus desktopAppSession_roundTrip(RttEstimator* rtt);
+
+/* desktopAppSession_setTxSchedule
+ *
+ * Function:
+ *	Sets how urgent and bulk messages share the UART (see
+ *	TransportTxSchedule).  The schedule is UART_TX_SCHEDULE until set.
+ *
+ * Parameters:
+ *	schedule - TX_SCHEDULE_STRICT or TX_SCHEDULE_WEIGHTED
+ *	urgentWeight - urgent messages sent for each bulk message while both wait,
+ *			for TX_SCHEDULE_WEIGHTED
+ *
+ * Return:
+ *	DesktopComSessionStatus
+ *		SESSION_NOT_INIT - if desktopAppSession_init() has not been performed
+ *				prior
+ *		SESSION_ERROR - if the schedule is not valid or the weight is 0
+ *		SESSION_OKAY - if the schedule was set
+ */
+DesktopComSessionStatus desktopAppSession_setTxSchedule(TransportTxSchedule schedule, uint32_t urgentWeight);
+
 /* desktopAppSession_enqueueMessage
  *
  * Function:
@@ -180,20 +664,24 @@ DesktopComSessionStatus desktopAppSession_update(void);
  * Parameters:
  *	header - char array message header code
  *	body - char array message body (or payload)
+ *	priority - SESSION_PRIORITY_URGENT or SESSION_PRIORITY_BULK
  *
  * Return:
  *	DesktopComSessionStatus
  *		SESSION_NOT_INIT - if desktopAppSession_init() has not been performed
  *				prior
- *		SESSION_BUFFER_FULL - if the queue is full
+ *		SESSION_BUFFER_FULL - if the priority's queue is full
+ *		SESSION_NOT_OPEN - if the session is being stopped
  *		SESSION_OKAY - if enqueuing successful
  */
-DesktopComSessionStatus desktopAppSession_enqueueMessage(char header[UART_PACKET_HEADER_SIZE], char body[UART_PACKET_PAYLOAD_SIZE]);
+DesktopComSessionStatus desktopAppSession_enqueueMessage(char header[UART_PACKET_HEADER_SIZE], char body[UART_PACKET_PAYLOAD_SIZE],
+		SessionPriority priority);
 
 /* desktopAppSession_dequeueMessage
  *
  * Function:
- *	Dequeues a message that has been received from the desktop application.
+ *	Dequeues a message that has been received from the desktop application,
+ *	copying it out.
  *
  * Parameters:
  *	header - char array pointer where the message header code is to be stored
@@ -205,8 +693,159 @@ DesktopComSessionStatus desktopAppSession_enqueueMessage(char header[UART_PACKET
  *				prior
  *		SESSION_BUFFER_EMPTY - if the queue is empty
  *		SESSION_OKAY - if dequeuing successful
+ *
+ * Note:
+ * 	The whole body is written, null characters filling it past the message's
+ * 	text, whatever the framing.
  */
 DesktopComSessionStatus desktopAppSession_dequeueMessage(char header[UART_PACKET_HEADER_SIZE], char body[UART_PACKET_PAYLOAD_SIZE]);
 
+/* desktopAppSession_enqueueBinary
+ *
+ * Function:
+ *	Enqueue a message with a binary payload for later transmission to the
+ *	desktop application.  The payload may hold zero bytes.
+ *
+ * Parameters:
+ *	header - char array message header code
+ *	payload - byte array message payload
+ *	length - number of payload bytes, at most UART_PACKET_PAYLOAD_SIZE
+ *	priority - SESSION_PRIORITY_URGENT or SESSION_PRIORITY_BULK
+ *
+ * Return:
+ *	DesktopComSessionStatus
+ *		SESSION_NOT_INIT - if desktopAppSession_init() has not been performed
+ *				prior
+ *		SESSION_ERROR - if the payload is too long
+ *		SESSION_BUFFER_FULL - if the priority's queue is full
+ *		SESSION_NOT_OPEN - if the session is being stopped
+ *		SESSION_OKAY - if enqueuing successful
+ *
+ * Note:
+ * 	The length reaches the desktop application with UART_PAYLOAD_BINARY or
+ * 	UART_FRAMING_COBS (see uart_packet_helpers.h).  Otherwise the payload is
+ * 	padded with zero bytes to UART_PACKET_PAYLOAD_SIZE.
+ */
+DesktopComSessionStatus desktopAppSession_enqueueBinary(const char header[UART_PACKET_HEADER_SIZE],
+		const uint8_t* payload, uint16_t length, SessionPriority priority);
+
+/* desktopAppSession_dequeueBinary
+ *
+ * Function:
+ *	Dequeues a message that has been received from the desktop application,
+ *	copying it out with the length of its payload.
+ *
+ * Parameters:
+ *	header - char array pointer where the message header code is to be stored
+ *	payload - byte array pointer where the message payload is to be stored
+ *	length - pointer to where the number of payload bytes is to be stored
+ *
+ * Return:
+ *	DesktopComSessionStatus
+ *		SESSION_NOT_INIT - if desktopAppSession_init() has not been performed
+ *				prior
+ *		SESSION_BUFFER_EMPTY - if the queue is empty
+ *		SESSION_OKAY - if dequeuing successful
+ *
+ * Note:
+ * 	Without UART_PAYLOAD_BINARY or UART_FRAMING_COBS, the length is always
+ * 	UART_PACKET_PAYLOAD_SIZE.  Payload bytes past the length are zeroed.
+ */
+DesktopComSessionStatus desktopAppSession_dequeueBinary(char header[UART_PACKET_HEADER_SIZE],
+		uint8_t payload[UART_PACKET_PAYLOAD_SIZE], uint16_t* length);
+
+/* desktopAppSession_acquireMessage
+ *
+ * Function:
+ *	Gets a view of a free, zeroed message slot in a transport layer tx lane
+ *	to build a message for the desktop application in place.
+ *
+ * Parameters:
+ *	message - pointer to the view to point at the message header and body
+ *	priority - SESSION_PRIORITY_URGENT or SESSION_PRIORITY_BULK
+ *
+ * Return:
+ *	DesktopComSessionStatus
+ *		SESSION_NOT_INIT - if desktopAppSession_init() has not been performed
+ *				prior
+ *		SESSION_BUFFER_FULL - if the priority's queue is full
+ *		SESSION_NOT_OPEN - if the session is being stopped
+ *		SESSION_OKAY - if a slot was acquired
+ *
+ * Note:
+ * 	The message is not sent until desktopAppSession_commitMessage() is called,
+ * 	which must be before any other message is enqueued.
+ */
+DesktopComSessionStatus desktopAppSession_acquireMessage(PacketView* message, SessionPriority priority);
+
+/* desktopAppSession_commitMessage
+ *
+ * Function:
+ *	Enqueues the message built in the slot from
+ *	desktopAppSession_acquireMessage() for transmission.
+ *
+ * Return:
+ *	DesktopComSessionStatus
+ *		SESSION_NOT_INIT - if desktopAppSession_init() has not been performed
+ *				prior
+ *		SESSION_OKAY - if enqueuing successful
+ */
+DesktopComSessionStatus desktopAppSession_commitMessage(void);
+
+/* desktopAppSession_commitMessageLength
+ *
+ * Function:
+ *	Enqueues the message built in the slot from
+ *	desktopAppSession_acquireMessage() for transmission, with a binary payload
+ *	of a given length.  desktopAppSession_commitMessage() takes the payload as
+ *	text, ending at its trailing zero bytes.
+ *
+ * Parameters:
+ *	length - number of payload bytes, at most UART_PACKET_PAYLOAD_SIZE
+ *
+ * Return:
+ *	DesktopComSessionStatus
+ *		SESSION_NOT_INIT - if desktopAppSession_init() has not been performed
+ *				prior
+ *		SESSION_ERROR - if the payload is too long (nothing is enqueued)
+ *		SESSION_OKAY - if enqueuing successful
+ */
+DesktopComSessionStatus desktopAppSession_commitMessageLength(uint16_t length);
+
+/* desktopAppSession_peekMessage
+ *
+ * Function:
+ *	Gets a view of the oldest message received from the desktop application,
+ *	in place in the session's receive queue.
+ *
+ * Parameters:
+ *	message - pointer to the view to point at the message header and body
+ *
+ * Return:
+ *	DesktopComSessionStatus
+ *		SESSION_NOT_INIT - if desktopAppSession_init() has not been performed
+ *				prior
+ *		SESSION_BUFFER_EMPTY - if no message is ready
+ *		SESSION_OKAY - if a message is ready
+ *
+ * Note:
+ * 	The view is valid until desktopAppSession_releaseMessage() is called.
+ */
+DesktopComSessionStatus desktopAppSession_peekMessage(PacketView* message);
+
+/* desktopAppSession_releaseMessage
+ *
+ * Function:
+ *	Releases the oldest received message, freeing its slot for reception.
+ *
+ * Return:
+ *	DesktopComSessionStatus
+ *		SESSION_NOT_INIT - if desktopAppSession_init() has not been performed
+ *				prior
+ *		SESSION_BUFFER_EMPTY - if no message is ready
+ *		SESSION_OKAY - if the message was released
+ */
+DesktopComSessionStatus desktopAppSession_releaseMessage(void);
+
 
 #endif /* INC_DESKTOP_APP_SESSION_LAYER_H_ */
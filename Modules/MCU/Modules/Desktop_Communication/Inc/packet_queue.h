@@ -0,0 +1,215 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ *
+ * Purpose:
+ *		A fixed-depth queue of packets for passing packets between exactly one
+ *	producer and one consumer, where one of the two may be an interrupt service
+ *	routine (such as a UART or DMA callback) and the other the main loop.
+ *		The queue is lock-free:  the producer only writes the head index and the
+ *	consumer only writes the tail index, so neither side needs to disable
+ *	interrupts.  The depth is set at compile time and must be a power of two so
+ *	that indexes wrap with a mask.
+ *		Packets can be copied in and out (push/pop), or written and read in
+ *	place in the queue's storage (back/commit and front/release) to avoid a copy.
+ *	Each slot is a frame buffer of UART_FRAME_SIZE bytes (see uart_packet_helpers.h).
+ *
+ *	Note:  Only one context may call the producer functions (push, back, commit)
+ *	and only one context may call the consumer functions (pop, front, release).
+ */
+
+#ifndef INC_PACKET_QUEUE_H_
+#define INC_PACKET_QUEUE_H_
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <uart_packet_helpers.h>
+
+
+/*
+ * State of a packet queue.  Declare queues with PACKET_QUEUE_DEFINE() rather than
+ * directly.
+ */
+typedef struct {
+	uint8_t (*slots)[UART_FRAME_SIZE];	// packet storage, depth frames long
+	uint32_t mask;						// depth - 1, for wrapping indexes
+	atomic_uint_fast32_t head;			// count of packets committed, written by producer only
+	atomic_uint_fast32_t tail;			// count of packets released, written by consumer only
+	uint32_t highWater;					// most packets held at once, written by producer only
+} PacketQueue;
+
+/*
+ * Defines a file-scope static packet queue and its storage.
+ *
+ * Parameters:
+ * 	name - identifier of the PacketQueue variable.
+ * 	depth - number of packets the queue holds, must be a power of two.
+ */
+#define PACKET_QUEUE_DEFINE(name, depth) \
+	_Static_assert((depth) > 0 && ((depth) & ((depth) - 1)) == 0, \
+			"packet queue depth must be a power of two"); \
+	static uint8_t name##_slots[(depth)][UART_FRAME_SIZE]; \
+	static PacketQueue name = { name##_slots, (depth) - 1, 0, 0, 0 }
+
+
+/* packetQueue_reset
+ *
+ * Function:
+ * 	Empties the queue and clears its high-water mark.
+ *
+ * Parameters:
+ * 	queue - pointer to the queue.
+ *
+ * Note:
+ * 	Neither the producer nor the consumer may be using the queue during a reset.
+ */
+void packetQueue_reset(PacketQueue* queue);
+
+/* packetQueue_count
+ *
+ * Function:
+ * 	Returns the number of packets in the queue.
+ *
+ * Parameters:
+ * 	queue - pointer to the queue.
+ *
+ * Return:
+ * 	uint32_t - number of packets committed and not yet released.
+ */
+uint32_t packetQueue_count(PacketQueue* queue);
+
+/* packetQueue_isFull
+ *
+ * Function:
+ * 	Returns if every slot of the queue holds a packet.
+ *
+ * Parameters:
+ * 	queue - pointer to the queue.
+ *
+ * Return:
+ * 	bool - true if full, false otherwise.
+ */
+bool packetQueue_isFull(PacketQueue* queue);
+
+/* packetQueue_highWater
+ *
+ * Function:
+ * 	Returns the largest number of packets the queue has held at once since it
+ * 	was last reset.
+ *
+ * Parameters:
+ * 	queue - pointer to the queue.
+ *
+ * Return:
+ * 	uint32_t - high-water mark.
+ */
+uint32_t packetQueue_highWater(PacketQueue* queue);
+
+/* packetQueue_resetHighWater
+ *
+ * Function:
+ * 	Restarts the high-water mark from the number of packets the queue holds
+ * 	now.  The producer must not run meanwhile.
+ *
+ * Parameters:
+ * 	queue - pointer to the queue.
+ */
+void packetQueue_resetHighWater(PacketQueue* queue);
+
+/* packetQueue_push
+ *
+ * Function:
+ * 	(Producer) Copies a packet into the back of the queue.
+ *
+ * Parameters:
+ * 	queue - pointer to the queue.
+ * 	packet - byte array pointer to the packet to copy in.
+ *
+ * Return:
+ * 	bool - true if the packet was queued, false if the queue is full.
+ */
+bool packetQueue_push(PacketQueue* queue, const uint8_t packet[UART_FRAME_SIZE]);
+
+/* packetQueue_pop
+ *
+ * Function:
+ * 	(Consumer) Copies the packet at the front of the queue out and removes it.
+ *
+ * Parameters:
+ * 	queue - pointer to the queue.
+ * 	packet - byte array pointer to copy the packet into.
+ *
+ * Return:
+ * 	bool - true if a packet was copied out, false if the queue is empty.
+ */
+bool packetQueue_pop(PacketQueue* queue, uint8_t packet[UART_FRAME_SIZE]);
+
+/* packetQueue_back
+ *
+ * Function:
+ * 	(Producer) Returns the free slot at the back of the queue to write a packet
+ * 	into in place.  The packet is not part of the queue until committed.
+ *
+ * Parameters:
+ * 	queue - pointer to the queue.
+ *
+ * Return:
+ * 	uint8_t* - pointer to the slot, or NULL if the queue is full.
+ */
+uint8_t* packetQueue_back(PacketQueue* queue);
+
+/* packetQueue_commit
+ *
+ * Function:
+ * 	(Producer) Adds the packet written into the slot from packetQueue_back() to
+ * 	the queue.
+ *
+ * Parameters:
+ * 	queue - pointer to the queue.
+ */
+void packetQueue_commit(PacketQueue* queue);
+
+/* packetQueue_front
+ *
+ * Function:
+ * 	(Consumer) Returns the packet at the front of the queue to be read in place.
+ * 	The packet stays in the queue until released.
+ *
+ * Parameters:
+ * 	queue - pointer to the queue.
+ *
+ * Return:
+ * 	uint8_t* - pointer to the packet, or NULL if the queue is empty.
+ */
+uint8_t* packetQueue_front(PacketQueue* queue);
+
+/* packetQueue_at
+ *
+ * Function:
+ * 	(Consumer) Returns a packet in the queue to be read in place, counting from
+ * 	the front.  Lets the consumer work through packets ahead of releasing them.
+ *
+ * Parameters:
+ * 	queue - pointer to the queue.
+ * 	index - position of the packet, 0 for the front.
+ *
+ * Return:
+ * 	uint8_t* - pointer to the packet, or NULL if the queue holds no more than
+ * 			index packets.
+ */
+uint8_t* packetQueue_at(PacketQueue* queue, uint32_t index);
+
+/* packetQueue_release
+ *
+ * Function:
+ * 	(Consumer) Removes the packet at the front of the queue, freeing its slot.
+ *
+ * Parameters:
+ * 	queue - pointer to the queue.
+ */
+void packetQueue_release(PacketQueue* queue);
+
+
+#endif /* INC_PACKET_QUEUE_H_ */
@@ -0,0 +1,196 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ *
+ * Purpose:
+ *		Runs the desktop application session as a FreeRTOS service.  The
+ *	session, the transport layer and the UART keep their state in file-scope
+ *	variables and are not safe to call from more than one task, so one task
+ *	(the comms task) owns them and the other tasks only exchange messages with
+ *	it through RTOS queues:  sessionRtos_send() copies a message into the send
+ *	queue and sessionRtos_receive() copies one out of the receive queue, each
+ *	blocking (and yielding to the other tasks) for at most a timeout while the
+ *	queue is full or empty.  Any number of tasks may send and receive.
+ *		The comms task blocks on its task notification, which the transport
+ *	layer's rx event and tx complete interrupts give, as do sending (work for
+ *	it) and receiving from a full receive queue (room for a message held back).
+ *	On each wake it advances the handshake (desktopAppSession_start()),
+ *	updates the session, moves messages from the send queue into the transport
+ *	layer's tx lanes while a session is open and they have room, and moves
+ *	received messages that no handler took into the receive queue while it has
+ *	room.  Work that falls due with time is covered by a timeout on the wait:
+ *	SESSION_RTOS_POLL_MS while a session is open or being opened, and
+ *	SESSION_RTOS_CLOSED_POLL_MS otherwise.
+ *		Handlers registered with desktopAppSession_registerHandler() run in the
+ *	comms task, and must be registered before sessionRtos_init().  Messages
+ *	sent while no session is open wait in the send queue for one.
+ *
+ *		Only built if SESSION_RTOS is defined at build time, as FreeRTOS must be
+ *	part of the project (enabled for the core in STM32CubeMX).
+ *
+ *	Note:  The service takes the transport layer's tx complete and rx event
+ *	callbacks, so is not used together with session_sequencer.h.  The
+ *	interrupts' priority must be at or below
+ *	configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY, as they give a notification.
+ */
+
+#ifndef INC_SESSION_RTOS_H_
+#define INC_SESSION_RTOS_H_
+
+
+#ifdef SESSION_RTOS
+
+#include <desktop_app_session.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <queue.h>
+
+
+/*
+ * Number of messages the send and receive queues hold, between the other tasks
+ * and the comms task.
+ */
+#ifndef SESSION_RTOS_TX_QUEUE_LENGTH
+#define SESSION_RTOS_TX_QUEUE_LENGTH 8
+#endif
+#ifndef SESSION_RTOS_RX_QUEUE_LENGTH
+#define SESSION_RTOS_RX_QUEUE_LENGTH 8
+#endif
+
+/*
+ * Longest time the comms task waits without an update, in milliseconds, while a
+ * session is open or being opened and while none is (see session_sequencer.h).
+ */
+#ifndef SESSION_RTOS_POLL_MS
+#define SESSION_RTOS_POLL_MS 10
+#endif
+#ifndef SESSION_RTOS_CLOSED_POLL_MS
+#define SESSION_RTOS_CLOSED_POLL_MS 250
+#endif
+
+/*
+ * Stack size of the comms task, in words.
+ */
+#ifndef SESSION_RTOS_STACK_SIZE
+#define SESSION_RTOS_STACK_SIZE 512
+#endif
+
+/*
+ * A message copied through the send and receive queues.
+ */
+typedef struct {
+	char header[UART_PACKET_HEADER_SIZE];		// header code
+	uint8_t payload[UART_PACKET_PAYLOAD_SIZE];	// payload, zero padded
+	uint16_t length;							// number of payload bytes
+	bool binary;								// sent with its length, rather than as text
+	SessionPriority priority;					// tx lane the message is sent in
+} SessionRtosMessage;
+
+
+/* sessionRtos_init
+ *
+ * Function:
+ * 	Creates the send and receive queues and the comms task, and sets the
+ * 	transport layer's interrupts to notify it.  May be called before or after
+ * 	the scheduler is started.
+ *
+ * Parameters:
+ * 	priority - priority of the comms task, usually above the tasks using it.
+ *
+ * Return:
+ * 	bool - true if created, false if the queues or the task could not be.
+ *
+ * Note:
+ * 	desktopAppSession_init() must have been performed prior.  No other task
+ * 	may call the session or transport layer functions afterwards.
+ */
+bool sessionRtos_init(UBaseType_t priority);
+
+/* sessionRtos_send
+ *
+ * Function:
+ * 	Copies a text message into the send queue for the comms task to send.
+ *
+ * Parameters:
+ * 	header - char array message header code
+ * 	body - message body, ended by a null character or at
+ * 			UART_PACKET_PAYLOAD_SIZE characters
+ * 	priority - SESSION_PRIORITY_URGENT or SESSION_PRIORITY_BULK
+ * 	timeout - most ticks to block for while the queue is full, portMAX_DELAY for
+ * 			no limit
+ *
+ * Return:
+ * 	DesktopComSessionStatus
+ * 		SESSION_NOT_INIT - if sessionRtos_init() has not been performed prior
+ * 		SESSION_TIMEOUT - if the queue stayed full
+ * 		SESSION_OKAY - if queued
+ */
+DesktopComSessionStatus sessionRtos_send(const char header[UART_PACKET_HEADER_SIZE], const char* body,
+		SessionPriority priority, TickType_t timeout);
+
+/* sessionRtos_sendBinary
+ *
+ * Function:
+ * 	Copies a message with a binary payload into the send queue (see
+ * 	desktopAppSession_enqueueBinary()).
+ *
+ * Parameters:
+ * 	header - char array message header code
+ * 	payload - byte array message payload
+ * 	length - number of payload bytes, at most UART_PACKET_PAYLOAD_SIZE
+ * 	priority - SESSION_PRIORITY_URGENT or SESSION_PRIORITY_BULK
+ * 	timeout - most ticks to block for while the queue is full, portMAX_DELAY for
+ * 			no limit
+ *
+ * Return:
+ * 	DesktopComSessionStatus
+ * 		SESSION_NOT_INIT - if sessionRtos_init() has not been performed prior
+ * 		SESSION_ERROR - if the payload is too long
+ * 		SESSION_TIMEOUT - if the queue stayed full
+ * 		SESSION_OKAY - if queued
+ */
+DesktopComSessionStatus sessionRtos_sendBinary(const char header[UART_PACKET_HEADER_SIZE], const uint8_t* payload,
+		uint16_t length, SessionPriority priority, TickType_t timeout);
+
+/* sessionRtos_receive
+ *
+ * Function:
+ * 	Copies out the oldest message received for the application (one no handler
+ * 	took), blocking while there is none for at most a timeout.
+ *
+ * Parameters:
+ * 	message - where the message is copied
+ * 	timeout - most ticks to block for, portMAX_DELAY for no limit
+ *
+ * Return:
+ * 	DesktopComSessionStatus
+ * 		SESSION_NOT_INIT - if sessionRtos_init() has not been performed prior
+ * 		SESSION_TIMEOUT - if no message arrived
+ * 		SESSION_OKAY - if a message was received
+ */
+DesktopComSessionStatus sessionRtos_receive(SessionRtosMessage* message, TickType_t timeout);
+
+/* sessionRtos_isOpen
+ *
+ * Function:
+ * 	Returns whether a session was open at the comms task's last update.
+ *
+ * Return:
+ * 	bool - true if open, false if not
+ */
+bool sessionRtos_isOpen(void);
+
+/* sessionRtos_wakes
+ *
+ * Function:
+ * 	Returns the number of times the comms task has updated the session.
+ *
+ * Return:
+ * 	uint32_t - number of updates since sessionRtos_init().
+ */
+uint32_t sessionRtos_wakes(void);
+
+
+#endif /* SESSION_RTOS */
+
+#endif /* INC_SESSION_RTOS_H_ */
@@ -0,0 +1,124 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ *
+ * Purpose:
+ *		Runs the desktop application session from the STM32 sequencer
+ *	(UTIL_SEQ) rather than from a main loop that updates it on every pass.  The
+ *	session is updated by a sequencer task, which the transport layer's rx event
+ *	and tx complete interrupts set, so it only runs when there is work and the
+ *	core can wait for interrupts (__WFI) in between.
+ *		The session also has work that falls due with time rather than with an
+ *	interrupt (the CTS window and retransmission timeouts, handshake steps, a
+ *	partial packet to discard).  The application's UTIL_SEQ_Idle() calls
+ *	sessionSequencer_idle(), which sets the task once SESSION_SEQ_POLL_MS have
+ *	passed since it last ran while a session is open or being opened, and once
+ *	SESSION_SEQ_CLOSED_POLL_MS have passed otherwise.  On the MCU the core is
+ *	woken by the SysTick every millisecond, so the check is made that often.
+ *		The task advances the handshake (desktopAppSession_start()), updates the
+ *	session (desktopAppSession_update()) and then calls the application's hook,
+ *	where it reads its messages (those without a registered handler) and checks
+ *	the session's state.  Messages enqueued, or released, outside the hook are
+ *	followed by sessionSequencer_notify() so the task runs to send them (or to
+ *	take in messages held back for the room).
+ *
+ *		Only built if SESSION_SEQUENCER is defined at build time, as the
+ *	sequencer (stm32_seq.h, from the STM32 utilities) must be part of the
+ *	project.  The sequencer's own task IDs and priorities are the application's
+ *	(usually in utilities_def.h), so the session task's are passed in.
+ *
+ *	Note:  The integration takes the transport layer's tx complete and rx event
+ *	callbacks.
+ */
+
+#ifndef INC_SESSION_SEQUENCER_H_
+#define INC_SESSION_SEQUENCER_H_
+
+
+#ifdef SESSION_SEQUENCER
+
+#include <desktop_app_session.h>
+#include <stm32_seq.h>
+
+
+/*
+ * Longest time the session goes without an update, in milliseconds, while a
+ * session is open or being opened and while none is.  The first bounds how late
+ * a timeout is acted on, the second how long a partial packet from a desktop that
+ * went away is kept.
+ */
+#ifndef SESSION_SEQ_POLL_MS
+#define SESSION_SEQ_POLL_MS 10
+#endif
+#ifndef SESSION_SEQ_CLOSED_POLL_MS
+#define SESSION_SEQ_CLOSED_POLL_MS 250
+#endif
+
+
+/* sessionSequencer_init
+ *
+ * Function:
+ * 	Registers the session task with the sequencer and sets the transport
+ * 	layer's interrupts to set it.  The task is set once so that the session
+ * 	starts listening.
+ *
+ * Parameters:
+ * 	taskId - sequencer task ID bitmask for the session task (one bit).
+ * 	priority - sequencer priority the task is set with.
+ * 	application - function called at the end of each run of the task, or NULL.
+ *
+ * Return:
+ * 	bool - true if registered, false if the task ID is not a single bit.
+ *
+ * Note:
+ * 	desktopAppSession_init() must have been performed prior, and UTIL_SEQ_Init()
+ * 	must have been called.
+ */
+bool sessionSequencer_init(UTIL_SEQ_bm_t taskId, uint32_t priority, void (*application)(void));
+
+/* sessionSequencer_notify
+ *
+ * Function:
+ * 	Sets the session task to run, for work the integration does not see (a
+ * 	message enqueued or released outside the application hook).
+ *
+ * Note:
+ * 	May be called from interrupt context.
+ */
+void sessionSequencer_notify(void);
+
+/* sessionSequencer_idle
+ *
+ * Function:
+ * 	Checks whether the session is due an update with time, and if so, sets its
+ * 	task.  Called from the application's UTIL_SEQ_Idle() before waiting for an
+ * 	interrupt.
+ *
+ * Return:
+ * 	bool - true if the task was set (the core must not wait), false if the
+ * 			core can wait for an interrupt.
+ *
+ * Example:
+ * 	void UTIL_SEQ_Idle(void)
+ * 	{
+ * 		if (!sessionSequencer_idle())
+ * 			__WFI();
+ * 	}
+ */
+bool sessionSequencer_idle(void);
+
+/* sessionSequencer_runs
+ *
+ * Function:
+ * 	Returns the number of times the session task has run, to compare with the
+ * 	number of passes a polling main loop makes.
+ *
+ * Return:
+ * 	uint32_t - number of runs since sessionSequencer_init().
+ */
+uint32_t sessionSequencer_runs(void);
+
+
+#endif /* SESSION_SEQUENCER */
+
+#endif /* INC_SESSION_SEQUENCER_H_ */
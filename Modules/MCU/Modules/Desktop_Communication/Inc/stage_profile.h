@@ -0,0 +1,183 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ *
+ * Purpose:
+ *		Measures how long each stage of the transport and session layers takes
+ *	(the session update and its tell, dispatch and listen phases, and the
+ *	transport layer's frame encoding, transmission start and ring extraction),
+ *	keeping the count, minimum, maximum and total of each stage's times.  The
+ *	desktop application reads them with the session's PROF command (see
+ *	desktop_app_session.h).
+ *		Stages are wrapped with PROFILE_CALL().  Times are read from the DWT
+ *	cycle counter on the CM4 (CORE_CM4), from the SysTick counter on the CM0+
+ *	(CORE_CM0PLUS), which has no DWT cycle counter, and from the monotonic
+ *	clock in nanoseconds on a host build.  A stage's time includes the stages
+ *	nested in it and the interrupts taken while it ran.
+ *
+ *		The stages are only timed if SESSION_PROFILE is defined at build time.
+ *	Otherwise PROFILE_CALL() is just the call it wraps, so the stages cost
+ *	nothing.  The time source (stageProfile_init(), stageProfile_now(),
+ *	stageProfile_unit() and stageProfile_fromMicroseconds()) is always built:
+ *	the session measures the time budget of its updates with it (see
+ *	desktopAppSession_updateWithin()), and the event trace stamps its events
+ *	with it (see event_trace.h).
+ *
+ *	Note:  On the CM0+, a time taken with interrupts masked across a SysTick
+ *	reload can be a tick short, as the HAL's tick count has not been advanced.
+ */
+
+#ifndef INC_STAGE_PROFILE_H_
+#define INC_STAGE_PROFILE_H_
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/*
+ * Stages of the transport and session layers.
+ */
+typedef enum {
+	PROFILE_UPDATE,			// Session update, all of it
+	PROFILE_TELL,			// Tx phase of the update
+	PROFILE_DISPATCH,		// Servicing received messages (handlers, receive queue)
+	PROFILE_LISTEN,			// Rx phase of the update (CTS window)
+	PROFILE_TX_ENCODE,		// Encoding a committed packet into its frame
+	PROFILE_TX_START,		// Starting transmission of the next frame
+	PROFILE_RX_EXTRACT,		// Moving received frames from the ring into the rx queue
+	PROFILE_STAGES			// Number of stages
+} ProfileStage;
+
+/*
+ * Times of a stage, in the units of stageProfile_unit().
+ */
+typedef struct {
+	uint32_t count;			// times the stage ran
+	uint32_t min;			// shortest time
+	uint32_t max;			// longest time
+	uint64_t total;			// sum of the times, for the mean
+} StageProfileStats;
+
+
+/*
+ * Longest time stageProfile_fromMicroseconds() returns, in the time source's units:
+ * half its range, so that the difference of two readings taken within it is
+ * compared correctly across the time source wrapping around.
+ */
+#define STAGE_PROFILE_SPAN (UINT32_MAX / 2U)
+
+
+/* stageProfile_init
+ *
+ * Function:
+ * 	Starts the time source (the DWT cycle counter on the CM4) and clears the
+ * 	times of every stage.
+ */
+void stageProfile_init(void);
+
+/* stageProfile_now
+ *
+ * Function:
+ * 	Reads the time source.
+ *
+ * Return:
+ * 	uint32_t - free-running time, in the units of stageProfile_unit()
+ */
+uint32_t stageProfile_now(void);
+
+/* stageProfile_unit
+ *
+ * Function:
+ * 	Returns the units of the times:  "cyc" (core clock cycles) or "ns".
+ *
+ * Return:
+ * 	const char* - the units.
+ */
+const char* stageProfile_unit(void);
+
+/* stageProfile_fromMicroseconds
+ *
+ * Function:
+ * 	Converts a time in microseconds into the time source's units, for comparing
+ * 	with the difference of two readings of stageProfile_now().
+ *
+ * Parameters:
+ * 	time_us - the time, in microseconds.
+ *
+ * Return:
+ * 	uint32_t - the time in the units of stageProfile_unit(), at most
+ * 			STAGE_PROFILE_SPAN.
+ *
+ * Note:
+ * 	On the cores the units are cycles of SystemCoreClock, so a time converted
+ * 	before the core clock is changed must be converted again.
+ */
+uint32_t stageProfile_fromMicroseconds(uint32_t time_us);
+
+
+#ifdef SESSION_PROFILE
+
+/*
+ * Runs a call (a statement, such as an assignment of its return) as a stage.
+ */
+#define PROFILE_CALL(stage, call) do { \
+		uint32_t _profileStart = stageProfile_now(); \
+		call; \
+		stageProfile_record((stage), _profileStart); \
+	} while (0)
+
+
+/* stageProfile_record
+ *
+ * Function:
+ * 	Adds the time since a start read with stageProfile_now() to a stage's
+ * 	times.  May be called from interrupts.
+ *
+ * Parameters:
+ * 	stage - the stage that ran.
+ * 	start - time the stage started.
+ */
+void stageProfile_record(ProfileStage stage, uint32_t start);
+
+/* stageProfile_reset
+ *
+ * Function:
+ * 	Clears the times of every stage.
+ */
+void stageProfile_reset(void);
+
+/* stageProfile_read
+ *
+ * Function:
+ * 	Copies out a stage's times, consistent with each other.
+ *
+ * Parameters:
+ * 	stage - the stage to read.
+ * 	stats - pointer to where the times are to be stored.
+ *
+ * Return:
+ * 	bool - true if read, false if the stage does not exist.
+ */
+bool stageProfile_read(ProfileStage stage, StageProfileStats* stats);
+
+/* stageProfile_name
+ *
+ * Function:
+ * 	Returns a stage's name, as reported to the desktop application.
+ *
+ * Parameters:
+ * 	stage - the stage.
+ *
+ * Return:
+ * 	const char* - the name, or "?" if the stage does not exist.
+ */
+const char* stageProfile_name(ProfileStage stage);
+
+#else
+
+#define PROFILE_CALL(stage, call) call
+
+#endif /* SESSION_PROFILE */
+
+#endif /* INC_STAGE_PROFILE_H_ */
@@ -0,0 +1,137 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ */
+
+
+#include <event_trace.h>
+
+#ifdef SESSION_TRACE
+
+#include <stage_profile.h>
+#include <uart_packet_helpers.h>
+#include "stm32wlxx_hal.h"
+
+
+_Static_assert((SESSION_TRACE_DEPTH & (SESSION_TRACE_DEPTH - 1)) == 0,
+		"trace depth must be a power of two");
+
+
+// Private Variables
+static TraceEntry _entries[SESSION_TRACE_DEPTH];	// ring of entries
+static uint32_t _head = 0;							// entries recorded since emptied
+static bool _frozen = false;						// flag for entries not being added
+
+
+/* eventTrace_init
+ *
+ * Starts the time source shared with the stage profile and empties the ring.
+ */
+void eventTrace_init(void)
+{
+	stageProfile_init();
+	eventTrace_thaw(true);
+}
+
+
+/* eventTrace_record
+ *
+ * Reads the time before masking interrupts, then fills the next entry with them
+ * masked, as an event recorded from an interrupt may come in the middle.
+ */
+void eventTrace_record(TraceEvent event, uint8_t arg, uint16_t value)
+{
+	uint32_t time = stageProfile_now();
+	uint32_t primask = __get_PRIMASK();
+	TraceEntry* entry;
+
+	__disable_irq();
+	if (!_frozen)
+	{
+		entry = &_entries[_head++ & (SESSION_TRACE_DEPTH - 1)];
+		entry->time = time;
+		entry->event = (uint8_t)event;
+		entry->arg = arg;
+		entry->value = value;
+	}
+	__set_PRIMASK(primask);
+}
+
+
+/* eventTrace_recordFrame
+ *
+ * Finds the header through a view of the frame.
+ */
+void eventTrace_recordFrame(TraceEvent event, uint8_t arg, uint8_t* frame)
+{
+	PacketView view;
+
+	packetView_init(&view, frame);
+	TRACE_HEADER(event, arg, view.header);
+}
+
+
+/* eventTrace_freeze
+ *
+ * Sets the flag with interrupts masked, so no entry is half written.
+ */
+uint32_t eventTrace_freeze(void)
+{
+	uint32_t primask = __get_PRIMASK();
+	uint32_t head;
+
+	__disable_irq();
+	_frozen = true;
+	head = _head;
+	__set_PRIMASK(primask);
+
+	return head;
+}
+
+
+/* eventTrace_thaw
+ *
+ * Clears the flag, and the index if emptying, with interrupts masked.
+ */
+void eventTrace_thaw(bool clear)
+{
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	if (clear)
+	{
+		_head = 0;
+	}
+	_frozen = false;
+	__set_PRIMASK(primask);
+}
+
+
+/* eventTrace_read
+ *
+ * The index wraps around the ring.
+ */
+const TraceEntry* eventTrace_read(uint32_t index)
+{
+	return &_entries[index & (SESSION_TRACE_DEPTH - 1)];
+}
+
+
+/* eventTrace_encode
+ *
+ * Time, event, arg, then value, little-endian.
+ */
+void eventTrace_encode(const TraceEntry* entry, uint8_t bytes[TRACE_ENTRY_SIZE])
+{
+	bytes[0] = (uint8_t)entry->time;
+	bytes[1] = (uint8_t)(entry->time >> 8);
+	bytes[2] = (uint8_t)(entry->time >> 16);
+	bytes[3] = (uint8_t)(entry->time >> 24);
+	bytes[4] = entry->event;
+	bytes[5] = entry->arg;
+	bytes[6] = (uint8_t)entry->value;
+	bytes[7] = (uint8_t)(entry->value >> 8);
+}
+
+
+#endif /* SESSION_TRACE */
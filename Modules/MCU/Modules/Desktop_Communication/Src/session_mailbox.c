@@ -0,0 +1,295 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ */
+
+
+#include <session_mailbox.h>
+
+#ifdef SESSION_MAILBOX
+
+#include <string.h>
+
+
+/*
+ * Memory orders for the index accesses, as for the packet queues (see
+ * packet_queue.c).
+ */
+#define LOAD_OWN(index) atomic_load_explicit(&(index), memory_order_relaxed)
+#define LOAD_OTHER(index) atomic_load_explicit(&(index), memory_order_acquire)
+#define STORE_OWN(index, value) atomic_store_explicit(&(index), (value), memory_order_release)
+
+
+// Private Function Prototypes
+DesktopComSessionStatus _sessionMailbox_send(const char header[UART_PACKET_HEADER_SIZE], const uint8_t* payload,
+		uint16_t length, bool binary, SessionPriority priority);
+DesktopComSessionStatus _sessionMailbox_receive(char header[UART_PACKET_HEADER_SIZE],
+		uint8_t payload[UART_PACKET_PAYLOAD_SIZE], uint16_t* length);
+void _sessionMailbox_appRx(IPCC_HandleTypeDef* hipcc, uint32_t channel, IPCC_CHANNELDirTypeDef direction);
+
+
+// Private Variables
+static SessionMailbox* _mailbox = NULL;				// mailbox, once the link core has initialized it
+static IPCC_HandleTypeDef* _hipcc = NULL;			// IPCC handle of the application core
+static void (*_notify)(void) = NULL;				// called when the link core rings
+
+
+/* sessionMailbox_initApp
+ *
+ * Takes the mailbox if ready and listens for the link core's doorbell.
+ */
+bool sessionMailbox_initApp(SessionMailbox* mailbox, IPCC_HandleTypeDef* hipcc, void (*notify)(void))
+{
+	if (mailbox == NULL || hipcc == NULL
+			|| atomic_load_explicit(&mailbox->ready, memory_order_acquire) != SESSION_MAILBOX_READY)
+	{
+		return false;
+	}
+
+	_hipcc = hipcc;
+	_notify = notify;
+	if (HAL_IPCC_ActivateNotification(hipcc, SESSION_MAILBOX_CHANNEL_FROM_LINK, IPCC_CHANNEL_DIR_RX,
+			_sessionMailbox_appRx) != HAL_OK)
+	{
+		return false;
+	}
+	_mailbox = mailbox;
+
+	return true;
+}
+
+
+/* sessionMailbox_isOpen
+ *
+ * Returns the flag published by the link core.
+ */
+bool sessionMailbox_isOpen(void)
+{
+	return _mailbox != NULL && atomic_load_explicit(&_mailbox->open, memory_order_relaxed);
+}
+
+
+/* sessionMailbox_enqueueMessage
+ *
+ * Sends the body as text, all UART_PACKET_PAYLOAD_SIZE characters of it.
+ */
+DesktopComSessionStatus sessionMailbox_enqueueMessage(const char header[UART_PACKET_HEADER_SIZE],
+		const char body[UART_PACKET_PAYLOAD_SIZE], SessionPriority priority)
+{
+	return _sessionMailbox_send(header, (const uint8_t*)body, UART_PACKET_PAYLOAD_SIZE, false, priority);
+}
+
+
+/* sessionMailbox_enqueueBinary
+ *
+ * Sends the payload with its length.
+ */
+DesktopComSessionStatus sessionMailbox_enqueueBinary(const char header[UART_PACKET_HEADER_SIZE],
+		const uint8_t* payload, uint16_t length, SessionPriority priority)
+{
+	if (_mailbox != NULL && length > UART_PACKET_PAYLOAD_SIZE)
+	{
+		return SESSION_ERROR;
+	}
+
+	return _sessionMailbox_send(header, payload, length, true, priority);
+}
+
+
+/* sessionMailbox_dequeueMessage
+ *
+ * Copies out the message's payload bytes, null characters filling the rest of the body.
+ */
+DesktopComSessionStatus sessionMailbox_dequeueMessage(char header[UART_PACKET_HEADER_SIZE],
+		char body[UART_PACKET_PAYLOAD_SIZE])
+{
+	uint16_t length;
+
+	return _sessionMailbox_receive(header, (uint8_t*)body, &length);
+}
+
+
+/* sessionMailbox_dequeueBinary
+ *
+ * Copies out the message's payload bytes and their number.
+ */
+DesktopComSessionStatus sessionMailbox_dequeueBinary(char header[UART_PACKET_HEADER_SIZE],
+		uint8_t payload[UART_PACKET_PAYLOAD_SIZE], uint16_t* length)
+{
+	return _sessionMailbox_receive(header, payload, length);
+}
+
+
+/* mailboxRing_reset
+ *
+ * Sets both indexes to zero.
+ */
+void mailboxRing_reset(MailboxRing* ring)
+{
+	atomic_store(&ring->head, 0);
+	atomic_store(&ring->tail, 0);
+}
+
+
+/* mailboxRing_back
+ *
+ * Hands out the slot after the last message if the ring has room.
+ */
+MailboxMessage* mailboxRing_back(MailboxRing* ring)
+{
+	uint32_t head = (uint32_t)LOAD_OWN(ring->head);
+
+	if (head - (uint32_t)LOAD_OTHER(ring->tail) >= SESSION_MAILBOX_DEPTH)
+	{
+		return NULL;
+	}
+
+	return &ring->slots[head & (SESSION_MAILBOX_DEPTH - 1)];
+}
+
+
+/* mailboxRing_commit
+ *
+ * Publishes the slot by advancing the head.
+ */
+void mailboxRing_commit(MailboxRing* ring)
+{
+	STORE_OWN(ring->head, LOAD_OWN(ring->head) + 1);
+}
+
+
+/* mailboxRing_front
+ *
+ * Hands out the oldest message if the ring has one.
+ */
+MailboxMessage* mailboxRing_front(MailboxRing* ring)
+{
+	uint32_t tail = (uint32_t)LOAD_OWN(ring->tail);
+
+	if ((uint32_t)LOAD_OTHER(ring->head) == tail)
+	{
+		return NULL;
+	}
+
+	return &ring->slots[tail & (SESSION_MAILBOX_DEPTH - 1)];
+}
+
+
+/* mailboxRing_release
+ *
+ * Frees the oldest message's slot by advancing the tail.
+ */
+void mailboxRing_release(MailboxRing* ring)
+{
+	STORE_OWN(ring->tail, LOAD_OWN(ring->tail) + 1);
+}
+
+
+/* mailboxDoorbell_ring
+ *
+ * The fence orders the ring's index store before the channel is read, so either
+ * the channel is seen free and set, or the other core frees it after the store and
+ * reads the ring afterwards.
+ */
+void mailboxDoorbell_ring(IPCC_HandleTypeDef* hipcc, uint32_t channel)
+{
+	atomic_thread_fence(memory_order_seq_cst);
+	if (HAL_IPCC_GetChannelStatus(hipcc, channel, IPCC_CHANNEL_DIR_TX) == IPCC_CHANNEL_STATUS_FREE)
+	{
+		HAL_IPCC_NotifyCPU(hipcc, channel, IPCC_CHANNEL_DIR_TX);
+	}
+}
+
+
+/* _sessionMailbox_send
+ *
+ * Copies a message into the ring to the link core, zero padded, and rings its
+ * doorbell.
+ */
+DesktopComSessionStatus _sessionMailbox_send(const char header[UART_PACKET_HEADER_SIZE], const uint8_t* payload,
+		uint16_t length, bool binary, SessionPriority priority)
+{
+	MailboxMessage* slot;
+
+	if (_mailbox == NULL)
+	{
+		return SESSION_NOT_INIT;
+	}
+
+	slot = mailboxRing_back(&_mailbox->toLink);
+	if (slot == NULL)
+	{
+		return SESSION_BUFFER_FULL;
+	}
+
+	memcpy(slot->header, header, UART_PACKET_HEADER_SIZE);
+	memcpy(slot->payload, payload, length);
+	memset(slot->payload + length, 0, UART_PACKET_PAYLOAD_SIZE - length);
+	slot->length = length;
+	slot->priority = (uint8_t)priority;
+	slot->binary = binary;
+	mailboxRing_commit(&_mailbox->toLink);
+
+	mailboxDoorbell_ring(_hipcc, SESSION_MAILBOX_CHANNEL_TO_LINK);
+
+	return SESSION_OKAY;
+}
+
+
+/* _sessionMailbox_receive
+ *
+ * Copies the oldest message out of the ring from the link core, zeroing the payload
+ * past its length, and releases it.  Rings the link core's doorbell if that made
+ * room in a full ring, as it may be holding a message back for the room.
+ */
+DesktopComSessionStatus _sessionMailbox_receive(char header[UART_PACKET_HEADER_SIZE],
+		uint8_t payload[UART_PACKET_PAYLOAD_SIZE], uint16_t* length)
+{
+	MailboxMessage* message;
+	bool wasFull;
+
+	if (_mailbox == NULL)
+	{
+		return SESSION_NOT_INIT;
+	}
+
+	message = mailboxRing_front(&_mailbox->fromLink);
+	if (message == NULL)
+	{
+		return SESSION_BUFFER_EMPTY;
+	}
+
+	memcpy(header, message->header, UART_PACKET_HEADER_SIZE);
+	memcpy(payload, message->payload, message->length);
+	memset(payload + message->length, 0, UART_PACKET_PAYLOAD_SIZE - message->length);
+	*length = message->length;
+	wasFull = ((uint32_t)LOAD_OTHER(_mailbox->fromLink.head) - (uint32_t)LOAD_OWN(_mailbox->fromLink.tail)
+			>= SESSION_MAILBOX_DEPTH);
+	mailboxRing_release(&_mailbox->fromLink);
+
+	if (wasFull)
+	{
+		mailboxDoorbell_ring(_hipcc, SESSION_MAILBOX_CHANNEL_TO_LINK);
+	}
+
+	return SESSION_OKAY;
+}
+
+
+/* _sessionMailbox_appRx
+ *
+ * IPCC rx callback of the link core's doorbell.  Frees the channel, then calls the
+ * application's hook.
+ */
+void _sessionMailbox_appRx(IPCC_HandleTypeDef* hipcc, uint32_t channel, IPCC_CHANNELDirTypeDef direction)
+{
+	HAL_IPCC_NotifyCPU(hipcc, channel, IPCC_CHANNEL_DIR_RX);
+
+	if (_notify != NULL)
+	{
+		_notify();
+	}
+}
+
+
+#endif /* SESSION_MAILBOX */
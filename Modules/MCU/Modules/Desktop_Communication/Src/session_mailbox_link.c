@@ -0,0 +1,179 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ */
+
+
+#include <session_mailbox.h>
+
+#ifdef SESSION_MAILBOX
+
+#include <string.h>
+
+
+// Private Function Prototypes
+bool _sessionMailbox_moveTx(void);
+bool _sessionMailbox_moveRx(void);
+void _sessionMailbox_linkRx(IPCC_HandleTypeDef* hipcc, uint32_t channel, IPCC_CHANNELDirTypeDef direction);
+
+
+// Private Variables
+static SessionMailbox* _mailbox = NULL;				// mailbox, once initialized
+static IPCC_HandleTypeDef* _hipcc = NULL;			// IPCC handle of the link core
+static void (*_notify)(void) = NULL;				// called when the application rings
+
+
+/* sessionMailbox_initLink
+ *
+ * Empties both rings before marking the mailbox ready for the application core.
+ */
+bool sessionMailbox_initLink(SessionMailbox* mailbox, IPCC_HandleTypeDef* hipcc, void (*notify)(void))
+{
+	if (mailbox == NULL || hipcc == NULL)
+	{
+		return false;
+	}
+
+	atomic_store(&mailbox->ready, 0);
+	atomic_store(&mailbox->open, false);
+	mailboxRing_reset(&mailbox->toLink);
+	mailboxRing_reset(&mailbox->fromLink);
+
+	_hipcc = hipcc;
+	_notify = notify;
+	if (HAL_IPCC_ActivateNotification(hipcc, SESSION_MAILBOX_CHANNEL_TO_LINK, IPCC_CHANNEL_DIR_RX,
+			_sessionMailbox_linkRx) != HAL_OK)
+	{
+		return false;
+	}
+	_mailbox = mailbox;
+	atomic_store_explicit(&mailbox->ready, SESSION_MAILBOX_READY, memory_order_release);
+
+	return true;
+}
+
+
+/* sessionMailbox_updateLink
+ *
+ * Publishes the session's state, moves messages both ways, and rings the
+ * application core's doorbell if anything changed.
+ */
+bool sessionMailbox_updateLink(void)
+{
+	bool open;
+	bool changed;
+	bool moved;
+
+	if (_mailbox == NULL)
+	{
+		return false;
+	}
+
+	open = sessionOpen();
+	changed = (atomic_load_explicit(&_mailbox->open, memory_order_relaxed) != open);
+	atomic_store_explicit(&_mailbox->open, open, memory_order_relaxed);
+
+	moved = _sessionMailbox_moveTx();
+	moved = _sessionMailbox_moveRx() || moved;
+
+	if (changed || moved)
+	{
+		mailboxDoorbell_ring(_hipcc, SESSION_MAILBOX_CHANNEL_FROM_LINK);
+	}
+
+	return moved;
+}
+
+
+/* _sessionMailbox_moveTx
+ *
+ * Moves messages from the ring to the link core into the transport layer's tx
+ * lanes, while a session is open and the message's lane has room.  A message that
+ * does not fit is left at the front of the ring, keeping the order they were sent
+ * in.
+ *
+ * Return:
+ * 	bool - true if any message was taken out of the ring
+ */
+bool _sessionMailbox_moveTx(void)
+{
+	MailboxMessage* message;
+	DesktopComSessionStatus status;
+	bool moved = false;
+
+	while (sessionOpen() && (message = mailboxRing_front(&_mailbox->toLink)) != NULL)
+	{
+		if (message->binary)
+		{
+			status = desktopAppSession_enqueueBinary((char*)message->header, message->payload, message->length,
+					message->priority);
+		}
+		else
+		{
+			status = desktopAppSession_enqueueMessage((char*)message->header, (char*)message->payload,
+					message->priority);
+		}
+		if (status == SESSION_BUFFER_FULL)
+		{
+			break;
+		}
+
+		// sent, or not sendable (too long), either way taken out
+		mailboxRing_release(&_mailbox->toLink);
+		moved = true;
+	}
+
+	return moved;
+}
+
+
+/* _sessionMailbox_moveRx
+ *
+ * Copies received messages from the session's receive queue into the ring to the
+ * application core while it has room, releasing them.
+ *
+ * Return:
+ * 	bool - true if any message was moved
+ */
+bool _sessionMailbox_moveRx(void)
+{
+	MailboxMessage* slot;
+	PacketView received;
+	bool moved = false;
+
+	while ((slot = mailboxRing_back(&_mailbox->fromLink)) != NULL
+			&& desktopAppSession_peekMessage(&received) == SESSION_OKAY)
+	{
+		memcpy(slot->header, received.header, UART_PACKET_HEADER_SIZE);
+		memcpy(slot->payload, received.payload, received.length);
+		memset(slot->payload + received.length, 0, UART_PACKET_PAYLOAD_SIZE - received.length);
+		slot->length = received.length;
+		slot->priority = SESSION_PRIORITY_BULK;
+		slot->binary = false;
+		desktopAppSession_releaseMessage();
+
+		mailboxRing_commit(&_mailbox->fromLink);
+		moved = true;
+	}
+
+	return moved;
+}
+
+
+/* _sessionMailbox_linkRx
+ *
+ * IPCC rx callback of the application core's doorbell.  Frees the channel, then
+ * calls the link core's hook.
+ */
+void _sessionMailbox_linkRx(IPCC_HandleTypeDef* hipcc, uint32_t channel, IPCC_CHANNELDirTypeDef direction)
+{
+	HAL_IPCC_NotifyCPU(hipcc, channel, IPCC_CHANNEL_DIR_RX);
+
+	if (_notify != NULL)
+	{
+		_notify();
+	}
+}
+
+
+#endif /* SESSION_MAILBOX */
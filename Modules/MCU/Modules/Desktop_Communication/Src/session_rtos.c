@@ -0,0 +1,284 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ */
+
+
+#include <session_rtos.h>
+
+#ifdef SESSION_RTOS
+
+#include <string.h>
+
+
+// Private Function Prototypes
+DesktopComSessionStatus _sessionRtos_queue(SessionRtosMessage* message, const char header[UART_PACKET_HEADER_SIZE],
+		SessionPriority priority, TickType_t timeout);
+void _sessionRtos_task(void* parameters);
+void _sessionRtos_event(void);
+void _sessionRtos_moveTx(void);
+bool _sessionRtos_moveRx(void);
+
+
+// Private Variables
+static QueueHandle_t _txQueue = NULL;				// messages from the other tasks to send
+static QueueHandle_t _rxQueue = NULL;				// messages received for the other tasks
+static TaskHandle_t _task = NULL;					// comms task
+static volatile bool _open = false;					// session open at the last update
+static volatile uint32_t _wakes = 0;				// updates by the comms task
+
+
+/* sessionRtos_init
+ *
+ * Creates the queues and the task, then takes the transport layer's callbacks.
+ */
+bool sessionRtos_init(UBaseType_t priority)
+{
+	_txQueue = xQueueCreate(SESSION_RTOS_TX_QUEUE_LENGTH, sizeof(SessionRtosMessage));
+	_rxQueue = xQueueCreate(SESSION_RTOS_RX_QUEUE_LENGTH, sizeof(SessionRtosMessage));
+	if (_txQueue == NULL || _rxQueue == NULL)
+	{
+		return false;
+	}
+
+	_open = false;
+	_wakes = 0;
+	if (xTaskCreate(_sessionRtos_task, "session", SESSION_RTOS_STACK_SIZE, NULL, priority, &_task) != pdPASS)
+	{
+		_task = NULL;
+		return false;
+	}
+
+	uartTransport_setTxCompleteCallback(_sessionRtos_event);
+	uartTransport_setRxEventCallback(_sessionRtos_event);
+
+	return true;
+}
+
+
+/* sessionRtos_send
+ *
+ * Copies the body up to its null character, zero padded, and queues it as text.
+ */
+DesktopComSessionStatus sessionRtos_send(const char header[UART_PACKET_HEADER_SIZE], const char* body,
+		SessionPriority priority, TickType_t timeout)
+{
+	SessionRtosMessage message;
+
+	memset(message.payload, 0, UART_PACKET_PAYLOAD_SIZE);
+	memcpy(message.payload, body, strnlen(body, UART_PACKET_PAYLOAD_SIZE));
+	message.length = UART_PACKET_PAYLOAD_SIZE;
+	message.binary = false;
+
+	return _sessionRtos_queue(&message, header, priority, timeout);
+}
+
+
+/* sessionRtos_sendBinary
+ *
+ * Copies the payload, zero padded, and queues it with its length.
+ */
+DesktopComSessionStatus sessionRtos_sendBinary(const char header[UART_PACKET_HEADER_SIZE], const uint8_t* payload,
+		uint16_t length, SessionPriority priority, TickType_t timeout)
+{
+	SessionRtosMessage message;
+
+	// the payload must fit in one message
+	if (length > UART_PACKET_PAYLOAD_SIZE)
+	{
+		return SESSION_ERROR;
+	}
+
+	memset(message.payload, 0, UART_PACKET_PAYLOAD_SIZE);
+	memcpy(message.payload, payload, length);
+	message.length = length;
+	message.binary = true;
+
+	return _sessionRtos_queue(&message, header, priority, timeout);
+}
+
+
+/* sessionRtos_receive
+ *
+ * Takes a message from the receive queue, and notifies the comms task if that made
+ * room in a full queue.
+ */
+DesktopComSessionStatus sessionRtos_receive(SessionRtosMessage* message, TickType_t timeout)
+{
+	if (_task == NULL)
+	{
+		return SESSION_NOT_INIT;
+	}
+
+	if (xQueueReceive(_rxQueue, message, timeout) != pdPASS)
+	{
+		return SESSION_TIMEOUT;
+	}
+	if (uxQueueSpacesAvailable(_rxQueue) == 1)
+	{
+		xTaskNotifyGive(_task);
+	}
+
+	return SESSION_OKAY;
+}
+
+
+/* sessionRtos_isOpen
+ *
+ * Returns the flag set by the comms task.
+ */
+bool sessionRtos_isOpen(void)
+{
+	return _open;
+}
+
+
+/* sessionRtos_wakes
+ *
+ * Returns the count of updates.
+ */
+uint32_t sessionRtos_wakes(void)
+{
+	return _wakes;
+}
+
+
+/* _sessionRtos_queue
+ *
+ * Completes a message with its header and priority, copies it into the send queue
+ * and notifies the comms task.
+ */
+DesktopComSessionStatus _sessionRtos_queue(SessionRtosMessage* message, const char header[UART_PACKET_HEADER_SIZE],
+		SessionPriority priority, TickType_t timeout)
+{
+	if (_task == NULL)
+	{
+		return SESSION_NOT_INIT;
+	}
+
+	memcpy(message->header, header, UART_PACKET_HEADER_SIZE);
+	message->priority = priority;
+	if (xQueueSend(_txQueue, message, timeout) != pdPASS)
+	{
+		return SESSION_TIMEOUT;
+	}
+	xTaskNotifyGive(_task);
+
+	return SESSION_OKAY;
+}
+
+
+/* _sessionRtos_task
+ *
+ * The comms task.  Updates the session and moves messages between it and the queues
+ * until there is nothing to move, then waits for a notification or the poll period.
+ * Goes round again at once if a message was moved to the receive queue, so a
+ * message held back for the room is taken in.
+ */
+void _sessionRtos_task(void* parameters)
+{
+	DesktopComSessionStatus status;
+	bool active;
+	bool moved;
+
+	for (;;)
+	{
+		_wakes++;
+
+		// a session that is open stays open, otherwise the handshake is advanced
+		status = desktopAppSession_start();
+		_open = (status == SESSION_OKAY);
+		active = (status == SESSION_OKAY || status == SESSION_BUSY);
+
+		desktopAppSession_update();
+
+		_sessionRtos_moveTx();
+		moved = _sessionRtos_moveRx();
+
+		if (!moved)
+		{
+			ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(active ? SESSION_RTOS_POLL_MS : SESSION_RTOS_CLOSED_POLL_MS));
+		}
+	}
+}
+
+
+/* _sessionRtos_event
+ *
+ * Transport layer callback, from interrupt context.  Notifies the comms task.
+ */
+void _sessionRtos_event(void)
+{
+	BaseType_t woken = pdFALSE;
+
+	vTaskNotifyGiveFromISR(_task, &woken);
+	portYIELD_FROM_ISR(woken);
+}
+
+
+/* _sessionRtos_moveTx
+ *
+ * Moves messages from the send queue into the transport layer's tx lanes, while a
+ * session is open and the message's lane has room.  A message that does not fit is
+ * left at the front of the queue, keeping the order they were sent in, until a tx
+ * complete notifies the task.
+ */
+void _sessionRtos_moveTx(void)
+{
+	SessionRtosMessage message;
+	DesktopComSessionStatus status;
+
+	while (_open && xQueuePeek(_txQueue, &message, 0) == pdPASS)
+	{
+		if (message.binary)
+		{
+			status = desktopAppSession_enqueueBinary(message.header, message.payload, message.length, message.priority);
+		}
+		else
+		{
+			status = desktopAppSession_enqueueMessage(message.header, (char*)message.payload, message.priority);
+		}
+		if (status == SESSION_BUFFER_FULL)
+		{
+			break;
+		}
+
+		// sent, or not sendable (too long), either way taken out
+		xQueueReceive(_txQueue, &message, 0);
+	}
+}
+
+
+/* _sessionRtos_moveRx
+ *
+ * Copies received messages from the session's receive queue into the RTOS receive
+ * queue while it has room, releasing them.
+ *
+ * Return:
+ * 	bool - true if any message was moved
+ */
+bool _sessionRtos_moveRx(void)
+{
+	SessionRtosMessage message;
+	PacketView received;
+	bool moved = false;
+
+	while (uxQueueSpacesAvailable(_rxQueue) > 0 && desktopAppSession_peekMessage(&received) == SESSION_OKAY)
+	{
+		memcpy(message.header, received.header, UART_PACKET_HEADER_SIZE);
+		memset(message.payload, 0, UART_PACKET_PAYLOAD_SIZE);
+		memcpy(message.payload, received.payload, received.length);
+		message.length = received.length;
+		message.binary = false;
+		message.priority = SESSION_PRIORITY_BULK;
+		desktopAppSession_releaseMessage();
+
+		xQueueSend(_rxQueue, &message, 0);
+		moved = true;
+	}
+
+	return moved;
+}
+
+
+#endif /* SESSION_RTOS */
@@ -0,0 +1,139 @@
+/*
+ * Author:  Kevin Imlay
+ * Date:  September, 2023
+ */
+
+
+#include <session_sequencer.h>
+
+#ifdef SESSION_SEQUENCER
+
+#include <stddef.h>
+
+
+// Private Function Prototypes
+void _sessionSequencer_task(void);
+void _sessionSequencer_event(void);
+
+
+// Private Variables
+static UTIL_SEQ_bm_t _taskId = 0;					// sequencer task ID bitmask of the session task
+static uint32_t _priority = 0;						// sequencer priority the task is set with
+static void (*_application)(void) = NULL;			// application hook, end of each run
+static volatile uint32_t _lastRunTick = 0;			// tick of the last run of the task
+static volatile bool _active = false;				// session open or being opened at the last run
+static uint32_t _runs = 0;							// runs of the task
+
+
+/* sessionSequencer_init
+ *
+ * Registers the task and takes the transport layer's callbacks.
+ */
+bool sessionSequencer_init(UTIL_SEQ_bm_t taskId, uint32_t priority, void (*application)(void))
+{
+	// one task
+	if (taskId == 0 || (taskId & (taskId - 1)) != 0)
+	{
+		return false;
+	}
+
+	_taskId = taskId;
+	_priority = priority;
+	_application = application;
+	_lastRunTick = HAL_GetTick();
+	_active = false;
+	_runs = 0;
+
+	UTIL_SEQ_RegTask(_taskId, UTIL_SEQ_RFU, _sessionSequencer_task);
+	uartTransport_setTxCompleteCallback(_sessionSequencer_event);
+	uartTransport_setRxEventCallback(_sessionSequencer_event);
+	UTIL_SEQ_SetTask(_taskId, _priority);
+
+	return true;
+}
+
+
+/* sessionSequencer_notify
+ *
+ * Sets the task.
+ */
+void sessionSequencer_notify(void)
+{
+	UTIL_SEQ_SetTask(_taskId, _priority);
+}
+
+
+/* sessionSequencer_idle
+ *
+ * Sets the task if the poll period for the session's state has passed since the
+ * last run.
+ */
+bool sessionSequencer_idle(void)
+{
+	uint32_t period = _active ? SESSION_SEQ_POLL_MS : SESSION_SEQ_CLOSED_POLL_MS;
+
+	if ((HAL_GetTick() - _lastRunTick) >= period)
+	{
+		UTIL_SEQ_SetTask(_taskId, _priority);
+		return true;
+	}
+
+	return false;
+}
+
+
+/* sessionSequencer_runs
+ *
+ * Returns the count of runs.
+ */
+uint32_t sessionSequencer_runs(void)
+{
+	return _runs;
+}
+
+
+/* _sessionSequencer_task
+ *
+ * The session task.  Advances the handshake, updates the session and calls the
+ * application's hook.  Runs again if the hook released a message, so that a
+ * message held back for the room is taken in (and, with a window or credit, the
+ * release is acknowledged) without waiting for the poll.
+ */
+void _sessionSequencer_task(void)
+{
+	DesktopComSessionStatus status;
+	SessionRxStats before;
+	SessionRxStats after;
+
+	_runs++;
+	_lastRunTick = HAL_GetTick();
+
+	// a session that is open stays open, otherwise the handshake is advanced
+	status = desktopAppSession_start();
+	_active = (status == SESSION_OKAY || status == SESSION_BUSY);
+
+	desktopAppSession_update();
+
+	if (_application != NULL)
+	{
+		desktopAppSession_rxStats(&before);
+		_application();
+		if (desktopAppSession_rxStats(&after) == SESSION_OKAY && after.depth < before.depth)
+		{
+			UTIL_SEQ_SetTask(_taskId, _priority);
+		}
+	}
+}
+
+
+/* _sessionSequencer_event
+ *
+ * Transport layer callback, from interrupt context.  Sets the task.
+ */
+void _sessionSequencer_event(void)
+{
+	UTIL_SEQ_SetTask(_taskId, _priority);
+}
+
+
+#endif /* SESSION_SEQUENCER */
@@ -14,8 +14,8 @@
  * character arrays into packet buffer at correct locations.
  *
  * Copies UART_PACKET_HEADER_SIZE number of bytes to the packet_buffer, then copies
- * UART_PACKET_PAYLOAD_SIZE bytes to the packet buffer offset by UART_PACKET_HEADER_SIZE
- * number of bytes.
+ * UART_PACKET_PAYLOAD_SIZE bytes to the packet buffer after the header and link
+ * segments.  The link segment is left as it is.
  */
 void composePacket(uint8_t packet_buffer[UART_PACKET_SIZE], const uint8_t header[UART_PACKET_HEADER_SIZE],
 		const uint8_t payload[UART_PACKET_PAYLOAD_SIZE])
@@ -23,7 +23,7 @@ void composePacket(uint8_t packet_buffer[UART_PACKET_SIZE], const uint8_t header
 	// Copy header into packet.
 	memcpy(packet_buffer, header, UART_PACKET_HEADER_SIZE * sizeof(uint8_t));
 	// Copy payload into packet.
-	memcpy(packet_buffer + UART_PACKET_HEADER_SIZE, payload, UART_PACKET_PAYLOAD_SIZE * sizeof(uint8_t));
+	memcpy(packet_buffer + UART_PACKET_HEADER_SIZE + UART_PACKET_LINK_SIZE, payload, UART_PACKET_PAYLOAD_SIZE * sizeof(uint8_t));
 }
 
 
@@ -41,5 +41,326 @@ void decomposePacket(uint8_t header[UART_PACKET_HEADER_SIZE], uint8_t payload[UA
 	// Copy header from packet.
 	memcpy(header, packet_buffer, UART_PACKET_HEADER_SIZE * sizeof(uint8_t));
 	// Copy payload from packet.
-	memcpy(payload, packet_buffer + UART_PACKET_HEADER_SIZE, UART_PACKET_PAYLOAD_SIZE * sizeof(uint8_t));
+	memcpy(payload, packet_buffer + UART_PACKET_HEADER_SIZE + UART_PACKET_LINK_SIZE, UART_PACKET_PAYLOAD_SIZE * sizeof(uint8_t));
+}
+
+
+/*
+ * Layout of a packet in its frame buffer.  A COBS frame starts with the COBS code
+ * byte and has the payload length byte between the link and payload segments, so
+ * the packet is encoded and decoded in place around them.  A fixed-length packet
+ * with binary payloads has the length byte in the same place.
+ */
+#ifdef UART_FRAMING_COBS
+#define FRAME_HEADER_OFFSET 1
+#define FRAME_LINK_OFFSET (FRAME_HEADER_OFFSET + UART_PACKET_HEADER_SIZE)
+#define FRAME_LENGTH_OFFSET (FRAME_LINK_OFFSET + UART_PACKET_LINK_SIZE)
+#define FRAME_PAYLOAD_OFFSET (FRAME_LENGTH_OFFSET + UART_FRAME_LENGTH_SIZE)
+#else
+#define FRAME_HEADER_OFFSET 0
+#define FRAME_LINK_OFFSET (FRAME_HEADER_OFFSET + UART_PACKET_HEADER_SIZE)
+#define FRAME_LENGTH_OFFSET (FRAME_LINK_OFFSET + UART_PACKET_LINK_SIZE)
+#define FRAME_PAYLOAD_OFFSET (FRAME_LENGTH_OFFSET + UART_PACKET_LENGTH_SIZE)
+#endif
+
+
+/* packetView_init
+ *
+ * The header segment starts the packet, followed by the link segment (if any),
+ * and the payload segment fills the rest of the packet.
+ */
+void packetView_init(PacketView* view, uint8_t packet_buffer[UART_FRAME_SIZE])
+{
+	view->header = packet_buffer + FRAME_HEADER_OFFSET;
+	view->link = packet_buffer + FRAME_LINK_OFFSET;
+	view->payload = packet_buffer + FRAME_PAYLOAD_OFFSET;
+	view->length = UART_PACKET_PAYLOAD_SIZE;
+}
+
+
+/* packetView_frame
+ *
+ * The header segment is at a fixed offset from the start of the frame.
+ */
+uint8_t* packetView_frame(const PacketView* view)
+{
+	return view->header - FRAME_HEADER_OFFSET;
+}
+
+
+/* textPayloadLength
+ *
+ * Counts back over the zero bytes that pad the end of the payload.
+ */
+uint16_t textPayloadLength(const uint8_t frame_buffer[UART_FRAME_SIZE])
+{
+	uint16_t payloadLength = UART_PACKET_PAYLOAD_SIZE;
+
+	while (payloadLength > 0 && frame_buffer[FRAME_PAYLOAD_OFFSET + payloadLength - 1] == 0)
+	{
+		payloadLength--;
+	}
+
+	return payloadLength;
+}
+
+
+#ifdef UART_FRAMING_COBS
+
+/* receivedPayloadLength
+ *
+ * The length byte is left in place by decodeFrame().
+ */
+uint16_t receivedPayloadLength(const uint8_t frame_buffer[UART_FRAME_SIZE])
+{
+	return frame_buffer[FRAME_LENGTH_OFFSET];
+}
+
+
+/* encodeFrame
+ *
+ * The packet bytes sit one byte into the buffer, after room for the first COBS
+ * code byte.  COBS replaces each zero byte with the distance to the next zero
+ * byte (or to the end of the data), and every other byte keeps its position, so
+ * encoding in place only writes the code bytes.  Blocks are never longer than
+ * 254 bytes, as a frame is far shorter, so no extra code bytes are needed.
+ */
+uint16_t encodeFrame(uint8_t frame_buffer[UART_FRAME_SIZE], uint16_t payloadLength)
+{
+	uint16_t end;
+	uint16_t code = 0;
+	uint16_t i;
+
+	// bytes past the payload length are not sent
+	if (payloadLength > UART_PACKET_PAYLOAD_SIZE)
+	{
+		payloadLength = UART_PACKET_PAYLOAD_SIZE;
+	}
+	frame_buffer[FRAME_LENGTH_OFFSET] = (uint8_t)payloadLength;
+	end = FRAME_PAYLOAD_OFFSET + payloadLength;
+
+	// link each zero byte (and the end of the data) to the one before it
+	for (i = 1; i < end; i++)
+	{
+		if (frame_buffer[i] == UART_FRAME_DELIMITER)
+		{
+			frame_buffer[code] = (uint8_t)(i - code);
+			code = i;
+		}
+	}
+	frame_buffer[code] = (uint8_t)(end - code);
+
+	// delimit the frame
+	frame_buffer[end] = UART_FRAME_DELIMITER;
+
+	return end + 1;
+}
+
+
+/* frameLength
+ *
+ * An encoded frame holds no zero bytes before its delimiter.
+ */
+uint16_t frameLength(const uint8_t frame_buffer[UART_FRAME_SIZE])
+{
+	uint16_t length = 0;
+
+	while (length < UART_FRAME_SIZE - 1 && frame_buffer[length] != UART_FRAME_DELIMITER)
+	{
+		length++;
+	}
+
+	return length + 1;
+}
+
+
+/* decodeFrame
+ *
+ * The inverse of encodeFrame():  following the chain of code bytes from the
+ * first, each code byte is put back to zero (the first is not part of the
+ * packet).  The frame is
+ * well formed if the chain ends exactly at the end of the frame and the length
+ * byte agrees with the number of payload bytes received.
+ */
+bool decodeFrame(uint8_t frame_buffer[UART_FRAME_SIZE], uint16_t length)
+{
+	uint16_t code = 0;
+	uint16_t next;
+	uint16_t payloadLength;
+
+	// too short to hold a header and length, or too long to be a frame
+	if (length < FRAME_PAYLOAD_OFFSET || length > UART_FRAME_SIZE - 1)
+	{
+		return false;
+	}
+
+	// follow the chain of code bytes, restoring the zero bytes
+	while (1)
+	{
+		next = code + frame_buffer[code];
+
+		if (next == code || next > length)
+		{
+			return false;
+		}
+
+		frame_buffer[code] = 0;
+
+		if (next == length)
+		{
+			break;
+		}
+		code = next;
+	}
+
+	// check the length byte against the payload received
+	payloadLength = length - FRAME_PAYLOAD_OFFSET;
+	if (frame_buffer[FRAME_LENGTH_OFFSET] != payloadLength)
+	{
+		return false;
+	}
+
+	// zero the unused payload so it reads as a padded fixed-length payload
+	memset(frame_buffer + length, 0, UART_FRAME_SIZE - length);
+	return true;
+}
+
+#elif defined(UART_PAYLOAD_BINARY)
+
+/* receivedPayloadLength
+ *
+ * The length byte is checked by decodeFrame().
+ */
+uint16_t receivedPayloadLength(const uint8_t frame_buffer[UART_FRAME_SIZE])
+{
+	return frame_buffer[FRAME_LENGTH_OFFSET];
+}
+
+
+/* encodeFrame
+ *
+ * A fixed-length packet is sent as it is, once the payload length is recorded
+ * and the bytes past it are zeroed.
+ */
+uint16_t encodeFrame(uint8_t frame_buffer[UART_FRAME_SIZE], uint16_t payloadLength)
+{
+	if (payloadLength > UART_PACKET_PAYLOAD_SIZE)
+	{
+		payloadLength = UART_PACKET_PAYLOAD_SIZE;
+	}
+	frame_buffer[FRAME_LENGTH_OFFSET] = (uint8_t)payloadLength;
+	memset(frame_buffer + FRAME_PAYLOAD_OFFSET + payloadLength, 0, UART_PACKET_PAYLOAD_SIZE - payloadLength);
+
+	return UART_FRAME_SIZE;
+}
+
+
+/* frameLength
+ *
+ * Every fixed-length frame is UART_FRAME_SIZE bytes.
+ */
+uint16_t frameLength(const uint8_t frame_buffer[UART_FRAME_SIZE])
+{
+	(void)frame_buffer;
+	return UART_FRAME_SIZE;
+}
+
+
+/* decodeFrame
+ *
+ * A fixed-length packet is received as it is, and well formed if complete and
+ * its length byte is within the payload.  Payload bytes past the length are
+ * zeroed.
+ */
+bool decodeFrame(uint8_t frame_buffer[UART_FRAME_SIZE], uint16_t length)
+{
+	uint16_t payloadLength = frame_buffer[FRAME_LENGTH_OFFSET];
+
+	if (length != UART_FRAME_SIZE || payloadLength > UART_PACKET_PAYLOAD_SIZE)
+	{
+		return false;
+	}
+
+	memset(frame_buffer + FRAME_PAYLOAD_OFFSET + payloadLength, 0, UART_PACKET_PAYLOAD_SIZE - payloadLength);
+	return true;
+}
+
+#else
+
+/* receivedPayloadLength
+ *
+ * Fixed-length packets always carry a full payload.
+ */
+uint16_t receivedPayloadLength(const uint8_t frame_buffer[UART_FRAME_SIZE])
+{
+	(void)frame_buffer;
+	return UART_PACKET_PAYLOAD_SIZE;
+}
+
+
+/* encodeFrame
+ *
+ * A fixed-length packet is sent as it is, with its full payload.
+ */
+uint16_t encodeFrame(uint8_t frame_buffer[UART_FRAME_SIZE], uint16_t payloadLength)
+{
+	(void)frame_buffer;
+	(void)payloadLength;
+	return UART_FRAME_SIZE;
+}
+
+
+/* frameLength
+ *
+ * Every fixed-length frame is UART_FRAME_SIZE bytes.
+ */
+uint16_t frameLength(const uint8_t frame_buffer[UART_FRAME_SIZE])
+{
+	(void)frame_buffer;
+	return UART_FRAME_SIZE;
+}
+
+
+/* decodeFrame
+ *
+ * A fixed-length packet is received as it is, and well formed if complete.
+ */
+bool decodeFrame(uint8_t frame_buffer[UART_FRAME_SIZE], uint16_t length)
+{
+	(void)frame_buffer;
+	return length == UART_FRAME_SIZE;
+}
+
+#endif
+
+
+/* packSevenBit
+ *
+ * Shifts the bytes into an accumulator and takes characters out of it 7 bits at a
+ * time, the last character holding what is left.
+ */
+uint16_t packSevenBit(const uint8_t* bytes, uint16_t count, uint8_t* chars)
+{
+	uint32_t bits = 0;		// bits not yet taken out, least significant first
+	uint8_t held = 0;		// number of bits held
+	uint16_t length = 0;
+	uint16_t i;
+
+	for (i = 0; i < count; i++)
+	{
+		bits |= (uint32_t)bytes[i] << held;
+		held += 8;
+		while (held >= 7)
+		{
+			chars[length++] = (uint8_t)(bits & 0x7F);
+			bits >>= 7;
+			held -= 7;
+		}
+	}
+	if (held > 0)
+	{
+		chars[length++] = (uint8_t)(bits & 0x7F);
+	}
+
+	return length;
 }